@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_hash.h"
+#include "sys/hashtable.h"
+#include "xio_rcu_htbl.h"
+
+#define DEFAULT_ENTRIES		10000
+#define DEFAULT_DURATION_MS	1000
+#define MAX_THREADS		64
+
+/*
+ * multi threaded lookup throughput of the id caches used for sessions and
+ * nexuses: the former fixed size table behind a global spinlock versus the
+ * resizable rcu table. every run is repeated with one extra thread that
+ * keeps removing and re-inserting entries, forcing grace periods.
+ */
+
+/*---------------------------------------------------------------------------*/
+/* the former cache - fixed buckets, one lock				     */
+/*---------------------------------------------------------------------------*/
+struct locked_entry {
+	HT_ENTRY(locked_entry, xio_key_int32) htbl;
+};
+
+static HT_HEAD(, locked_entry, HASHTABLE_PRIME_SMALL) locked_cache;
+static spinlock_t locked_lock;
+static struct locked_entry *locked_entries;
+
+static void *locked_lookup(uint32_t id)
+{
+	struct locked_entry	*e;
+	struct xio_key_int32	key = { id, {0} };
+
+	spin_lock(&locked_lock);
+	HT_LOOKUP(&locked_cache, &key, e, htbl);
+	spin_unlock(&locked_lock);
+
+	return e;
+}
+
+static void locked_insert(uint32_t id)
+{
+	struct locked_entry	*e = &locked_entries[id];
+	struct xio_key_int32	key = { id, {0} };
+
+	spin_lock(&locked_lock);
+	HT_INSERT(&locked_cache, &key, e, htbl);
+	spin_unlock(&locked_lock);
+}
+
+static void locked_remove(uint32_t id)
+{
+	struct locked_entry	*e = &locked_entries[id];
+
+	spin_lock(&locked_lock);
+	HT_REMOVE(&locked_cache, e, locked_entry, htbl);
+	spin_unlock(&locked_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* the rcu cache							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_rcu_htbl rcu_cache;
+
+static void *rcu_lookup(uint32_t id)
+{
+	return xio_rcu_htbl_lookup(&rcu_cache, id);
+}
+
+static void rcu_insert(uint32_t id)
+{
+	xio_rcu_htbl_insert(&rcu_cache, id, &locked_entries[id]);
+}
+
+static void rcu_remove(uint32_t id)
+{
+	xio_rcu_htbl_remove(&rcu_cache, id);
+}
+
+/*---------------------------------------------------------------------------*/
+/* bench								     */
+/*---------------------------------------------------------------------------*/
+struct cache_ops {
+	const char	*name;
+	void		*(*lookup)(uint32_t id);
+	void		(*insert)(uint32_t id);
+	void		(*remove)(uint32_t id);
+};
+
+static struct cache_ops caches[] = {
+	{ "locked", locked_lookup, locked_insert, locked_remove },
+	{ "rcu",    rcu_lookup,    rcu_insert,    rcu_remove    },
+};
+
+struct thread_data {
+	pthread_t		thread;
+	struct cache_ops	*ops;
+	uint64_t		ops_nr;
+	uint64_t		misses;
+	uint32_t		seed;
+	uint32_t		pad;
+};
+
+static volatile int	stop;
+static uint32_t		entries = DEFAULT_ENTRIES;
+
+/*---------------------------------------------------------------------------*/
+/* reader_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *reader_thread(void *arg)
+{
+	struct thread_data	*td = arg;
+	uint64_t		n = 0, misses = 0;
+	uint32_t		seed = td->seed;
+
+	while (!stop) {
+		seed = seed * 1103515245 + 12345;
+		if (td->ops->lookup((seed >> 8) % entries) == NULL)
+			misses++;
+		n++;
+	}
+	td->ops_nr = n;
+	td->misses = misses;
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* writer_thread - churns the upper half of the key space		     */
+/*---------------------------------------------------------------------------*/
+static void *writer_thread(void *arg)
+{
+	struct thread_data	*td = arg;
+	uint64_t		n = 0;
+	uint32_t		seed = td->seed, id;
+
+	while (!stop) {
+		seed = seed * 1103515245 + 12345;
+		id = entries / 2 + (seed >> 8) % (entries - entries / 2);
+		td->ops->remove(id);
+		td->ops->insert(id);
+		n++;
+	}
+	td->ops_nr = n;
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* run									     */
+/*---------------------------------------------------------------------------*/
+static void run(struct cache_ops *ops, int threads_nr, int with_writer,
+		int duration_ms)
+{
+	struct thread_data	td[MAX_THREADS + 1];
+	uint64_t		total = 0, misses = 0;
+	int			i, nr = threads_nr + with_writer;
+
+	memset(td, 0, sizeof(td));
+	stop = 0;
+	for (i = 0; i < nr; i++) {
+		td[i].ops  = ops;
+		td[i].seed = i + 1;
+		pthread_create(&td[i].thread, NULL,
+			       i < threads_nr ? reader_thread : writer_thread,
+			       &td[i]);
+	}
+	usleep(duration_ms * 1000);
+	stop = 1;
+	for (i = 0; i < nr; i++)
+		pthread_join(td[i].thread, NULL);
+
+	for (i = 0; i < threads_nr; i++) {
+		total  += td[i].ops_nr;
+		misses += td[i].misses;
+	}
+	printf("%-7s threads=%-3d writer=%d lookups=%8.2f Mops/s " \
+	       "misses=%.3f%%",
+	       ops->name, threads_nr, with_writer,
+	       total / (duration_ms * 1000.0),
+	       total ? 100.0 * misses / total : 0.0);
+	if (with_writer)
+		printf(" updates=%.2f Mops/s",
+		       td[threads_nr].ops_nr / (duration_ms * 1000.0));
+	printf("\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	int		max_threads, duration_ms = DEFAULT_DURATION_MS;
+	int		threads_nr, with_writer;
+	uint32_t	i;
+	size_t		c;
+
+	if (argc > 1 && atoi(argv[1]) > 1)
+		entries = atoi(argv[1]);
+	if (argc > 2 && atoi(argv[2]) > 0)
+		duration_ms = atoi(argv[2]);
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (argc > 3 && atoi(argv[3]) > 0)
+		max_threads = atoi(argv[3]);
+	if (max_threads > MAX_THREADS)
+		max_threads = MAX_THREADS;
+
+	printf("entries=%u duration=%dms max threads=%d\n",
+	       entries, duration_ms, max_threads);
+
+	xio_init();
+
+	locked_entries = calloc(entries, sizeof(*locked_entries));
+	if (!locked_entries) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	HT_INIT(&locked_cache, xio_int32_hash, xio_int32_cmp, xio_int32_cp);
+	spin_lock_init(&locked_lock);
+	if (xio_rcu_htbl_init(&rcu_cache, 128)) {
+		fprintf(stderr, "rcu table init failed\n");
+		exit(1);
+	}
+	for (i = 0; i < entries; i++) {
+		locked_insert(i);
+		rcu_insert(i);
+	}
+
+	for (with_writer = 0; with_writer <= 1; with_writer++) {
+		for (threads_nr = 1; threads_nr <= max_threads;
+		     threads_nr <<= 1) {
+			for (c = 0; c < sizeof(caches) / sizeof(caches[0]); c++)
+				run(&caches[c], threads_nr, with_writer,
+				    duration_ms);
+		}
+	}
+
+	xio_rcu_htbl_destroy(&rcu_cache);
+	free(locked_entries);
+
+	xio_shutdown();
+
+	return 0;
+}
@@ -0,0 +1,1081 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#include "libxio.h"
+#include "xio_perftest_histogram.h"
+
+/*
+ * connection scaling benchmark. for every connection count a fresh server
+ * and client process pair is forked, the client opens that many sessions,
+ * one connection each, on a single context over tcp loopback and reports:
+ *  - establishment rate with a bounded number of connects in flight
+ *  - rss and hugetlb growth per connection on both sides
+ *  - wakeup lateness of a periodic timer on the client context, without
+ *    connections and with all of them idle
+ *  - ping-pong latency when only a fraction of the connections is active
+ * linear scans over per-context lists and oversized per-connection pools
+ * show up as columns that grow with the connection count.
+ */
+
+#define DEFAULT_PORT		2161
+#define DEFAULT_COUNTS		"1,100,1000,10000,50000"
+#define DEFAULT_WINDOW		256
+#define DEFAULT_ACTIVE		0.01
+#define DEFAULT_ACTIVE_MS	1000
+#define DEFAULT_PROBE_MS	1000
+#define DEFAULT_PROBE_US	1000
+#define SRC_ADDR_CONNS		16384
+#define FD_SLACK		256
+#define NSEC_PER_SEC		1000000000ULL
+#define NSEC_PER_MSEC		1000000ULL
+#define NSEC_PER_USEC		1000ULL
+
+enum cs_format {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+};
+
+enum cs_status {
+	STATUS_OK,
+	STATUS_PARTIAL,
+	STATUS_FD_LIMIT,
+	STATUS_FAILED,
+};
+
+enum cs_stage {
+	STAGE_CONNECT,
+	STAGE_PROBE,
+	STAGE_ACTIVE,
+	STAGE_TEARDOWN,
+};
+
+struct cs_params {
+	int			*counts;
+	double			active;
+	int			counts_nr;
+	int			port;
+	int			window;
+	int			active_ms;
+	int			probe_ms;
+	int			probe_us;
+	int			single_stream;
+	enum cs_format		format;
+};
+
+/* what a client process reports back to the parent through a pipe */
+struct cs_result {
+	uint64_t		conns;
+	uint64_t		established;
+	uint64_t		cli_rss;
+	uint64_t		cli_huge;
+	uint64_t		srv_rss;
+	uint64_t		srv_huge;
+	uint64_t		base_p50;
+	uint64_t		base_p99;
+	uint64_t		idle_p50;
+	uint64_t		idle_p99;
+	uint64_t		idle_max;
+	uint64_t		active;
+	uint64_t		rtt_p50;
+	uint64_t		rtt_p99;
+	uint64_t		rtt_p999;
+	double			connect_rate;
+	double			req_rate;
+	double			teardown_rate;
+	enum cs_status		status;
+	int			term_signal;
+};
+
+struct cs_conn {
+	struct xio_session	*session;
+	struct xio_connection	*conn;
+	struct xio_msg		req;
+	uint64_t		sent_ns;
+	int			established;
+	int			failed;
+};
+
+struct cs_client {
+	struct cs_params	*params;
+	struct xio_context	*ctx;
+	struct cs_conn		*conns;
+	struct perf_hist	*hist;
+	uint64_t		probe_next;
+	uint64_t		probe_end;
+	uint64_t		active_end;
+	uint64_t		completed;
+	int			conns_nr;
+	int			next;
+	int			connected;
+	int			done;
+	int			in_flight;
+	int			torn_down;
+	int			outstanding;
+	int			probe_fd;
+	enum cs_stage		stage;
+	int			pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct cs_params		g_params;
+static struct cs_client		g_client;
+static struct xio_context	*g_srv_ctx;
+static struct xio_msg		*g_free_rsps;
+
+static struct option const long_options[] = {
+	{ "counts",		1, 0, 'n' },
+	{ "port",		1, 0, 'p' },
+	{ "window",		1, 0, 'w' },
+	{ "active",		1, 0, 'a' },
+	{ "active-time",	1, 0, 'd' },
+	{ "probe-time",		1, 0, 'P' },
+	{ "probe-interval",	1, 0, 'i' },
+	{ "single-stream",	0, 0, 's' },
+	{ "format",		1, 0, 'f' },
+	{ "help",		0, 0, 'h' },
+	{ 0,			0, 0, 0 },
+};
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	printf("Usage:\n");
+	printf("  %s [OPTIONS]\n", argv0);
+	printf("\n");
+	printf("Options:\n");
+	printf("\t-n, --counts=<list>         ");
+	printf("connection counts (default %s)\n", DEFAULT_COUNTS);
+	printf("\t-p, --port=<port>           ");
+	printf("first loopback port used (default %d)\n", DEFAULT_PORT);
+	printf("\t-w, --window=<num>          ");
+	printf("connects in flight (default %d)\n", DEFAULT_WINDOW);
+	printf("\t-a, --active=<fraction>     ");
+	printf("fraction of connections doing ping-pong (default %.2f)\n",
+	       DEFAULT_ACTIVE);
+	printf("\t-d, --active-time=<ms>      ");
+	printf("ping-pong duration (default %d)\n", DEFAULT_ACTIVE_MS);
+	printf("\t-P, --probe-time=<ms>       ");
+	printf("event loop probe duration (default %d)\n", DEFAULT_PROBE_MS);
+	printf("\t-i, --probe-interval=<us>   ");
+	printf("event loop probe period (default %d)\n", DEFAULT_PROBE_US);
+	printf("\t-s, --single-stream         ");
+	printf("one socket per tcp connection instead of two\n");
+	printf("\t-f, --format=<type>         ");
+	printf("text or csv (default text)\n");
+	printf("\t-h, --help                  ");
+	printf("display this help and exit\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* get_time_ns								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* proc_mem - VmRSS and HugetlbPages of a process in bytes		     */
+/*---------------------------------------------------------------------------*/
+static void proc_mem(pid_t pid, uint64_t *rss, uint64_t *huge)
+{
+	char		path[64];
+	char		line[256];
+	FILE		*fp;
+	uint64_t	val;
+
+	*rss = 0;
+	*huge = 0;
+
+	sprintf(path, "/proc/%d/status", (int)pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "VmRSS: %" SCNu64, &val) == 1)
+			*rss = val * 1024;
+		else if (sscanf(line, "HugetlbPages: %" SCNu64, &val) == 1)
+			*huge = val * 1024;
+	}
+	fclose(fp);
+}
+
+/*---------------------------------------------------------------------------*/
+/* per_conn								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t per_conn(uint64_t after, uint64_t before, uint64_t n)
+{
+	return (after > before && n) ? (after - before) / n : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* parse_counts								     */
+/*---------------------------------------------------------------------------*/
+static int parse_counts(const char *arg, struct cs_params *params)
+{
+	char		*str, *token, *saveptr, *end;
+	long		val;
+
+	str = strdup(arg);
+	if (!str)
+		return -1;
+
+	params->counts_nr = 0;
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		val = strtol(token, &end, 0);
+		if (*end == 'k' || *end == 'K') {
+			val *= 1000;
+			end++;
+		}
+		if (end == token || *end || val < 1)
+			goto cleanup;
+		params->counts = realloc(params->counts,
+					 (params->counts_nr + 1) *
+					 sizeof(*params->counts));
+		if (!params->counts)
+			goto cleanup;
+		params->counts[params->counts_nr++] = (int)val;
+	}
+	free(str);
+
+	return params->counts_nr ? 0 : -1;
+
+cleanup:
+	free(str);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* set_tcp_options							     */
+/*---------------------------------------------------------------------------*/
+static void set_tcp_options(struct cs_params *params)
+{
+	int	optval;
+
+	optval = 1;
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_NO_DELAY,
+		    &optval, sizeof(optval));
+	if (params->single_stream) {
+		optval = 0;
+		xio_set_opt(NULL, XIO_OPTLEVEL_TCP,
+			    XIO_OPTNAME_TCP_DUAL_STREAM,
+			    &optval, sizeof(optval));
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_request							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_request(struct xio_session *session,
+			  struct xio_msg *req,
+			  int more_in_batch,
+			  void *cb_user_context)
+{
+	struct xio_msg	*rsp = g_free_rsps;
+
+	if (rsp)
+		g_free_rsps = rsp->user_context;
+	else
+		rsp = calloc(1, sizeof(*rsp));
+	if (!rsp)
+		return 0;
+
+	rsp->request		= req;
+	rsp->more_in_batch	= more_in_batch;
+	rsp->in.header.iov_len	= 0;
+	rsp->out.header.iov_len	= 0;
+	vmsg_sglist_set_nents(&rsp->in, 0);
+	vmsg_sglist_set_nents(&rsp->out, 0);
+
+	if (xio_send_response(rsp) == -1) {
+		rsp->user_context = g_free_rsps;
+		g_free_rsps = rsp;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_send_response_complete					     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_send_response_complete(struct xio_session *session,
+					 struct xio_msg *rsp,
+					 void *cb_user_context)
+{
+	rsp->user_context = g_free_rsps;
+	g_free_rsps = rsp;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_msg_error							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_msg_error(struct xio_session *session,
+			    enum xio_status error, struct xio_msg *rsp,
+			    void *cb_user_context)
+{
+	return srv_on_send_response_complete(session, rsp, cb_user_context);
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_session_event(struct xio_session *session,
+				struct xio_session_event_data *event_data,
+				void *cb_user_context)
+{
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_new_session(struct xio_session *session,
+			      struct xio_new_session_req *req,
+			      void *cb_user_context)
+{
+	/* every connection stays on the listening context */
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  srv_on_session_event,
+	.on_new_session			=  srv_on_new_session,
+	.on_msg_send_complete		=  srv_on_send_response_complete,
+	.on_msg				=  srv_on_request,
+	.on_msg_error			=  srv_on_msg_error,
+	.assign_data_in_buf		=  NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_signal							     */
+/*---------------------------------------------------------------------------*/
+static void srv_on_signal(int fd, int events, void *data)
+{
+	struct signalfd_siginfo	info;
+
+	if (read(fd, &info, sizeof(info)) == sizeof(info))
+		xio_context_stop_loop(g_srv_ctx, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_server - child process, signals readiness on ready_fd		     */
+/*---------------------------------------------------------------------------*/
+static int run_server(struct cs_params *params, int port, int ready_fd)
+{
+	struct xio_server	*server;
+	struct xio_msg		*rsp;
+	char			url[64];
+	char			ready = 1;
+	sigset_t		sigs;
+	int			sig_fd;
+
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGTERM);
+	sigprocmask(SIG_BLOCK, &sigs, NULL);
+	sig_fd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sig_fd == -1)
+		return -1;
+
+	xio_init();
+	set_tcp_options(params);
+
+	g_srv_ctx = xio_context_create(NULL, 0, -1);
+	if (!g_srv_ctx)
+		goto cleanup;
+
+	sprintf(url, "tcp://127.0.0.1:%d", port);
+	server = xio_bind(g_srv_ctx, &server_ops, url, NULL, 0, NULL);
+	if (!server) {
+		fprintf(stderr, "failed to bind %s. %s\n", url,
+			xio_strerror(xio_errno()));
+		xio_context_destroy(g_srv_ctx);
+		goto cleanup;
+	}
+	xio_context_add_ev_handler(g_srv_ctx, sig_fd, XIO_POLLIN,
+				   srv_on_signal, NULL);
+
+	if (write(ready_fd, &ready, sizeof(ready)) != sizeof(ready))
+		goto unbind;
+
+	xio_context_run_loop(g_srv_ctx, XIO_INFINITE);
+
+unbind:
+	xio_context_del_ev_handler(g_srv_ctx, sig_fd);
+	xio_unbind(server);
+	xio_context_destroy(g_srv_ctx);
+
+	while ((rsp = g_free_rsps)) {
+		g_free_rsps = rsp->user_context;
+		free(rsp);
+	}
+
+cleanup:
+	xio_shutdown();
+	close(sig_fd);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* check_connect_done							     */
+/*---------------------------------------------------------------------------*/
+static void connect_more(struct cs_client *cl);
+
+static void check_connect_done(struct cs_client *cl)
+{
+	cl->in_flight--;
+	if (++cl->done == cl->conns_nr)
+		xio_context_stop_loop(cl->ctx, 1);
+	else
+		connect_more(cl);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct cs_client	*cl = &g_client;
+	struct cs_conn		*c = cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		c->established = 1;
+		cl->connected++;
+		check_connect_done(cl);
+		break;
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+	case XIO_SESSION_CONNECTION_DISCONNECTED_EVENT:
+	case XIO_SESSION_CONNECTION_CLOSED_EVENT:
+	case XIO_SESSION_REJECT_EVENT:
+		if (c->established || c->failed)
+			break;
+		c->failed = 1;
+		check_connect_done(cl);
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		c->conn = NULL;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		cl->torn_down++;
+		if (cl->stage == STAGE_TEARDOWN &&
+		    cl->torn_down == cl->connected)
+			xio_context_stop_loop(cl->ctx, 1);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* send_ping								     */
+/*---------------------------------------------------------------------------*/
+static int send_ping(struct cs_conn *c)
+{
+	c->req.in.header.iov_len	= 0;
+	c->req.out.header.iov_len	= 0;
+	vmsg_sglist_set_nents(&c->req.in, 0);
+	vmsg_sglist_set_nents(&c->req.out, 0);
+
+	c->sent_ns = get_time_ns();
+
+	return xio_send_request(c->conn, &c->req);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *msg,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	struct cs_client	*cl = &g_client;
+	struct cs_conn		*c = cb_user_context;
+	uint64_t		now = get_time_ns();
+
+	perf_hist_record(cl->hist, now - c->sent_ns);
+	cl->completed++;
+
+	xio_release_response(msg);
+
+	if (now < cl->active_end && send_ping(c) == 0)
+		return 0;
+
+	if (--cl->outstanding == 0)
+		xio_context_stop_loop(cl->ctx, 1);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error, struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct cs_client	*cl = &g_client;
+
+	if (--cl->outstanding == 0)
+		xio_context_stop_loop(cl->ctx, 1);
+
+	return 0;
+}
+
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_session_established		=  NULL,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error
+};
+
+/*---------------------------------------------------------------------------*/
+/* connect_more - keeps up to "window" connects in flight		     */
+/*---------------------------------------------------------------------------*/
+static void connect_more(struct cs_client *cl)
+{
+	struct xio_session_params	ses_params;
+	struct cs_conn			*c;
+	char				url[64];
+	char				out_addr[32];
+
+	sprintf(url, "tcp://127.0.0.1:%d", cl->params->port);
+	memset(&ses_params, 0, sizeof(ses_params));
+	ses_params.type		= XIO_SESSION_CLIENT;
+	ses_params.ses_ops	= &ses_ops;
+	ses_params.uri		= url;
+
+	while (cl->in_flight < cl->params->window &&
+	       cl->next < cl->conns_nr) {
+		c = &cl->conns[cl->next];
+		/* a loopback source address runs out of ephemeral ports
+		 * well below the largest counts, so rotate over 127.0.0.x
+		 */
+		sprintf(out_addr, "127.0.0.%d",
+			1 + (cl->next / SRC_ADDR_CONNS) % 254);
+		cl->next++;
+		cl->in_flight++;
+
+		ses_params.user_context = c;
+		c->session = xio_session_create(&ses_params);
+		if (c->session)
+			c->conn = xio_connect(c->session, cl->ctx, 0,
+					      out_addr, c);
+		if (!c->conn) {
+			c->failed = 1;
+			check_connect_done(cl);
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_probe								     */
+/*---------------------------------------------------------------------------*/
+static void on_probe(int fd, int events, void *data)
+{
+	struct cs_client	*cl = data;
+	uint64_t		expirations, now;
+
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+
+	/* lateness of the most recent expiration, missed ones are counted
+	 * by the timer and skipped
+	 */
+	now = get_time_ns();
+	cl->probe_next += (expirations - 1) *
+			  (cl->params->probe_us * NSEC_PER_USEC);
+	perf_hist_record(cl->hist, now - cl->probe_next);
+	cl->probe_next += cl->params->probe_us * NSEC_PER_USEC;
+
+	if (now >= cl->probe_end)
+		xio_context_stop_loop(cl->ctx, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_probe - wakeup lateness of a periodic timer on the client context     */
+/*---------------------------------------------------------------------------*/
+static void run_probe(struct cs_client *cl, uint64_t *p50, uint64_t *p99,
+		      uint64_t *max)
+{
+	struct itimerspec	its;
+	uint64_t		period = cl->params->probe_us * NSEC_PER_USEC;
+
+	perf_hist_reset(cl->hist);
+	cl->stage = STAGE_PROBE;
+	cl->probe_next = get_time_ns() + period;
+	cl->probe_end = cl->probe_next + cl->params->probe_ms * NSEC_PER_MSEC;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec	= cl->probe_next / NSEC_PER_SEC;
+	its.it_value.tv_nsec	= cl->probe_next % NSEC_PER_SEC;
+	its.it_interval.tv_sec	= period / NSEC_PER_SEC;
+	its.it_interval.tv_nsec	= period % NSEC_PER_SEC;
+	timerfd_settime(cl->probe_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+	while (get_time_ns() < cl->probe_end)
+		xio_context_run_loop(cl->ctx, 100);
+
+	memset(&its, 0, sizeof(its));
+	timerfd_settime(cl->probe_fd, 0, &its, NULL);
+
+	*p50 = perf_hist_percentile(cl->hist, 50.0);
+	*p99 = perf_hist_percentile(cl->hist, 99.0);
+	*max = cl->hist->count ? cl->hist->max : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_active - ping-pong on a fraction of the connections		     */
+/*---------------------------------------------------------------------------*/
+static void run_active(struct cs_client *cl, struct cs_result *res)
+{
+	uint64_t	start, deadline;
+	int		i, active;
+
+	active = (int)(cl->connected * cl->params->active);
+	if (active < 1)
+		active = 1;
+
+	perf_hist_reset(cl->hist);
+	cl->stage = STAGE_ACTIVE;
+	cl->completed = 0;
+	start = get_time_ns();
+	cl->active_end = start + cl->params->active_ms * NSEC_PER_MSEC;
+
+	for (i = 0; i < cl->conns_nr && cl->outstanding < active; i++) {
+		if (!cl->conns[i].established || !cl->conns[i].conn)
+			continue;
+		if (send_ping(&cl->conns[i]) == 0)
+			cl->outstanding++;
+	}
+	res->active = cl->outstanding;
+
+	deadline = cl->active_end + 5 * NSEC_PER_SEC;
+	while (cl->outstanding > 0 && get_time_ns() < deadline)
+		xio_context_run_loop(cl->ctx, 100);
+
+	res->req_rate	= cl->completed * 1e9 / (get_time_ns() - start);
+	res->rtt_p50	= perf_hist_percentile(cl->hist, 50.0);
+	res->rtt_p99	= perf_hist_percentile(cl->hist, 99.0);
+	res->rtt_p999	= perf_hist_percentile(cl->hist, 99.9);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_client - child process, writes a cs_result to result_fd		     */
+/*---------------------------------------------------------------------------*/
+static int run_client(struct cs_params *params, int conns_nr, int port,
+		      pid_t srv_pid, int result_fd)
+{
+	struct cs_client	*cl = &g_client;
+	struct cs_result	res;
+	uint64_t		cli_rss, cli_huge, srv_rss, srv_huge;
+	uint64_t		start, deadline, idle_max;
+	int			i;
+
+	memset(&res, 0, sizeof(res));
+	res.conns	= conns_nr;
+	res.status	= STATUS_FAILED;
+
+	xio_init();
+	set_tcp_options(params);
+
+	cl->params	= params;
+	cl->conns_nr	= conns_nr;
+	cl->conns	= calloc(conns_nr, sizeof(*cl->conns));
+	cl->hist	= malloc(sizeof(*cl->hist));
+	cl->ctx		= xio_context_create(NULL, 0, -1);
+	cl->probe_fd	= timerfd_create(CLOCK_MONOTONIC,
+					 TFD_NONBLOCK | TFD_CLOEXEC);
+	params->port	= port;
+	if (!cl->conns || !cl->hist || !cl->ctx || cl->probe_fd == -1 ||
+	    xio_context_add_ev_handler(cl->ctx, cl->probe_fd, XIO_POLLIN,
+				       on_probe, cl))
+		goto cleanup;
+
+	/* baseline: event loop without connections, memory before them */
+	run_probe(cl, &res.base_p50, &res.base_p99, &idle_max);
+	proc_mem(getpid(), &cli_rss, &cli_huge);
+	proc_mem(srv_pid, &srv_rss, &srv_huge);
+
+	cl->stage = STAGE_CONNECT;
+	start = get_time_ns();
+	connect_more(cl);
+	while (cl->done < cl->conns_nr)
+		xio_context_run_loop(cl->ctx, 100);
+	res.connect_rate = cl->connected * 1e9 / (get_time_ns() - start);
+	res.established	 = cl->connected;
+
+	proc_mem(getpid(), &res.cli_rss, &res.cli_huge);
+	res.cli_rss  = per_conn(res.cli_rss, cli_rss, cl->connected);
+	res.cli_huge = per_conn(res.cli_huge, cli_huge, cl->connected);
+	proc_mem(srv_pid, &res.srv_rss, &res.srv_huge);
+	res.srv_rss  = per_conn(res.srv_rss, srv_rss, cl->connected);
+	res.srv_huge = per_conn(res.srv_huge, srv_huge, cl->connected);
+
+	if (cl->connected) {
+		run_probe(cl, &res.idle_p50, &res.idle_p99, &res.idle_max);
+		run_active(cl, &res);
+	}
+	res.status = (cl->connected == cl->conns_nr) ? STATUS_OK :
+		     STATUS_PARTIAL;
+
+	cl->stage = STAGE_TEARDOWN;
+	start = get_time_ns();
+	for (i = 0; i < cl->conns_nr; i++)
+		if (cl->conns[i].established && cl->conns[i].conn)
+			xio_disconnect(cl->conns[i].conn);
+	deadline = start + 30 * NSEC_PER_SEC;
+	while (cl->torn_down < cl->connected && get_time_ns() < deadline)
+		xio_context_run_loop(cl->ctx, 100);
+	res.teardown_rate = cl->torn_down * 1e9 / (get_time_ns() - start);
+
+	for (i = 0; i < cl->conns_nr; i++)
+		if (cl->conns[i].session)
+			xio_session_destroy(cl->conns[i].session);
+
+	xio_context_del_ev_handler(cl->ctx, cl->probe_fd);
+
+cleanup:
+	if (write(result_fd, &res, sizeof(res)) != sizeof(res))
+		perror("write");
+
+	if (cl->probe_fd != -1)
+		close(cl->probe_fd);
+	if (cl->ctx)
+		xio_context_destroy(cl->ctx);
+	free(cl->hist);
+	free(cl->conns);
+
+	xio_shutdown();
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_header								     */
+/*---------------------------------------------------------------------------*/
+static void print_header(void)
+{
+	if (g_params.format == FORMAT_CSV) {
+		printf("conns,established,status,connect_rate,"
+		       "cli_rss_per_conn,srv_rss_per_conn,"
+		       "cli_huge_per_conn,srv_huge_per_conn,"
+		       "base_p50_us,base_p99_us,idle_p50_us,idle_p99_us,"
+		       "idle_max_us,active,req_rate,rtt_p50_us,rtt_p99_us,"
+		       "rtt_p999_us,teardown_rate\n");
+		return;
+	}
+	printf("%7s %7s %8s | %8s %8s %8s %8s | %7s %7s %7s %7s %8s | "
+	       "%6s %8s %7s %7s %7s | %8s\n",
+	       "conns", "estab", "conn/s",
+	       "cli_B/c", "srv_B/c", "cli_hB/c", "srv_hB/c",
+	       "b_p50", "b_p99", "i_p50", "i_p99", "i_max",
+	       "active", "req/s", "p50", "p99", "p99.9",
+	       "close/s");
+	printf("%7s %7s %8s | %8s %8s %8s %8s | %7s %7s %7s %7s %8s | "
+	       "%6s %8s %7s %7s %7s | %8s\n",
+	       "", "", "", "rss", "rss", "hugetlb", "hugetlb",
+	       "[us]", "[us]", "[us]", "[us]", "[us]",
+	       "", "", "[us]", "[us]", "[us]", "");
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_result								     */
+/*---------------------------------------------------------------------------*/
+static void print_result(const struct cs_result *res)
+{
+	static const char * const status_str[] = {
+		"ok", "partial", "fd-limit", "failed"
+	};
+
+	if (g_params.format == FORMAT_CSV) {
+		printf("%" PRIu64 ",%" PRIu64 ",%s,%.0f,%" PRIu64 ",%" PRIu64
+		       ",%" PRIu64 ",%" PRIu64 ",%.1f,%.1f,%.1f,%.1f,%.1f,%"
+		       PRIu64 ",%.0f,%.1f,%.1f,%.1f,%.0f\n",
+		       res->conns, res->established, status_str[res->status],
+		       res->connect_rate, res->cli_rss, res->srv_rss,
+		       res->cli_huge, res->srv_huge,
+		       res->base_p50 / 1000.0, res->base_p99 / 1000.0,
+		       res->idle_p50 / 1000.0, res->idle_p99 / 1000.0,
+		       res->idle_max / 1000.0, res->active, res->req_rate,
+		       res->rtt_p50 / 1000.0, res->rtt_p99 / 1000.0,
+		       res->rtt_p999 / 1000.0, res->teardown_rate);
+		fflush(stdout);
+		return;
+	}
+	if (res->status == STATUS_FD_LIMIT) {
+		printf("%7" PRIu64 " skipped: open files limit too low "
+		       "(see ulimit -n)\n", res->conns);
+		fflush(stdout);
+		return;
+	}
+	if (res->status == STATUS_FAILED) {
+		if (res->term_signal)
+			printf("%7" PRIu64 " failed: client killed by %s\n",
+			       res->conns, strsignal(res->term_signal));
+		else
+			printf("%7" PRIu64 " failed\n", res->conns);
+		fflush(stdout);
+		return;
+	}
+	printf("%7" PRIu64 " %7" PRIu64 " %8.0f | %8" PRIu64 " %8" PRIu64
+	       " %8" PRIu64 " %8" PRIu64 " | %7.1f %7.1f %7.1f %7.1f %8.1f | "
+	       "%6" PRIu64 " %8.0f %7.1f %7.1f %7.1f | %8.0f\n",
+	       res->conns, res->established, res->connect_rate,
+	       res->cli_rss, res->srv_rss, res->cli_huge, res->srv_huge,
+	       res->base_p50 / 1000.0, res->base_p99 / 1000.0,
+	       res->idle_p50 / 1000.0, res->idle_p99 / 1000.0,
+	       res->idle_max / 1000.0, res->active, res->req_rate,
+	       res->rtt_p50 / 1000.0, res->rtt_p99 / 1000.0,
+	       res->rtt_p999 / 1000.0, res->teardown_rate);
+	fflush(stdout);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_count - one server/client process pair for "conns" connections	     */
+/*---------------------------------------------------------------------------*/
+static void run_count(struct cs_params *params, int conns, int port,
+		      struct cs_result *res)
+{
+	int		ready_pipe[2], result_pipe[2];
+	pid_t		srv_pid, cli_pid;
+	char		ready;
+	int		wstatus;
+
+	memset(res, 0, sizeof(*res));
+	res->conns	= conns;
+	res->status	= STATUS_FAILED;
+
+	if (pipe(ready_pipe))
+		return;
+	if (pipe(result_pipe)) {
+		close(ready_pipe[0]);
+		close(ready_pipe[1]);
+		return;
+	}
+
+	fflush(stdout);
+	srv_pid = fork();
+	if (srv_pid == 0) {
+		close(ready_pipe[0]);
+		close(result_pipe[0]);
+		close(result_pipe[1]);
+		_exit(run_server(params, port, ready_pipe[1]) ? 1 : 0);
+	}
+	close(ready_pipe[1]);
+	if (srv_pid == -1 ||
+	    read(ready_pipe[0], &ready, sizeof(ready)) != sizeof(ready))
+		goto cleanup;
+
+	cli_pid = fork();
+	if (cli_pid == 0) {
+		close(ready_pipe[0]);
+		close(result_pipe[0]);
+		_exit(run_client(params, conns, port, srv_pid,
+				 result_pipe[1]) ? 1 : 0);
+	}
+	close(result_pipe[1]);
+	result_pipe[1] = -1;
+	if (cli_pid != -1) {
+		if (read(result_pipe[0], res, sizeof(*res)) != sizeof(*res))
+			res->status = STATUS_FAILED;
+		/* typically the oom killer once the pools outgrow memory */
+		if (waitpid(cli_pid, &wstatus, 0) == cli_pid &&
+		    WIFSIGNALED(wstatus))
+			res->term_signal = WTERMSIG(wstatus);
+	}
+
+cleanup:
+	if (srv_pid > 0) {
+		kill(srv_pid, SIGTERM);
+		waitpid(srv_pid, NULL, 0);
+	}
+	close(ready_pipe[0]);
+	close(result_pipe[0]);
+	if (result_pipe[1] != -1)
+		close(result_pipe[1]);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct cs_params	*params = &g_params;
+	struct cs_result	res;
+	struct rlimit		rlim;
+	uint64_t		fds;
+	int			opt, i;
+
+	params->port		= DEFAULT_PORT;
+	params->window		= DEFAULT_WINDOW;
+	params->active		= DEFAULT_ACTIVE;
+	params->active_ms	= DEFAULT_ACTIVE_MS;
+	params->probe_ms	= DEFAULT_PROBE_MS;
+	params->probe_us	= DEFAULT_PROBE_US;
+	if (parse_counts(DEFAULT_COUNTS, params))
+		return 1;
+
+	while ((opt = getopt_long(argc, argv, "n:p:w:a:d:P:i:sf:h",
+				  long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			if (parse_counts(optarg, params))
+				goto bad_arg;
+			break;
+		case 'p':
+			params->port = strtol(optarg, NULL, 0);
+			break;
+		case 'w':
+			params->window = strtol(optarg, NULL, 0);
+			break;
+		case 'a':
+			params->active = strtod(optarg, NULL);
+			break;
+		case 'd':
+			params->active_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'P':
+			params->probe_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			params->probe_us = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			params->single_stream = 1;
+			break;
+		case 'f':
+			if (!strcmp(optarg, "text"))
+				params->format = FORMAT_TEXT;
+			else if (!strcmp(optarg, "csv"))
+				params->format = FORMAT_CSV;
+			else
+				goto bad_arg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			goto bad_arg;
+		}
+	}
+	if (params->window < 1 || params->active <= 0 ||
+	    params->active > 1 || params->active_ms < 1 ||
+	    params->probe_ms < 1 || params->probe_us < 1)
+		goto bad_arg;
+
+	/* every connection costs one or two descriptors on each side */
+	getrlimit(RLIMIT_NOFILE, &rlim);
+	rlim.rlim_cur = rlim.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rlim);
+
+	if (params->format == FORMAT_TEXT)
+		printf("tcp loopback, %s stream, %d connects in flight, "
+		       "%.2f%% active, open files limit %lu\n",
+		       params->single_stream ? "single" : "dual",
+		       params->window, params->active * 100,
+		       (unsigned long)rlim.rlim_cur);
+	print_header();
+
+	for (i = 0; i < params->counts_nr; i++) {
+		fds = (uint64_t)params->counts[i] *
+		      (params->single_stream ? 1 : 2) + FD_SLACK;
+		if (fds > rlim.rlim_cur) {
+			memset(&res, 0, sizeof(res));
+			res.conns  = params->counts[i];
+			res.status = STATUS_FD_LIMIT;
+		} else {
+			run_count(params, params->counts[i],
+				  params->port + i, &res);
+		}
+		print_result(&res);
+	}
+	free(params->counts);
+
+	return 0;
+
+bad_arg:
+	usage(argv[0]);
+	return 1;
+}
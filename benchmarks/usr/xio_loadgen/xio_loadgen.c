@@ -0,0 +1,1692 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#include "libxio.h"
+#include "xio_perftest_histogram.h"
+
+/*
+ * open loop load generator. unlike the closed loop clients that keep a fixed
+ * number of requests in flight, requests are issued on a precomputed arrival
+ * schedule (poisson or constant rate) whether or not earlier ones have been
+ * answered, and latency is measured from the scheduled arrival time. a server
+ * that cannot keep up therefore shows up as growing queueing delay and not
+ * as a silently lower send rate, which is what exposes the saturation knee.
+ */
+
+#define DEFAULT_PORT		2061
+#define DEFAULT_RATE		"10000"
+#define DEFAULT_DURATION	10
+#define DEFAULT_INTERVAL_MS	1000
+#define DEFAULT_DRAIN_MS	2000
+#define DEFAULT_SIZES		"64"
+#define DEFAULT_MAX_OUTSTANDING	65536
+#define DEFAULT_MAX_RSP		(1 << 20)
+#define START_DELAY_NS		20000000ULL
+#define NSEC_PER_SEC		1000000000ULL
+#define NSEC_PER_MSEC		1000000ULL
+
+enum lg_arrival {
+	ARRIVAL_POISSON,
+	ARRIVAL_CONSTANT,
+};
+
+enum lg_format {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+};
+
+enum lg_state {
+	STATE_IDLE,
+	STATE_ISSUING,
+	STATE_DRAINING,
+};
+
+/* carried in the request header so the server knows what to answer with */
+struct lg_hdr {
+	uint32_t		req_len;
+	uint32_t		rsp_len;
+};
+
+/* weighted size distribution: "size[:weight],..." */
+struct lg_dist {
+	uint64_t		*sizes;
+	double			*cdf;
+	uint64_t		max;
+	int			nr;
+	int			pad;
+};
+
+struct lg_params {
+	char			*host;
+	char			*transport;
+	double			*rates;
+	struct lg_dist		req_dist;
+	struct lg_dist		rsp_dist;
+	uint64_t		max_rsp;
+	int			rates_nr;
+	int			port;
+	int			threads;
+	int			sessions;
+	int			conns;
+	int			duration;
+	int			interval_ms;
+	int			drain_ms;
+	int			queue_depth;
+	int			conn_depth;
+	int			max_outstanding;
+	enum lg_arrival		arrival;
+	enum lg_format		format;
+	int			pad;
+};
+
+struct lg_thread;
+
+struct lg_session {
+	struct xio_session	*session;
+	/* threads that own at least one of the session's connections */
+	struct lg_thread	**threads;
+	int			threads_nr;
+	int			pad;
+};
+
+struct lg_conn {
+	struct lg_thread	*tdata;
+	struct lg_session	*ses;
+	struct xio_connection	*conn;
+	int			established;
+	int			failed;
+	int			outstanding;
+	int			pad;
+};
+
+struct lg_req {
+	struct xio_msg		msg;
+	struct lg_hdr		hdr;
+	uint64_t		intended_ns;
+	struct lg_req		*next;
+	struct lg_conn		*lconn;
+	uint32_t		phase;
+	int			pad;
+};
+
+/* counters of one reporting window, owned by the worker, read under lock */
+struct lg_counters {
+	uint64_t		sent;
+	uint64_t		completed;
+	uint64_t		dropped;
+	uint64_t		errors;
+};
+
+struct lg_thread {
+	struct lg_params	*params;
+	struct xio_context	*ctx;
+	struct lg_conn		**conns;
+	struct lg_req		*free_reqs;
+	struct xio_buf		*out_xbuf;
+	struct xio_buf		*in_xbuf;
+	struct perf_hist	*ival_hist;
+	struct perf_hist	*phase_hist;
+	struct lg_counters	ival;
+	struct lg_counters	phase_cnt;
+	uint64_t		rng;
+	uint64_t		end_ns;
+	double			next_ns;
+	double			gap_ns;
+	uint64_t		outstanding;
+	pthread_spinlock_t	lock;
+	int			conns_nr;
+	int			next_conn;
+	int			connect_done;
+	int			sessions_open;
+	int			reqs_nr;
+	int			timer_fd;
+	int			affinity;
+	uint32_t		phase;
+	enum lg_state		state;
+	pthread_t		thread_id;
+};
+
+/* phase result kept for the final saturation table */
+struct lg_result {
+	double			rate;
+	double			sent_rate;
+	double			done_rate;
+	uint64_t		dropped;
+	uint64_t		errors;
+	uint64_t		p50;
+	uint64_t		p90;
+	uint64_t		p99;
+	uint64_t		p999;
+	uint64_t		max;
+};
+
+struct lg_server_thread {
+	struct lg_params	*params;
+	struct xio_context	*ctx;
+	struct xio_buf		*out_xbuf;
+	struct xio_buf		*in_xbuf;
+	struct xio_msg		*free_rsps;
+	const char		*portal;
+	int			affinity;
+	int			pad;
+	pthread_t		thread_id;
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct lg_params		g_params;
+static struct lg_thread		*g_threads;
+static struct lg_session	*g_sessions;
+static struct lg_server_thread	*g_srv_threads;
+static struct xio_context	*g_srv_ctx;
+static pthread_barrier_t	g_barrier;
+static volatile int		g_done;
+static volatile int		g_failed;
+
+static struct option const long_options[] = {
+	{ "server",		0, 0, 'S' },
+	{ "host",		1, 0, 'c' },
+	{ "port",		1, 0, 'p' },
+	{ "transport",		1, 0, 'r' },
+	{ "threads",		1, 0, 't' },
+	{ "sessions",		1, 0, 's' },
+	{ "connections",	1, 0, 'n' },
+	{ "rate",		1, 0, 'R' },
+	{ "arrival",		1, 0, 'a' },
+	{ "duration",		1, 0, 'd' },
+	{ "interval",		1, 0, 'i' },
+	{ "req-sizes",		1, 0, 'q' },
+	{ "rsp-sizes",		1, 0, 'Q' },
+	{ "max-rsp",		1, 0, 'M' },
+	{ "queue-depth",	1, 0, 'D' },
+	{ "max-outstanding",	1, 0, 'm' },
+	{ "format",		1, 0, 'f' },
+	{ "help",		0, 0, 'h' },
+	{ 0,			0, 0, 0 },
+};
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	printf("Usage:\n");
+	printf("  %s -S [OPTIONS]\t\tstart a server\n", argv0);
+	printf("  %s -c <host> [OPTIONS]\tgenerate load against <host>\n",
+	       argv0);
+	printf("\n");
+	printf("Options:\n");
+	printf("\t-p, --port=<port>           ");
+	printf("listen on/connect to port <port> (default %d)\n",
+	       DEFAULT_PORT);
+	printf("\t-r, --transport=<type>      ");
+	printf("rdma or tcp (default rdma)\n");
+	printf("\t-t, --threads=<num>         ");
+	printf("worker threads, server portals on the server (default 1)\n");
+	printf("\t-s, --sessions=<num>        ");
+	printf("client sessions (default 1)\n");
+	printf("\t-n, --connections=<num>     ");
+	printf("connections per session, at most one per thread\n");
+	printf("\t                            (default 1)\n");
+	printf("\t-R, --rate=<list>           ");
+	printf("aggregate requests/sec, a list runs one phase per rate\n");
+	printf("\t                            (e.g. 10k,20k,40k, default %s)\n",
+	       DEFAULT_RATE);
+	printf("\t-a, --arrival=<type>        ");
+	printf("poisson or constant (default poisson)\n");
+	printf("\t-d, --duration=<sec>        ");
+	printf("seconds per phase (default %d)\n", DEFAULT_DURATION);
+	printf("\t-i, --interval=<ms>         ");
+	printf("reporting interval (default %d)\n", DEFAULT_INTERVAL_MS);
+	printf("\t-q, --req-sizes=<dist>      ");
+	printf("request sizes as size[:weight],... (default %s)\n",
+	       DEFAULT_SIZES);
+	printf("\t-Q, --rsp-sizes=<dist>      ");
+	printf("response sizes as size[:weight],... (default %s)\n",
+	       DEFAULT_SIZES);
+	printf("\t-M, --max-rsp=<size>        ");
+	printf("server: largest response served (default 1m)\n");
+	printf("\t-D, --queue-depth=<num>     ");
+	printf("accelio per connection queue depth\n");
+	printf("\t-m, --max-outstanding=<num> ");
+	printf("requests in flight per thread before arrivals are dropped\n");
+	printf("\t                            (default %d)\n",
+	       DEFAULT_MAX_OUTSTANDING);
+	printf("\t-f, --format=<type>         ");
+	printf("text or csv (default text)\n");
+	printf("\t-h, --help                  ");
+	printf("display this help and exit\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* get_time_ns								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* rng_next - xorshift64*						     */
+/*---------------------------------------------------------------------------*/
+static inline double rng_next(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	/* uniform in [0, 1) */
+	return ((x * 2685821657736338717ULL) >> 11) *
+		(1.0 / 9007199254740992.0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* parse_size								     */
+/*---------------------------------------------------------------------------*/
+static int parse_size(const char *str, char **endp, uint64_t *size)
+{
+	char		*end;
+	uint64_t	val;
+
+	errno = 0;
+	val = strtoull(str, &end, 0);
+	if (errno || end == str)
+		return -1;
+
+	switch (tolower(*end)) {
+	case 'g':
+		val <<= 10;
+		/* fall through */
+	case 'm':
+		val <<= 10;
+		/* fall through */
+	case 'k':
+		val <<= 10;
+		end++;
+		break;
+	default:
+		break;
+	}
+	*size = val;
+	*endp = end;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* parse_dist								     */
+/*---------------------------------------------------------------------------*/
+static int parse_dist(const char *arg, struct lg_dist *dist)
+{
+	char		*str, *token, *saveptr, *end;
+	uint64_t	size;
+	double		weight, total = 0;
+	int		i;
+
+	str = strdup(arg);
+	if (!str)
+		return -1;
+
+	memset(dist, 0, sizeof(*dist));
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		if (parse_size(token, &end, &size))
+			goto cleanup;
+		weight = 1;
+		if (*end == ':') {
+			weight = strtod(end + 1, &end);
+			if (weight <= 0)
+				goto cleanup;
+		}
+		if (*end)
+			goto cleanup;
+
+		dist->sizes = realloc(dist->sizes,
+				      (dist->nr + 1) * sizeof(*dist->sizes));
+		dist->cdf = realloc(dist->cdf,
+				    (dist->nr + 1) * sizeof(*dist->cdf));
+		if (!dist->sizes || !dist->cdf)
+			goto cleanup;
+		dist->sizes[dist->nr] = size;
+		dist->cdf[dist->nr] = weight;
+		if (size > dist->max)
+			dist->max = size;
+		total += weight;
+		dist->nr++;
+	}
+	if (dist->nr == 0)
+		goto cleanup;
+
+	for (i = 0, weight = 0; i < dist->nr; i++) {
+		weight += dist->cdf[i];
+		dist->cdf[i] = weight / total;
+	}
+	free(str);
+
+	return 0;
+
+cleanup:
+	free(str);
+	free(dist->sizes);
+	free(dist->cdf);
+	memset(dist, 0, sizeof(*dist));
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* dist_sample								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t dist_sample(const struct lg_dist *dist, uint64_t *rng)
+{
+	double	u;
+	int	i;
+
+	if (dist->nr == 1)
+		return dist->sizes[0];
+
+	u = rng_next(rng);
+	for (i = 0; i < dist->nr - 1; i++)
+		if (u < dist->cdf[i])
+			break;
+
+	return dist->sizes[i];
+}
+
+/*---------------------------------------------------------------------------*/
+/* parse_rates - k/m suffixes are decimal for rates			     */
+/*---------------------------------------------------------------------------*/
+static int parse_rates(const char *arg, struct lg_params *params)
+{
+	char		*str, *token, *saveptr, *end;
+	double		rate;
+
+	str = strdup(arg);
+	if (!str)
+		return -1;
+
+	params->rates_nr = 0;
+	for (token = strtok_r(str, ",", &saveptr); token;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		rate = strtod(token, &end);
+		switch (tolower(*end)) {
+		case 'm':
+			rate *= 1000;
+			/* fall through */
+		case 'k':
+			rate *= 1000;
+			end++;
+			break;
+		default:
+			break;
+		}
+		if (end == token || *end || rate <= 0)
+			goto cleanup;
+
+		params->rates = realloc(params->rates,
+					(params->rates_nr + 1) *
+					sizeof(*params->rates));
+		if (!params->rates)
+			goto cleanup;
+		params->rates[params->rates_nr++] = rate;
+	}
+	free(str);
+
+	return params->rates_nr ? 0 : -1;
+
+cleanup:
+	free(str);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_rsp_get								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_msg *srv_rsp_get(struct lg_server_thread *tdata)
+{
+	struct xio_msg	*rsp = tdata->free_rsps;
+
+	/* the number of requests in flight is up to the clients, so the
+	 * pool grows on demand instead of failing the request
+	 */
+	if (rsp)
+		tdata->free_rsps = rsp->user_context;
+	else
+		rsp = calloc(1, sizeof(*rsp));
+
+	return rsp;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_rsp_put								     */
+/*---------------------------------------------------------------------------*/
+static void srv_rsp_put(struct lg_server_thread *tdata, struct xio_msg *rsp)
+{
+	rsp->user_context = tdata->free_rsps;
+	tdata->free_rsps = rsp;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_request							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_request(struct xio_session *session,
+			  struct xio_msg *req,
+			  int more_in_batch,
+			  void *cb_user_context)
+{
+	struct lg_server_thread	*tdata = cb_user_context;
+	struct lg_hdr		*hdr = req->in.header.iov_base;
+	struct xio_msg		*rsp;
+	struct xio_iovec_ex	*sglist;
+	uint64_t		rsp_len = 0;
+
+	if (hdr && req->in.header.iov_len >= sizeof(*hdr))
+		rsp_len = hdr->rsp_len;
+	if (rsp_len > tdata->params->max_rsp)
+		rsp_len = tdata->params->max_rsp;
+
+	rsp = srv_rsp_get(tdata);
+	if (!rsp) {
+		fprintf(stderr, "**** [%p] Error - out of memory\n", session);
+		return 0;
+	}
+
+	rsp->request		= req;
+	rsp->more_in_batch	= more_in_batch;
+	rsp->in.header.iov_len	= 0;
+	rsp->out.header.iov_len	= 0;
+	vmsg_sglist_set_nents(&rsp->in, 0);
+
+	rsp->out.sgl_type	= XIO_SGL_TYPE_IOV;
+	if (rsp_len) {
+		sglist = vmsg_sglist(&rsp->out);
+		sglist[0].iov_base	= tdata->out_xbuf->addr;
+		sglist[0].iov_len	= rsp_len;
+		sglist[0].mr		= tdata->out_xbuf->mr;
+		vmsg_sglist_set_nents(&rsp->out, 1);
+	} else {
+		vmsg_sglist_set_nents(&rsp->out, 0);
+	}
+
+	if (xio_send_response(rsp) == -1) {
+		fprintf(stderr, "**** [%p] Error - xio_send_response failed. %s\n",
+			session, xio_strerror(xio_errno()));
+		srv_rsp_put(tdata, rsp);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_send_response_complete					     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_send_response_complete(struct xio_session *session,
+					 struct xio_msg *rsp,
+					 void *cb_user_context)
+{
+	srv_rsp_put(cb_user_context, rsp);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_msg_error							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_msg_error(struct xio_session *session,
+			    enum xio_status error, struct xio_msg *rsp,
+			    void *cb_user_context)
+{
+	srv_rsp_put(cb_user_context, rsp);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_assign_data_in_buf						     */
+/*---------------------------------------------------------------------------*/
+static int srv_assign_data_in_buf(struct xio_msg *msg, void *cb_user_context)
+{
+	struct lg_server_thread	*tdata = cb_user_context;
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&msg->in);
+
+	/* request payload is discarded, all requests share one buffer */
+	if (!tdata->in_xbuf) {
+		tdata->in_xbuf = xio_alloc(sglist[0].iov_len);
+	} else if (tdata->in_xbuf->length < sglist[0].iov_len) {
+		xio_free(&tdata->in_xbuf);
+		tdata->in_xbuf = xio_alloc(sglist[0].iov_len);
+	}
+
+	vmsg_sglist_set_nents(&msg->in, 1);
+
+	sglist[0].iov_base	= tdata->in_xbuf->addr;
+	sglist[0].iov_len	= tdata->in_xbuf->length;
+	sglist[0].mr		= tdata->in_xbuf->mr;
+
+	return 0;
+}
+
+static struct xio_session_ops portal_server_ops = {
+	.on_session_event		=  NULL,
+	.on_new_session			=  NULL,
+	.on_msg_send_complete		=  srv_on_send_response_complete,
+	.on_msg				=  srv_on_request,
+	.on_msg_error			=  srv_on_msg_error,
+	.assign_data_in_buf		=  srv_assign_data_in_buf
+};
+
+/*---------------------------------------------------------------------------*/
+/* portal_server_cb							     */
+/*---------------------------------------------------------------------------*/
+static void *portal_server_cb(void *data)
+{
+	struct lg_server_thread	*tdata = data;
+	struct xio_server	*server;
+	struct xio_msg		*rsp;
+	cpu_set_t		cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(tdata->affinity, &cpuset);
+	pthread_setaffinity_np(tdata->thread_id, sizeof(cpu_set_t), &cpuset);
+
+	tdata->out_xbuf = xio_alloc(tdata->params->max_rsp);
+	if (!tdata->out_xbuf) {
+		fprintf(stderr, "failed to allocate response buffer\n");
+		return NULL;
+	}
+
+	tdata->ctx = xio_context_create(NULL, 0, tdata->affinity);
+	if (!tdata->ctx)
+		goto cleanup;
+
+	server = xio_bind(tdata->ctx, &portal_server_ops, tdata->portal,
+			  NULL, 0, tdata);
+	if (server) {
+		xio_context_run_loop(tdata->ctx, XIO_INFINITE);
+		xio_unbind(server);
+	} else {
+		fprintf(stderr, "failed to bind %s. %s\n", tdata->portal,
+			xio_strerror(xio_errno()));
+	}
+
+	xio_context_destroy(tdata->ctx);
+
+cleanup:
+	while ((rsp = tdata->free_rsps)) {
+		tdata->free_rsps = rsp->user_context;
+		free(rsp);
+	}
+	if (tdata->in_xbuf)
+		xio_free(&tdata->in_xbuf);
+	xio_free(&tdata->out_xbuf);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_session_event(struct xio_session *session,
+				struct xio_session_event_data *event_data,
+				void *cb_user_context)
+{
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int srv_on_new_session(struct xio_session *session,
+			      struct xio_new_session_req *req,
+			      void *cb_user_context)
+{
+	const char	**portals = cb_user_context;
+
+	/* connections are spread over the portals round robin */
+	xio_accept(session, portals, g_params.threads, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  srv_on_session_event,
+	.on_new_session			=  srv_on_new_session,
+	.on_msg_send_complete		=  NULL,
+	.on_msg				=  NULL,
+	.on_msg_error			=  NULL,
+	.assign_data_in_buf		=  NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* srv_on_signal							     */
+/*---------------------------------------------------------------------------*/
+static void srv_on_signal(int fd, int events, void *data)
+{
+	struct signalfd_siginfo	info;
+	int			i;
+
+	if (read(fd, &info, sizeof(info)) != sizeof(info))
+		return;
+
+	for (i = 0; i < g_params.threads; i++)
+		if (g_srv_threads[i].ctx)
+			xio_context_stop_loop(g_srv_threads[i].ctx, 0);
+	xio_context_stop_loop(g_srv_ctx, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_server								     */
+/*---------------------------------------------------------------------------*/
+static int run_server(struct lg_params *params)
+{
+	struct xio_server	*server;
+	char			**portals;
+	char			url[256];
+	sigset_t		sigs;
+	int			sig_fd;
+	int			i, cpus, retval = -1;
+
+	/* termination is handled by the balancer's event loop */
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+	sig_fd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (sig_fd == -1) {
+		perror("signalfd");
+		return -1;
+	}
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	portals = calloc(params->threads, sizeof(*portals));
+	g_srv_threads = calloc(params->threads, sizeof(*g_srv_threads));
+	if (!portals || !g_srv_threads)
+		goto cleanup;
+
+	for (i = 0; i < params->threads; i++) {
+		sprintf(url, "%s://*:%d", params->transport,
+			params->port + i + 1);
+		portals[i] = strdup(url);
+		g_srv_threads[i].params		= params;
+		g_srv_threads[i].portal		= portals[i];
+		g_srv_threads[i].affinity	= i % cpus;
+		pthread_create(&g_srv_threads[i].thread_id, NULL,
+			       portal_server_cb, &g_srv_threads[i]);
+	}
+
+	g_srv_ctx = xio_context_create(NULL, 0, -1);
+	if (!g_srv_ctx)
+		goto stop;
+
+	sprintf(url, "%s://*:%d", params->transport, params->port);
+	server = xio_bind(g_srv_ctx, &server_ops, url, NULL, 0, portals);
+	if (!server) {
+		fprintf(stderr, "failed to bind %s. %s\n", url,
+			xio_strerror(xio_errno()));
+		xio_context_destroy(g_srv_ctx);
+		goto stop;
+	}
+	xio_context_add_ev_handler(g_srv_ctx, sig_fd, XIO_POLLIN,
+				   srv_on_signal, NULL);
+
+	printf("listening on %s, %d portals, max response %" PRIu64 "\n",
+	       url, params->threads, params->max_rsp);
+	fflush(stdout);
+
+	xio_context_run_loop(g_srv_ctx, XIO_INFINITE);
+
+	xio_context_del_ev_handler(g_srv_ctx, sig_fd);
+	xio_unbind(server);
+	xio_context_destroy(g_srv_ctx);
+	retval = 0;
+
+stop:
+	for (i = 0; i < params->threads; i++) {
+		if (g_srv_threads[i].ctx)
+			xio_context_stop_loop(g_srv_threads[i].ctx, 0);
+		pthread_join(g_srv_threads[i].thread_id, NULL);
+		free(portals[i]);
+	}
+
+cleanup:
+	free(g_srv_threads);
+	free(portals);
+	close(sig_fd);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* stop_thread_loop							     */
+/*---------------------------------------------------------------------------*/
+static inline void stop_thread_loop(struct lg_thread *tdata)
+{
+	tdata->state = STATE_IDLE;
+	xio_context_stop_loop(tdata->ctx, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* arm_timer								     */
+/*---------------------------------------------------------------------------*/
+static void arm_timer(struct lg_thread *tdata, uint64_t abs_ns)
+{
+	struct itimerspec	its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec	= abs_ns / NSEC_PER_SEC;
+	its.it_value.tv_nsec	= abs_ns % NSEC_PER_SEC;
+
+	timerfd_settime(tdata->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+/* req_get								     */
+/*---------------------------------------------------------------------------*/
+static struct lg_req *req_get(struct lg_thread *tdata)
+{
+	struct lg_req	*req = tdata->free_reqs;
+
+	if (req) {
+		tdata->free_reqs = req->next;
+		return req;
+	}
+	if (tdata->reqs_nr == tdata->params->max_outstanding)
+		return NULL;
+
+	req = calloc(1, sizeof(*req));
+	if (req)
+		tdata->reqs_nr++;
+
+	return req;
+}
+
+/*---------------------------------------------------------------------------*/
+/* req_put								     */
+/*---------------------------------------------------------------------------*/
+static inline void req_put(struct lg_thread *tdata, struct lg_req *req)
+{
+	req->next = tdata->free_reqs;
+	tdata->free_reqs = req;
+}
+
+/*---------------------------------------------------------------------------*/
+/* next_conn - round robin over the usable connections			     */
+/*---------------------------------------------------------------------------*/
+static struct lg_conn *next_conn(struct lg_thread *tdata)
+{
+	struct lg_conn	*lconn;
+	int		i;
+
+	for (i = 0; i < tdata->conns_nr; i++) {
+		lconn = tdata->conns[tdata->next_conn];
+		if (++tdata->next_conn == tdata->conns_nr)
+			tdata->next_conn = 0;
+		/* a full connection would only log and fail the send */
+		if (lconn->established &&
+		    lconn->outstanding < tdata->params->conn_depth)
+			return lconn;
+	}
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* issue_request							     */
+/*---------------------------------------------------------------------------*/
+static void issue_request(struct lg_thread *tdata, uint64_t intended_ns)
+{
+	struct lg_params	*params = tdata->params;
+	struct lg_conn		*lconn;
+	struct lg_req		*req;
+	struct xio_msg		*msg;
+	struct xio_iovec_ex	*sglist;
+
+	req = req_get(tdata);
+	lconn = next_conn(tdata);
+	if (!req || !lconn)
+		goto drop;
+
+	req->lconn		= lconn;
+	req->intended_ns	= intended_ns;
+	req->phase		= tdata->phase;
+	req->hdr.req_len	= dist_sample(&params->req_dist, &tdata->rng);
+	req->hdr.rsp_len	= dist_sample(&params->rsp_dist, &tdata->rng);
+
+	msg = &req->msg;
+	msg->user_context	= req;
+	msg->out.header.iov_base = &req->hdr;
+	msg->out.header.iov_len	= sizeof(req->hdr);
+	msg->out.sgl_type	= XIO_SGL_TYPE_IOV;
+	if (req->hdr.req_len) {
+		sglist = vmsg_sglist(&msg->out);
+		sglist[0].iov_base	= tdata->out_xbuf->addr;
+		sglist[0].iov_len	= req->hdr.req_len;
+		sglist[0].mr		= tdata->out_xbuf->mr;
+		vmsg_sglist_set_nents(&msg->out, 1);
+	} else {
+		vmsg_sglist_set_nents(&msg->out, 0);
+	}
+
+	/* responses land in one shared buffer sized for the largest one */
+	msg->in.header.iov_base	= NULL;
+	msg->in.header.iov_len	= 0;
+	msg->in.sgl_type	= XIO_SGL_TYPE_IOV;
+	if (req->hdr.rsp_len) {
+		sglist = vmsg_sglist(&msg->in);
+		sglist[0].iov_base	= tdata->in_xbuf->addr;
+		sglist[0].iov_len	= tdata->in_xbuf->length;
+		sglist[0].mr		= tdata->in_xbuf->mr;
+		vmsg_sglist_set_nents(&msg->in, 1);
+	} else {
+		vmsg_sglist_set_nents(&msg->in, 0);
+	}
+
+	if (xio_send_request(lconn->conn, msg) == -1)
+		goto drop;
+
+	tdata->outstanding++;
+	lconn->outstanding++;
+	pthread_spin_lock(&tdata->lock);
+	tdata->ival.sent++;
+	tdata->phase_cnt.sent++;
+	pthread_spin_unlock(&tdata->lock);
+
+	return;
+
+drop:
+	/* the arrival is lost, not deferred: deferring it would turn the
+	 * generator back into a closed loop one
+	 */
+	if (req)
+		req_put(tdata, req);
+	pthread_spin_lock(&tdata->lock);
+	tdata->ival.dropped++;
+	tdata->phase_cnt.dropped++;
+	pthread_spin_unlock(&tdata->lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_timer								     */
+/*---------------------------------------------------------------------------*/
+static void on_timer(int fd, int events, void *data)
+{
+	struct lg_thread	*tdata = data;
+	uint64_t		expirations, now;
+
+	if (read(fd, &expirations, sizeof(expirations)) == -1)
+		return;
+
+	if (tdata->state == STATE_DRAINING) {
+		/* what is still in flight is not accounted to this phase */
+		stop_thread_loop(tdata);
+		return;
+	}
+	if (tdata->state != STATE_ISSUING)
+		return;
+
+	/* issue every arrival that is due, however late the timer fired */
+	now = get_time_ns();
+	while (tdata->next_ns <= now && tdata->next_ns < tdata->end_ns) {
+		issue_request(tdata, (uint64_t)tdata->next_ns);
+		if (tdata->params->arrival == ARRIVAL_POISSON)
+			tdata->next_ns -= log(1.0 - rng_next(&tdata->rng)) *
+					  tdata->gap_ns;
+		else
+			tdata->next_ns += tdata->gap_ns;
+	}
+
+	if (tdata->next_ns < tdata->end_ns) {
+		arm_timer(tdata, (uint64_t)tdata->next_ns);
+		return;
+	}
+
+	tdata->state = STATE_DRAINING;
+	if (tdata->outstanding == 0)
+		stop_thread_loop(tdata);
+	else
+		arm_timer(tdata, tdata->end_ns +
+			  tdata->params->drain_ms * NSEC_PER_MSEC);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *msg,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	struct lg_conn		*lconn = cb_user_context;
+	struct lg_thread	*tdata = lconn->tdata;
+	struct lg_req		*req = msg->user_context;
+	uint64_t		latency = get_time_ns() - req->intended_ns;
+
+	pthread_spin_lock(&tdata->lock);
+	if (req->phase == tdata->phase) {
+		perf_hist_record(tdata->ival_hist, latency);
+		perf_hist_record(tdata->phase_hist, latency);
+		tdata->ival.completed++;
+		tdata->phase_cnt.completed++;
+	}
+	pthread_spin_unlock(&tdata->lock);
+
+	xio_release_response(msg);
+	req->lconn->outstanding--;
+	req_put(tdata, req);
+
+	if (--tdata->outstanding == 0 && tdata->state == STATE_DRAINING)
+		stop_thread_loop(tdata);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error, struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct lg_conn		*lconn = cb_user_context;
+	struct lg_thread	*tdata = lconn->tdata;
+	struct lg_req		*req = msg->user_context;
+
+	pthread_spin_lock(&tdata->lock);
+	if (req->phase == tdata->phase) {
+		tdata->ival.errors++;
+		tdata->phase_cnt.errors++;
+	}
+	pthread_spin_unlock(&tdata->lock);
+
+	req->lconn->outstanding--;
+	req_put(tdata, req);
+
+	if (--tdata->outstanding == 0 && tdata->state == STATE_DRAINING)
+		stop_thread_loop(tdata);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct lg_session	*ses = cb_user_context;
+	struct lg_conn		*lconn = event_data->conn_user_context;
+	struct lg_thread	*tdata;
+	int			i;
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		lconn->established = 1;
+		if (++lconn->tdata->connect_done == lconn->tdata->conns_nr)
+			xio_context_stop_loop(lconn->tdata->ctx, 1);
+		break;
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+	case XIO_SESSION_CONNECTION_DISCONNECTED_EVENT:
+	case XIO_SESSION_CONNECTION_CLOSED_EVENT:
+		if (!lconn || lconn->failed)
+			break;
+		if (!lconn->established) {
+			fprintf(stderr, "connection failed. %s\n",
+				xio_strerror(event_data->reason));
+			g_failed = 1;
+			if (++lconn->tdata->connect_done ==
+			    lconn->tdata->conns_nr)
+				xio_context_stop_loop(lconn->tdata->ctx, 1);
+		}
+		lconn->established = 0;
+		lconn->failed = 1;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		if (lconn)
+			lconn->conn = NULL;
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_ERROR_EVENT:
+		fprintf(stderr, "%s. reason: %s\n",
+			xio_session_event_str(event_data->event),
+			xio_strerror(event_data->reason));
+		g_failed = 1;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		/* the event may be delivered on any of the session's threads */
+		for (i = 0; i < ses->threads_nr; i++) {
+			tdata = ses->threads[i];
+			if (__sync_sub_and_fetch(&tdata->sessions_open, 1) == 0)
+				xio_context_stop_loop(tdata->ctx, 0);
+		}
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_session_established		=  NULL,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error
+};
+
+/*---------------------------------------------------------------------------*/
+/* worker_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *worker_thread(void *data)
+{
+	struct lg_thread	*tdata = data;
+	struct lg_params	*params = tdata->params;
+	struct lg_conn		*lconn;
+	struct lg_req		*req;
+	cpu_set_t		cpuset;
+	uint64_t		deadline;
+	int			i;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(tdata->affinity, &cpuset);
+	pthread_setaffinity_np(tdata->thread_id, sizeof(cpu_set_t), &cpuset);
+
+	tdata->ctx = xio_context_create(NULL, 0, tdata->affinity);
+	tdata->out_xbuf = xio_alloc(params->req_dist.max ?
+				    params->req_dist.max : 1);
+	tdata->in_xbuf = xio_alloc(params->rsp_dist.max ?
+				   params->rsp_dist.max : 1);
+	tdata->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+					 TFD_NONBLOCK | TFD_CLOEXEC);
+	if (!tdata->ctx || !tdata->out_xbuf || !tdata->in_xbuf ||
+	    tdata->timer_fd == -1 ||
+	    xio_context_add_ev_handler(tdata->ctx, tdata->timer_fd,
+				       XIO_POLLIN, on_timer, tdata)) {
+		fprintf(stderr, "thread %d: failed to allocate resources\n",
+			tdata->affinity);
+		g_failed = 1;
+		tdata->conns_nr = 0;
+	}
+
+	/* connect and wait until every connection is up or failed */
+	for (i = 0; i < tdata->conns_nr; i++) {
+		lconn = tdata->conns[i];
+		lconn->conn = xio_connect(lconn->ses->session, tdata->ctx,
+					  0, NULL, lconn);
+		if (!lconn->conn) {
+			lconn->failed = 1;
+			tdata->connect_done++;
+			g_failed = 1;
+		}
+	}
+	while (tdata->connect_done < tdata->conns_nr && !g_failed)
+		xio_context_run_loop(tdata->ctx, 100);
+
+	pthread_barrier_wait(&g_barrier);
+
+	while (1) {
+		/* the main thread sets up the phase between the barriers */
+		pthread_barrier_wait(&g_barrier);
+		if (g_done)
+			break;
+
+		arm_timer(tdata, (uint64_t)tdata->next_ns);
+		while (tdata->state != STATE_IDLE)
+			xio_context_run_loop(tdata->ctx, XIO_INFINITE);
+
+		pthread_barrier_wait(&g_barrier);
+	}
+
+	for (i = 0; i < tdata->conns_nr; i++)
+		if (tdata->conns[i]->conn)
+			xio_disconnect(tdata->conns[i]->conn);
+
+	deadline = get_time_ns() + 5 * NSEC_PER_SEC;
+	while (tdata->sessions_open > 0 && get_time_ns() < deadline)
+		xio_context_run_loop(tdata->ctx, 100);
+
+	if (tdata->ctx) {
+		if (tdata->timer_fd != -1)
+			xio_context_del_ev_handler(tdata->ctx, tdata->timer_fd);
+		xio_context_destroy(tdata->ctx);
+	}
+	if (tdata->timer_fd != -1)
+		close(tdata->timer_fd);
+	while ((req = tdata->free_reqs)) {
+		tdata->free_reqs = req->next;
+		free(req);
+	}
+	if (tdata->out_xbuf)
+		xio_free(&tdata->out_xbuf);
+	if (tdata->in_xbuf)
+		xio_free(&tdata->in_xbuf);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* collect - folds the threads' window into hist/cnt and restarts it	     */
+/*---------------------------------------------------------------------------*/
+static uint64_t collect(struct perf_hist *hist, struct lg_counters *cnt)
+{
+	struct lg_thread	*tdata;
+	uint64_t		outstanding = 0;
+	int			i;
+
+	perf_hist_reset(hist);
+	memset(cnt, 0, sizeof(*cnt));
+
+	for (i = 0; i < g_params.threads; i++) {
+		tdata = &g_threads[i];
+		pthread_spin_lock(&tdata->lock);
+		perf_hist_merge(hist, tdata->ival_hist);
+		perf_hist_reset(tdata->ival_hist);
+		cnt->sent	+= tdata->ival.sent;
+		cnt->completed	+= tdata->ival.completed;
+		cnt->dropped	+= tdata->ival.dropped;
+		cnt->errors	+= tdata->ival.errors;
+		memset(&tdata->ival, 0, sizeof(tdata->ival));
+		pthread_spin_unlock(&tdata->lock);
+		outstanding += __atomic_load_n(&tdata->outstanding,
+					       __ATOMIC_RELAXED);
+	}
+
+	return outstanding;
+}
+
+/*---------------------------------------------------------------------------*/
+/* fill_result								     */
+/*---------------------------------------------------------------------------*/
+static void fill_result(struct lg_result *res, const struct perf_hist *hist,
+			const struct lg_counters *cnt, double secs)
+{
+	res->sent_rate	= cnt->sent / secs;
+	res->done_rate	= cnt->completed / secs;
+	res->dropped	= cnt->dropped;
+	res->errors	= cnt->errors;
+	res->p50	= perf_hist_percentile(hist, 50.0);
+	res->p90	= perf_hist_percentile(hist, 90.0);
+	res->p99	= perf_hist_percentile(hist, 99.0);
+	res->p999	= perf_hist_percentile(hist, 99.9);
+	res->max	= hist->count ? hist->max : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_result								     */
+/*---------------------------------------------------------------------------*/
+static void print_result(const char *kind, double secs,
+			 const struct lg_result *res, uint64_t outstanding)
+{
+	if (g_params.format == FORMAT_CSV) {
+		printf("%s,%.0f,%.3f,%.0f,%.0f,%" PRIu64 ",%" PRIu64 ",%"
+		       PRIu64 ",%.1f,%.1f,%.1f,%.1f,%.1f\n",
+		       kind, res->rate, secs, res->sent_rate, res->done_rate,
+		       res->dropped, res->errors, outstanding,
+		       res->p50 / 1000.0, res->p90 / 1000.0,
+		       res->p99 / 1000.0, res->p999 / 1000.0,
+		       res->max / 1000.0);
+	} else {
+		printf("%7.1f %10.0f %10.0f %8" PRIu64 " %6" PRIu64 " %8"
+		       PRIu64 " %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+		       secs, res->sent_rate, res->done_rate,
+		       res->dropped, res->errors, outstanding,
+		       res->p50 / 1000.0, res->p90 / 1000.0,
+		       res->p99 / 1000.0, res->p999 / 1000.0,
+		       res->max / 1000.0);
+	}
+	fflush(stdout);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_phase								     */
+/*---------------------------------------------------------------------------*/
+static void run_phase(double rate, struct lg_result *res)
+{
+	struct lg_params	*params = &g_params;
+	struct perf_hist	*hist;
+	struct lg_thread	*tdata;
+	struct lg_counters	cnt, total;
+	struct lg_result	ival;
+	struct timespec		ts;
+	uint64_t		start, end, now, last, report, outstanding;
+	double			gap;
+	int			i;
+
+	hist = malloc(sizeof(*hist));
+	if (!hist) {
+		g_failed = 1;
+		return;
+	}
+
+	/* every thread carries an equal share of the aggregate rate, constant
+	 * arrivals are staggered so that the threads do not fire in lockstep
+	 */
+	gap	= NSEC_PER_SEC * (double)params->threads / rate;
+	start	= get_time_ns() + START_DELAY_NS;
+	end	= start + params->duration * NSEC_PER_SEC;
+	for (i = 0; i < params->threads; i++) {
+		tdata = &g_threads[i];
+		tdata->phase++;
+		tdata->gap_ns	= gap;
+		tdata->next_ns	= start + gap * i / params->threads;
+		tdata->end_ns	= end;
+		tdata->state	= STATE_ISSUING;
+		perf_hist_reset(tdata->ival_hist);
+		perf_hist_reset(tdata->phase_hist);
+		memset(&tdata->ival, 0, sizeof(tdata->ival));
+		memset(&tdata->phase_cnt, 0, sizeof(tdata->phase_cnt));
+	}
+
+	if (params->format == FORMAT_TEXT) {
+		printf("\nrate %.0f req/s, %s arrivals\n", rate,
+		       params->arrival == ARRIVAL_POISSON ?
+		       "poisson" : "constant");
+		printf("%7s %10s %10s %8s %6s %8s %9s %9s %9s %9s %9s\n",
+		       "time[s]", "sent/s", "done/s", "dropped", "errors",
+		       "inflight", "p50[us]", "p90[us]", "p99[us]",
+		       "p99.9[us]", "max[us]");
+	}
+
+	memset(&ival, 0, sizeof(ival));
+	ival.rate = rate;
+	pthread_barrier_wait(&g_barrier);
+
+	last = start;
+	for (report = start + params->interval_ms * NSEC_PER_MSEC;
+	     report < end; report += params->interval_ms * NSEC_PER_MSEC) {
+		ts.tv_sec  = report / NSEC_PER_SEC;
+		ts.tv_nsec = report % NSEC_PER_SEC;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &ts, NULL) == EINTR)
+			;
+		now = get_time_ns();
+		outstanding = collect(hist, &cnt);
+		fill_result(&ival, hist, &cnt, (now - last) / 1e9);
+		print_result("interval", (now - start) / 1e9, &ival,
+			     outstanding);
+		last = now;
+	}
+
+	/* the last window also carries the drain of the requests in flight */
+	pthread_barrier_wait(&g_barrier);
+	now = get_time_ns();
+	outstanding = collect(hist, &cnt);
+	fill_result(&ival, hist, &cnt, (end - last) / 1e9);
+	print_result("interval", (now - start) / 1e9, &ival, outstanding);
+
+	perf_hist_reset(hist);
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < params->threads; i++) {
+		tdata = &g_threads[i];
+		perf_hist_merge(hist, tdata->phase_hist);
+		total.sent	+= tdata->phase_cnt.sent;
+		total.completed	+= tdata->phase_cnt.completed;
+		total.dropped	+= tdata->phase_cnt.dropped;
+		total.errors	+= tdata->phase_cnt.errors;
+	}
+	res->rate = rate;
+	fill_result(res, hist, &total, params->duration);
+	if (params->format == FORMAT_CSV)
+		print_result("summary", params->duration, res, outstanding);
+
+	free(hist);
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_client								     */
+/*---------------------------------------------------------------------------*/
+static int run_client(struct lg_params *params)
+{
+	struct xio_session_params	ses_params;
+	struct lg_conn			*lconns;
+	struct lg_result		*results;
+	struct lg_thread		*tdata;
+	struct lg_session		*ses;
+	char				url[256];
+	int				total, cpus, i, j, k, retval = -1;
+
+	total	= params->sessions * params->conns;
+	cpus	= sysconf(_SC_NPROCESSORS_ONLN);
+
+	g_threads	= calloc(params->threads, sizeof(*g_threads));
+	g_sessions	= calloc(params->sessions, sizeof(*g_sessions));
+	lconns		= calloc(total, sizeof(*lconns));
+	results		= calloc(params->rates_nr, sizeof(*results));
+	if (!g_threads || !g_sessions || !lconns || !results)
+		goto cleanup;
+
+	for (i = 0; i < params->threads; i++) {
+		tdata = &g_threads[i];
+		tdata->params	= params;
+		tdata->affinity	= i % cpus;
+		tdata->timer_fd	= -1;
+		tdata->rng	= 0x9e3779b97f4a7c15ULL * (i + 1) ^
+				  get_time_ns();
+		tdata->conns	= calloc(total / params->threads + 1,
+					 sizeof(*tdata->conns));
+		tdata->ival_hist  = malloc(sizeof(*tdata->ival_hist));
+		tdata->phase_hist = malloc(sizeof(*tdata->phase_hist));
+		if (!tdata->conns || !tdata->ival_hist || !tdata->phase_hist)
+			goto cleanup;
+		pthread_spin_init(&tdata->lock, PTHREAD_PROCESS_PRIVATE);
+	}
+
+	sprintf(url, "%s://%s:%d", params->transport, params->host,
+		params->port);
+	memset(&ses_params, 0, sizeof(ses_params));
+	ses_params.type		= XIO_SESSION_CLIENT;
+	ses_params.ses_ops	= &ses_ops;
+	ses_params.uri		= url;
+
+	/* connection k of the run is owned by thread k % threads. a session
+	 * has at most one connection per context, hence conns <= threads
+	 */
+	for (i = 0, k = 0; i < params->sessions; i++) {
+		ses = &g_sessions[i];
+		ses->threads = calloc(params->threads, sizeof(*ses->threads));
+		if (!ses->threads)
+			goto cleanup;
+		ses_params.user_context = ses;
+		ses->session = xio_session_create(&ses_params);
+		if (!ses->session) {
+			fprintf(stderr, "failed to create session. %s\n",
+				xio_strerror(xio_errno()));
+			goto cleanup;
+		}
+		for (j = 0; j < params->conns; j++, k++) {
+			tdata = &g_threads[k % params->threads];
+			lconns[k].tdata	= tdata;
+			lconns[k].ses	= ses;
+			tdata->conns[tdata->conns_nr++] = &lconns[k];
+			ses->threads[ses->threads_nr++] = tdata;
+			tdata->sessions_open++;
+		}
+	}
+
+	pthread_barrier_init(&g_barrier, NULL, params->threads + 1);
+	for (i = 0; i < params->threads; i++)
+		pthread_create(&g_threads[i].thread_id, NULL, worker_thread,
+			       &g_threads[i]);
+
+	/* wait for the connections */
+	pthread_barrier_wait(&g_barrier);
+	if (!g_failed) {
+		if (params->format == FORMAT_CSV)
+			printf("kind,rate,time,sent_rps,done_rps,dropped,"
+			       "errors,inflight,p50_us,p90_us,p99_us,"
+			       "p999_us,max_us\n");
+		else
+			printf("%s: %d threads, %d sessions x %d connections\n",
+			       url, params->threads, params->sessions,
+			       params->conns);
+		for (i = 0; i < params->rates_nr && !g_failed; i++)
+			run_phase(params->rates[i], &results[i]);
+
+		if (params->format == FORMAT_TEXT) {
+			printf("\n%10s %10s %10s %8s %6s %9s %9s %9s %9s %9s\n",
+			       "rate", "sent/s", "done/s", "dropped",
+			       "errors", "p50[us]", "p90[us]", "p99[us]",
+			       "p99.9[us]", "max[us]");
+			for (j = 0; j < i; j++)
+				printf("%10.0f %10.0f %10.0f %8" PRIu64
+				       " %6" PRIu64
+				       " %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+				       results[j].rate, results[j].sent_rate,
+				       results[j].done_rate,
+				       results[j].dropped, results[j].errors,
+				       results[j].p50 / 1000.0,
+				       results[j].p90 / 1000.0,
+				       results[j].p99 / 1000.0,
+				       results[j].p999 / 1000.0,
+				       results[j].max / 1000.0);
+		}
+		retval = g_failed ? -1 : 0;
+	}
+
+	g_done = 1;
+	pthread_barrier_wait(&g_barrier);
+	for (i = 0; i < params->threads; i++)
+		pthread_join(g_threads[i].thread_id, NULL);
+	pthread_barrier_destroy(&g_barrier);
+
+cleanup:
+	for (i = 0; g_sessions && i < params->sessions; i++) {
+		if (g_sessions[i].session)
+			xio_session_destroy(g_sessions[i].session);
+		free(g_sessions[i].threads);
+	}
+	for (i = 0; g_threads && i < params->threads; i++) {
+		free(g_threads[i].conns);
+		free(g_threads[i].ival_hist);
+		free(g_threads[i].phase_hist);
+		pthread_spin_destroy(&g_threads[i].lock);
+	}
+	free(results);
+	free(lconns);
+	free(g_sessions);
+	free(g_threads);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct lg_params	*params = &g_params;
+	char			*end;
+	int			server = 0;
+	int			opt, optval, optlen, retval;
+
+	params->transport	= "rdma";
+	params->port		= DEFAULT_PORT;
+	params->threads		= 1;
+	params->sessions	= 1;
+	params->conns		= 1;
+	params->duration	= DEFAULT_DURATION;
+	params->interval_ms	= DEFAULT_INTERVAL_MS;
+	params->drain_ms	= DEFAULT_DRAIN_MS;
+	params->max_outstanding	= DEFAULT_MAX_OUTSTANDING;
+	params->max_rsp		= DEFAULT_MAX_RSP;
+
+	if (parse_rates(DEFAULT_RATE, params) ||
+	    parse_dist(DEFAULT_SIZES, &params->req_dist) ||
+	    parse_dist(DEFAULT_SIZES, &params->rsp_dist))
+		return -1;
+
+	while ((opt = getopt_long(argc, argv,
+				  "Sc:p:r:t:s:n:R:a:d:i:q:Q:M:D:m:f:h",
+				  long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'S':
+			server = 1;
+			break;
+		case 'c':
+			params->host = optarg;
+			break;
+		case 'p':
+			params->port = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			params->transport = optarg;
+			break;
+		case 't':
+			params->threads = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			params->sessions = strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			params->conns = strtol(optarg, NULL, 0);
+			break;
+		case 'R':
+			if (parse_rates(optarg, params))
+				goto bad_arg;
+			break;
+		case 'a':
+			if (!strcmp(optarg, "poisson"))
+				params->arrival = ARRIVAL_POISSON;
+			else if (!strcmp(optarg, "constant"))
+				params->arrival = ARRIVAL_CONSTANT;
+			else
+				goto bad_arg;
+			break;
+		case 'd':
+			params->duration = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			params->interval_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'q':
+			free(params->req_dist.sizes);
+			free(params->req_dist.cdf);
+			if (parse_dist(optarg, &params->req_dist))
+				goto bad_arg;
+			break;
+		case 'Q':
+			free(params->rsp_dist.sizes);
+			free(params->rsp_dist.cdf);
+			if (parse_dist(optarg, &params->rsp_dist))
+				goto bad_arg;
+			break;
+		case 'M':
+			if (parse_size(optarg, &end, &params->max_rsp) ||
+			    *end || params->max_rsp == 0)
+				goto bad_arg;
+			break;
+		case 'D':
+			params->queue_depth = strtol(optarg, NULL, 0);
+			break;
+		case 'm':
+			params->max_outstanding = strtol(optarg, NULL, 0);
+			break;
+		case 'f':
+			if (!strcmp(optarg, "text"))
+				params->format = FORMAT_TEXT;
+			else if (!strcmp(optarg, "csv"))
+				params->format = FORMAT_CSV;
+			else
+				goto bad_arg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			goto bad_arg;
+		}
+	}
+
+	if (server == !!params->host || params->threads < 1 ||
+	    params->sessions < 1 || params->conns < 1 ||
+	    params->conns > params->threads ||
+	    params->duration < 1 || params->interval_ms < 1 ||
+	    params->max_outstanding < 1 ||
+	    (strcmp(params->transport, "rdma") &&
+	     strcmp(params->transport, "tcp")))
+		goto bad_arg;
+
+	xio_init();
+
+	if (params->queue_depth > 0)
+		xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			    XIO_OPTNAME_QUEUE_DEPTH,
+			    &params->queue_depth, sizeof(int));
+	optlen = sizeof(params->conn_depth);
+	if (xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_QUEUE_DEPTH,
+			&params->conn_depth, &optlen))
+		params->conn_depth = DEFAULT_MAX_OUTSTANDING;
+	if (!strcmp(params->transport, "tcp")) {
+		optval = 1;
+		xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_NO_DELAY,
+			    &optval, sizeof(optval));
+	}
+
+	retval = server ? run_server(params) : run_client(params);
+
+	xio_shutdown();
+
+	free(params->rates);
+	free(params->req_dist.sizes);
+	free(params->req_dist.cdf);
+	free(params->rsp_dist.sizes);
+	free(params->rsp_dist.cdf);
+
+	return retval ? 1 : 0;
+
+bad_arg:
+	usage(argv[0]);
+	return 1;
+}
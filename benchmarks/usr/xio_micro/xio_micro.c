@@ -0,0 +1,731 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <getopt.h>
+#include <sys/eventfd.h>
+
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_common.h"
+#include "xio_protocol.h"
+#include "xio_msg_list.h"
+#include "xio_task.h"
+#include "xio_timers_list.h"
+#include "xio_ev_loop.h"
+
+#define DEFAULT_ITERS		1000000
+#define DEFAULT_REPEATS		5
+#define BURST			32
+#define LIST_LEN		64
+#define PENDING_TIMERS		64
+#define IOV_NR			4
+#define IOV_LEN			1024
+
+/*
+ * single threaded microbenchmarks of the library internals that sit on the
+ * data path. every benchmark runs its iterations "repeats" times and the
+ * min/avg/max cost of one operation is reported, either as a table or as
+ * csv/json for tracking regressions across releases.
+ */
+
+enum output_format {
+	OUTPUT_TEXT,
+	OUTPUT_CSV,
+	OUTPUT_JSON,
+};
+
+struct bench {
+	const char	*name;
+	const char	*desc;
+	/* runs iters iterations and returns the number of operations done */
+	uint64_t	(*run)(uint64_t iters);
+};
+
+static volatile uint64_t	sink;
+
+/*---------------------------------------------------------------------------*/
+/* mempool								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_mempool	*mpool;
+
+static uint64_t mempool_alloc_free(uint64_t iters, size_t len)
+{
+	struct xio_mempool_obj	obj;
+	uint64_t		i;
+
+	for (i = 0; i < iters; i++) {
+		xio_mempool_alloc(mpool, len, &obj);
+		sink += (uintptr_t)obj.addr;
+		xio_mempool_free(&obj);
+	}
+	return iters;
+}
+
+static uint64_t mempool_alloc_free_64(uint64_t iters)
+{
+	return mempool_alloc_free(iters, 64);
+}
+
+static uint64_t mempool_alloc_free_4k(uint64_t iters)
+{
+	return mempool_alloc_free(iters, 4096);
+}
+
+static uint64_t mempool_burst_64(uint64_t iters)
+{
+	struct xio_mempool_obj	obj[BURST];
+	uint64_t		i;
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < BURST; j++)
+			xio_mempool_alloc(mpool, 64, &obj[j]);
+		for (j = BURST - 1; j >= 0; j--)
+			xio_mempool_free(&obj[j]);
+	}
+	return iters * BURST;
+}
+
+/*---------------------------------------------------------------------------*/
+/* tasks pool								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_tasks_pool	*tasks_pool;
+
+static uint64_t tasks_pool_get_put(uint64_t iters)
+{
+	struct xio_task		*task;
+	uint64_t		i;
+
+	for (i = 0; i < iters; i++) {
+		task = xio_tasks_pool_get(tasks_pool);
+		sink += task->tlv_type;
+		xio_tasks_pool_put(task);
+	}
+	return iters;
+}
+
+static uint64_t tasks_pool_burst(uint64_t iters)
+{
+	struct xio_task		*task[BURST];
+	uint64_t		i;
+	int			j;
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < BURST; j++)
+			task[j] = xio_tasks_pool_get(tasks_pool);
+		for (j = 0; j < BURST; j++)
+			xio_tasks_pool_put(task[j]);
+	}
+	return iters * BURST;
+}
+
+/*---------------------------------------------------------------------------*/
+/* timers list - PENDING_TIMERS timers are kept armed in the background so  */
+/* the sorted insertion has something to walk over			     */
+/*---------------------------------------------------------------------------*/
+static struct xio_timers_list		timers_list;
+static xio_delayed_work_handle_t	pending_timers[PENDING_TIMERS];
+
+static void timer_fired(void *data)
+{
+	sink++;
+}
+
+static uint64_t timers_add_del(uint64_t iters)
+{
+	struct xio_timers_list_entry	tentry;
+	uint64_t			i;
+
+	INIT_LIST_HEAD(&tentry.entry);
+	for (i = 0; i < iters; i++) {
+		xio_timers_list_add_duration(
+				&timers_list,
+				(i % PENDING_TIMERS + 1) * XIO_NS_IN_SEC,
+				&tentry);
+		xio_timers_list_del(&timers_list, &tentry);
+	}
+	return iters;
+}
+
+static uint64_t timers_add_expire(uint64_t iters)
+{
+	xio_delayed_work_handle_t	dwork;
+	uint64_t			i;
+
+	memset(&dwork, 0, sizeof(dwork));
+	INIT_LIST_HEAD(&dwork.timer.entry);
+	dwork.work.function = timer_fired;
+	for (i = 0; i < iters; i++) {
+		dwork.work.flags |= XIO_WORK_PENDING;
+		xio_timers_list_add_duration(&timers_list, 0, &dwork.timer);
+		xio_timers_list_expire(&timers_list);
+	}
+	return iters;
+}
+
+/*---------------------------------------------------------------------------*/
+/* event loop								     */
+/*---------------------------------------------------------------------------*/
+static void		*ev_loop;
+static int		ev_fd = -1;
+static struct xio_ev_data ev_event;
+
+static void ev_fd_handler(int fd, int events, void *data)
+{
+	eventfd_t	val;
+
+	if (eventfd_read(fd, &val) == 0)
+		sink += val;
+}
+
+static void ev_event_handler(struct xio_ev_data *tev, void *data)
+{
+	sink++;
+}
+
+static uint64_t ev_loop_add_del(uint64_t iters)
+{
+	uint64_t	i;
+
+	for (i = 0; i < iters; i++) {
+		xio_ev_loop_add(ev_loop, ev_fd, XIO_POLLIN,
+				ev_fd_handler, NULL);
+		xio_ev_loop_del(ev_loop, ev_fd);
+		/* deleted handlers are released by the loop itself */
+		if ((i & 255) == 255)
+			xio_ev_loop_run_timeout(ev_loop, 0);
+	}
+	xio_ev_loop_run_timeout(ev_loop, 0);
+
+	return iters;
+}
+
+static uint64_t ev_loop_modify(uint64_t iters)
+{
+	uint64_t	i;
+
+	xio_ev_loop_add(ev_loop, ev_fd, XIO_POLLIN, ev_fd_handler, NULL);
+	for (i = 0; i < iters; i++)
+		xio_ev_loop_modify(ev_loop, ev_fd,
+				   (i & 1) ? XIO_POLLIN : XIO_POLLOUT);
+	xio_ev_loop_del(ev_loop, ev_fd);
+	xio_ev_loop_run_timeout(ev_loop, 0);
+
+	return iters;
+}
+
+static uint64_t ev_loop_dispatch_fd(uint64_t iters)
+{
+	uint64_t	i;
+
+	xio_ev_loop_add(ev_loop, ev_fd, XIO_POLLIN, ev_fd_handler, NULL);
+	for (i = 0; i < iters; i++) {
+		eventfd_write(ev_fd, 1);
+		xio_ev_loop_run_timeout(ev_loop, 0);
+	}
+	xio_ev_loop_del(ev_loop, ev_fd);
+	xio_ev_loop_run_timeout(ev_loop, 0);
+
+	return iters;
+}
+
+static uint64_t ev_loop_dispatch_event(uint64_t iters)
+{
+	uint64_t	i;
+
+	xio_ev_loop_init_event(&ev_event, ev_event_handler, NULL);
+	for (i = 0; i < iters; i++) {
+		xio_ev_loop_add_event(ev_loop, &ev_event);
+		xio_ev_loop_run_timeout(ev_loop, 0);
+	}
+	return iters;
+}
+
+/*---------------------------------------------------------------------------*/
+/* scatter/gather copy							     */
+/*---------------------------------------------------------------------------*/
+static char			copy_src[IOV_NR * IOV_LEN];
+static char			copy_dst[IOV_NR * IOV_LEN];
+
+static uint64_t memcpyv_gather(uint64_t iters)
+{
+	struct xio_iovec	src[IOV_NR], dst[1];
+	uint64_t		i;
+	int			j;
+
+	for (j = 0; j < IOV_NR; j++) {
+		src[j].iov_base = copy_src + j * IOV_LEN;
+		src[j].iov_len  = IOV_LEN;
+	}
+	dst[0].iov_base = copy_dst;
+	dst[0].iov_len  = sizeof(copy_dst);
+	for (i = 0; i < iters; i++)
+		sink += memcpyv(dst, 1, src, IOV_NR);
+
+	return iters;
+}
+
+static uint64_t memcpyv_scatter(uint64_t iters)
+{
+	struct xio_iovec	src[1], dst[IOV_NR];
+	uint64_t		i;
+	int			j;
+
+	for (j = 0; j < IOV_NR; j++) {
+		dst[j].iov_base = copy_dst + j * IOV_LEN;
+		dst[j].iov_len  = IOV_LEN;
+	}
+	src[0].iov_base = copy_src;
+	src[0].iov_len  = sizeof(copy_src);
+	for (i = 0; i < iters; i++)
+		sink += memcpyv(dst, IOV_NR, src, 1);
+
+	return iters;
+}
+
+static uint64_t memcpyv_ex_gather(uint64_t iters)
+{
+	struct xio_iovec_ex	src[IOV_NR], dst[1];
+	uint64_t		i;
+	int			j;
+
+	memset(src, 0, sizeof(src));
+	memset(dst, 0, sizeof(dst));
+	for (j = 0; j < IOV_NR; j++) {
+		src[j].iov_base = copy_src + j * IOV_LEN;
+		src[j].iov_len  = IOV_LEN;
+	}
+	dst[0].iov_base = copy_dst;
+	dst[0].iov_len  = sizeof(copy_dst);
+	for (i = 0; i < iters; i++)
+		sink += memcpyv_ex(dst, 1, src, IOV_NR);
+
+	return iters;
+}
+
+static uint64_t memcpyv_ex_scatter(uint64_t iters)
+{
+	struct xio_iovec_ex	src[1], dst[IOV_NR];
+	uint64_t		i;
+	int			j;
+
+	memset(src, 0, sizeof(src));
+	memset(dst, 0, sizeof(dst));
+	for (j = 0; j < IOV_NR; j++) {
+		dst[j].iov_base = copy_dst + j * IOV_LEN;
+		dst[j].iov_len  = IOV_LEN;
+	}
+	src[0].iov_base = copy_src;
+	src[0].iov_len  = sizeof(copy_src);
+	for (i = 0; i < iters; i++)
+		sink += memcpyv_ex(dst, IOV_NR, src, 1);
+
+	return iters;
+}
+
+/*---------------------------------------------------------------------------*/
+/* tlv and protocol encoders						     */
+/*---------------------------------------------------------------------------*/
+static uint8_t			wire[256];
+
+static uint64_t tlv_write_read(uint64_t iters)
+{
+	uint32_t	type;
+	uint64_t	len, i;
+	void		*value;
+
+	for (i = 0; i < iters; i++) {
+		xio_write_tlv(0x100 + (i & 7), 64, wire);
+		sink += xio_read_tlv(&type, &len, &value, wire);
+		sink += type;
+	}
+	return iters;
+}
+
+/* a header shaped like the session and transport headers */
+static uint64_t protocol_encode_decode(uint64_t iters)
+{
+	uint64_t	i, u64a, u64b;
+	uint32_t	u32a, u32b;
+	uint16_t	u16a, u16b;
+	uint8_t		u8;
+	size_t		len;
+
+	for (i = 0; i < iters; i++) {
+		len  = xio_write_uint32((uint32_t)i, 0, wire);
+		len += xio_write_uint16(1, len, wire);
+		len += xio_write_uint16(2, len, wire);
+		len += xio_write_uint64(i, len, wire);
+		len += xio_write_uint64(~i, len, wire);
+		len += xio_write_uint32(64, len, wire);
+		len += xio_write_uint8(3, len, wire);
+
+		len  = xio_read_uint32(&u32a, 0, wire);
+		len += xio_read_uint16(&u16a, len, wire);
+		len += xio_read_uint16(&u16b, len, wire);
+		len += xio_read_uint64(&u64a, len, wire);
+		len += xio_read_uint64(&u64b, len, wire);
+		len += xio_read_uint32(&u32b, len, wire);
+		len += xio_read_uint8(&u8, len, wire);
+		sink += u32a + u16a + u16b + u64a + u64b + u32b + u8 + len;
+	}
+	return iters;
+}
+
+/*---------------------------------------------------------------------------*/
+/* message lists							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_msg		msgs[LIST_LEN];
+
+static uint64_t msg_list_tail_remove(uint64_t iters)
+{
+	struct xio_msg_list	list;
+	struct xio_msg		*msg;
+	uint64_t		i;
+	int			j;
+
+	xio_msg_list_init(&list);
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < LIST_LEN; j++)
+			xio_msg_list_insert_tail(&list, &msgs[j], pdata);
+		while (!xio_msg_list_empty(&list)) {
+			msg = xio_msg_list_first(&list);
+			xio_msg_list_remove(&list, msg, pdata);
+		}
+	}
+	return iters * LIST_LEN;
+}
+
+static uint64_t msg_list_head_remove(uint64_t iters)
+{
+	struct xio_msg_list	list;
+	struct xio_msg		*msg;
+	uint64_t		i;
+	int			j;
+
+	xio_msg_list_init(&list);
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < LIST_LEN; j++)
+			xio_msg_list_insert_head(&list, &msgs[j], pdata);
+		while (!xio_msg_list_empty(&list)) {
+			msg = xio_msg_list_first(&list);
+			xio_msg_list_remove(&list, msg, pdata);
+		}
+	}
+	return iters * LIST_LEN;
+}
+
+static uint64_t msg_list_concat(uint64_t iters)
+{
+	struct xio_msg_list	list1, list2;
+	uint64_t		i;
+
+	xio_msg_list_init(&list1);
+	xio_msg_list_init(&list2);
+	xio_msg_list_insert_tail(&list1, &msgs[0], pdata);
+	xio_msg_list_insert_tail(&list2, &msgs[1], pdata);
+	for (i = 0; i < iters; i++) {
+		xio_msg_list_concat(&list1, &list2, pdata);
+		xio_msg_list_remove(&list1, &msgs[1], pdata);
+		xio_msg_list_insert_tail(&list2, &msgs[1], pdata);
+	}
+	return iters;
+}
+
+/*---------------------------------------------------------------------------*/
+/* benchmarks table							     */
+/*---------------------------------------------------------------------------*/
+static struct bench benches[] = {
+	{ "mempool_alloc_free_64",  "alloc+free of a 64B object",
+	  mempool_alloc_free_64 },
+	{ "mempool_alloc_free_4k",  "alloc+free of a 4KB object",
+	  mempool_alloc_free_4k },
+	{ "mempool_burst_64",	    "per object, 32 allocs then 32 frees",
+	  mempool_burst_64 },
+	{ "tasks_pool_get_put",	    "get+put of one task",
+	  tasks_pool_get_put },
+	{ "tasks_pool_burst",	    "per task, 32 gets then 32 puts",
+	  tasks_pool_burst },
+	{ "timers_add_del",	    "add+del with 64 timers pending",
+	  timers_add_del },
+	{ "timers_add_expire",	    "add+expire+dispatch of one timer",
+	  timers_add_expire },
+	{ "ev_loop_add_del",	    "fd add+del",
+	  ev_loop_add_del },
+	{ "ev_loop_modify",	    "fd modify",
+	  ev_loop_modify },
+	{ "ev_loop_dispatch_fd",    "eventfd write+loop pass+handler",
+	  ev_loop_dispatch_fd },
+	{ "ev_loop_dispatch_event", "scheduled event add+loop pass",
+	  ev_loop_dispatch_event },
+	{ "memcpyv_gather",	    "4x1KB into 4KB",
+	  memcpyv_gather },
+	{ "memcpyv_scatter",	    "4KB into 4x1KB",
+	  memcpyv_scatter },
+	{ "memcpyv_ex_gather",	    "4x1KB into 4KB",
+	  memcpyv_ex_gather },
+	{ "memcpyv_ex_scatter",	    "4KB into 4x1KB",
+	  memcpyv_ex_scatter },
+	{ "tlv_write_read",	    "tlv header write+read",
+	  tlv_write_read },
+	{ "protocol_encode_decode", "7 field header encode+decode",
+	  protocol_encode_decode },
+	{ "msg_list_tail_remove",   "per msg, insert_tail+remove",
+	  msg_list_tail_remove },
+	{ "msg_list_head_remove",   "per msg, insert_head+remove",
+	  msg_list_head_remove },
+	{ "msg_list_concat",	    "concat+remove+insert_tail",
+	  msg_list_concat },
+};
+
+#define BENCHES_NR	(sizeof(benches) / sizeof(benches[0]))
+
+/*---------------------------------------------------------------------------*/
+/* setup								     */
+/*---------------------------------------------------------------------------*/
+static int setup(void)
+{
+	struct xio_tasks_pool_params	params;
+	int				i;
+
+	mpool = xio_mempool_create(-1, XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC);
+	if (!mpool)
+		return -1;
+	/* preallocated, so a burst never resizes a slot while timed */
+	if (xio_mempool_add_allocator(mpool, 64, 64, 1024, 64) ||
+	    xio_mempool_add_allocator(mpool, 4096, 64, 1024, 64))
+		return -1;
+
+	memset(&params, 0, sizeof(params));
+	params.start_nr	= 256;
+	params.max_nr	= 1024;
+	params.alloc_nr	= 64;
+	tasks_pool = xio_tasks_pool_create(&params);
+	if (!tasks_pool)
+		return -1;
+
+	xio_timers_list_init(&timers_list);
+	for (i = 0; i < PENDING_TIMERS; i++) {
+		INIT_LIST_HEAD(&pending_timers[i].timer.entry);
+		pending_timers[i].work.function = timer_fired;
+		xio_timers_list_add_duration(&timers_list,
+					     (i + 1) * XIO_NS_IN_SEC,
+					     &pending_timers[i].timer);
+	}
+
+	ev_loop = xio_ev_loop_create();
+	if (!ev_loop)
+		return -1;
+	ev_fd = eventfd(0, EFD_NONBLOCK);
+	if (ev_fd < 0)
+		return -1;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* teardown								     */
+/*---------------------------------------------------------------------------*/
+static void teardown(void)
+{
+	if (ev_fd >= 0)
+		close(ev_fd);
+	if (ev_loop)
+		xio_ev_loop_destroy(&ev_loop);
+	xio_timers_list_close(&timers_list);
+	if (tasks_pool)
+		xio_tasks_pool_destroy(tasks_pool);
+	if (mpool)
+		xio_mempool_destroy(mpool);
+}
+
+/*---------------------------------------------------------------------------*/
+/* now_ns								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * XIO_NS_IN_SEC + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0, int status)
+{
+	printf("Usage: %s [OPTIONS]\n", argv0);
+	printf("\t-n <iters>\titerations per run (default %d)\n",
+	       DEFAULT_ITERS);
+	printf("\t-r <repeats>\truns per benchmark (default %d)\n",
+	       DEFAULT_REPEATS);
+	printf("\t-b <name>\trun only benchmarks whose name contains <name>\n");
+	printf("\t-f <format>\toutput format: text, csv or json " \
+	       "(default text)\n");
+	printf("\t-l\t\tlist the benchmarks and exit\n");
+	printf("\t-h\t\tdisplay this help and exit\n");
+
+	exit(status);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	enum output_format	format = OUTPUT_TEXT;
+	const char		*filter = NULL;
+	uint64_t		iters = DEFAULT_ITERS;
+	uint64_t		ops, start, elapsed;
+	double			ns, min, max, sum;
+	int			repeats = DEFAULT_REPEATS;
+	int			c, r, first = 1;
+	size_t			b;
+
+	while ((c = getopt(argc, argv, "n:r:b:f:lh")) != -1) {
+		switch (c) {
+		case 'n':
+			iters = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeats = atoi(optarg);
+			break;
+		case 'b':
+			filter = optarg;
+			break;
+		case 'f':
+			if (!strcmp(optarg, "csv"))
+				format = OUTPUT_CSV;
+			else if (!strcmp(optarg, "json"))
+				format = OUTPUT_JSON;
+			else if (!strcmp(optarg, "text"))
+				format = OUTPUT_TEXT;
+			else
+				usage(argv[0], 1);
+			break;
+		case 'l':
+			for (b = 0; b < BENCHES_NR; b++)
+				printf("%-24s %s\n", benches[b].name,
+				       benches[b].desc);
+			return 0;
+		case 'h':
+			usage(argv[0], 0);
+			break;
+		default:
+			usage(argv[0], 1);
+			break;
+		}
+	}
+	if (iters == 0 || repeats <= 0)
+		usage(argv[0], 1);
+
+	xio_init();
+
+	if (setup()) {
+		fprintf(stderr, "setup failed. %s\n",
+			xio_strerror(xio_errno()));
+		teardown();
+		xio_shutdown();
+		return 1;
+	}
+
+	switch (format) {
+	case OUTPUT_CSV:
+		printf("name,iters,repeats,ops,min_ns,avg_ns,max_ns\n");
+		break;
+	case OUTPUT_JSON:
+		printf("{\n  \"iters\": %" PRIu64 ",\n  \"repeats\": %d,\n" \
+		       "  \"benchmarks\": [", iters, repeats);
+		break;
+	default:
+		printf("%-24s %14s %10s %10s %10s\n",
+		       "name", "ops", "min ns/op", "avg ns/op", "max ns/op");
+		break;
+	}
+
+	for (b = 0; b < BENCHES_NR; b++) {
+		if (filter && !strstr(benches[b].name, filter))
+			continue;
+
+		/* warm up caches and grow the pools outside the timing */
+		benches[b].run(iters / 10 + 1);
+
+		min = max = sum = 0;
+		ops = 0;
+		for (r = 0; r < repeats; r++) {
+			start = now_ns();
+			ops = benches[b].run(iters);
+			elapsed = now_ns() - start;
+			ns = (double)elapsed / ops;
+			if (r == 0 || ns < min)
+				min = ns;
+			if (ns > max)
+				max = ns;
+			sum += ns;
+		}
+
+		switch (format) {
+		case OUTPUT_CSV:
+			printf("%s,%" PRIu64 ",%d,%" PRIu64 ",%.2f,%.2f,%.2f\n",
+			       benches[b].name, iters, repeats, ops,
+			       min, sum / repeats, max);
+			break;
+		case OUTPUT_JSON:
+			printf("%s\n    { \"name\": \"%s\", \"ops\": %" PRIu64
+			       ", \"min_ns\": %.2f, \"avg_ns\": %.2f" \
+			       ", \"max_ns\": %.2f }",
+			       first ? "" : ",", benches[b].name, ops,
+			       min, sum / repeats, max);
+			break;
+		default:
+			printf("%-24s %14" PRIu64 " %10.2f %10.2f %10.2f\n",
+			       benches[b].name, ops, min, sum / repeats, max);
+			break;
+		}
+		fflush(stdout);
+		first = 0;
+	}
+
+	if (format == OUTPUT_JSON)
+		printf("\n  ]\n}\n");
+
+	teardown();
+	xio_shutdown();
+
+	return 0;
+}
@@ -67,23 +67,33 @@ int main(int argc, char *argv[])
 {
 	struct perf_parameters	user_param;
 	int optval;
+	int is_rdma;
 
 
 	if (parse_cmdline(&user_param, argc, argv) != 0)
 		return -1;
 
+	is_rdma = !strcmp(user_param.transport, "rdma");
+
 	print_test_info(&user_param);
 
 	set_cpu_affinity(user_param.cpu);
 
 	/* run as root */
-	if (user_param.test_type == LAT) {
+	if (is_rdma && user_param.test_type == LAT) {
 		optval = 1;
 		xio_set_opt(NULL,
 			    XIO_OPTLEVEL_RDMA,
 			    XIO_OPTNAME_ENABLE_DMA_LATENCY,
 			    &optval, sizeof(optval));
 	}
+	if (!is_rdma) {
+		optval = 1;
+		xio_set_opt(NULL,
+			    XIO_OPTLEVEL_TCP,
+			    XIO_OPTNAME_TCP_NO_DELAY,
+			    &optval, sizeof(optval));
+	}
 
 
 	if (user_param.machine_type == CLIENT)
@@ -93,7 +103,7 @@ int main(int argc, char *argv[])
 		run_server_test(&user_param);
 
 	/* run as root */
-	if (user_param.test_type == LAT) {
+	if (is_rdma && user_param.test_type == LAT) {
 		optval = 0;
 		xio_set_opt(NULL,
 			    XIO_OPTLEVEL_RDMA,
@@ -53,6 +53,7 @@
 #include "xio_perftest_parameters.h"
 #include "xio_perftest_communication.h"
 #include "xio_perftest_resources.h"
+#include "xio_perftest_histogram.h"
 #include "xio_perftest.h"
 
 #define USECS_IN_SEC		1000000
@@ -69,6 +70,7 @@ struct thread_stat_data {
 
 struct thread_data {
 	struct thread_stat_data stat;
+	struct perf_hist	*hist;
 	struct session_data    *sdata;
 	struct msg_pool		*pool;
 	struct xio_buf		*xbuf;
@@ -93,6 +95,12 @@ struct session_data {
 	double			min_lat_us;
 	double			max_lat_us;
 	double			avg_bw;
+	double			p50_lat_us;
+	double			p90_lat_us;
+	double			p99_lat_us;
+	double			p999_lat_us;
+	double			p9999_lat_us;
+	uint64_t		samples;
 	int			abort;
 	int			hs_connected;
 	struct xio_session	*session;
@@ -112,6 +120,7 @@ static uint64_t	hdr_len;
 static uint64_t	data_len;
 static FILE	*fd = NULL;
 static double	g_mhz;
+static uint64_t	co_interval_ns;
 
 /*---------------------------------------------------------------------------*/
 /* statistics_thread_cb							     */
@@ -166,7 +175,7 @@ static void *statistics_thread_cb(void *data)
 		rtt_end += sess_data->tdata[i].stat.tot_rtt;
 		if (min_rtt > sess_data->tdata[i].stat.min_rtt)
 			min_rtt = sess_data->tdata[i].stat.min_rtt;
-		if (max_rtt < sess_data->tdata[i].stat.min_rtt)
+		if (max_rtt < sess_data->tdata[i].stat.max_rtt)
 			max_rtt = sess_data->tdata[i].stat.max_rtt;
 	}
 	if ( scnt_end != scnt_start) {
@@ -333,6 +342,9 @@ static int on_response(struct xio_session *session,
 			tdata->stat.min_rtt = rtt;
 		tdata->stat.tot_rtt += rtt;
 		tdata->stat.ccnt++;
+		perf_hist_record_corrected(tdata->hist,
+					   (uint64_t)(rtt * 1000 / g_mhz),
+					   co_interval_ns);
 	}
 
 	tdata->rx_nr++;
@@ -395,6 +407,104 @@ static struct xio_session_ops ses_ops = {
 	.on_msg_error			=  on_msg_error
 };
 
+/*---------------------------------------------------------------------------*/
+/* collect_percentiles - merge the per thread histograms of the run	     */
+/*---------------------------------------------------------------------------*/
+static void collect_percentiles(struct session_data *sess_data,
+				struct perf_hist *total)
+{
+	int i;
+
+	perf_hist_reset(total);
+	for (i = 0; i < threads_iter; i++)
+		perf_hist_merge(total, sess_data->tdata[i].hist);
+
+	sess_data->samples	= total->count;
+	sess_data->p50_lat_us	= perf_hist_percentile(total, 50.0) / 1000.0;
+	sess_data->p90_lat_us	= perf_hist_percentile(total, 90.0) / 1000.0;
+	sess_data->p99_lat_us	= perf_hist_percentile(total, 99.0) / 1000.0;
+	sess_data->p999_lat_us	= perf_hist_percentile(total, 99.9) / 1000.0;
+	sess_data->p9999_lat_us	= perf_hist_percentile(total, 99.99) / 1000.0;
+	if (co_interval_ns && total->count) {
+		/* the corrected samples shift the average and the peak */
+		sess_data->avg_lat_us = perf_hist_mean(total) / 1000.0;
+		sess_data->max_lat_us = total->max / 1000.0;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* report_open								     */
+/*---------------------------------------------------------------------------*/
+static void report_open(struct perf_parameters *user_param, int format)
+{
+	switch (format) {
+	case JSON:
+		fprintf(fd, "{\n  \"transport\": \"%s\",\n" \
+			"  \"test\": \"%s\",\n" \
+			"  \"queue_depth\": %d,\n" \
+			"  \"co_interval_us\": %d,\n" \
+			"  \"results\": [",
+			user_param->transport,
+			user_param->test_type == BW ? "BW" : "LAT",
+			user_param->queue_depth, user_param->co_interval_us);
+		break;
+	default:
+		fprintf(fd, "size,threads,tps,bw_mbps,lat_avg_us,lat_min_us," \
+			"lat_max_us,lat_p50_us,lat_p90_us,lat_p99_us," \
+			"lat_p999_us,lat_p9999_us,samples\n");
+		break;
+	}
+	fflush(fd);
+}
+
+/*---------------------------------------------------------------------------*/
+/* report_result							     */
+/*---------------------------------------------------------------------------*/
+static void report_result(struct session_data *sess_data, int format,
+			  int first)
+{
+	switch (format) {
+	case JSON:
+		fprintf(fd, "%s\n    { \"size\": %" PRIu64 \
+			", \"threads\": %d, \"tps\": %" PRIu64 \
+			", \"bw_mbps\": %.2lf, \"lat_avg_us\": %.2lf" \
+			", \"lat_min_us\": %.2lf, \"lat_max_us\": %.2lf" \
+			", \"lat_p50_us\": %.2lf, \"lat_p90_us\": %.2lf" \
+			", \"lat_p99_us\": %.2lf, \"lat_p999_us\": %.2lf" \
+			", \"lat_p9999_us\": %.2lf, \"samples\": %" PRIu64 \
+			" }",
+			first ? "" : ",", data_len, threads_iter,
+			sess_data->tps, sess_data->avg_bw,
+			sess_data->avg_lat_us, sess_data->min_lat_us,
+			sess_data->max_lat_us, sess_data->p50_lat_us,
+			sess_data->p90_lat_us, sess_data->p99_lat_us,
+			sess_data->p999_lat_us, sess_data->p9999_lat_us,
+			sess_data->samples);
+		break;
+	default:
+		fprintf(fd, "%" PRIu64 ",%d,%" PRIu64 ",%.2lf,%.2lf,%.2lf," \
+			"%.2lf,%.2lf,%.2lf,%.2lf,%.2lf,%.2lf,%" PRIu64 "\n",
+			data_len, threads_iter, sess_data->tps,
+			sess_data->avg_bw, sess_data->avg_lat_us,
+			sess_data->min_lat_us, sess_data->max_lat_us,
+			sess_data->p50_lat_us, sess_data->p90_lat_us,
+			sess_data->p99_lat_us, sess_data->p999_lat_us,
+			sess_data->p9999_lat_us, sess_data->samples);
+		break;
+	}
+	fflush(fd);
+}
+
+/*---------------------------------------------------------------------------*/
+/* report_close								     */
+/*---------------------------------------------------------------------------*/
+static void report_close(int format)
+{
+	if (format == JSON)
+		fprintf(fd, "\n  ]\n}\n");
+	fflush(fd);
+}
+
 /*---------------------------------------------------------------------------*/
 /* run_client_test							     */
 /*---------------------------------------------------------------------------*/
@@ -403,7 +513,10 @@ int run_client_test(struct perf_parameters *user_param)
 	struct session_data	sess_data;
 	struct perf_comm	*comm;
 	struct thread_data	*tdata;
+	struct perf_hist	*hists = NULL;
+	struct perf_hist	*total = NULL;
 	char			url[256];
+	char			cpus_str[256];
 	int			i = 0;
 	int			cpu;
 	int			max_cpus;
@@ -411,8 +524,8 @@ int run_client_test(struct perf_parameters *user_param)
 	uint64_t		cpusmask;
 	pthread_t		statistics_thread_id;
 	struct perf_command	command;
-	int			size_log2;
-	int			max_size_log2 = 24;
+	uint32_t		size_idx, threads_idx;
+	int			format = CSV, first = 1;
 	struct xio_session_params params;
 
 
@@ -420,14 +533,21 @@ int run_client_test(struct perf_parameters *user_param)
 
 	g_mhz		= get_cpu_mhz(0);
 	max_cpus	= sysconf(_SC_NPROCESSORS_ONLN);
-	threads_iter	= 1;
-	size_log2	= 0;
+	co_interval_ns	= (uint64_t)user_param->co_interval_us * NSECS_IN_USEC;
+	size_idx	= 0;
+	threads_idx	= 0;
 
 	tdata = calloc(user_param->threads_num, sizeof(*tdata));
 	if (tdata == NULL) {
-		fprintf(fd, "malloc failed\n");
+		fprintf(stderr, "malloc failed\n");
+		goto cleanup1;
+	}
+	hists = calloc(user_param->threads_num + 1, sizeof(*hists));
+	if (hists == NULL) {
+		fprintf(stderr, "malloc failed\n");
 		goto cleanup1;
 	}
+	total = &hists[user_param->threads_num];
 
 	comm = create_comm_struct(user_param);
 	if (establish_connection(comm)) {
@@ -435,33 +555,51 @@ int run_client_test(struct perf_parameters *user_param)
 		goto cleanup2;
 	}
 
+	/* the table goes to stdout, machine readable results to the output
+	 * file, or to stdout in its place when a format is asked for
+	 */
+	format = (user_param->output_format == TEXT) ? CSV :
+						user_param->output_format;
 	if (user_param->output_file) {
 		fd = fopen(user_param->output_file, "w");
 		if (fd == NULL) {
-			fprintf(fd, "file open failed. %s\n",
+			fprintf(stderr, "file open failed. %s\n",
 				user_param->output_file);
 			goto cleanup2;
 		}
-		fprintf(fd, "size, threads, tps, bw[Mbps], lat[usec]\n");
-		fflush(fd);
-	}
-	i = intf_name_best_cpus(user_param->intf_name, &cpusmask, &cpusnr);
-	if (i == 0) {
-		printf("best cpus [%d] %s\n", cpusnr,
-		       intf_cpusmask_str(cpusmask, cpusnr, user_param->intf_name));
+	} else if (user_param->output_format != TEXT) {
+		fd = stdout;
 	}
+	if (fd)
+		report_open(user_param, format);
 
-	printf("%s", RESULT_FMT);
-	printf("%s", RESULT_LINE);
+	if (!user_param->intf_name ||
+	    intf_name_best_cpus(user_param->intf_name, &cpusmask, &cpusnr))
+		all_cpusmask(&cpusmask, &cpusnr);
+	fprintf(info_stream(user_param), "best cpus [%d] %s\n", cpusnr,
+		intf_cpusmask_str(cpusmask, cpusnr, cpus_str));
 
+	if (fd != stdout) {
+		printf("%s", RESULT_FMT);
+		printf("%s", RESULT_LINE);
+	}
 
-	while (threads_iter <= user_param->threads_num)  {
-		data_len	= (uint64_t)1 << size_log2;
+	while (threads_idx < (user_param->threads_list ?
+			      user_param->threads_list_nr :
+			      user_param->threads_num)) {
+		threads_iter	= user_param->threads_list ?
+				  user_param->threads_list[threads_idx] :
+				  threads_idx + 1;
+		data_len	= user_param->sizes[size_idx];
 
 		memset(&sess_data, 0, sizeof(sess_data));
 		memset(tdata, 0, user_param->threads_num*sizeof(*tdata));
 		memset(&params, 0, sizeof(params));
 		sess_data.tdata = tdata;
+		for (i = 0; i < threads_iter; i++) {
+			tdata[i].hist = &hists[i];
+			perf_hist_reset(tdata[i].hist);
+		}
 
 		command.test_param.machine_type	= user_param->machine_type;
 		command.test_param.test_type	= user_param->test_type;
@@ -527,6 +665,8 @@ int run_client_test(struct perf_parameters *user_param)
 			goto cleanup;
 		}
 
+		collect_percentiles(&sess_data, total);
+
 		/* send result to server */
 		command.results.bytes		= data_len;
 		command.results.threads		= threads_iter;
@@ -535,43 +675,56 @@ int run_client_test(struct perf_parameters *user_param)
 		command.results.avg_lat		= sess_data.avg_lat_us;
 		command.results.min_lat		= sess_data.min_lat_us;
 		command.results.max_lat		= sess_data.max_lat_us;
+		command.results.p50_lat		= sess_data.p50_lat_us;
+		command.results.p90_lat		= sess_data.p90_lat_us;
+		command.results.p99_lat		= sess_data.p99_lat_us;
+		command.results.p999_lat	= sess_data.p999_lat_us;
+		command.results.p9999_lat	= sess_data.p9999_lat_us;
+		command.results.samples		= sess_data.samples;
 		command.command			= GetTestResults;
 
 		/* sync point */
 		ctx_write_data(comm, &command, sizeof(command));
 
-		printf(REPORT_FMT,
-		       data_len,
-		       threads_iter,
-		       sess_data.tps,
-		       sess_data.avg_bw,
-		       sess_data.avg_lat_us,
-		       sess_data.min_lat_us,
-		       sess_data.max_lat_us);
-		if (fd)
-			fprintf(fd, "%lu, %d, %lu, %.2lf, %.2lf\n",
-				data_len,
-				threads_iter,
-				sess_data.tps,
-				sess_data.avg_bw,
-				sess_data.avg_lat_us);
-		fflush(fd);
+		if (fd != stdout)
+			printf(REPORT_FMT,
+			       data_len,
+			       threads_iter,
+			       sess_data.tps,
+			       sess_data.avg_bw,
+			       sess_data.avg_lat_us,
+			       sess_data.min_lat_us,
+			       sess_data.max_lat_us,
+			       sess_data.p50_lat_us,
+			       sess_data.p90_lat_us,
+			       sess_data.p99_lat_us,
+			       sess_data.p999_lat_us,
+			       sess_data.p9999_lat_us);
+		if (fd) {
+			report_result(&sess_data, format, first);
+			first = 0;
+		}
 
 		/* sync point */
 		ctx_read_data(comm, NULL, 0, NULL);
 
-		if (++size_log2 < max_size_log2)
+		if (++size_idx < user_param->sizes_nr)
 			continue;
 
-		threads_iter++;
-		size_log2 = 0;
+		threads_idx++;
+		size_idx = 0;
 	}
 
-	printf("%s", RESULT_LINE);
+	if (fd != stdout)
+		printf("%s", RESULT_LINE);
 
 cleanup:
-	if (fd)
-		fclose(fd);
+	if (fd) {
+		report_close(format);
+		if (fd != stdout)
+			fclose(fd);
+		fd = NULL;
+	}
 
 	ctx_hand_shake(comm);
 
@@ -580,9 +733,10 @@ cleanup:
 cleanup2:
 	destroy_comm_struct(comm);
 
+cleanup1:
+	free(hists);
 	free(tdata);
 
-cleanup1:
 	xio_shutdown();
 
 	return 0;
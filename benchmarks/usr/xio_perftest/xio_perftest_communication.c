@@ -626,4 +626,20 @@ char *intf_cpusmask_str(uint64_t cpusmask, int nr, char *str)
 	return str;
 }
 
+/*---------------------------------------------------------------------------*/
+/* all_cpusmask - fallback when the interface has no numa locality, e.g.    */
+/* tcp over loopback or virtual nics					     */
+/*---------------------------------------------------------------------------*/
+void all_cpusmask(uint64_t *cpusmask, int *nr)
+{
+	int max_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
 
+	if (max_cpus > 64)
+		max_cpus = 64;
+
+	*cpusmask = 0;
+	for (i = 0; i < max_cpus; i++)
+		cpusmask_set_bit(i, cpusmask);
+	*nr = max_cpus;
+}
@@ -79,5 +79,7 @@ int intf_name_best_cpus(const char *if_name, uint64_t *cpusmask, int *nr);
 
 char *intf_cpusmask_str(uint64_t cpusmask, int nr, char *str);
 
+void all_cpusmask(uint64_t *cpusmask, int *nr);
+
 #endif /* XIO_PERFTEST_COMMUNICATION_H */
 
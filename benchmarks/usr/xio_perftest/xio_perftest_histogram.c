@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include "xio_perftest_histogram.h"
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_reset							     */
+/*---------------------------------------------------------------------------*/
+void perf_hist_reset(struct perf_hist *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = (uint64_t)-1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_merge							     */
+/*---------------------------------------------------------------------------*/
+void perf_hist_merge(struct perf_hist *dst, const struct perf_hist *src)
+{
+	int	i;
+
+	if (src->count == 0)
+		return;
+
+	for (i = 0; i < PERF_HIST_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+	dst->count += src->count;
+	dst->sum   += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_highest_value - last value that falls into bucket "index"	     */
+/*---------------------------------------------------------------------------*/
+static uint64_t perf_hist_highest_value(int index)
+{
+	int	shift;
+
+	if (index < (1 << PERF_HIST_SUB_BITS))
+		return index;
+
+	shift = index / PERF_HIST_HALF - 1;
+
+	return (((uint64_t)(index % PERF_HIST_HALF + PERF_HIST_HALF) + 1) <<
+		shift) - 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_percentile							     */
+/*---------------------------------------------------------------------------*/
+uint64_t perf_hist_percentile(const struct perf_hist *hist, double percentile)
+{
+	uint64_t	target, seen = 0, value;
+	int		i;
+
+	if (hist->count == 0)
+		return 0;
+
+	if (percentile > 100.0)
+		percentile = 100.0;
+	target = (uint64_t)(percentile * hist->count / 100.0 + 0.5);
+	if (target == 0)
+		target = 1;
+
+	for (i = 0; i < PERF_HIST_BUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= target)
+			break;
+	}
+	if (i == PERF_HIST_BUCKETS)
+		return hist->max;
+
+	value = perf_hist_highest_value(i);
+
+	/* never report beyond what was actually seen */
+	return (value > hist->max) ? hist->max : value;
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_mean							     */
+/*---------------------------------------------------------------------------*/
+double perf_hist_mean(const struct perf_hist *hist)
+{
+	if (hist->count == 0)
+		return 0;
+
+	return (double)hist->sum / hist->count;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_PERFTEST_HISTOGRAM_H
+#define XIO_PERFTEST_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * log-linear latency histogram in the spirit of HdrHistogram: values below
+ * 2^PERF_HIST_SUB_BITS are counted exactly, larger ones in buckets whose
+ * width keeps the relative error under 1/2^(PERF_HIST_SUB_BITS - 1).
+ * values are in nanoseconds and clamped to 2^PERF_HIST_MAX_BITS.
+ */
+#define PERF_HIST_SUB_BITS	7
+#define PERF_HIST_MAX_BITS	40
+#define PERF_HIST_HALF		(1 << (PERF_HIST_SUB_BITS - 1))
+#define PERF_HIST_BUCKETS	((PERF_HIST_MAX_BITS - PERF_HIST_SUB_BITS + 2) \
+				 * PERF_HIST_HALF)
+
+struct perf_hist {
+	uint64_t		count;
+	uint64_t		min;
+	uint64_t		max;
+	uint64_t		sum;
+	uint64_t		counts[PERF_HIST_BUCKETS];
+};
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_index							     */
+/*---------------------------------------------------------------------------*/
+static inline int perf_hist_index(uint64_t value)
+{
+	int	shift;
+
+	if (value < (1 << PERF_HIST_SUB_BITS))
+		return (int)value;
+	if (value >= (1ULL << PERF_HIST_MAX_BITS))
+		return PERF_HIST_BUCKETS - 1;
+
+	shift = 63 - __builtin_clzll(value) - PERF_HIST_SUB_BITS + 1;
+
+	return shift * PERF_HIST_HALF + (int)(value >> shift);
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_record							     */
+/*---------------------------------------------------------------------------*/
+static inline void perf_hist_record(struct perf_hist *hist, uint64_t value)
+{
+	hist->counts[perf_hist_index(value)]++;
+	hist->count++;
+	hist->sum += value;
+	if (value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_record_corrected						     */
+/*---------------------------------------------------------------------------*/
+/*
+ * coordinated omission correction: a closed loop generator stops sending
+ * while it waits for a slow response, so the requests it would have issued
+ * every "interval" ns meanwhile are back filled with the latency they would
+ * have seen.
+ */
+static inline void perf_hist_record_corrected(struct perf_hist *hist,
+					      uint64_t value,
+					      uint64_t interval)
+{
+	uint64_t	missed;
+
+	perf_hist_record(hist, value);
+	if (interval == 0 || value <= interval)
+		return;
+
+	for (missed = value - interval; missed >= interval;
+	     missed -= interval)
+		perf_hist_record(hist, missed);
+}
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_reset							     */
+/*---------------------------------------------------------------------------*/
+void perf_hist_reset(struct perf_hist *hist);
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_merge							     */
+/*---------------------------------------------------------------------------*/
+void perf_hist_merge(struct perf_hist *dst, const struct perf_hist *src);
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_percentile	- highest value equivalent to the percentile	     */
+/*---------------------------------------------------------------------------*/
+uint64_t perf_hist_percentile(const struct perf_hist *hist, double percentile);
+
+/*---------------------------------------------------------------------------*/
+/* perf_hist_mean							     */
+/*---------------------------------------------------------------------------*/
+double perf_hist_mean(const struct perf_hist *hist);
+
+#endif /* XIO_PERFTEST_HISTOGRAM_H */
@@ -141,6 +141,91 @@ cleanup:
 	return vec;
 }
 
+/*---------------------------------------------------------------------------*/
+/* parse_size								     */
+/*---------------------------------------------------------------------------*/
+static int parse_size(const char *str, uint64_t *size)
+{
+	char		*end;
+	uint64_t	val;
+
+	errno = 0;
+	val = strtoull(str, &end, 0);
+	if (errno || end == str)
+		return -1;
+
+	switch (tolower(*end)) {
+	case 'g':
+		val <<= 10;
+		/* fall through */
+	case 'm':
+		val <<= 10;
+		/* fall through */
+	case 'k':
+		val <<= 10;
+		end++;
+		break;
+	default:
+		break;
+	}
+	if (*end || val == 0)
+		return -1;
+
+	*size = val;
+
+	return 0;
+}
+
+/* parses "min-max" or "v1,v2,..." into a vector, ranges are expanded by
+ * doubling (sizes) or by one (thread counts)
+ */
+/*---------------------------------------------------------------------------*/
+/* parse_sweep								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t *parse_sweep(const char *arg, int doubling, uint32_t *vec_len)
+{
+	char		*str, *token, *dash;
+	uint64_t	*vec = NULL, *tmp;
+	uint64_t	min, max, val;
+	uint32_t	n = 0;
+
+	str = strdup(arg);
+	if (!str)
+		return NULL;
+
+	for (token = strtok(str, ","); token; token = strtok(NULL, ",")) {
+		dash = strchr(token, '-');
+		if (dash) {
+			*dash = 0;
+			if (parse_size(token, &min) ||
+			    parse_size(dash + 1, &max) || min > max)
+				goto cleanup;
+		} else {
+			if (parse_size(token, &min))
+				goto cleanup;
+			max = min;
+		}
+		for (val = min; val <= max;
+		     val = doubling ? val << 1 : val + 1) {
+			tmp = realloc(vec, (n + 1) * sizeof(*vec));
+			if (!tmp)
+				goto cleanup;
+			vec = tmp;
+			vec[n++] = val;
+		}
+	}
+	free(str);
+	*vec_len = n;
+
+	return vec;
+
+cleanup:
+	free(str);
+	free(vec);
+
+	return NULL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* usage                                                                     */
 /*---------------------------------------------------------------------------*/
@@ -165,11 +250,12 @@ void usage(const char *argv0, int status)
 			"(default %d)\n", XIO_DEF_THREADS_NUM);
 
 	printf("\t-r, --transport=<type>");
-	printf("\t\t\t\tSet the transport type to rdma/tcp (default rdma)\n");
+	printf("\t\t\t\tSet the transport type to rdma/tcp (default %s)\n",
+	       XIO_DEF_TRANSPORT);
 
 	printf("\t-i, --interface=<name>");
-	printf("\t\t\t\tSet the interface name (default %s)\n",
-	       XIO_DEF_INTERFACE);
+	printf("\t\t\t\tSet the interface name used for cpu affinity " \
+	       "(rdma default %s)\n", XIO_DEF_INTERFACE);
 
 	printf("\t-w, --portals={\"addr:port,addr:port,...\"}");
 	printf("\tSet address and port of each portal in server\n");
@@ -182,6 +268,26 @@ void usage(const char *argv0, int status)
 	printf("\t\t\tSet the number of messages to send " \
 	       "(default %d)\n", XIO_DEF_QUEUE_DEPTH);
 
+	printf("\t-s, --sizes=<min-max|s1,s2,...> ");
+	printf("\t\tMessage sizes to sweep, ranges double " \
+	       "(default %s)\n", XIO_DEF_SIZES);
+
+	printf("\t-l, --threads_list=<min-max|n1,n2,...> ");
+	printf("\tThread counts to sweep " \
+	       "(default 1 to --threads)\n");
+
+	printf("\t-f, --format=<text|csv|json> ");
+	printf("\t\t\tResults format, written to the output file " \
+	       "or else to stdout (default text)\n");
+
+	printf("\t-e, --co_interval=<usecs> ");
+	printf("\t\t\tCorrect coordinated omission for this expected " \
+	       "request interval (default off)\n");
+
+	printf("\t-o, --output_file=<file> ");
+	printf("\t\t\tWrite the results to <file> " \
+	       "(csv unless --format is given)\n");
+
 	printf("\t-v, --version ");
 	printf("\t\t\t\t\tPrint the version and exit\n");
 
@@ -196,6 +302,8 @@ void usage(const char *argv0, int status)
 /*---------------------------------------------------------------------------*/
 static int force_dependencies(struct perf_parameters *user_param)
 {
+	uint32_t i;
+
 	if (user_param->test_type == LAT) {
 		user_param->queue_depth = LAT_QUEUE_DEPTH;
 		if (user_param->poll_timeout == XIO_DEF_POLL_TIMEOUT) {
@@ -223,6 +331,14 @@ static int force_dependencies(struct perf_parameters *user_param)
 			return -1;
 		}
 	}
+	if (user_param->threads_list) {
+		for (i = 0; i < user_param->threads_list_nr; i++) {
+			if (user_param->threads_list[i] >
+			    user_param->threads_num)
+				user_param->threads_num =
+					user_param->threads_list[i];
+		}
+	}
 	if (user_param->threads_num  < 1) {
 		printf("threads number is mandatory - recommended cores " \
 		       "per numa\n");
@@ -247,6 +363,12 @@ static void init_perf_params(struct perf_parameters *user_param)
 	user_param->test_type		= XIO_TEST_TYPE;
 	user_param->verb		= XIO_VERB;
 	user_param->machine_type	= SERVER;
+	user_param->output_format	= TEXT;
+	user_param->co_interval_us	= 0;
+	user_param->sizes		= NULL;
+	user_param->sizes_nr		= 0;
+	user_param->threads_list	= NULL;
+	user_param->threads_list_nr	= 0;
 	user_param->output_file		= NULL;
 	user_param->transport		= NULL;
 	user_param->portals_arr		= NULL;
@@ -286,6 +408,16 @@ void destroy_perf_params(struct perf_parameters *user_param)
 		free(user_param->output_file);
 		user_param->output_file = NULL;
 	}
+
+	if (user_param->sizes) {
+		free(user_param->sizes);
+		user_param->sizes = NULL;
+	}
+
+	if (user_param->threads_list) {
+		free(user_param->threads_list);
+		user_param->threads_list = NULL;
+	}
 }
 
 /*---------------------------------------------------------------------------*/
@@ -294,9 +426,11 @@ void destroy_perf_params(struct perf_parameters *user_param)
 int parse_cmdline(struct perf_parameters *user_param,
 		  int argc, char **argv)
 {
-	int	max_cpus;
-	char	*portals = NULL;
-	long	l;
+	int		max_cpus;
+	char		*portals = NULL;
+	long		l;
+	uint64_t	*vec;
+	uint32_t	i, vec_len;
 
 	if (!user_param)
 		return -1;
@@ -315,13 +449,17 @@ int parse_cmdline(struct perf_parameters *user_param,
 			{ .name = "portals",	 .has_arg = 1, .val = 'w'},
 			{ .name = "poll_time",   .has_arg = 1, .val = 't'},
 			{ .name = "queue_depth", .has_arg = 1, .val = 'q'},
-			{ .name = "output file", .has_arg = 1, .val = 'o'},
+			{ .name = "output_file", .has_arg = 1, .val = 'o'},
+			{ .name = "sizes",	 .has_arg = 1, .val = 's'},
+			{ .name = "threads_list", .has_arg = 1, .val = 'l'},
+			{ .name = "format",	 .has_arg = 1, .val = 'f'},
+			{ .name = "co_interval", .has_arg = 1, .val = 'e'},
 			{ .name = "version",	 .has_arg = 0, .val = 'v'},
 			{ .name = "help",	 .has_arg = 0, .val = 'h'},
 			{0, 0, 0, 0},
 		};
 
-		static char *short_options = "c:i:p:n:r:w:t:q:o:vh";
+		static char *short_options = "c:i:p:n:r:w:t:q:o:s:l:f:e:vh";
 
 		c = getopt_long(argc, argv, short_options,
 				long_options, NULL);
@@ -419,6 +557,59 @@ int parse_cmdline(struct perf_parameters *user_param,
 				goto invalid_cmdline;
 
 		break;
+		case 's':
+			if (!optarg || user_param->sizes)
+				goto invalid_cmdline;
+			user_param->sizes = parse_sweep(optarg, 1,
+							&user_param->sizes_nr);
+			if (!user_param->sizes) {
+				fprintf(stderr, "failed to parse sizes\n");
+				goto invalid_cmdline;
+			}
+			break;
+		case 'l':
+			if (!optarg || user_param->threads_list)
+				goto invalid_cmdline;
+			vec = parse_sweep(optarg, 0, &vec_len);
+			if (!vec) {
+				fprintf(stderr,
+					"failed to parse threads list\n");
+				goto invalid_cmdline;
+			}
+			user_param->threads_list = calloc(vec_len,
+							  sizeof(uint32_t));
+			if (!user_param->threads_list) {
+				free(vec);
+				goto invalid_cmdline;
+			}
+			for (i = 0; i < vec_len; i++)
+				user_param->threads_list[i] = (uint32_t)vec[i];
+			user_param->threads_list_nr = vec_len;
+			free(vec);
+			break;
+		case 'f':
+			if (!optarg)
+				goto invalid_cmdline;
+			if (!strcmp(optarg, "text"))
+				user_param->output_format = TEXT;
+			else if (!strcmp(optarg, "csv"))
+				user_param->output_format = CSV;
+			else if (!strcmp(optarg, "json"))
+				user_param->output_format = JSON;
+			else
+				goto invalid_cmdline;
+			break;
+		case 'e':
+			if (!optarg)
+				goto invalid_cmdline;
+			errno = 0;
+			l = strtol(optarg, NULL, 0);
+			if (errno || l < 0) {
+				fprintf(stderr, "strtol failed :%m\n");
+				goto invalid_cmdline;
+			}
+			user_param->co_interval_us = (uint32_t)l;
+			break;
 		case 'i':
 			if (optarg && !user_param->intf_name) {
 				user_param->intf_name = strdup(optarg);
@@ -456,9 +647,21 @@ int parse_cmdline(struct perf_parameters *user_param,
 	if (!user_param->transport) {
 		user_param->transport = strdup(XIO_DEF_TRANSPORT);
 	}
-	if (!user_param->intf_name) {
+	if (strcmp(user_param->transport, "rdma") &&
+	    strcmp(user_param->transport, "tcp")) {
+		fprintf(stderr, "unsupported transport %s\n",
+			user_param->transport);
+		goto invalid_cmdline;
+	}
+	if (!user_param->intf_name && !strcmp(user_param->transport, "rdma")) {
 		user_param->intf_name = strdup(XIO_DEF_INTERFACE);
 	}
+	if (!user_param->sizes) {
+		user_param->sizes = parse_sweep(XIO_DEF_SIZES, 1,
+						&user_param->sizes_nr);
+		if (!user_param->sizes)
+			goto invalid_cmdline;
+	}
 
 	if (portals && !user_param->portals_arr) {
 		user_param->portals_arr =
@@ -500,30 +703,45 @@ invalid_cmdline:
 *************************************************************/
 void print_test_info(const struct perf_parameters *user_param)
 {
-	printf(" =============================================\n");
+	FILE	*out = info_stream(user_param);
+
+	fprintf(out, " =============================================\n");
 	if (user_param->server_addr)
-		printf(" Server Address		: %s\n",
-		       user_param->server_addr);
+		fprintf(out, " Server Address		: %s\n",
+			user_param->server_addr);
 	if (user_param->intf_name)
-		printf(" Local Interface	: %s\n",
-		       user_param->intf_name);
-		printf(" Server Port		: %d\n",
-	       user_param->server_port);
-	printf(" Transport Type		: %s\n",
-	       user_param->transport);
-	printf(" Test Type		: %s\n",
-	       test_type_str(user_param->test_type));
-	printf(" Queue Depth		: %d\n",
-	       user_param->queue_depth);
-	printf(" Threads		: %d\n",
-	       user_param->threads_num);
-	printf(" Poll timeout		: %d\n",
-	       user_param->poll_timeout);
+		fprintf(out, " Local Interface	: %s\n",
+			user_param->intf_name);
+	fprintf(out, " Server Port		: %d\n",
+		user_param->server_port);
+	fprintf(out, " Transport Type		: %s\n",
+		user_param->transport);
+	fprintf(out, " Test Type		: %s\n",
+		test_type_str(user_param->test_type));
+	fprintf(out, " Queue Depth		: %d\n",
+		user_param->queue_depth);
+	fprintf(out, " Threads		: %d\n",
+		user_param->threads_num);
+	fprintf(out, " Poll timeout		: %d\n",
+		user_param->poll_timeout);
+	if (user_param->co_interval_us)
+		fprintf(out, " CO interval		: %d usecs\n",
+			user_param->co_interval_us);
 	if (user_param->output_file)
-		printf(" Output file		: %s\n",
-		       user_param->output_file);
-	printf(" CPU Affinity		: %x\n",
-	       user_param->cpu);
-	printf(" =============================================\n");
+		fprintf(out, " Output file		: %s\n",
+			user_param->output_file);
+	fprintf(out, " CPU Affinity		: %x\n",
+		user_param->cpu);
+	fprintf(out, " =============================================\n");
 }
 
+/*---------------------------------------------------------------------------*/
+/* info_stream								     */
+/*---------------------------------------------------------------------------*/
+FILE *info_stream(const struct perf_parameters *user_param)
+{
+	if (user_param->output_format != TEXT && !user_param->output_file)
+		return stderr;
+
+	return stdout;
+}
@@ -47,6 +47,9 @@ typedef enum { SERVER , CLIENT , UNCHOSEN} MachineType;
 /* verb operation */
 typedef enum { READ, WRITE} Verb;
 
+/* results output format */
+typedef enum { TEXT, CSV, JSON } OutputFormat;
+
 
 
 #define LAT_QUEUE_DEPTH			1
@@ -58,13 +61,19 @@ typedef enum { READ, WRITE} Verb;
 #define CLIENT_LAT_POLL_TIMEOUT		100
 
 
+#define SERVER_POOL_SLACK		256
+
 #define XIO_DEF_PORT			2061
 #define XIO_DEF_CPU			0
 
 #define XIO_DEF_TRANSPORT		"rdma"
 
+/* rdma only, tcp runs on all cpus unless an interface is given */
 #define XIO_DEF_INTERFACE		"ib0"
 
+/* message sizes swept by default: 1 byte to 8 MB, doubling */
+#define XIO_DEF_SIZES			"1-8m"
+
 #if defined(TEST_LAT)
 #define XIO_TEST_TYPE			LAT
 #define XIO_DEF_QUEUE_DEPTH		LAT_QUEUE_DEPTH
@@ -84,12 +93,12 @@ typedef enum { READ, WRITE} Verb;
 #define XIO_DEF_THREADS_NUM		0
 #define XIO_PERF_VERSION		"1.0.0"
 
-#define RESULT_LINE "----------------------------------------------------------------------------------------------------------------------\n"
+#define RESULT_LINE "-------------------------------------------------------------------------------------------------------------------------------\n"
 
 /* The format of the results */
-#define RESULT_FMT		" #bytes     #threads   #TPS       BW average[MBps]   Latency average[usecs]   Latency low[usecs]   Latency peak[usecs]\n"
+#define RESULT_FMT		" #bytes     #threads #TPS       BW[MBps]   Latency[usecs]: average   low       peak      p50       p90       p99       p99.9     p99.99\n"
 /* Result print format */
-#define REPORT_FMT		" %-7lu     %d         %-7.2lu	  %-7.2lf            %-7.2lf		      %-7.2lf		    %-7.2lf\n"
+#define REPORT_FMT		" %-10lu %-8d %-10lu %-10.2lf                 %-9.2lf %-9.2lf %-9.2lf %-9.2lf %-9.2lf %-9.2lf %-9.2lf %-9.2lf\n"
 
 
 struct perf_parameters {
@@ -102,6 +111,12 @@ struct perf_parameters {
 	TestType		test_type;
 	MachineType		machine_type;
 	Verb			verb;
+	OutputFormat		output_format;
+	uint32_t		co_interval_us;
+	uint32_t		sizes_nr;
+	uint32_t		threads_list_nr;
+	uint64_t		*sizes;
+	uint32_t		*threads_list;
 	char			*output_file;
 	char			*transport;
 	char			**portals_arr;
@@ -127,6 +142,12 @@ int parse_cmdline(struct perf_parameters *perf_parameters,
 void print_test_info(const struct perf_parameters *perf_parameters_p);
 
 
+/*---------------------------------------------------------------------------*/
+/* info_stream - where informational output goes, so that machine	     */
+/* readable results written to stdout stay parsable			     */
+/*---------------------------------------------------------------------------*/
+FILE *info_stream(const struct perf_parameters *perf_parameters_p);
+
 /*---------------------------------------------------------------------------*/
 /* destroy_perf_params							     */
 /*---------------------------------------------------------------------------*/
@@ -58,7 +58,12 @@ struct test_results {
 	double			avg_lat;
 	double			min_lat;
 	double			max_lat;
-
+	double			p50_lat;
+	double			p90_lat;
+	double			p99_lat;
+	double			p999_lat;
+	double			p9999_lat;
+	uint64_t		samples;
 };
 
 
@@ -97,6 +97,10 @@ static int on_request(struct xio_session *session,
 
 	/* alloc transaction */
 	rsp	= msg_pool_get(tdata->pool);
+	if (rsp == NULL) {
+		printf("**** [%p] Error - response pool is empty\n", session);
+		return 0;
+	}
 
 	/* fill response */
 	rsp->request		= req;
@@ -200,8 +204,11 @@ static void *portal_server_cb(void *data)
 
 	pthread_setaffinity_np(tdata->thread_id, sizeof(cpu_set_t), &cpuset);
 
-	/* prepare data for the cuurent thread */
-	tdata->pool = msg_pool_alloc(tdata->user_param->queue_depth + 64);
+	/* prepare data for the cuurent thread. tcp reports send completions
+	 * in batches, so keep enough responses around to cover a batch
+	 */
+	tdata->pool = msg_pool_alloc(tdata->user_param->queue_depth +
+				     SERVER_POOL_SLACK);
 
 	/* create thread context for the client */
 	tdata->ctx = xio_context_create(NULL, tdata->user_param->poll_timeout,
@@ -343,7 +350,12 @@ static void on_test_results(struct test_results *results)
 	       results->avg_bw,
 	       results->avg_lat,
 	       results->min_lat,
-	       results->max_lat);
+	       results->max_lat,
+	       results->p50_lat,
+	       results->p90_lat,
+	       results->p99_lat,
+	       results->p999_lat,
+	       results->p9999_lat);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -358,16 +370,17 @@ int run_server_test(struct perf_parameters *user_param)
 	uint64_t		cpusmask;
 	int			cpusnr;
 	int			cpu;
+	char			cpus_str[256];
 
 	xio_init();
 
 	max_cpus = sysconf(_SC_NPROCESSORS_ONLN);
 
-	i = intf_name_best_cpus(user_param->intf_name, &cpusmask, &cpusnr);
-	if (i == 0) {
-		printf("best cpus [%d] %s\n", cpusnr,
-		       intf_cpusmask_str(cpusmask, cpusnr, user_param->intf_name));
-	}
+	if (!user_param->intf_name ||
+	    intf_name_best_cpus(user_param->intf_name, &cpusmask, &cpusnr))
+		all_cpusmask(&cpusmask, &cpusnr);
+	printf("best cpus [%d] %s\n", cpusnr,
+	       intf_cpusmask_str(cpusmask, cpusnr, cpus_str));
 
 	server_data.my_test_param.machine_type	= user_param->machine_type;
 	server_data.my_test_param.test_type	= user_param->test_type;
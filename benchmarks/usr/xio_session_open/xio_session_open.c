@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libxio.h"
+
+#define DEFAULT_ITERATIONS	100
+#define WARM_IDLE_NR		2
+#define WARMUP_MSEC		200
+
+/*
+ * measures the session open latency - xio_session_create up to the
+ * session established callback - once over a cold context, where every
+ * session pays the transport handshake, and once over a context that
+ * keeps warm connections to the server (xio_context_prewarm).
+ * run one instance with -s as the server and another as the client.
+ */
+
+struct bench_data {
+	struct xio_context	*ctx;
+	struct xio_connection	*conn;
+	struct timespec		start;
+	double			*lat_usec;
+	int			samples;
+	int			failed;
+};
+
+/*---------------------------------------------------------------------------*/
+/* elapsed_usec								     */
+/*---------------------------------------------------------------------------*/
+static double elapsed_usec(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000000.0 +
+	       (now.tv_nsec - start->tv_nsec) / 1000.0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_established						     */
+/*---------------------------------------------------------------------------*/
+static int on_session_established(struct xio_session *session,
+				  struct xio_new_session_rsp *rsp,
+				  void *cb_user_context)
+{
+	struct bench_data *bench = cb_user_context;
+
+	bench->lat_usec[bench->samples++] = elapsed_usec(&bench->start);
+	xio_disconnect(bench->conn);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct bench_data *bench = cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+		bench->failed = 1;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(bench->ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_server_session_event						     */
+/*---------------------------------------------------------------------------*/
+static int on_server_session_event(struct xio_session *session,
+				   struct xio_session_event_data *event_data,
+				   void *cb_user_context)
+{
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_server_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg				=  NULL,
+	.on_msg_error			=  NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* run_server								     */
+/*---------------------------------------------------------------------------*/
+static int run_server(const char *url)
+{
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+
+	ctx = xio_context_create(NULL, 0, -1);
+	server = xio_bind(ctx, &server_ops, url, NULL, 0, NULL);
+	if (server == NULL) {
+		fprintf(stderr, "bind to %s failed. %s\n", url,
+			xio_strerror(xio_errno()));
+		xio_context_destroy(ctx);
+		return -1;
+	}
+	printf("listen to %s\n", url);
+
+	xio_context_run_loop(ctx, XIO_INFINITE);
+
+	xio_unbind(server);
+	xio_context_destroy(ctx);
+
+	return 0;
+}
+
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_session_established		=  on_session_established,
+	.on_msg				=  NULL,
+	.on_msg_error			=  NULL
+};
+
+/*---------------------------------------------------------------------------*/
+/* open_session								     */
+/*---------------------------------------------------------------------------*/
+static int open_session(struct bench_data *bench, char *url)
+{
+	struct xio_session		*session;
+	struct xio_session_params	params;
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &ses_ops;
+	params.user_context	= bench;
+	params.uri		= url;
+
+	clock_gettime(CLOCK_MONOTONIC, &bench->start);
+
+	session = xio_session_create(&params);
+	if (session == NULL)
+		return -1;
+	bench->conn = xio_connect(session, bench->ctx, 0, NULL, bench);
+	if (bench->conn == NULL) {
+		xio_session_destroy(session);
+		return -1;
+	}
+
+	/* returns once the session is torn down */
+	xio_context_run_loop(bench->ctx, XIO_INFINITE);
+
+	return bench->failed ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* cmp_double								     */
+/*---------------------------------------------------------------------------*/
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_stats								     */
+/*---------------------------------------------------------------------------*/
+static void print_stats(const char *name, double *lat, int n)
+{
+	double	sum = 0;
+	int	i;
+
+	if (n == 0) {
+		printf("%-6s no samples\n", name);
+		return;
+	}
+	qsort(lat, n, sizeof(*lat), cmp_double);
+	for (i = 0; i < n; i++)
+		sum += lat[i];
+
+	printf("%-6s n=%-6d min=%8.1f avg=%8.1f p50=%8.1f p99=%8.1f " \
+	       "max=%8.1f usec\n",
+	       name, n, lat[0], sum / n, lat[n / 2],
+	       lat[(int)(n * 0.99)], lat[n - 1]);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct bench_data	bench;
+	char			url[256];
+	double			*cold, *warm;
+	int			iterations = DEFAULT_ITERATIONS;
+	int			i, cold_nr, warm_nr;
+	int			server_mode = 0;
+
+	if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+		server_mode = 1;
+		argc--;
+		argv++;
+	}
+	if (argc < 3) {
+		printf("Usage: %s [-s] <host> <port> <transport:optional> " \
+		       "<iterations:optional>\n", argv[0]);
+		exit(1);
+	}
+	if (argc > 3)
+		sprintf(url, "%s://%s:%s", argv[3], argv[1], argv[2]);
+	else
+		sprintf(url, "rdma://%s:%s", argv[1], argv[2]);
+	if (argc > 4)
+		iterations = atoi(argv[4]);
+	if (iterations <= 0)
+		iterations = DEFAULT_ITERATIONS;
+
+	xio_init();
+	if (server_mode) {
+		i = run_server(url);
+		xio_shutdown();
+		return i ? 1 : 0;
+	}
+
+	cold = calloc(iterations, sizeof(*cold));
+	warm = calloc(iterations, sizeof(*warm));
+	if (!cold || !warm) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	memset(&bench, 0, sizeof(bench));
+
+	/* cold: a fresh context per session leaves no connection to reuse */
+	bench.lat_usec = cold;
+	for (i = 0; i < iterations; i++) {
+		bench.ctx = xio_context_create(NULL, 0, -1);
+		if (open_session(&bench, url))
+			bench.failed = 0;
+		xio_context_destroy(bench.ctx);
+	}
+	cold_nr = bench.samples;
+
+	/* warm: one context keeping idle connections to the server */
+	bench.lat_usec = warm;
+	bench.samples = 0;
+	bench.ctx = xio_context_create(NULL, 0, -1);
+	if (xio_context_prewarm(bench.ctx, url, WARM_IDLE_NR)) {
+		fprintf(stderr, "xio_context_prewarm failed. %s\n",
+			xio_strerror(xio_errno()));
+		exit(1);
+	}
+	xio_context_run_loop(bench.ctx, WARMUP_MSEC);
+	for (i = 0; i < iterations; i++) {
+		if (open_session(&bench, url))
+			bench.failed = 0;
+	}
+	warm_nr = bench.samples;
+	xio_context_prewarm(bench.ctx, url, 0);
+	xio_context_destroy(bench.ctx);
+
+	print_stats("cold", cold, cold_nr);
+	print_stats("warm", warm, warm_nr);
+
+	free(cold);
+	free(warm);
+
+	xio_shutdown();
+
+	return 0;
+}
@@ -64,6 +64,7 @@ struct libraio_data {
 	struct raio_iocb **iocbs;
 	struct io_u **io_us;
 	struct libraio_engine_data *engine_datas;
+	raio_mr_t mr;	/* covers td->orig_buffer, all the io_u buffers */
 	int iocbs_nr;
 	int engine_datas_free;
 	int fd;
@@ -73,7 +74,7 @@ struct libraio_data {
 struct libraio_engine_data {
 	struct raio_iocb	iocb;
 	struct libraio_data	*raio_data;
-	raio_mr_t		mr;
+	raio_mr_t		mr;	/* the shared registration */
 };
 
 static int fio_libraio_prep(struct thread_data *td, struct io_u *io_u)
@@ -289,6 +290,8 @@ static int fio_libraio_open(struct thread_data *td, struct fio_file *f)
 	char			path[256];
 	char			host[256];
 	uint32_t		port;
+	char			*queues = getenv("RAIO_QUEUES");
+	int			queues_nr = queues ? atoi(queues) : 1;
 
 	dprint(FD_FILE, "fd open %s\n", f->file_name);
 
@@ -316,17 +319,18 @@ static int fio_libraio_open(struct thread_data *td, struct fio_file *f)
 	servaddr.sin_port = htons(port);
 
 
-	f->fd = raio_open((struct sockaddr *)&servaddr, sizeof(servaddr),
-			  path, flags);
+	/* RAIO_QUEUES spreads the file over as many server portals */
+	f->fd = raio_open_mq((struct sockaddr *)&servaddr, sizeof(servaddr),
+			     path, flags, queues_nr);
 
 	if (f->fd == -1 && errno == EINVAL &&
 	    ((flags & O_DIRECT) == O_DIRECT)) {
 		log_err("libraio open failed with o_direct- file:%s " \
 			"flags:%x %m\n", f->file_name, flags);
 		flags &= ~O_DIRECT;
-		f->fd = raio_open((struct sockaddr *)&servaddr,
-				  sizeof(servaddr),
-				  path, flags);
+		f->fd = raio_open_mq((struct sockaddr *)&servaddr,
+				     sizeof(servaddr),
+				     path, flags, queues_nr);
 	}
 	if (f->fd == -1) {
 		log_err("libraio open failed - file:%s " \
@@ -345,6 +349,7 @@ static int fio_libraio_open_file(struct thread_data *td, struct fio_file *f)
 {
 	int			ret;
 	struct libraio_data	*ld = td->io_ops->data;
+	char			*hipri = getenv("RAIO_HIPRI");
 
 	if (ld->fd != -1) {
 		f->fd = ld->fd;
@@ -362,6 +367,13 @@ static int fio_libraio_open_file(struct thread_data *td, struct fio_file *f)
 		log_err("libraio: raio_setup failed. %m\n");
 		return 1;
 	}
+	/* RAIO_HIPRI polls for completions, spinning up to as many usecs
+	 * before sleeping in the event loop
+	 */
+	if (hipri && raio_set_poll(ld->raio_ctx, atoi(hipri))) {
+		log_err("libraio: raio_set_poll failed. %m\n");
+		return 1;
+	}
 	ld->fd = f->fd;
 
 	return 0;
@@ -452,7 +464,6 @@ static int fio_libraio_init(struct thread_data *td)
 {
 	struct io_u			*io_u;
 	struct libraio_data		*ld = malloc(sizeof(*ld));
-	unsigned int			max_bs;
 	int				ret;
 	struct				fio_file f;
 	struct libraio_engine_data	*engine_data;
@@ -486,19 +497,24 @@ static int fio_libraio_init(struct thread_data *td)
 	if (ret != 0)
 		return ret;
 
-	max_bs = max(td->o.max_bs[DDIR_READ], td->o.max_bs[DDIR_WRITE]);
+	/* a single registration of fio's iomem region, so that the
+	 * transport places the read data straight in the io_u buffers
+	 */
+	ret = raio_reg_mr(ld->raio_ctx,
+			  td->orig_buffer,
+			  td->orig_buffer_size,
+			  &ld->mr);
+	if (ret) {
+		log_err("libraio: memory registration failed\n");
+		ld->mr = NULL;
+		return 1;
+	}
+
 	io_u_qiter(&td->io_u_freelist, io_u, ld->engine_datas_free) {
 		io_u->engine_data = &ld->engine_datas[ld->engine_datas_free];
 
 		engine_data = io_u->engine_data;
-		raio_reg_mr(ld->raio_ctx,
-			    io_u->buf,
-			    max_bs,
-			    &engine_data->mr);
-		if (engine_data->mr == NULL) {
-			log_err("libraio: memory registration failed\n");
-			return 1;
-		}
+		engine_data->mr = ld->mr;
 	}
 
 	return 0;
@@ -507,14 +523,9 @@ static int fio_libraio_init(struct thread_data *td)
 static void fio_libraio_cleanup(struct thread_data *td)
 {
 	struct libraio_data		*ld = td->io_ops->data;
-	struct libraio_engine_data	*engine_data;
-	struct io_u			*io_u;
-	int				i;
 
-	io_u_qiter(&td->io_u_freelist, io_u, i) {
-		engine_data = io_u->engine_data;
-		raio_dereg_mr(ld->raio_ctx, engine_data->mr);
-	}
+	if (ld->mr)
+		raio_dereg_mr(ld->raio_ctx, ld->mr);
 
 	if (ld->fd != -1) {
 		struct fio_file f;
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Arguments Check
+if [ $# -lt 3 ]; then
+        echo "[$0] Missing Parameters!"
+        echo "Usage: $0 [Server IP] [Port] [File] [Transport (optional)]"
+        exit 1
+fi
+
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:./.libs/:../../../src/usr/:../../../examples/usr/raio/
+
+export RAIO_HOST=$1
+export RAIO_PORT=$2
+file=$3
+trans="rdma"
+if [ $# -ge 4 ]; then
+	trans=$4
+fi
+
+# the same job against each backing store of a local raio server, null
+# serves /dev/null and bounds what the transport itself can do
+for bs in null aio uring
+do
+	if [ "$bs" = "null" ]; then
+		export RAIO_FILE=/dev/null
+	else
+		export RAIO_FILE=$file
+	fi
+
+	../raio/raio_server ${RAIO_HOST} ${RAIO_PORT} ${trans} ${bs} \
+		> /tmp/raio_server_${bs}.txt 2>&1 &
+	server=$!
+	sleep 1
+
+	taskset -c 6 $FIO_ROOT/fio ./raio-bs-compare.fio \
+		> /tmp/raio_bs_${bs}.txt 2>&1
+
+	kill -INT $server
+	wait $server
+
+	echo "=== ${bs} ==="
+	grep -E "^ *(read|write) *:|clat \(" /tmp/raio_bs_${bs}.txt
+done
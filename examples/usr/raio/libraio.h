@@ -45,6 +45,7 @@ extern "C" {
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 /*---------------------------------------------------------------------------*/
 /* forward declarations	                                                     */
@@ -65,6 +66,11 @@ typedef struct raio_mr *raio_mr_t;
 enum raio_iocb_cmd {
 	RAIO_CMD_PREAD		= 0,
 	RAIO_CMD_PWRITE		= 1,
+	RAIO_CMD_PREADV		= 7,
+	RAIO_CMD_PWRITEV	= 8,
+	RAIO_CMD_OPEN_FILE	= 16,
+	RAIO_CMD_FSTAT_FILE	= 17,
+	RAIO_CMD_CLOSE_FILE	= 18,
 };
 
 /*---------------------------------------------------------------------------*/
@@ -79,6 +85,24 @@ struct raio_iocb_common {
 	unsigned int		resfd;
 };	/* result code is the amount read or negative errno */
 
+struct raio_iocb_vector {
+	const struct iovec	*vec;
+	int			nr;
+	int			pad;
+	long long		offset;
+	raio_mr_t		mr;	/* covers all the vector's buffers */
+};	/* result code is the amount read or negative errno */
+
+struct raio_iocb_file {
+	const struct sockaddr	*addr;		/* open only */
+	const char		*pathname;	/* open only */
+	struct stat64		*stbuf;		/* fstat only */
+	socklen_t		addrlen;
+	int			flags;
+};	/* result code is the new file descriptor for open, zero for fstat
+	 * and close, or negative errno
+	 */
+
 struct raio_iocb {
 	void			*data;  /* Return in the io completion event */
 	unsigned int		key;	/* For use in identifying io requests */
@@ -87,6 +111,8 @@ struct raio_iocb {
 	int			pad;
 	union {
 		struct raio_iocb_common	c;
+		struct raio_iocb_vector	v;
+		struct raio_iocb_file	f;
 	} u;
 };
 
@@ -104,7 +130,9 @@ struct raio_event {
  * @addr: address to rcopy server
  * @addrlen: address length
  * @pathname: fullpath to the file or device
- * @flags:    open flags - see "man 2 open"
+ * @flags:    open flags - see "man 2 open". with O_DIRECT the server
+ *	      bypasses its page cache, offsets and lengths must then be
+ *	      aligned to the device's sector size
  *
  * RETURNS: return the new file descriptor, or -1 if an error occurred (in
  * which case, errno is set appropriately)
@@ -112,6 +140,46 @@ struct raio_event {
 int raio_open(const struct sockaddr *addr, socklen_t addrlen,
 	      const char *pathname, int flags);
 
+/**
+ * raio_open_mq - open file for io operations over several queues, one
+ *		  connection per server portal, so that the server serves
+ *		  the file from as many cores. raio_submit spreads the
+ *		  requests over the queues by 1MB stripes of the file.
+ *
+ * @addr: address to rcopy server
+ * @addrlen: address length
+ * @pathname: fullpath to the file or device
+ * @flags:    open flags - see raio_open
+ * @queues_nr: number of queues, 1 to 16. queues beyond the server's portal
+ *	       count share portals
+ *
+ * RETURNS: return the new file descriptor, or -1 if an error occurred (in
+ * which case, errno is set appropriately)
+ */
+int raio_open_mq(const struct sockaddr *addr, socklen_t addrlen,
+		 const char *pathname, int flags, int queues_nr);
+
+/**
+ * raio_open_batch - open many files of the same server at once. the opens
+ *		     are in flight together instead of one round trip each
+ *
+ * @addr: address to rcopy server
+ * @addrlen: address length
+ * @nr:	      number of files
+ * @pathnames: fullpaths to the files or devices
+ * @flags:    open flags - see raio_open
+ * @fds:      returned file descriptors, or negative errno for the files
+ *	      that failed to open
+ * @depth:    maximum opens in flight, up to 128, or 0 for the default of
+ *	      16. every open sets up a session and a connection of its own
+ *	      on the server, which the opened file keeps until raio_close
+ *
+ * RETURNS: the number of files opened, or -1 if an error occurred (in
+ * which case, errno is set appropriately)
+ */
+int raio_open_batch(const struct sockaddr *addr, socklen_t addrlen, int nr,
+		    const char *pathnames[], int flags, int fds[], int depth);
+
 /**
  * raio_fstat - get file status
  *
@@ -147,6 +215,21 @@ int raio_close(int fd);
  */
 int raio_setup(int fd, int maxevents, raio_context_t *ctxp);
 
+/**
+ * raio_setup_files - creates an asynchronous context for opening, stating
+ * and closing files. raio_submit takes iocbs prepared by raio_prep_open,
+ * raio_prep_fstat and raio_prep_close, and raio_getevents returns their
+ * completions. a file may have one such request in flight at a time.
+ *
+ * @maxevents:	max requests in flight
+ * @ctxp:	On successful creation of the RAIO context, *ctxp is filled
+ *		in with the resulting  handle.
+ *
+ * RETURNS: On success, zero is returned.  On error, -1 is returned, and errno
+ * is set appropriately.
+ */
+int raio_setup_files(int maxevents, raio_context_t *ctxp);
+
 /**
  * raio_destroy - destroys an asynchronous I/O context
  *
@@ -159,7 +242,10 @@ int raio_destroy(raio_context_t ctx);
 
 /**
  * raio_submit - queues nr I/O request blocks for processing in the RAIO
- *		 context ctx
+ *		 context ctx. runs of neighbouring requests with the same
+ *		 direction are carried to the server in a single message.
+ *		 a vectored request must fit in one message: at most 16
+ *		 buffers and 128KB.
  *
  * @ctx:	the RAIO context
  * @nr:		number of events to queue
@@ -199,6 +285,19 @@ int raio_cancel(raio_context_t ctx, struct raio_iocb *iocb,
 int raio_getevents(raio_context_t ctx, long min_nr, long nr,
 		   struct raio_event *events, struct timespec *timeout);
 
+/**
+ * raio_set_poll - makes raio_getevents busy poll the context's connections
+ *		   for completions instead of sleeping in the event loop. it
+ *		   falls back to sleeping once the spin budget is spent.
+ *
+ * @ctx:	the RAIO context ID, of raio_setup
+ * @spin_us:	spin budget of each wait, in microseconds. 0 turns polling off
+ *
+ * RETURNS: On success, zero is returned.  On error, -1 is returned, and errno
+ * is set appropriately.
+ */
+int raio_set_poll(raio_context_t ctx, int spin_us);
+
 /**
  * raio_release - release raio resources when events is no longer needed
  *
@@ -212,7 +311,9 @@ int raio_getevents(raio_context_t ctx, long min_nr, long nr,
 int raio_release(raio_context_t ctx, long nr, struct raio_event *events);
 
 /**
- * raio_reg_mr - register memory region for rdma operations
+ * raio_reg_mr - register memory region for rdma operations. reads into
+ *		 registered memory are placed straight in it by the
+ *		 transport, whatever their size
  *
  * @ctx:	the RAIO context ID
  * @buf:	pointer to memory buffer
@@ -262,6 +363,62 @@ static inline void raio_prep_pwrite(struct raio_iocb *iocb, int fd, void *buf,
 	iocb->u.c.mr = mr;
 }
 
+static inline void raio_prep_preadv(struct raio_iocb *iocb, int fd,
+				    const struct iovec *iov, int iovcnt,
+				    long long offset, raio_mr_t mr)
+{
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->raio_fildes = fd;
+	iocb->raio_lio_opcode = RAIO_CMD_PREADV;
+	iocb->u.v.vec = iov;
+	iocb->u.v.nr = iovcnt;
+	iocb->u.v.offset = offset;
+	iocb->u.v.mr = mr;
+}
+
+static inline void raio_prep_pwritev(struct raio_iocb *iocb, int fd,
+				     const struct iovec *iov, int iovcnt,
+				     long long offset, raio_mr_t mr)
+{
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->raio_fildes = fd;
+	iocb->raio_lio_opcode = RAIO_CMD_PWRITEV;
+	iocb->u.v.vec = iov;
+	iocb->u.v.nr = iovcnt;
+	iocb->u.v.offset = offset;
+	iocb->u.v.mr = mr;
+}
+
+static inline void raio_prep_open(struct raio_iocb *iocb,
+				  const struct sockaddr *addr,
+				  socklen_t addrlen, const char *pathname,
+				  int flags)
+{
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->raio_fildes = -1;
+	iocb->raio_lio_opcode = RAIO_CMD_OPEN_FILE;
+	iocb->u.f.addr = addr;
+	iocb->u.f.addrlen = addrlen;
+	iocb->u.f.pathname = pathname;
+	iocb->u.f.flags = flags;
+}
+
+static inline void raio_prep_fstat(struct raio_iocb *iocb, int fd,
+				   struct stat64 *stbuf)
+{
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->raio_fildes = fd;
+	iocb->raio_lio_opcode = RAIO_CMD_FSTAT_FILE;
+	iocb->u.f.stbuf = stbuf;
+}
+
+static inline void raio_prep_close(struct raio_iocb *iocb, int fd)
+{
+	memset(iocb, 0, sizeof(*iocb));
+	iocb->raio_fildes = fd;
+	iocb->raio_lio_opcode = RAIO_CMD_CLOSE_FILE;
+}
+
 static inline void raio_set_eventfd(struct raio_iocb *iocb, int eventfd)
 {
 	iocb->u.c.flags |= (1 << 0) /* RAIOCB_FLAG_RESFD */;
@@ -64,6 +64,11 @@
 #define NSECS_IN_USEC		1000
 #define NSECS_IN_SEC		1000000000
 
+#define RAIO_MAX_QUEUES		16
+#define RAIO_STRIPE_SHIFT	20	/* 1MB of the file per queue turn */
+#define RAIO_DEF_OPENS		16	/* raio_open_batch opens in flight */
+#define RAIO_MAX_OPENS		128	/* and at most */
+
 #define uint64_from_ptr(p)	(uint64_t)(uintptr_t)(p)
 #define ptr_from_int64(p)	(void *)(unsigned long)(p)
 
@@ -88,10 +93,19 @@ struct raio_mr {
 struct raio_io_u {
 	struct raio_iocb		*iocb;
 	struct raio_session_data	*ses_data;
+	struct raio_io_u		*leader; /* owns the message */
 	struct xio_msg			req;
 	struct xio_msg			*rsp;
 	int				res;
 	int				res2;
+	int				extent;	/* first extent in message */
+	int				extents_nr;
+
+	/* leader only - the iocbs carried by req */
+	int				members_nr;
+	int				refs;	/* members not yet released */
+	struct raio_io_u		*members[RAIO_SUBMITV_MAX_EXTENTS];
+	struct xio_iovec_ex		sglist[RAIO_SUBMITV_MAX_EXTENTS];
 
 	char				req_hdr[MAX_MSG_LEN];
 
@@ -99,17 +113,35 @@ struct raio_io_u {
 };
 
 struct raio_context  {
-	struct raio_session_data	*session_data;
+	struct raio_session_data	*session_data;	/* NULL for files */
 
 	struct raio_io_u		*io_us_free;
 	int				io_u_queued_nr;
 	int				io_u_completed_nr;
 	int				io_u_free_nr;
+	int				poll_us; /* getevents spin budget */
 	int				pad;
 
+	/* files context only - open, fstat and close of any session */
+	int				maxevents;
+	int				npending;
+	int				min_nr;
+	struct xio_context		*loop;	/* dispatches the sessions */
+
 	TAILQ_HEAD(, raio_io_u)		io_u_free_list;
 	TAILQ_HEAD(, raio_io_u)		io_u_completed_list;
 	TAILQ_HEAD(, raio_io_u)		io_u_queued_list;
+
+	/* sessions on their way out, destroyed once torn down */
+	LIST_HEAD(, raio_session_data)	zombies_list;
+};
+
+/* a connection to one of the server's portals */
+struct raio_queue {
+	struct xio_context		*ctx;
+	struct xio_connection		*conn;	/* NULL once torn down */
+	int				established;
+	int				poll_fd; /* ctx, polled by the lead */
 };
 
 /* private session data */
@@ -127,11 +159,23 @@ struct raio_session_data {
 	struct xio_msg			*cmd_rsp;
 	struct xio_msg			cmd_req;
 	struct xio_connection		*conn;
+	int				queues_nr;
+	int				queues_waiting;
+	int				torn_down;
+	int				poll_fd; /* ctx, while in files_ctx */
+
+	/* the open, fstat or close in flight for a files context */
+	raio_context_t			files_ctx;
+	struct raio_io_u		*file_op;
+
+	/* queue 0 is the lead connection */
+	struct raio_queue		queues[RAIO_MAX_QUEUES];
 
 	struct xio_context		*ctx;
 	raio_context_t			io_ctx;
 
 	LIST_ENTRY(raio_session_data)   rsd_siblings;
+	LIST_ENTRY(raio_session_data)   zombies_siblings;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -274,6 +318,133 @@ static inline uint16_t get_port(const struct sockaddr *ip)
 	}
 	return 0;
 }
+/*---------------------------------------------------------------------------*/
+/* raio_queues_disconnect - the lead goes last				     */
+/*---------------------------------------------------------------------------*/
+static void raio_queues_disconnect(struct raio_session_data *session_data)
+{
+	int i;
+
+	for (i = 1; i < session_data->queues_nr; i++)
+		if (session_data->queues[i].conn)
+			xio_disconnect(session_data->queues[i].conn);
+	xio_disconnect(session_data->conn);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_attach - the files context dispatches the session		     */
+/*---------------------------------------------------------------------------*/
+static int raio_files_attach(raio_context_t ctx,
+			     struct raio_session_data *session_data)
+{
+	struct xio_poll_params	poll_params;
+
+	if (xio_context_get_poll_params(session_data->ctx, &poll_params) ||
+	    xio_context_add_ev_handler(ctx->loop,
+				       poll_params.fd,
+				       poll_params.events,
+				       poll_params.handler,
+				       poll_params.data))
+		return -1;
+
+	session_data->poll_fd	= poll_params.fd;
+	session_data->files_ctx	= ctx;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_detach							     */
+/*---------------------------------------------------------------------------*/
+static void raio_files_detach(struct raio_session_data *session_data)
+{
+	xio_context_del_ev_handler(session_data->files_ctx->loop,
+				   session_data->poll_fd);
+	session_data->files_ctx = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_complete							     */
+/*---------------------------------------------------------------------------*/
+static void raio_files_complete(raio_context_t ctx, struct raio_io_u *io_u,
+				int res)
+{
+	io_u->res = res;
+	io_u->res2 = 0;
+
+	TAILQ_INSERT_TAIL(&ctx->io_u_completed_list, io_u, io_u_list);
+	ctx->io_u_completed_nr++;
+
+	/* this for getevent call */
+	if (ctx->min_nr != 0 && ctx->io_u_completed_nr >= ctx->min_nr)
+		xio_context_stop_loop(ctx->loop, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_file_op_done							     */
+/*---------------------------------------------------------------------------*/
+static void raio_file_op_done(struct raio_session_data *session_data, int res)
+{
+	raio_context_t		ctx = session_data->files_ctx;
+	struct raio_io_u	*io_u = session_data->file_op;
+	int			opcode = io_u->iocb->raio_lio_opcode;
+
+	session_data->file_op = NULL;
+	raio_files_complete(ctx, io_u, res);
+
+	if (opcode == RAIO_CMD_CLOSE_FILE)
+		rsd_list_remove(session_data);
+
+	/* a failed open and a close leave nothing behind. the session
+	 * stays in the files context until it is torn down
+	 */
+	if (opcode == RAIO_CMD_CLOSE_FILE ||
+	    (opcode == RAIO_CMD_OPEN_FILE && res < 0)) {
+		if (!session_data->disconnected)
+			raio_queues_disconnect(session_data);
+		LIST_INSERT_HEAD(&ctx->zombies_list, session_data,
+				 zombies_siblings);
+	} else {
+		raio_files_detach(session_data);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_file_op_answer							     */
+/*---------------------------------------------------------------------------*/
+static void on_file_op_answer(struct raio_session_data *session_data,
+			      struct xio_msg *rsp)
+{
+	struct raio_iocb	*iocb = session_data->file_op->iocb;
+	int			retval;
+
+	switch (iocb->raio_lio_opcode) {
+	case RAIO_CMD_OPEN_FILE:
+		retval = unpack_open_answer(rsp->in.header.iov_base,
+					    rsp->in.header.iov_len,
+					    &session_data->fd);
+		break;
+	case RAIO_CMD_FSTAT_FILE:
+		retval = unpack_fstat_answer(rsp->in.header.iov_base,
+					     rsp->in.header.iov_len,
+					     iocb->u.f.stbuf);
+		break;
+	default:
+		retval = unpack_close_answer(rsp->in.header.iov_base,
+					     rsp->in.header.iov_len);
+		break;
+	}
+	if (retval == -1)
+		retval = -errno;
+	else if (iocb->raio_lio_opcode == RAIO_CMD_OPEN_FILE)
+		retval = rsd_list_add(session_data);
+
+	/* acknowlege xio that response is no longer needed */
+	xio_release_response(rsp);
+
+	raio_file_op_done(session_data, retval);
+}
+
 /*---------------------------------------------------------------------------*/
 /* on_session_event							     */
 /*---------------------------------------------------------------------------*/
@@ -282,16 +453,41 @@ static int on_session_event(struct xio_session *session,
 			    void *cb_user_context)
 {
 	struct raio_session_data  *session_data = cb_user_context;
+	struct raio_queue	  *queue = NULL;
+	int			  i;
+
+	for (i = 1; i < session_data->queues_nr; i++) {
+		if (session_data->queues[i].conn == event_data->conn) {
+			queue = &session_data->queues[i];
+			break;
+		}
+	}
 
 	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		if (queue)
+			queue->established = 1;
+		break;
 	case XIO_SESSION_CONNECTION_CLOSED_EVENT:
 		break;
 	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
 		xio_connection_destroy(event_data->conn);
+		/* a lost queue hands its stripes back to the lead */
+		if (queue) {
+			queue->conn = NULL;
+			break;
+		}
 		session_data->disconnected = 1;
+		/* the key is handed out once the file is open */
+		if (session_data->file_op)
+			raio_file_op_done(session_data, session_data->key ?
+					  -ECONNRESET : -ECONNREFUSED);
 		break;
 	case XIO_SESSION_TEARDOWN_EVENT:
+		session_data->torn_down = 1;
 		xio_context_stop_loop(session_data->ctx, 0);  /* exit */
+		if (session_data->files_ctx)
+			xio_context_stop_loop(session_data->files_ctx->loop, 0);
 		break;
 	default:
 		printf("libraio: unexpected session event: %s. reason: %s\n",
@@ -299,6 +495,9 @@ static int on_session_event(struct xio_session *session,
 		       xio_strerror(event_data->reason));
 		break;
 	};
+	/* raio_open waits for the queues to come up */
+	if (queue && session_data->queues_waiting)
+		xio_context_stop_loop(session_data->ctx, 0);
 
 	return 0;
 }
@@ -334,6 +533,70 @@ static void on_submit_answer(struct xio_msg *rsp)
 	}
 }
 
+/*---------------------------------------------------------------------------*/
+/* on_submitv_answer							     */
+/*---------------------------------------------------------------------------*/
+static void on_submitv_answer(struct xio_msg *rsp)
+{
+	struct raio_io_u	*leader = rsp->user_context;
+	struct raio_io_u	*io_u;
+	struct raio_answer	*ans = &leader->ses_data->ans;
+	raio_context_t		io_ctx = leader->ses_data->io_ctx;
+	const char		*buffer;
+	int			res, res2;
+	int			i, j;
+
+	buffer = unpack_u32((uint32_t *)&ans->ret_errno,
+		 unpack_u32((uint32_t *)&ans->ret,
+		 unpack_u32(&ans->data_len,
+		 unpack_u32(&ans->command,
+			    rsp->in.header.iov_base))));
+
+	if (ans->ret == 0) {
+		io_u = leader->members[leader->members_nr - 1];
+		if (ans->data_len != (io_u->extent + io_u->extents_nr) *
+				     2*sizeof(uint32_t)) {
+			ans->ret = -1;
+			ans->ret_errno = EIO;
+		}
+	}
+
+	for (i = 0; i < leader->members_nr; i++) {
+		io_u = leader->members[i];
+		io_u->rsp = rsp;
+		if (ans->ret == -1) {
+			io_u->res = -ans->ret_errno;
+			io_u->res2 = 0;
+		} else {
+			/* a vectored iocb adds up its extents */
+			io_u->res = 0;
+			io_u->res2 = 0;
+			for (j = 0; j < io_u->extents_nr; j++) {
+				buffer = unpack_u32((uint32_t *)&res2,
+					 unpack_u32((uint32_t *)&res,
+						    buffer));
+				if (io_u->res < 0)
+					continue;
+				if (res < 0) {
+					io_u->res = res;
+					io_u->res2 = res2;
+				} else {
+					io_u->res += res;
+				}
+			}
+		}
+		TAILQ_INSERT_TAIL(&io_ctx->io_u_completed_list,
+				  io_u, io_u_list);
+		io_ctx->io_u_completed_nr++;
+	}
+
+	/* this for getevent call */
+	if (leader->ses_data->min_nr != 0) {
+		if (io_ctx->io_u_completed_nr >= leader->ses_data->min_nr)
+			xio_context_stop_loop(leader->ses_data->ctx, 0);
+	}
+}
+
 /*---------------------------------------------------------------------------*/
 /* on_response								     */
 /*---------------------------------------------------------------------------*/
@@ -352,9 +615,18 @@ static int on_response(struct xio_session *session,
 	case RAIO_CMD_IO_SUBMIT:
 		on_submit_answer(rsp);
 		break;
+	case RAIO_CMD_IO_SUBMITV:
+		on_submitv_answer(rsp);
+		break;
 	case RAIO_CMD_OPEN:
 	case RAIO_CMD_FSTAT:
 	case RAIO_CMD_CLOSE:
+		/* asynchronous ones complete in their files context */
+		if (session_data->file_op) {
+			on_file_op_answer(session_data, rsp);
+			break;
+		}
+		/* fall through */
 	case RAIO_CMD_IO_SETUP:
 	case RAIO_CMD_IO_DESTROY:
 		/* break the loop */
@@ -379,22 +651,140 @@ struct xio_session_ops ses_ops = {
 };
 
 /*---------------------------------------------------------------------------*/
-/* raio_open								     */
+/* raio_queues_connecting						     */
 /*---------------------------------------------------------------------------*/
-__RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
-			    const char *pathname, int flags)
+static int raio_queues_connecting(struct raio_session_data *session_data)
+{
+	int i;
+
+	for (i = 1; i < session_data->queues_nr; i++)
+		if (session_data->queues[i].conn &&
+		    !session_data->queues[i].established)
+			return 1;
+
+	return 0;
+}
 
+/*---------------------------------------------------------------------------*/
+/* raio_queues_connect							     */
+/*---------------------------------------------------------------------------*/
+static void raio_queues_connect(struct raio_session_data *session_data,
+				int queues_nr)
+{
+	struct xio_poll_params	poll_params;
+	struct raio_queue	*queue;
+	int			i;
+
+	session_data->queues[0].ctx		= session_data->ctx;
+	session_data->queues[0].conn		= session_data->conn;
+	session_data->queues[0].established	= 1;
+	session_data->queues[0].poll_fd		= -1;
+	session_data->queues_nr			= 1;
+
+	/* one connection per context, the session spreads them over the
+	 * portals the server advertised once it is accepted. the queues
+	 * are connected before the lead is online, and their contexts are
+	 * dispatched from the lead context's loop
+	 */
+	for (i = 1; i < queues_nr; i++) {
+		queue = &session_data->queues[i];
+		queue->ctx = xio_context_create(NULL, 0, -1);
+		if (queue->ctx == NULL)
+			break;
+		if (xio_context_get_poll_params(queue->ctx, &poll_params) ||
+		    xio_context_add_ev_handler(session_data->ctx,
+					       poll_params.fd,
+					       poll_params.events,
+					       poll_params.handler,
+					       poll_params.data)) {
+			xio_context_destroy(queue->ctx);
+			queue->ctx = NULL;
+			break;
+		}
+		queue->poll_fd = poll_params.fd;
+		session_data->queues_nr++;
+
+		queue->conn = xio_connect(session_data->session, queue->ctx,
+					  0, NULL, session_data);
+		if (queue->conn == NULL)
+			break;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_queues_wait							     */
+/*---------------------------------------------------------------------------*/
+static void raio_queues_wait(struct raio_session_data *session_data,
+			     int queues_nr)
+{
+	session_data->queues_waiting = 1;
+	while (raio_queues_connecting(session_data) &&
+	       !session_data->disconnected)
+		xio_context_run_loop(session_data->ctx, XIO_INFINITE);
+	session_data->queues_waiting = 0;
+
+	if (session_data->queues_nr < queues_nr)
+		printf("libraio: %d of %d queues opened\n",
+		       session_data->queues_nr, queues_nr);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_queues_free - once the session is destroyed			     */
+/*---------------------------------------------------------------------------*/
+static void raio_queues_free(struct raio_session_data *session_data)
+{
+	int i;
+
+	for (i = 1; i < session_data->queues_nr; i++) {
+		xio_context_del_ev_handler(session_data->ctx,
+					   session_data->queues[i].poll_fd);
+		xio_context_destroy(session_data->queues[i].ctx);
+	}
+	session_data->queues_nr = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_queue_conn - the connection serving the iocb's stripe		     */
+/*---------------------------------------------------------------------------*/
+static inline int raio_queue_idx(struct raio_session_data *session_data,
+				 long long offset)
+{
+	return ((unsigned long long)offset >> RAIO_STRIPE_SHIFT) %
+	       session_data->queues_nr;
+}
+
+static inline struct xio_connection *raio_queue_conn(
+		struct raio_session_data *session_data, int idx)
+{
+	struct raio_queue *queue = &session_data->queues[idx];
+
+	if (queue->conn && queue->established)
+		return queue->conn;
+
+	return session_data->conn;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_session_create - connects, the open request is up to the caller	     */
+/*---------------------------------------------------------------------------*/
+static struct raio_session_data *raio_session_create(
+		const struct sockaddr *addr, socklen_t addrlen, int queues_nr)
 {
-	int				retval;
 	char				url[256];
 	struct raio_session_data	*session_data;
-	int				raio_err = 0;
-	int				fd;
+	int				iov_len = RAIO_SUBMITV_MAX_EXTENTS;
 	struct xio_session_params	params;
 
-
 	xio_init();
 
+	/* a vectored submit carries one sge per extent, both ways */
+	xio_set_opt(NULL,
+		    XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_MAX_IN_IOVLEN,
+		    &iov_len, sizeof(int));
+	xio_set_opt(NULL,
+		    XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_MAX_OUT_IOVLEN,
+		    &iov_len, sizeof(int));
+
 	session_data = calloc(1, sizeof(*session_data));
 	memset(&params, 0, sizeof(params));
 
@@ -407,6 +797,8 @@ __RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
 
 	/* create thread context for the client */
 	session_data->ctx = xio_context_create(NULL, 0, -1);
+	if (session_data->ctx == NULL)
+		goto cleanup;
 
 	/* create url to connect to */
 	sprintf(url, "rdma://%s:%d",
@@ -418,7 +810,7 @@ __RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
 
 	session_data->session = xio_session_create(&params);
 	if (session_data->session == NULL)
-		goto cleanup;
+		goto cleanup1;
 
 	/* connect the session  */
 	session_data->conn = xio_connect(session_data->session,
@@ -426,7 +818,77 @@ __RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
 					 NULL,
 					 session_data);
 	if (session_data->conn == NULL)
-		goto cleanup1;
+		goto cleanup2;
+
+	raio_queues_connect(session_data, queues_nr);
+
+	return session_data;
+
+cleanup2:
+	xio_session_destroy(session_data->session);
+cleanup1:
+	xio_context_destroy(session_data->ctx);
+cleanup:
+	free(session_data->cmd_req.out.header.iov_base);
+	free(session_data);
+	xio_shutdown();
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_session_destroy							     */
+/*---------------------------------------------------------------------------*/
+static void raio_session_destroy(struct raio_session_data *session_data)
+{
+	if (!session_data->disconnected) {
+		raio_queues_disconnect(session_data);
+		xio_context_run_loop(session_data->ctx, XIO_INFINITE);
+	}
+	xio_session_destroy(session_data->session);
+	raio_queues_free(session_data);
+
+	/* free the context */
+	xio_context_destroy(session_data->ctx);
+
+	free(session_data->cmd_req.out.header.iov_base);
+	free(session_data);
+
+	xio_shutdown();
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_open								     */
+/*---------------------------------------------------------------------------*/
+__RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
+			    const char *pathname, int flags)
+{
+	return raio_open_mq(addr, addrlen, pathname, flags, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_open_mq								     */
+/*---------------------------------------------------------------------------*/
+__RAIO_PUBLIC int raio_open_mq(const struct sockaddr *addr, socklen_t addrlen,
+			       const char *pathname, int flags, int queues_nr)
+
+{
+	int				retval;
+	struct raio_session_data	*session_data;
+	int				raio_err = 0;
+	int				fd;
+
+
+	if (queues_nr < 1 || queues_nr > RAIO_MAX_QUEUES) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	session_data = raio_session_create(addr, addrlen, queues_nr);
+	if (session_data == NULL) {
+		printf("libraio: raio_open failed. %m\n");
+		return -1;
+	}
 
 	msg_reset(&session_data->cmd_req);
 	pack_open_command(pathname, flags,
@@ -439,9 +901,8 @@ __RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
 	xio_context_run_loop(session_data->ctx, XIO_INFINITE);
 
 	if (session_data->disconnected) {
-		retval = -1;
 		raio_err = ECONNREFUSED;
-		goto cleanup1;
+		goto cleanup;
 	}
 
 	retval = unpack_open_answer(
@@ -454,29 +915,19 @@ __RAIO_PUBLIC int raio_open(const struct sockaddr *addr, socklen_t addrlen,
 
 	if (retval == -1) {
 		raio_err = errno;
-		xio_disconnect(session_data->conn);
-		goto cleanup1;
+		goto cleanup;
 	}
 
+	raio_queues_wait(session_data, queues_nr);
+
 	errno = 0;
 	fd = rsd_list_add(session_data);
 
 
 	return fd;
 
-cleanup1:
-	if (session_data->session) {
-		if (!session_data->disconnected) {
-			xio_context_run_loop(session_data->ctx, XIO_INFINITE);
-			xio_session_destroy(session_data->session);
-		} else {
-		     xio_session_destroy(session_data->session);
-		}
-		session_data->session = NULL;
-	}
 cleanup:
-	/* free the context */
-	xio_context_destroy(session_data->ctx);
+	raio_session_destroy(session_data);
 
 	errno = raio_err;
 
@@ -498,6 +949,10 @@ __RAIO_PUBLIC int raio_close(int fd)
 		errno = EINVAL;
 		return -1;
 	}
+	if (session_data->file_op) {
+		errno = EBUSY;
+		return -1;
+	}
 
 
 	if (session_data->disconnected) {
@@ -530,17 +985,7 @@ __RAIO_PUBLIC int raio_close(int fd)
 cleanup:
 	rsd_list_remove(session_data);
 
-	if (!session_data->disconnected) {
-		xio_disconnect(session_data->conn);
-		xio_context_run_loop(session_data->ctx, XIO_INFINITE);
-		xio_session_destroy(session_data->session);
-	}
-	/* free the context */
-	xio_context_destroy(session_data->ctx);
-
-	xio_shutdown();
-
-	free(session_data);
+	raio_session_destroy(session_data);
 
 	errno = raio_err;
 	return retval;
@@ -558,6 +1003,10 @@ __RAIO_PUBLIC int raio_fstat(int fd, struct stat64 *stbuf)
 		errno = EINVAL;
 		return -1;
 	}
+	if (session_data->file_op) {
+		errno = EBUSY;
+		return -1;
+	}
 
 	msg_reset(&session_data->cmd_req);
 	pack_fstat_command(
@@ -601,6 +1050,7 @@ __RAIO_PUBLIC int raio_setup(int fd, int maxevents, raio_context_t *ctxp)
 {
 	int				i;
 	raio_context_t			ctx;
+	struct raio_io_u		*io_u;
 	int				retval;
 
 	struct raio_session_data *session_data = rsd_list_find(fd);
@@ -653,10 +1103,17 @@ __RAIO_PUBLIC int raio_setup(int fd, int maxevents, raio_context_t *ctxp)
 
 	/* register each io_u in the free list */
 	for (i = 0; i < ctx->io_u_free_nr; i++) {
-		ctx->io_us_free[i].req.out.header.iov_base =
-			ctx->io_us_free[i].req_hdr;
-		ctx->io_us_free[i].req.out.header.iov_len =
-			MAX_MSG_LEN;
+		io_u = &ctx->io_us_free[i];
+		io_u->req.out.header.iov_base = io_u->req_hdr;
+		io_u->req.out.header.iov_len = MAX_MSG_LEN;
+
+		/* only one side carries data, they share the sglist */
+		io_u->req.in.sgl_type = XIO_SGL_TYPE_IOV_PTR;
+		io_u->req.in.pdata_iov.max_nents = RAIO_SUBMITV_MAX_EXTENTS;
+		io_u->req.in.pdata_iov.sglist = io_u->sglist;
+		io_u->req.out.sgl_type = XIO_SGL_TYPE_IOV_PTR;
+		io_u->req.out.pdata_iov.max_nents = RAIO_SUBMITV_MAX_EXTENTS;
+		io_u->req.out.pdata_iov.sglist = io_u->sglist;
 		TAILQ_INSERT_TAIL(&ctx->io_u_free_list,
 				  &ctx->io_us_free[i], io_u_list);
 	}
@@ -667,40 +1124,137 @@ __RAIO_PUBLIC int raio_setup(int fd, int maxevents, raio_context_t *ctxp)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_setup_files							     */
+/*---------------------------------------------------------------------------*/
+__RAIO_PUBLIC int raio_setup_files(int maxevents, raio_context_t *ctxp)
+{
+	int				i;
+	raio_context_t			ctx;
+
+	if (maxevents <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	xio_init();
+
+	ctx = calloc(1, sizeof(*ctx));
+
+	/* the sessions' contexts are dispatched from this loop while their
+	 * requests are in flight
+	 */
+	ctx->loop = xio_context_create(NULL, 0, -1);
+	if (ctx->loop == NULL) {
+		free(ctx);
+		xio_shutdown();
+		return -1;
+	}
+	ctx->maxevents = maxevents;
+	ctx->io_us_free = calloc(maxevents, sizeof(struct raio_io_u));
+	ctx->io_u_free_nr = maxevents;
+
+	TAILQ_INIT(&ctx->io_u_free_list);
+	TAILQ_INIT(&ctx->io_u_queued_list);
+	TAILQ_INIT(&ctx->io_u_completed_list);
+	LIST_INIT(&ctx->zombies_list);
+
+	for (i = 0; i < ctx->io_u_free_nr; i++)
+		TAILQ_INSERT_TAIL(&ctx->io_u_free_list,
+				  &ctx->io_us_free[i], io_u_list);
+	*ctxp = ctx;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_reap - destroys the sessions that are torn down		     */
+/*---------------------------------------------------------------------------*/
+static void raio_files_reap(raio_context_t ctx)
+{
+	struct raio_session_data *session_data, *next;
+
+	for (session_data = LIST_FIRST(&ctx->zombies_list); session_data;
+	     session_data = next) {
+		next = LIST_NEXT(session_data, zombies_siblings);
+		if (!session_data->torn_down)
+			continue;
+		LIST_REMOVE(session_data, zombies_siblings);
+		raio_files_detach(session_data);
+		raio_session_destroy(session_data);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_destroy							     */
+/*---------------------------------------------------------------------------*/
+static int raio_files_destroy(raio_context_t ctx)
+{
+	/* let the requests in flight land first */
+	while (ctx->npending > ctx->io_u_completed_nr) {
+		ctx->min_nr = ctx->npending;
+		xio_context_run_loop(ctx->loop, XIO_INFINITE);
+		raio_files_reap(ctx);
+	}
+	ctx->min_nr = 0;
+
+	while (!LIST_EMPTY(&ctx->zombies_list)) {
+		xio_context_run_loop(ctx->loop, XIO_INFINITE);
+		raio_files_reap(ctx);
+	}
+	xio_context_destroy(ctx->loop);
+
+	free(ctx->io_us_free);
+	free(ctx);
+
+	xio_shutdown();
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_destroy								     */
 /*---------------------------------------------------------------------------*/
 __RAIO_PUBLIC int raio_destroy(raio_context_t ctx)
 {
 	struct raio_session_data *session_data;
+	struct raio_queue	 *queue;
 	int			 retval  = 0;
+	int			 i;
 
 	session_data = ctx->session_data;
+	if (session_data == NULL)
+		return raio_files_destroy(ctx);
 
 	if (session_data->disconnected)
 		goto cleanup;
 
+	/* every queue tears down its own portal's context, the lead last */
+	for (i = session_data->queues_nr - 1; i >= 0; i--) {
+		queue = &session_data->queues[i];
+		if (!queue->conn || !queue->established)
+			continue;
 
-	msg_reset(&session_data->cmd_req);
-	pack_destroy_command(
-			session_data->fd,
-			session_data->cmd_req.out.header.iov_base,
-			&session_data->cmd_req.out.header.iov_len);
-
-	xio_send_request(session_data->conn, &session_data->cmd_req);
+		msg_reset(&session_data->cmd_req);
+		pack_destroy_command(
+				session_data->fd,
+				session_data->cmd_req.out.header.iov_base,
+				&session_data->cmd_req.out.header.iov_len);
 
-	xio_context_run_loop(session_data->ctx, XIO_INFINITE);
-	if (session_data->disconnected) {
-		errno =  ECONNRESET;
-		retval = -1;
-		goto cleanup;
-	}
+		xio_send_request(queue->conn, &session_data->cmd_req);
 
+		xio_context_run_loop(session_data->ctx, XIO_INFINITE);
+		if (session_data->disconnected) {
+			errno =  ECONNRESET;
+			retval = -1;
+			goto cleanup;
+		}
 
-	/* don't check answer just clean */
+		/* don't check answer just clean */
 
-	/* acknowlege xio that response is no longer needed */
-	xio_release_response(session_data->cmd_rsp);
+		/* acknowlege xio that response is no longer needed */
+		xio_release_response(session_data->cmd_rsp);
+	}
 
 cleanup:
 	free(ctx->io_us_free);
@@ -709,6 +1263,252 @@ cleanup:
 	return retval;
 }
 
+/*---------------------------------------------------------------------------*/
+/* iocb_is_read								     */
+/*---------------------------------------------------------------------------*/
+static inline int iocb_is_read(struct raio_iocb *iocb)
+{
+	return (iocb->raio_lio_opcode == RAIO_CMD_PREAD ||
+		iocb->raio_lio_opcode == RAIO_CMD_PREADV);
+}
+
+/*---------------------------------------------------------------------------*/
+/* iocb_is_vector							     */
+/*---------------------------------------------------------------------------*/
+static inline int iocb_is_vector(struct raio_iocb *iocb)
+{
+	return (iocb->raio_lio_opcode == RAIO_CMD_PREADV ||
+		iocb->raio_lio_opcode == RAIO_CMD_PWRITEV);
+}
+
+/*---------------------------------------------------------------------------*/
+/* iocb_offset								     */
+/*---------------------------------------------------------------------------*/
+static inline long long iocb_offset(struct raio_iocb *iocb)
+{
+	return iocb_is_vector(iocb) ? iocb->u.v.offset : iocb->u.c.offset;
+}
+
+/*---------------------------------------------------------------------------*/
+/* iocb_extents - number of extents the iocb takes in a message, or -1	     */
+/*---------------------------------------------------------------------------*/
+static int iocb_extents(struct raio_iocb *iocb, uint64_t *nbytes)
+{
+	int i;
+
+	switch (iocb->raio_lio_opcode) {
+	case RAIO_CMD_PREAD:
+	case RAIO_CMD_PWRITE:
+		*nbytes = iocb->u.c.nbytes;
+		return 1;
+	case RAIO_CMD_PREADV:
+	case RAIO_CMD_PWRITEV:
+		if (iocb->u.v.nr <= 0 ||
+		    iocb->u.v.nr > RAIO_SUBMITV_MAX_EXTENTS)
+			return -1;
+		*nbytes = 0;
+		for (i = 0; i < iocb->u.v.nr; i++) {
+			if (iocb->u.v.vec[i].iov_len == 0)
+				return -1;
+			*nbytes += iocb->u.v.vec[i].iov_len;
+		}
+		if (*nbytes > RAIO_SUBMITV_MAX_BYTES)
+			return -1;
+		return iocb->u.v.nr;
+	default:
+		return -1;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_submitv_prep - packs nr iocbs into the leader's message		     */
+/*---------------------------------------------------------------------------*/
+static void raio_submitv_prep(raio_context_t ctx, struct raio_io_u *leader,
+			      long nr, struct raio_iocb *ios[],
+			      int is_last_in_batch)
+{
+	struct raio_session_data	*session_data = ctx->session_data;
+	struct raio_extent		extents[RAIO_SUBMITV_MAX_EXTENTS];
+	struct raio_io_u		*io_u;
+	struct xio_iovec_ex		*sglist = leader->sglist;
+	int				is_read = iocb_is_read(ios[0]);
+	int				zero_copy = is_read;
+	int				i, j, k = 0;
+
+	for (i = 0; i < nr; i++) {
+		if (i) {
+			io_u = TAILQ_FIRST(&ctx->io_u_free_list);
+			TAILQ_REMOVE(&ctx->io_u_free_list, io_u, io_u_list);
+			ctx->io_u_free_nr--;
+		} else {
+			io_u = leader;
+		}
+		ios[i]->raio_fildes	= session_data->fd;
+		io_u->iocb		= ios[i];
+		io_u->ses_data		= session_data;
+		io_u->leader		= leader;
+		io_u->extent		= k;
+		leader->members[i]	= io_u;
+
+		if (iocb_is_vector(ios[i])) {
+			long long offset = ios[i]->u.v.offset;
+
+			for (j = 0; j < ios[i]->u.v.nr; j++, k++) {
+				extents[k].offset = offset;
+				extents[k].nbytes = ios[i]->u.v.vec[j].iov_len;
+				sglist[k].iov_base =
+					ios[i]->u.v.vec[j].iov_base;
+				sglist[k].iov_len = ios[i]->u.v.vec[j].iov_len;
+				sglist[k].mr = ios[i]->u.v.mr ?
+					       ios[i]->u.v.mr->omr : NULL;
+				offset += ios[i]->u.v.vec[j].iov_len;
+			}
+		} else {
+			extents[k].offset	= ios[i]->u.c.offset;
+			extents[k].nbytes	= ios[i]->u.c.nbytes;
+			sglist[k].iov_base	= ios[i]->u.c.buf;
+			sglist[k].iov_len	= ios[i]->u.c.nbytes;
+			sglist[k].mr		= ios[i]->u.c.mr ?
+						  ios[i]->u.c.mr->omr : NULL;
+			k++;
+		}
+		io_u->extents_nr = k - io_u->extent;
+	}
+	leader->members_nr	= nr;
+	leader->refs		= nr;
+
+	pack_submitv_command(
+			session_data->fd,
+			is_read ? RAIO_CMD_PREAD : RAIO_CMD_PWRITE,
+			extents, k,
+			is_last_in_batch,
+			leader->req.out.header.iov_base,
+			&leader->req.out.header.iov_len);
+
+	vmsg_sglist_set_nents(&leader->req.in, is_read ? k : 0);
+	vmsg_sglist_set_nents(&leader->req.out, is_read ? 0 : k);
+
+	/* placed in place only if all the buffers are registered */
+	for (i = 0; i < k && zero_copy; i++)
+		zero_copy = (sglist[i].mr != NULL);
+	leader->req.flags = zero_copy ? XIO_MSG_FLAG_SMALL_ZERO_COPY : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_start							     */
+/*---------------------------------------------------------------------------*/
+static void raio_files_start(raio_context_t ctx, struct raio_io_u *io_u)
+{
+	struct raio_iocb		*iocb = io_u->iocb;
+	struct raio_session_data	*session_data;
+
+	if (iocb->raio_lio_opcode == RAIO_CMD_OPEN_FILE) {
+		session_data = raio_session_create(iocb->u.f.addr,
+						   iocb->u.f.addrlen, 1);
+		if (session_data == NULL) {
+			raio_files_complete(ctx, io_u, -ECONNREFUSED);
+			return;
+		}
+		if (raio_files_attach(ctx, session_data)) {
+			raio_session_destroy(session_data);
+			raio_files_complete(ctx, io_u, -ENOMEM);
+			return;
+		}
+		msg_reset(&session_data->cmd_req);
+		pack_open_command(iocb->u.f.pathname, iocb->u.f.flags,
+				  session_data->cmd_req.out.header.iov_base,
+				  &session_data->cmd_req.out.header.iov_len);
+		goto send;
+	}
+
+	session_data = rsd_list_find(iocb->raio_fildes);
+	if (session_data == NULL) {
+		raio_files_complete(ctx, io_u, -EINVAL);
+		return;
+	}
+	if (session_data->file_op) {
+		raio_files_complete(ctx, io_u, -EBUSY);
+		return;
+	}
+	if (session_data->disconnected) {
+		/* as raio_close, a lost session is closed anyway */
+		if (iocb->raio_lio_opcode == RAIO_CMD_CLOSE_FILE) {
+			rsd_list_remove(session_data);
+			raio_session_destroy(session_data);
+			raio_files_complete(ctx, io_u, 0);
+		} else {
+			raio_files_complete(ctx, io_u, -ECONNRESET);
+		}
+		return;
+	}
+	if (raio_files_attach(ctx, session_data)) {
+		raio_files_complete(ctx, io_u, -ENOMEM);
+		return;
+	}
+
+	msg_reset(&session_data->cmd_req);
+	if (iocb->raio_lio_opcode == RAIO_CMD_FSTAT_FILE)
+		pack_fstat_command(
+				session_data->fd,
+				session_data->cmd_req.out.header.iov_base,
+				&session_data->cmd_req.out.header.iov_len);
+	else
+		pack_close_command(
+				session_data->fd,
+				session_data->cmd_req.out.header.iov_base,
+				&session_data->cmd_req.out.header.iov_len);
+send:
+	session_data->file_op = io_u;
+	io_u->ses_data = session_data;
+	xio_send_request(session_data->conn, &session_data->cmd_req);
+
+	/* work scheduled from outside the session's context doesn't wake
+	 * the files loop, run it once
+	 */
+	xio_context_run_loop(session_data->ctx, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_files_submit							     */
+/*---------------------------------------------------------------------------*/
+static int raio_files_submit(raio_context_t ctx,
+			     long nr, struct raio_iocb *ios[])
+{
+	struct raio_io_u		*io_u;
+	long				i;
+
+	if (ctx->npending == ctx->maxevents)
+		return -EINVAL;
+
+	if ((ctx->npending  + nr) > ctx->maxevents)
+		nr = ctx->maxevents - ctx->npending;
+
+	for (i = 0; i < nr; i++) {
+		if (ios[i]->raio_lio_opcode != RAIO_CMD_OPEN_FILE &&
+		    ios[i]->raio_lio_opcode != RAIO_CMD_FSTAT_FILE &&
+		    ios[i]->raio_lio_opcode != RAIO_CMD_CLOSE_FILE)
+			break;
+
+		io_u = TAILQ_FIRST(&ctx->io_u_free_list);
+		if (!io_u)
+			break;
+		TAILQ_REMOVE(&ctx->io_u_free_list, io_u, io_u_list);
+		ctx->io_u_free_nr--;
+
+		io_u->iocb	= ios[i];
+		io_u->rsp	= NULL;
+		io_u->leader	= io_u;
+		io_u->refs	= 1;
+		ctx->npending++;
+
+		raio_files_start(ctx, io_u);
+	}
+	if (i == 0 && nr)
+		return -EINVAL;
+
+	return i;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_submit								     */
 /*---------------------------------------------------------------------------*/
@@ -718,12 +1518,18 @@ __RAIO_PUBLIC int raio_submit(raio_context_t ctx,
 	struct raio_session_data	*session_data;
 	struct xio_iovec_ex		*sglist;
 	struct raio_io_u		*io_u;
-	int				i;
+	uint64_t			nbytes, msg_nbytes;
+	int				extents, msg_extents;
+	int				queue;
+	long				queue_last[RAIO_MAX_QUEUES];
+	long				i, j;
 
 	if (!ctx || (nr < 0))
 		return -EINVAL;
 
 	session_data = ctx->session_data;
+	if (session_data == NULL)
+		return raio_files_submit(ctx, nr, ios);
 
 	if (session_data->npending == session_data->maxevents)
 		return -EINVAL;
@@ -739,6 +1545,38 @@ __RAIO_PUBLIC int raio_submit(raio_context_t ctx,
 
 
 	for (i = 0; i < nr; i++) {
+		if (iocb_extents(ios[i], &nbytes) < 0) {
+			if (i == 0)
+				return -EINVAL;
+			nr = i;
+			break;
+		}
+	}
+	/* each queue's portal flushes its backing store on its own last io */
+	for (queue = 0; queue < session_data->queues_nr; queue++)
+		queue_last[queue] = -1;
+	for (i = 0; i < nr; i++)
+		queue_last[raio_queue_idx(session_data,
+					  iocb_offset(ios[i]))] = i;
+
+	for (i = 0; i < nr; i = j) {
+		msg_extents = iocb_extents(ios[i], &msg_nbytes);
+		/* stripes of the file are spread over the queues */
+		queue = raio_queue_idx(session_data, iocb_offset(ios[i]));
+
+		/* neighbouring iocbs of the same direction share a message */
+		for (j = i + 1; j < nr; j++) {
+			extents = iocb_extents(ios[j], &nbytes);
+			if ((iocb_is_read(ios[j]) != iocb_is_read(ios[i])) ||
+			    (raio_queue_idx(session_data,
+					    iocb_offset(ios[j])) != queue) ||
+			    (msg_extents + extents > RAIO_SUBMITV_MAX_EXTENTS) ||
+			    (msg_nbytes + nbytes > RAIO_SUBMITV_MAX_BYTES))
+				break;
+			msg_extents += extents;
+			msg_nbytes += nbytes;
+		}
+
 		io_u = TAILQ_FIRST(&ctx->io_u_free_list);
 		if (!io_u) {
 			printf("libraio: io_u_free_list is empty\n");
@@ -749,11 +1587,17 @@ __RAIO_PUBLIC int raio_submit(raio_context_t ctx,
 		ctx->io_u_free_nr--;
 		msg_reset(&io_u->req);
 
+		if ((j - i > 1) || iocb_is_vector(ios[i])) {
+			raio_submitv_prep(ctx, io_u, j - i, &ios[i],
+					  (j > queue_last[queue]));
+			goto send;
+		}
+
 		/* replace the shadowed fd with the real one */
 		ios[i]->raio_fildes = session_data->fd;
 		pack_submit_command(
 				ios[i],
-				(i == (nr - 1)),
+				(i == queue_last[queue]),
 				io_u->req.out.header.iov_base,
 				&io_u->req.out.header.iov_len);
 		if (ios[i]->raio_lio_opcode == RAIO_CMD_PWRITE) {
@@ -781,17 +1625,31 @@ __RAIO_PUBLIC int raio_submit(raio_context_t ctx,
 			vmsg_sglist_set_nents(&io_u->req.in, 1);
 			vmsg_sglist_set_nents(&io_u->req.out, 0);
 		}
-		io_u->req.user_context = io_u;
+		/* the transport places small reads of registered memory
+		 * straight in the buffer too, instead of copying them out
+		 * of its receive buffers
+		 */
+		io_u->req.flags = (iocb_is_read(ios[i]) && ios[i]->u.c.mr) ?
+				  XIO_MSG_FLAG_SMALL_ZERO_COPY : 0;
 		io_u->iocb = ios[i];
 		io_u->ses_data = session_data;
-		xio_send_request(session_data->conn, &io_u->req);
+		io_u->leader = io_u;
+		io_u->extent = 0;
+		io_u->extents_nr = 1;
+		io_u->members[0] = io_u;
+		io_u->members_nr = 1;
+		io_u->refs = 1;
+send:
+		io_u->req.user_context = io_u;
+		xio_send_request(raio_queue_conn(session_data, queue),
+				 &io_u->req);
 	}
 	session_data->npending += nr;
 
 	/* trigger event that packets are ready */
 	for (i = 0; i < nr; i++) {
-		if (io_u->iocb->u.c.flags & (1 << 0)) {
-			eventfd_write(io_u->iocb->u.c.resfd,
+		if (ios[i]->u.c.flags & (1 << 0)) {
+			eventfd_write(ios[i]->u.c.resfd,
 				      (eventfd_t)nr);
 		}
 	}
@@ -799,9 +1657,121 @@ __RAIO_PUBLIC int raio_submit(raio_context_t ctx,
 	return nr;
 }
 
-/*
-#define POLL_COMPLETIONS 1
-*/
+/*---------------------------------------------------------------------------*/
+/* raio_files_getevents							     */
+/*---------------------------------------------------------------------------*/
+static int raio_files_getevents(raio_context_t ctx, long min_nr, long nr,
+				struct raio_event *events, struct timespec *t)
+{
+	struct raio_io_u		*io_u;
+	struct timespec			start;
+	unsigned long long		usec = 0, elapsed;
+	int				i, r;
+	int				timeout = XIO_INFINITE;
+	int				have_timeout = 0;
+	int				actual_nr;
+
+	if ((ctx->npending == 0) &&
+	    (ctx->io_u_completed_nr == 0))
+		return 0;
+
+	if ((min_nr < 0) || (nr < min_nr))
+		return -EINVAL;
+
+	if (min_nr > ctx->npending)
+		min_nr = ctx->npending;
+
+	if (t)  {
+		if ((t->tv_sec != 0) || (t->tv_nsec != 0)) {
+			if (!fill_timespec(&start))
+				have_timeout = 1;
+			usec = (t->tv_sec * USECS_IN_SEC) +
+			       (t->tv_nsec / NSECS_IN_USEC);
+		}
+	}
+
+	r = 0;
+
+restart:
+	if ((ctx->io_u_completed_nr <  min_nr) ||
+	    (ctx->io_u_completed_nr == 0))  {
+		if (have_timeout) {
+			elapsed = ts_utime_since_now(&start);
+			timeout = (elapsed < usec) ?
+				  (usec - elapsed + 999) / 1000 : 0;
+		}
+		ctx->min_nr = (min_nr ? min_nr : 1);
+		xio_context_run_loop(ctx->loop, timeout);
+		ctx->min_nr = 0;
+
+		raio_files_reap(ctx);
+	}
+	actual_nr = ((nr - r < ctx->io_u_completed_nr) ?
+		     nr - r : ctx->io_u_completed_nr);
+
+	for (i = 0; i < actual_nr; i++) {
+		io_u = TAILQ_FIRST(&ctx->io_u_completed_list);
+		TAILQ_REMOVE(&ctx->io_u_completed_list, io_u, io_u_list);
+		ctx->io_u_completed_nr--;
+
+		/* a new file answers with its descriptor */
+		if (io_u->iocb->raio_lio_opcode == RAIO_CMD_OPEN_FILE)
+			io_u->iocb->raio_fildes	= io_u->res;
+
+		events[r].data		= io_u->iocb->data;
+		events[r].obj		= io_u->iocb;
+		events[r].res		= io_u->res;
+		events[r].res2		= io_u->res2;
+		events[r].handle	= uint64_from_ptr(io_u);
+
+		TAILQ_INSERT_TAIL(&ctx->io_u_queued_list, io_u, io_u_list);
+		ctx->io_u_queued_nr++;
+		r++;
+	}
+	ctx->npending -= actual_nr;
+
+	if (r >= min_nr)
+		return r;
+
+	if (have_timeout && ts_utime_since_now(&start) > usec)
+		return r;
+
+	goto restart;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_poll - spins on the connections until min_nr completions are in or  */
+/* the budget is spent							     */
+/*---------------------------------------------------------------------------*/
+static int raio_poll(raio_context_t ctx, long min_nr, long nr)
+{
+	struct raio_session_data	*session_data = ctx->session_data;
+	struct raio_queue		*queue;
+	struct timespec			start;
+	int				i;
+
+	if (fill_timespec(&start))
+		return 0;
+
+	/* answers land in the completion queue without stopping any loop */
+	session_data->min_nr = 0;
+	do {
+		for (i = 0; i < session_data->queues_nr; i++) {
+			queue = &session_data->queues[i];
+			if (!queue->conn || !queue->established)
+				continue;
+			xio_poll_completions(queue->conn, 0,
+					     nr - ctx->io_u_completed_nr,
+					     NULL);
+		}
+		if (ctx->io_u_completed_nr >= min_nr)
+			return 1;
+	} while (!session_data->disconnected &&
+		 ts_utime_since_now(&start) < (unsigned long long)ctx->poll_us);
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* rsd_getevents							     */
 /*---------------------------------------------------------------------------*/
@@ -817,6 +1787,8 @@ __RAIO_PUBLIC int raio_getevents(raio_context_t ctx, long min_nr, long nr,
 	int				actual_nr;
 
 	session_data = ctx->session_data;
+	if (session_data == NULL)
+		return raio_files_getevents(ctx, min_nr, nr, events, t);
 
 	if ((session_data->npending == 0) &&
 	    (ctx->io_u_completed_nr == 0))
@@ -840,17 +1812,14 @@ __RAIO_PUBLIC int raio_getevents(raio_context_t ctx, long min_nr, long nr,
 restart:
 	if ((ctx->io_u_completed_nr <  min_nr) ||
 	    (ctx->io_u_completed_nr == 0))  {
-#ifdef POLL_COMPLETIONS
-		session_data->min_nr = 0;
-		xio_poll_completions(session_data->conn,
-				     (min_nr ? min_nr : 1),
-				     nr , NULL);
-#else
-		session_data->min_nr  = (min_nr ? min_nr : 1);
-		xio_context_run_loop(session_data->ctx, XIO_INFINITE);
+		/* the loop is left for what polling did not bring in */
+		if (!ctx->poll_us || session_data->disconnected ||
+		    !raio_poll(ctx, (min_nr ? min_nr : 1), nr)) {
+			session_data->min_nr  = (min_nr ? min_nr : 1);
+			xio_context_run_loop(session_data->ctx, XIO_INFINITE);
+		}
 		if (session_data->disconnected)
 			return -ECONNRESET;
-#endif
 	}
 	actual_nr = ((nr < ctx->io_u_completed_nr) ?
 		     nr : ctx->io_u_completed_nr);
@@ -863,9 +1832,11 @@ restart:
 		ctx->io_u_completed_nr--;
 
 		io_u->iocb->raio_fildes	= session_data->key;
-		sglist = vmsg_sglist(&io_u->rsp->in);
+		if (io_u->iocb->raio_lio_opcode == RAIO_CMD_PREAD) {
+			sglist = vmsg_sglist(&io_u->rsp->in);
 
-		io_u->iocb->u.c.buf	= sglist[0].iov_base;
+			io_u->iocb->u.c.buf = sglist[io_u->extent].iov_base;
+		}
 
 		events[i].data		= io_u->iocb->data;
 		events[i].obj		= io_u->iocb;
@@ -893,6 +1864,20 @@ restart:
 	goto restart;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_set_poll							     */
+/*---------------------------------------------------------------------------*/
+__RAIO_PUBLIC int raio_set_poll(raio_context_t ctx, int spin_us)
+{
+	if (!ctx || !ctx->session_data || spin_us < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	ctx->poll_us = spin_us;
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_release								     */
 /*---------------------------------------------------------------------------*/
@@ -901,6 +1886,7 @@ __RAIO_PUBLIC int raio_release(raio_context_t ctx, long nr,
 {
 	int				i;
 	struct raio_io_u		*io_u;
+	struct raio_io_u		*leader;
 
 	for (i = 0; i < nr; i++) {
 		io_u = ptr_from_int64(events[i].handle);
@@ -908,14 +1894,106 @@ __RAIO_PUBLIC int raio_release(raio_context_t ctx, long nr,
 			continue;
 		TAILQ_REMOVE(&ctx->io_u_queued_list, io_u, io_u_list);
 		ctx->io_u_queued_nr--;
-		xio_release_response(io_u->rsp);
-		TAILQ_INSERT_TAIL(&ctx->io_u_free_list, io_u, io_u_list);
+
+		/* the response is shared by all the iocbs it carried */
+		leader = io_u->leader;
+		if (io_u != leader) {
+			TAILQ_INSERT_TAIL(&ctx->io_u_free_list, io_u,
+					  io_u_list);
+			ctx->io_u_free_nr++;
+		}
+		if (--leader->refs)
+			continue;
+		/* a files context answer was released on arrival */
+		if (leader->rsp)
+			xio_release_response(leader->rsp);
+		TAILQ_INSERT_TAIL(&ctx->io_u_free_list, leader, io_u_list);
 		ctx->io_u_free_nr++;
 	}
 
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_open_batch							     */
+/*---------------------------------------------------------------------------*/
+__RAIO_PUBLIC int raio_open_batch(const struct sockaddr *addr,
+				  socklen_t addrlen, int nr,
+				  const char *pathnames[], int flags, int fds[],
+				  int depth)
+{
+	raio_context_t			ctx;
+	struct raio_iocb		*iocbs;
+	struct raio_iocb		**ios;
+	struct raio_event		*events;
+	int				window;
+	int				submitted = 0, completed = 0;
+	int				opened = 0;
+	int				i, r;
+
+	if (nr <= 0 || depth < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	/* every open in flight holds a session and a connection on the
+	 * server, keep the window small unless the caller asks otherwise
+	 */
+	window = depth ? depth : RAIO_DEF_OPENS;
+	if (window > RAIO_MAX_OPENS)
+		window = RAIO_MAX_OPENS;
+	if (window > nr)
+		window = nr;
+
+	iocbs = calloc(nr, sizeof(*iocbs));
+	ios = calloc(nr, sizeof(*ios));
+	events = calloc(window, sizeof(*events));
+	if (!iocbs || !ios || !events) {
+		errno = ENOMEM;
+		opened = -1;
+		goto cleanup;
+	}
+
+	if (raio_setup_files(window, &ctx)) {
+		opened = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < nr; i++) {
+		raio_prep_open(&iocbs[i], addr, addrlen, pathnames[i], flags);
+		iocbs[i].data = &fds[i];
+		ios[i] = &iocbs[i];
+		fds[i] = -EIO;
+	}
+
+	/* keep the window full, every open is a connection of its own */
+	while (completed < nr) {
+		if (submitted < nr) {
+			r = raio_submit(ctx, nr - submitted, &ios[submitted]);
+			if (r > 0)
+				submitted += r;
+		}
+		r = raio_getevents(ctx, 1, window, events, NULL);
+		if (r <= 0)
+			break;
+
+		for (i = 0; i < r; i++) {
+			*(int *)events[i].data = (int)events[i].res;
+			if ((int)events[i].res >= 0)
+				opened++;
+		}
+		completed += r;
+		raio_release(ctx, r, events);
+	}
+	raio_destroy(ctx);
+
+cleanup:
+	free(events);
+	free(ios);
+	free(iocbs);
+
+	return opened;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_reg_mr								     */
 /*---------------------------------------------------------------------------*/
@@ -75,6 +75,9 @@ struct backingstore_template *get_backingstore_template(const char *name)
 
 extern void raio_bs_aio_constructor(void);
 extern void raio_bs_null_constructor(void);
+#ifdef HAVE_LINUX_IO_URING_H
+extern void raio_bs_uring_constructor(void);
+#endif
 
 /*---------------------------------------------------------------------------*/
 /* register_backingstores						     */
@@ -84,6 +87,9 @@ static void register_backingstores(void)
 	if (SLIST_EMPTY(&bst_list)) {
 		raio_bs_aio_constructor();
 		raio_bs_null_constructor();
+#ifdef HAVE_LINUX_IO_URING_H
+		raio_bs_uring_constructor();
+#endif
 	}
 }
 
@@ -169,4 +175,22 @@ int raio_bs_cmd_submit(struct raio_bs *dev, struct raio_io_cmd *cmd)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_bs_cmd_flush							     */
+/*---------------------------------------------------------------------------*/
+void raio_bs_cmd_flush(struct raio_bs *dev)
+{
+	if (dev->bst->bs_cmd_flush)
+		dev->bst->bs_cmd_flush(dev);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_register_buf							     */
+/*---------------------------------------------------------------------------*/
+int raio_bs_register_buf(struct raio_bs *dev, void *addr, size_t len)
+{
+	if (dev->bst->bs_register_buf)
+		return dev->bst->bs_register_buf(dev, addr, len);
 
+	return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <sys/queue.h>
 #include <stdint.h>
+#include <stddef.h>
 
 struct raio_io_cmd;
 struct raio_bs;
@@ -46,6 +47,8 @@ struct backingstore_template {
 	int (*bs_init)(struct raio_bs *dev);
 	void (*bs_exit)(struct raio_bs *dev);
 	int (*bs_cmd_submit)(struct raio_bs *dev, struct raio_io_cmd *cmd);
+	int (*bs_register_buf)(struct raio_bs *dev, void *addr, size_t len);
+	void (*bs_cmd_flush)(struct raio_bs *dev);
 
 	SLIST_ENTRY(backingstore_template)   backingstore_siblings;
 };
@@ -83,6 +86,16 @@ void  raio_bs_close(struct raio_bs *dev);
 /*---------------------------------------------------------------------------*/
 int raio_bs_cmd_submit(struct raio_bs *dev, struct raio_io_cmd *cmd);
 
+/*---------------------------------------------------------------------------*/
+/* raio_bs_cmd_flush - submits what waits for the end of the batch	     */
+/*---------------------------------------------------------------------------*/
+void raio_bs_cmd_flush(struct raio_bs *dev);
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_register_buf - optional, hints the I/O buffers region	     */
+/*---------------------------------------------------------------------------*/
+int raio_bs_register_buf(struct raio_bs *dev, void *addr, size_t len);
+
 /*---------------------------------------------------------------------------*/
 /* register_backingstore_template					     */
 /*---------------------------------------------------------------------------*/
@@ -375,6 +375,19 @@ static int raio_bs_aio_cmd_submit(struct raio_bs *dev, struct raio_io_cmd *cmd)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_bs_aio_cmd_flush						     */
+/*---------------------------------------------------------------------------*/
+static void raio_bs_aio_cmd_flush(struct raio_bs *dev)
+{
+	struct raio_bs_aio_info	*info = dev->dd;
+
+	if (info->nwaiting) {
+		raio_aio_submit_dev_batch(info);
+		raio_bs_aio_process_events(dev);
+	}
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_bs_aio_exit                                                           */
 /*---------------------------------------------------------------------------*/
@@ -398,6 +411,7 @@ static struct backingstore_template raio_aio_bst = {
 	.bs_open		= raio_bs_aio_open,
 	.bs_close		= raio_bs_aio_close,
 	.bs_cmd_submit		= raio_bs_aio_cmd_submit,
+	.bs_cmd_flush		= raio_bs_aio_cmd_flush,
 };
 
 /*
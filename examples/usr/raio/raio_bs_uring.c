@@ -0,0 +1,630 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+
+#include "raio_bs.h"
+#include "libxio.h"
+#include "libraio.h"
+
+/*---------------------------------------------------------------------------*/
+/* preprocessor directives                                                   */
+/*---------------------------------------------------------------------------*/
+#define URING_MAX_IODEPTH	128
+
+#define uring_load_acquire(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define uring_store_release(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct raio_uring_sq {
+	unsigned			*khead;
+	unsigned			*ktail;
+	unsigned			*kring_mask;
+	unsigned			*array;
+	struct io_uring_sqe		*sqes;
+	unsigned			tail;	/* local, published on submit */
+	int				pad;
+};
+
+struct raio_uring_cq {
+	unsigned			*khead;
+	unsigned			*ktail;
+	unsigned			*kring_mask;
+	struct io_uring_cqe		*cqes;
+};
+
+struct raio_bs_uring_info {
+	struct raio_bs			*dev;
+	int				ring_fd;
+	int				evt_fd;
+
+	struct raio_uring_sq		sq;
+	struct raio_uring_cq		cq;
+	void				*sq_ring;
+	void				*cq_ring;
+	size_t				sq_ring_sz;
+	size_t				cq_ring_sz;
+	size_t				sqes_sz;
+
+	uint32_t			iodepth;
+	uint32_t			npending;	/* owned by the kernel */
+	uint32_t			nqueued;	/* in the sq, unsubmitted */
+	uint32_t			nwaiting;	/* no room in the sq */
+	TAILQ_HEAD(, raio_io_cmd)	cmd_wait_list;
+
+	/* the response buffers, registered as fixed buffer 0 */
+	char				*fixed_addr;
+	size_t				fixed_len;
+};
+
+/*---------------------------------------------------------------------------*/
+/* io_uring system calls, no liburing dependency			     */
+/*---------------------------------------------------------------------------*/
+static inline int raio_uring_setup(unsigned entries,
+				   struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int raio_uring_enter(int fd, unsigned to_submit,
+				   unsigned min_complete, unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static inline int raio_uring_register(int fd, unsigned opcode,
+				      void *arg, unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_map_rings							     */
+/*---------------------------------------------------------------------------*/
+static int raio_uring_map_rings(struct raio_bs_uring_info *info,
+				struct io_uring_params *p)
+{
+	char	*sq_ring, *cq_ring;
+
+	info->sq_ring_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	info->cq_ring_sz = p->cq_off.cqes +
+			   p->cq_entries * sizeof(struct io_uring_cqe);
+	info->sqes_sz	 = p->sq_entries * sizeof(struct io_uring_sqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (info->cq_ring_sz > info->sq_ring_sz)
+			info->sq_ring_sz = info->cq_ring_sz;
+		info->cq_ring_sz = info->sq_ring_sz;
+	}
+
+	info->sq_ring = mmap(NULL, info->sq_ring_sz, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, info->ring_fd,
+			     IORING_OFF_SQ_RING);
+	if (info->sq_ring == MAP_FAILED)
+		goto cleanup;
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		info->cq_ring = info->sq_ring;
+	} else {
+		info->cq_ring = mmap(NULL, info->cq_ring_sz,
+				     PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, info->ring_fd,
+				     IORING_OFF_CQ_RING);
+		if (info->cq_ring == MAP_FAILED)
+			goto cleanup_sq;
+	}
+
+	info->sq.sqes = mmap(NULL, info->sqes_sz, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, info->ring_fd,
+			     IORING_OFF_SQES);
+	if (info->sq.sqes == MAP_FAILED)
+		goto cleanup_cq;
+
+	sq_ring = info->sq_ring;
+	info->sq.khead		= (unsigned *)(sq_ring + p->sq_off.head);
+	info->sq.ktail		= (unsigned *)(sq_ring + p->sq_off.tail);
+	info->sq.kring_mask	= (unsigned *)(sq_ring + p->sq_off.ring_mask);
+	info->sq.array		= (unsigned *)(sq_ring + p->sq_off.array);
+	info->sq.tail		= *info->sq.ktail;
+
+	cq_ring = info->cq_ring;
+	info->cq.khead		= (unsigned *)(cq_ring + p->cq_off.head);
+	info->cq.ktail		= (unsigned *)(cq_ring + p->cq_off.tail);
+	info->cq.kring_mask	= (unsigned *)(cq_ring + p->cq_off.ring_mask);
+	info->cq.cqes		= (struct io_uring_cqe *)
+				  (cq_ring + p->cq_off.cqes);
+
+	return 0;
+
+cleanup_cq:
+	if (info->cq_ring != info->sq_ring)
+		munmap(info->cq_ring, info->cq_ring_sz);
+cleanup_sq:
+	munmap(info->sq_ring, info->sq_ring_sz);
+cleanup:
+	info->sq_ring = NULL;
+	info->cq_ring = NULL;
+	fprintf(stderr, "failed to map io_uring rings, %m\n");
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_unmap_rings						     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_unmap_rings(struct raio_bs_uring_info *info)
+{
+	if (!info->sq_ring)
+		return;
+
+	munmap(info->sq.sqes, info->sqes_sz);
+	if (info->cq_ring != info->sq_ring)
+		munmap(info->cq_ring, info->cq_ring_sz);
+	munmap(info->sq_ring, info->sq_ring_sz);
+	info->sq_ring = NULL;
+	info->cq_ring = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_is_fixed							     */
+/*---------------------------------------------------------------------------*/
+static inline int raio_uring_is_fixed(struct raio_bs_uring_info *info,
+				      struct raio_io_cmd *cmd)
+{
+	char *buf = cmd->buf;
+
+	return info->fixed_addr && buf >= info->fixed_addr &&
+	       buf + cmd->bcount <= info->fixed_addr + info->fixed_len;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_sqe_prep							     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_sqe_prep(struct raio_bs_uring_info *info,
+				struct raio_io_cmd *cmd)
+{
+	unsigned		idx = info->sq.tail & *info->sq.kring_mask;
+	struct io_uring_sqe	*sqe = &info->sq.sqes[idx];
+	int			fixed = raio_uring_is_fixed(info, cmd);
+
+	memset(sqe, 0, sizeof(*sqe));
+	if (cmd->op == RAIO_CMD_PREAD)
+		sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	else
+		sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	sqe->fd		= cmd->fd;
+	sqe->addr	= (unsigned long)cmd->buf;
+	sqe->len	= cmd->bcount;
+	sqe->off	= cmd->offset;
+	sqe->buf_index	= 0;
+	sqe->user_data	= (unsigned long)cmd;
+
+	info->sq.array[idx] = idx;
+	info->sq.tail++;
+	info->nqueued++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_fill_sq - moves waiting commands into free sq entries	     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_fill_sq(struct raio_bs_uring_info *info)
+{
+	struct raio_io_cmd *cmd;
+
+	while (info->nwaiting &&
+	       info->npending + info->nqueued < info->iodepth) {
+		cmd = TAILQ_FIRST(&info->cmd_wait_list);
+		TAILQ_REMOVE(&info->cmd_wait_list, cmd, raio_list);
+		info->nwaiting--;
+		raio_uring_sqe_prep(info, cmd);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_complete_one						     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_complete_one(struct raio_io_cmd *cmd, int res)
+{
+	cmd->res  = res;
+	cmd->res2 = 0;
+	if (res != cmd->bcount) {
+		if (res < 0) {
+			fprintf(stderr, "completion error: %s - ",
+				strerror(-res));
+			fprintf(stderr, "fd:%d, buf:%p, count:%lu, " \
+				"offset:%ld\n",
+				cmd->fd, cmd->buf, cmd->bcount,
+				cmd->offset);
+		} else  {
+			fprintf(stderr, "fd:%d, buf:%p, count:%lu, " \
+				"offset:%ld\n",
+				cmd->fd, cmd->buf, cmd->bcount,
+				cmd->offset);
+			fprintf(stderr, "fd:%d missing bytes got %d\n",
+				cmd->fd, res);
+		}
+	}
+
+	if (cmd->comp_cb)
+		cmd->comp_cb(cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_fail_queued - unpublishes the queued sqes and fails their cmds */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_fail_queued(struct raio_bs_uring_info *info, int err)
+{
+	TAILQ_HEAD(, raio_io_cmd)	failed_list;
+	struct io_uring_sqe		*sqe;
+	struct raio_io_cmd		*cmd;
+	unsigned			tail;
+
+	/* the kernel consumed none of them - take the entries back before
+	 * the callbacks queue new ones over them
+	 */
+	TAILQ_INIT(&failed_list);
+	for (tail = info->sq.tail - info->nqueued; tail != info->sq.tail;
+	     tail++) {
+		sqe = &info->sq.sqes[info->sq.array[tail &
+						    *info->sq.kring_mask]];
+		cmd = (struct raio_io_cmd *)(unsigned long)sqe->user_data;
+		TAILQ_INSERT_TAIL(&failed_list, cmd, raio_list);
+	}
+	info->sq.tail -= info->nqueued;
+	info->nqueued  = 0;
+	uring_store_release(info->sq.ktail, info->sq.tail);
+
+	while (!TAILQ_EMPTY(&failed_list)) {
+		cmd = TAILQ_FIRST(&failed_list);
+		TAILQ_REMOVE(&failed_list, cmd, raio_list);
+		raio_uring_complete_one(cmd, -err);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_submit_batch - one system call for all the queued sqes	     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_submit_batch(struct raio_bs_uring_info *info)
+{
+	int nsuccess, err;
+
+	if (!info->nqueued)
+		return;
+
+	uring_store_release(info->sq.ktail, info->sq.tail);
+
+retry_enter:
+	nsuccess = raio_uring_enter(info->ring_fd, info->nqueued, 0, 0);
+	if (nsuccess < 0) {
+		if (errno == EINTR)
+			goto retry_enter;
+		if (errno == EAGAIN || errno == EBUSY) {
+			/* the sqes stay published, the next batch or
+			 * completion retries them
+			 */
+			fprintf(stderr, "delayed submit %u\n", info->nqueued);
+			return;
+		}
+		err = errno;
+		fprintf(stderr, "failed to submit %u cmds, err: %d - %m\n",
+			info->nqueued, err);
+		raio_uring_fail_queued(info, err);
+		return;
+	}
+
+	info->npending += nsuccess;
+	info->nqueued  -= nsuccess;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_reap_cq							     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_reap_cq(struct raio_bs_uring_info *info)
+{
+	struct io_uring_cqe	*cqe;
+	struct raio_io_cmd	*cmd;
+	unsigned		head, tail;
+	int			res;
+
+	head = *info->cq.khead;
+	tail = uring_load_acquire(info->cq.ktail);
+	while (head != tail) {
+		cqe = &info->cq.cqes[head & *info->cq.kring_mask];
+		cmd = (struct raio_io_cmd *)(unsigned long)cqe->user_data;
+		res = cqe->res;
+
+		/* hand the entry back before the callback may submit */
+		uring_store_release(info->cq.khead, ++head);
+		info->npending--;
+
+		raio_uring_complete_one(cmd, res);
+
+		if (head == tail)
+			tail = uring_load_acquire(info->cq.ktail);
+	}
+
+	if (info->nwaiting || info->nqueued) {
+		raio_uring_fill_sq(info);
+		raio_uring_submit_batch(info);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_uring_get_completions						     */
+/*---------------------------------------------------------------------------*/
+static void raio_uring_get_completions(int fd, int events, void *data)
+{
+	struct raio_bs_uring_info	*info = data;
+	int				ret;
+	eventfd_t			val;
+
+retry_read:
+	ret = eventfd_read(info->evt_fd, &val);
+	if (ret < 0) {
+		if (errno == EINTR)
+			goto retry_read;
+		/* EAGAIN: already reaped inline after a submit */
+		if (errno != EAGAIN)
+			fprintf(stderr,
+				"failed to read io_uring completions, %m\n");
+	}
+	if (info->npending)
+		raio_uring_reap_cq(info);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_init							     */
+/*---------------------------------------------------------------------------*/
+static int raio_bs_uring_init(struct raio_bs *dev)
+{
+	struct raio_bs_uring_info *info = dev->dd;
+
+	info->dev	= dev;
+	info->ring_fd	= -1;
+	info->evt_fd	= -1;
+
+	TAILQ_INIT(&info->cmd_wait_list);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_open							     */
+/*---------------------------------------------------------------------------*/
+static int raio_bs_uring_open(struct raio_bs *dev, int fd)
+{
+	struct raio_bs_uring_info	*info = dev->dd;
+	struct io_uring_params		params;
+	int				ret, afd;
+
+	info->iodepth = URING_MAX_IODEPTH;
+
+	memset(&params, 0, sizeof(params));
+	info->ring_fd = raio_uring_setup(info->iodepth, &params);
+	if (info->ring_fd < 0) {
+		fprintf(stderr, "failed to create io_uring, %m\n");
+		return -1;
+	}
+	ret = raio_uring_map_rings(info, &params);
+	if (ret)
+		goto close_ring;
+
+	afd = eventfd(0, EFD_NONBLOCK);
+	if (afd < 0) {
+		fprintf(stderr, "failed to create eventfd, %m\n");
+		ret = afd;
+		goto unmap_rings;
+	}
+
+	/* completions wake the xio event loop through the eventfd */
+	ret = raio_uring_register(info->ring_fd, IORING_REGISTER_EVENTFD,
+				  &afd, 1);
+	if (ret) {
+		fprintf(stderr, "failed to register eventfd, %m\n");
+		goto close_eventfd;
+	}
+
+	ret = xio_context_add_ev_handler(dev->ctx,
+					 afd,
+					 XIO_POLLIN,
+					 raio_uring_get_completions, info);
+	if (ret)
+		goto close_eventfd;
+	info->evt_fd = afd;
+
+	return 0;
+
+close_eventfd:
+	close(afd);
+unmap_rings:
+	raio_uring_unmap_rings(info);
+close_ring:
+	close(info->ring_fd);
+	info->ring_fd = -1;
+
+	return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_close							     */
+/*---------------------------------------------------------------------------*/
+static inline void raio_bs_uring_close(struct raio_bs *dev)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_register_buf						     */
+/*---------------------------------------------------------------------------*/
+static int raio_bs_uring_register_buf(struct raio_bs *dev, void *addr,
+				      size_t len)
+{
+	struct raio_bs_uring_info	*info = dev->dd;
+	struct iovec			iov = {
+		.iov_base	= addr,
+		.iov_len	= len,
+	};
+
+	/* pinned once here, reads into the responses then skip the per
+	 * I/O page mapping
+	 */
+	if (raio_uring_register(info->ring_fd, IORING_REGISTER_BUFFERS,
+				&iov, 1)) {
+		fprintf(stderr, "io_uring fixed buffers unavailable, %m\n");
+		return -1;
+	}
+	info->fixed_addr = addr;
+	info->fixed_len	 = len;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_cmd_submit						     */
+/*---------------------------------------------------------------------------*/
+static int raio_bs_uring_cmd_submit(struct raio_bs *dev,
+				    struct raio_io_cmd *cmd)
+{
+	struct raio_bs_uring_info	*info = dev->dd;
+
+	if (!info->nwaiting &&
+	    info->npending + info->nqueued < info->iodepth) {
+		raio_uring_sqe_prep(info, cmd);
+	} else {
+		TAILQ_INSERT_TAIL(&info->cmd_wait_list, cmd, raio_list);
+		info->nwaiting++;
+	}
+
+	if ((info->npending + info->nqueued == info->iodepth) ||
+	    (cmd->is_last_in_batch)) {
+		/* a failed submit completes the queued cmds with the error */
+		raio_uring_submit_batch(info);
+		/* cached data completes inline, do not wait for a wakeup */
+		if (info->npending)
+			raio_uring_reap_cq(info);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_cmd_flush						     */
+/*---------------------------------------------------------------------------*/
+static void raio_bs_uring_cmd_flush(struct raio_bs *dev)
+{
+	struct raio_bs_uring_info	*info = dev->dd;
+
+	if (!info->nqueued)
+		return;
+
+	raio_uring_submit_batch(info);
+	if (info->npending)
+		raio_uring_reap_cq(info);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_exit							     */
+/*---------------------------------------------------------------------------*/
+static void raio_bs_uring_exit(struct raio_bs *dev)
+{
+	struct raio_bs_uring_info *info = dev->dd;
+	unsigned		  head, tail;
+
+	if (info->ring_fd < 0)
+		return;
+
+	/* like io_destroy, wait for reads still landing in buffers that
+	 * outlive the ring. their completions are dropped
+	 */
+	while (info->npending) {
+		if (raio_uring_enter(info->ring_fd, 0, 1,
+				     IORING_ENTER_GETEVENTS) < 0 &&
+		    errno != EINTR)
+			break;
+		head = *info->cq.khead;
+		tail = uring_load_acquire(info->cq.ktail);
+		info->npending -= tail - head;
+		uring_store_release(info->cq.khead, tail);
+	}
+
+	xio_context_del_ev_handler(dev->ctx, info->evt_fd);
+	close(info->evt_fd);
+	if (info->fixed_addr)
+		raio_uring_register(info->ring_fd, IORING_UNREGISTER_BUFFERS,
+				    NULL, 0);
+	raio_uring_unmap_rings(info);
+	close(info->ring_fd);
+	info->ring_fd = -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* struct raio_uring_bst						     */
+/*---------------------------------------------------------------------------*/
+static struct backingstore_template raio_uring_bst = {
+	.bs_name		= "uring",
+	.bs_datasize		= sizeof(struct raio_bs_uring_info),
+	.bs_init		= raio_bs_uring_init,
+	.bs_exit		= raio_bs_uring_exit,
+	.bs_open		= raio_bs_uring_open,
+	.bs_close		= raio_bs_uring_close,
+	.bs_cmd_submit		= raio_bs_uring_cmd_submit,
+	.bs_register_buf	= raio_bs_uring_register_buf,
+	.bs_cmd_flush		= raio_bs_uring_cmd_flush,
+};
+
+/*---------------------------------------------------------------------------*/
+/* raio_bs_uring_constructor						     */
+/*---------------------------------------------------------------------------*/
+void raio_bs_uring_constructor(void)
+{
+	register_backingstore_template(&raio_uring_bst);
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
@@ -0,0 +1,624 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/queue.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "libxio.h"
+
+#include "raio_bs.h"
+#include "raio_cache.h"
+#include "libraio.h"
+
+/*---------------------------------------------------------------------------*/
+/* preprocessor macros							     */
+/*---------------------------------------------------------------------------*/
+#define min(a, b)	(((a) < (b)) ? (a) : (b))
+
+enum raio_cache_block_state {
+	RAIO_CACHE_BLOCK_FREE,
+	RAIO_CACHE_BLOCK_FILLING,
+	RAIO_CACHE_BLOCK_VALID
+};
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+
+/* shared by all the shards, a write through any of them bumps gen */
+struct raio_cache_inode {
+	dev_t				dev;
+	ino_t				ino;
+	uint64_t			gen;
+	int				refcnt;
+	int				pad;
+
+	LIST_ENTRY(raio_cache_inode)	inode_list;
+};
+
+struct raio_cache_block {
+	struct raio_cache		*cache;
+	struct raio_cache_inode		*inode;
+	struct raio_cache_file		*owner;		/* while filling */
+	char				*buf;
+	uint64_t			blkno;
+	uint64_t			gen;
+	uint32_t			len;
+	int				state;
+	int				refs;		/* responses in flight */
+	int				referenced;	/* clock bit */
+	int				hashed;
+	int				pad;
+	struct raio_io_cmd		fill;
+
+	TAILQ_HEAD(, raio_io_cmd)	waiters;
+	LIST_ENTRY(raio_cache_block)	hash_list;
+};
+
+LIST_HEAD(raio_cache_bucket, raio_cache_block);
+
+struct raio_cache {
+	struct xio_buf			*xbuf;
+	struct raio_cache_block		*blocks;
+	struct raio_cache_bucket	*hash;
+	uint32_t			nblocks;
+	uint32_t			hand;
+	uint32_t			hash_mask;
+	int				pad;
+	struct raio_cache_stats		stats;
+};
+
+struct raio_cache_file {
+	struct raio_cache		*cache;
+	struct raio_bs			*dev;
+	struct raio_cache_inode		*inode;
+	int				fd;
+	int				fills_queued;	/* not yet flushed */
+	uint64_t			fsize;
+	uint64_t			next_blkno;
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static LIST_HEAD(, raio_cache_inode) inodes = LIST_HEAD_INITIALIZER(inodes);
+static pthread_mutex_t inodes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_inode_get							     */
+/*---------------------------------------------------------------------------*/
+static struct raio_cache_inode *raio_cache_inode_get(dev_t dev, ino_t ino)
+{
+	struct raio_cache_inode *inode;
+
+	pthread_mutex_lock(&inodes_lock);
+	LIST_FOREACH(inode, &inodes, inode_list) {
+		if (inode->dev == dev && inode->ino == ino)
+			break;
+	}
+	if (!inode) {
+		inode = calloc(1, sizeof(*inode));
+		if (inode) {
+			inode->dev = dev;
+			inode->ino = ino;
+			LIST_INSERT_HEAD(&inodes, inode, inode_list);
+		}
+	}
+	if (inode)
+		inode->refcnt++;
+	pthread_mutex_unlock(&inodes_lock);
+
+	return inode;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_inode_put							     */
+/*---------------------------------------------------------------------------*/
+static void raio_cache_inode_put(struct raio_cache_inode *inode)
+{
+	pthread_mutex_lock(&inodes_lock);
+	if (--inode->refcnt == 0) {
+		LIST_REMOVE(inode, inode_list);
+		free(inode);
+	}
+	pthread_mutex_unlock(&inodes_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_inode_gen							     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t raio_cache_inode_gen(struct raio_cache_inode *inode)
+{
+	return __atomic_load_n(&inode->gen, __ATOMIC_ACQUIRE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_bucket							     */
+/*---------------------------------------------------------------------------*/
+static inline struct raio_cache_bucket *raio_cache_bucket(
+					struct raio_cache *cache,
+					struct raio_cache_inode *inode,
+					uint64_t blkno)
+{
+	uint64_t key = ((uintptr_t)inode >> 4) ^ blkno;
+
+	key *= 0x9e3779b97f4a7c15ULL;
+
+	return &cache->hash[(key >> 32) & cache->hash_mask];
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_lookup							     */
+/*---------------------------------------------------------------------------*/
+static struct raio_cache_block *raio_cache_lookup(struct raio_cache *cache,
+						  struct raio_cache_inode *inode,
+						  uint64_t blkno)
+{
+	struct raio_cache_block *blk;
+
+	LIST_FOREACH(blk, raio_cache_bucket(cache, inode, blkno), hash_list) {
+		if (blk->inode == inode && blk->blkno == blkno)
+			return blk;
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_block_drop - unhashes the block, in flight responses keep	     */
+/* its buffer until they are put					     */
+/*---------------------------------------------------------------------------*/
+static void raio_cache_block_drop(struct raio_cache_block *blk)
+{
+	if (blk->hashed) {
+		LIST_REMOVE(blk, hash_list);
+		blk->hashed = 0;
+	}
+	if (blk->inode) {
+		raio_cache_inode_put(blk->inode);
+		blk->inode = NULL;
+	}
+	blk->owner	= NULL;
+	blk->state	= RAIO_CACHE_BLOCK_FREE;
+	blk->referenced	= 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_evict - CLOCK, skips blocks that are filling or being sent     */
+/*---------------------------------------------------------------------------*/
+static struct raio_cache_block *raio_cache_evict(struct raio_cache *cache)
+{
+	struct raio_cache_block *blk;
+	uint32_t		i;
+
+	for (i = 0; i < 2*cache->nblocks; i++) {
+		blk = &cache->blocks[cache->hand];
+		cache->hand = (cache->hand + 1) % cache->nblocks;
+
+		if (blk->refs || blk->state == RAIO_CACHE_BLOCK_FILLING)
+			continue;
+		if (blk->state == RAIO_CACHE_BLOCK_FREE)
+			return blk;
+		if (blk->referenced) {
+			blk->referenced = 0;
+			continue;
+		}
+		raio_cache_block_drop(blk);
+		cache->stats.evictions++;
+		return blk;
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_serve - points cmd at the cached data and completes it	     */
+/*---------------------------------------------------------------------------*/
+static void raio_cache_serve(struct raio_cache_block *blk,
+			     struct raio_io_cmd *cmd)
+{
+	uint64_t off = cmd->offset - blk->blkno*RAIO_CACHE_BLOCK_SIZE;
+
+	cmd->buf	= blk->buf + off;
+	cmd->mr		= blk->cache->xbuf->mr;
+	cmd->res	= (off < blk->len) ? min(cmd->bcount, blk->len - off) : 0;
+	cmd->res2	= 0;
+
+	blk->refs++;
+	blk->referenced = 1;
+
+	cmd->comp_cb(cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_fill_comp							     */
+/*---------------------------------------------------------------------------*/
+static int raio_cache_fill_comp(struct raio_io_cmd *fill)
+{
+	struct raio_cache_block *blk = fill->user_context;
+	struct raio_io_cmd	*cmd;
+	int			keep = 1;
+
+	if (fill->res < 0) {
+		keep = 0;
+	} else {
+		if ((uint32_t)fill->res < blk->len) {
+			blk->len = fill->res;
+			keep = 0;
+		}
+		/* reads are served at full length, the tail reads as zeros */
+		memset(blk->buf + blk->len, 0,
+		       RAIO_CACHE_BLOCK_SIZE - blk->len);
+	}
+	/* written to while the fill was in flight */
+	if (blk->inode && blk->gen != raio_cache_inode_gen(blk->inode))
+		keep = 0;
+
+	blk->state = RAIO_CACHE_BLOCK_VALID;
+	blk->owner = NULL;
+
+	while (!TAILQ_EMPTY(&blk->waiters)) {
+		cmd = TAILQ_FIRST(&blk->waiters);
+		TAILQ_REMOVE(&blk->waiters, cmd, raio_list);
+		if (fill->res < 0) {
+			cmd->res  = fill->res;
+			cmd->res2 = fill->res2;
+			cmd->comp_cb(cmd);
+		} else {
+			raio_cache_serve(blk, cmd);
+		}
+	}
+	if (!keep)
+		raio_cache_block_drop(blk);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_fill - claims a block for blkno, submit it with		     */
+/* raio_cache_fill_submit once its waiters are queued			     */
+/*---------------------------------------------------------------------------*/
+static struct raio_cache_block *raio_cache_fill(struct raio_cache_file *file,
+						uint64_t blkno, uint64_t gen)
+{
+	struct raio_cache	*cache = file->cache;
+	struct raio_cache_block *blk;
+	uint64_t		offset = blkno*RAIO_CACHE_BLOCK_SIZE;
+
+	blk = raio_cache_evict(cache);
+	if (!blk)
+		return NULL;
+
+	/* the block keeps the inode, and its gen, past the file's close */
+	pthread_mutex_lock(&inodes_lock);
+	file->inode->refcnt++;
+	pthread_mutex_unlock(&inodes_lock);
+
+	blk->inode	= file->inode;
+	blk->owner	= file;
+	blk->blkno	= blkno;
+	blk->gen	= gen;
+	blk->len	= min(RAIO_CACHE_BLOCK_SIZE, file->fsize - offset);
+	blk->state	= RAIO_CACHE_BLOCK_FILLING;
+	blk->referenced	= 0;
+	TAILQ_INIT(&blk->waiters);
+
+	LIST_INSERT_HEAD(raio_cache_bucket(cache, blk->inode, blkno),
+			 blk, hash_list);
+	blk->hashed = 1;
+
+	memset(&blk->fill, 0, sizeof(blk->fill));
+	blk->fill.fd		= file->fd;
+	blk->fill.op		= RAIO_CMD_PREAD;
+	blk->fill.buf		= blk->buf;
+	blk->fill.bcount	= blk->len;
+	blk->fill.mr		= cache->xbuf->mr;
+	blk->fill.fsize		= file->fsize;
+	blk->fill.offset	= offset;
+	blk->fill.user_context	= blk;
+	blk->fill.comp_cb	= raio_cache_fill_comp;
+
+	return blk;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_fill_submit						     */
+/*---------------------------------------------------------------------------*/
+static void raio_cache_fill_submit(struct raio_cache_file *file,
+				   struct raio_cache_block *blk)
+{
+	int retval;
+
+	retval = raio_bs_cmd_submit(file->dev, &blk->fill);
+	if (retval) {
+		blk->fill.res = retval;
+		raio_cache_fill_comp(&blk->fill);
+		return;
+	}
+	file->fills_queued = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_readahead							     */
+/*---------------------------------------------------------------------------*/
+static void raio_cache_readahead(struct raio_cache_file *file,
+				 uint64_t blkno, uint64_t gen)
+{
+	struct raio_cache_block *blk;
+	uint64_t		last = blkno + RAIO_CACHE_READAHEAD;
+
+	for (blkno++; blkno <= last; blkno++) {
+		if (blkno*RAIO_CACHE_BLOCK_SIZE >= file->fsize)
+			break;
+		if (raio_cache_lookup(file->cache, file->inode, blkno))
+			continue;
+		blk = raio_cache_fill(file, blkno, gen);
+		if (!blk)
+			break;
+		file->cache->stats.readahead++;
+		raio_cache_fill_submit(file, blk);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_create							     */
+/*---------------------------------------------------------------------------*/
+struct raio_cache *raio_cache_create(size_t size)
+{
+	struct raio_cache	*cache;
+	uint32_t		i, nbuckets = 1;
+
+	if (size < RAIO_CACHE_BLOCK_SIZE)
+		return NULL;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->nblocks = size/RAIO_CACHE_BLOCK_SIZE;
+	while (nbuckets < cache->nblocks)
+		nbuckets <<= 1;
+	cache->hash_mask = nbuckets - 1;
+
+	cache->blocks = calloc(cache->nblocks, sizeof(*cache->blocks));
+	cache->hash = calloc(nbuckets, sizeof(*cache->hash));
+	/* registered once, responses are sent straight from the blocks */
+	cache->xbuf = xio_alloc((size_t)cache->nblocks*RAIO_CACHE_BLOCK_SIZE);
+	if (!cache->blocks || !cache->hash || !cache->xbuf) {
+		fprintf(stderr, "cache allocation failed, %zd bytes\n", size);
+		goto cleanup;
+	}
+
+	for (i = 0; i < nbuckets; i++)
+		LIST_INIT(&cache->hash[i]);
+
+	for (i = 0; i < cache->nblocks; i++) {
+		cache->blocks[i].cache	= cache;
+		cache->blocks[i].buf	= (char *)cache->xbuf->addr +
+					  (size_t)i*RAIO_CACHE_BLOCK_SIZE;
+		TAILQ_INIT(&cache->blocks[i].waiters);
+	}
+
+	return cache;
+
+cleanup:
+	if (cache->xbuf)
+		xio_free(&cache->xbuf);
+	free(cache->hash);
+	free(cache->blocks);
+	free(cache);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_destroy							     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_destroy(struct raio_cache *cache)
+{
+	uint32_t i;
+
+	for (i = 0; i < cache->nblocks; i++)
+		raio_cache_block_drop(&cache->blocks[i]);
+
+	xio_free(&cache->xbuf);
+	free(cache->hash);
+	free(cache->blocks);
+	free(cache);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_file_open							     */
+/*---------------------------------------------------------------------------*/
+struct raio_cache_file *raio_cache_file_open(struct raio_cache *cache,
+					     struct raio_bs *dev,
+					     int fd, uint64_t fsize)
+{
+	struct raio_cache_file	*file;
+	struct stat		stbuf;
+
+	/* the same image opened by many clients shares its blocks */
+	if (fstat(fd, &stbuf))
+		return NULL;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return NULL;
+
+	file->inode = raio_cache_inode_get(stbuf.st_dev, stbuf.st_ino);
+	if (!file->inode) {
+		free(file);
+		return NULL;
+	}
+	file->cache	 = cache;
+	file->dev	 = dev;
+	file->fd	 = fd;
+	file->fsize	 = fsize;
+	file->next_blkno = UINT64_MAX;
+
+	return file;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_file_close						     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_file_close(struct raio_cache_file *file)
+{
+	struct raio_cache	*cache = file->cache;
+	struct raio_cache_block *blk;
+	uint32_t		i;
+
+	/* fills still owned by the file will never complete */
+	for (i = 0; i < cache->nblocks; i++) {
+		blk = &cache->blocks[i];
+		if (blk->owner != file)
+			continue;
+		TAILQ_INIT(&blk->waiters);
+		raio_cache_block_drop(blk);
+	}
+	raio_cache_inode_put(file->inode);
+	free(file);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_read							     */
+/*---------------------------------------------------------------------------*/
+int raio_cache_read(struct raio_cache_file *file, struct raio_io_cmd *cmd)
+{
+	struct raio_cache	*cache = file->cache;
+	struct raio_cache_block *blk;
+	uint64_t		blkno, gen;
+	int			sequential;
+
+	cache->stats.lookups++;
+
+	/* only reads that fit in one block are cached */
+	blkno = cmd->offset/RAIO_CACHE_BLOCK_SIZE;
+	if (cmd->offset < 0 || cmd->bcount == 0 ||
+	    cmd->offset + cmd->bcount > file->fsize ||
+	    (cmd->offset + cmd->bcount - 1)/RAIO_CACHE_BLOCK_SIZE != blkno)
+		goto bypass;
+
+	gen = raio_cache_inode_gen(file->inode);
+	blk = raio_cache_lookup(cache, file->inode, blkno);
+	if (blk && blk->gen != gen) {
+		if (blk->state == RAIO_CACHE_BLOCK_FILLING)
+			goto bypass;
+		raio_cache_block_drop(blk);
+		blk = NULL;
+	}
+	/* another client's fill completes on its own backing store */
+	if (blk && blk->state == RAIO_CACHE_BLOCK_FILLING &&
+	    blk->owner != file)
+		goto bypass;
+
+	sequential = (blkno == file->next_blkno);
+	file->next_blkno = blkno + 1;
+
+	if (!blk) {
+		blk = raio_cache_fill(file, blkno, gen);
+		if (!blk)
+			goto bypass;
+		cache->stats.misses++;
+		/* queued first, the backing store may complete inline */
+		TAILQ_INSERT_TAIL(&blk->waiters, cmd, raio_list);
+		raio_cache_fill_submit(file, blk);
+	} else if (blk->state == RAIO_CACHE_BLOCK_FILLING) {
+		cache->stats.hits++;
+		TAILQ_INSERT_TAIL(&blk->waiters, cmd, raio_list);
+	} else {
+		cache->stats.hits++;
+		raio_cache_serve(blk, cmd);
+	}
+
+	if (sequential)
+		raio_cache_readahead(file, blkno, gen);
+
+	return 1;
+
+bypass:
+	cache->stats.bypassed++;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_file_flush						     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_file_flush(struct raio_cache_file *file)
+{
+	if (!file->fills_queued)
+		return;
+
+	file->fills_queued = 0;
+	raio_bs_cmd_flush(file->dev);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_write							     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_write(struct raio_cache_file *file)
+{
+	__atomic_add_fetch(&file->inode->gen, 1, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_put							     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_put(struct raio_cache *cache, void *buf)
+{
+	char	*base = cache->xbuf->addr;
+	size_t	off;
+
+	if ((char *)buf < base)
+		return;
+	off = (char *)buf - base;
+	if (off >= (size_t)cache->nblocks*RAIO_CACHE_BLOCK_SIZE)
+		return;
+
+	cache->blocks[off/RAIO_CACHE_BLOCK_SIZE].refs--;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_get_stats							     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_get_stats(struct raio_cache *cache,
+			  struct raio_cache_stats *stats)
+{
+	*stats = cache->stats;
+}
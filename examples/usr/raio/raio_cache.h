@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef RAIO_CACHE_H
+#define RAIO_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct raio_bs;
+struct raio_io_cmd;
+struct raio_cache;
+struct raio_cache_file;
+
+/*---------------------------------------------------------------------------*/
+/* preprocessor macros							     */
+/*---------------------------------------------------------------------------*/
+#define RAIO_CACHE_BLOCK_SIZE	(64*1024)
+#define RAIO_CACHE_READAHEAD	4	/* blocks, on sequential reads */
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct raio_cache_stats {
+	uint64_t			lookups;
+	uint64_t			hits;
+	uint64_t			misses;
+	uint64_t			bypassed;
+	uint64_t			readahead;
+	uint64_t			evictions;
+};
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_create - one shard, owned by the calling thread		     */
+/*---------------------------------------------------------------------------*/
+struct raio_cache *raio_cache_create(size_t size);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_destroy							     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_destroy(struct raio_cache *cache);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_file_open - fills of the file are issued to dev		     */
+/*---------------------------------------------------------------------------*/
+struct raio_cache_file *raio_cache_file_open(struct raio_cache *cache,
+					     struct raio_bs *dev,
+					     int fd, uint64_t fsize);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_file_close - after the backing store is closed		     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_file_close(struct raio_cache_file *file);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_read - returns 1 if the cache completes cmd, 0 to bypass it    */
+/*---------------------------------------------------------------------------*/
+int raio_cache_read(struct raio_cache_file *file, struct raio_io_cmd *cmd);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_file_flush - submits the fills the reads so far queued	     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_file_flush(struct raio_cache_file *file);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_write - invalidates the file, on submit and on completion      */
+/*---------------------------------------------------------------------------*/
+void raio_cache_write(struct raio_cache_file *file);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_put - releases a buffer a completed read was served from	     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_put(struct raio_cache *cache, void *buf);
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_get_stats							     */
+/*---------------------------------------------------------------------------*/
+void raio_cache_get_stats(struct raio_cache *cache,
+			  struct raio_cache_stats *stats);
+
+#endif  /* #define RAIO_CACHE_H */
@@ -68,6 +68,9 @@ static char		*server_addr;
 static uint16_t		server_port;
 static int		block_size;
 static int		loops;
+static int		queues = 1;
+static int		direct;
+static int		spin_us;
 
 struct raio_pool {
 	void		**stack_ptr;
@@ -164,7 +167,8 @@ static void usage(const char *argv0)
 	printf("\n");
 	printf("options:\n");
 	printf("%s -a <server_addr> -p <port> -f <file_path>  " \
-	       "-b <block_size> -l <loops>\n",
+	       "-b <block_size> -l <loops> [-q <queues>] [-d] " \
+	       "[-s <spin_usecs>]\n",
 	      argv0);
 
 	exit(0);
@@ -193,6 +197,9 @@ int parse_cmdline(int argc, char **argv)
 		{ .name = "file-path",	.has_arg = 1, .val = 'f'},
 		{ .name = "block-size",	.has_arg = 1, .val = 'b'},
 		{ .name = "loops",	.has_arg = 1, .val = 'l'},
+		{ .name = "queues",	.has_arg = 1, .val = 'q'},
+		{ .name = "direct",	.has_arg = 0, .val = 'd'},
+		{ .name = "spin",	.has_arg = 1, .val = 's'},
 		{ .name = "help",	.has_arg = 0, .val = 'h'},
 		{0, 0, 0, 0},
 	};
@@ -204,7 +211,7 @@ int parse_cmdline(int argc, char **argv)
 	while (1) {
 		int c;
 
-		static char *short_options = "a:p:f:b:l:h";
+		static char *short_options = "a:p:f:b:l:q:ds:h";
 
 		c = getopt_long(argc, argv, short_options,
 				long_options, NULL);
@@ -234,6 +241,15 @@ int parse_cmdline(int argc, char **argv)
 		case 'l':
 			loops = strtol(optarg, NULL, 0);
 			break;
+		case 'q':
+			queues = strtol(optarg, NULL, 0);
+			break;
+		case 'd':
+			direct = 1;
+			break;
+		case 's':
+			spin_us = strtol(optarg, NULL, 0);
+			break;
 		case 'h':
 			usage(argv[0]);
 			exit(0);
@@ -319,9 +335,11 @@ int main(int argc, char *argv[])
 		printf("open for write failed %m\n");
 #endif
 
-	flags = O_RDONLY | O_LARGEFILE /*| O_DIRECT*/;
-	fd = raio_open((struct sockaddr *)&servaddr, sizeof(servaddr),
-		       file_path, flags);
+	flags = O_RDONLY | O_LARGEFILE;
+	if (direct)
+		flags |= O_DIRECT;
+	fd = raio_open_mq((struct sockaddr *)&servaddr, sizeof(servaddr),
+			  file_path, flags, queues);
 	if (fd == -1) {
 		fprintf(stderr, "raio_open failed - file:%s:%d/%s " \
 			"flags:%x %m\n", server_addr, server_port,
@@ -349,6 +367,9 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "raio_setup failed - fd:%d %m\n", fd);
 		goto close_file;
 	}
+	/* busy poll for completions before sleeping */
+	if (spin_us > 0)
+		raio_set_poll(io_ctx, spin_us);
 
 	/* initialize iocb pool */
 	iocb_pool = raio_pool_init(IODEPTH, sizeof(struct raio_iocb));
@@ -53,16 +53,27 @@ enum raio_server_commands {
 	RAIO_CMD_IO_SUBMIT,
 	RAIO_CMD_IO_RELEASE,
 	RAIO_CMD_IO_DESTROY,
+	RAIO_CMD_IO_SUBMITV,
 
 	RAIO_CMD_LAST
 };
 
+/** limits of one RAIO_CMD_IO_SUBMITV command */
+#define RAIO_SUBMITV_MAX_EXTENTS	16
+#define RAIO_SUBMITV_MAX_BYTES		(128*1024)
+
 /** command for server */
 struct raio_command {
 	uint32_t command;
 	uint32_t data_len;
 };
 
+/** one (offset, len) extent of a vectored submit */
+struct raio_extent {
+	uint64_t offset;
+	uint64_t nbytes;
+};
+
 /** answer to client */
 struct raio_answer {
 	uint32_t command;
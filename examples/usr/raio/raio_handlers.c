@@ -37,6 +37,7 @@
  */
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <sys/param.h>
@@ -53,6 +54,7 @@
 #include "raio_handlers.h"
 #include "raio_utils.h"
 #include "raio_bs.h"
+#include "raio_cache.h"
 #include "libraio.h"
 #include "msg_pool.h"
 
@@ -63,6 +65,13 @@
 #define BS_IODEPTH	128
 #define NULL_BS_DEV_SIZE (1ULL << 32)
 #define EXTRA_MSGS	100
+#define RSP_HDR_LEN	(sizeof(struct raio_answer) + \
+			 RAIO_SUBMITV_MAX_EXTENTS*2*sizeof(uint32_t))
+#define WBUF_MIN_SIZE	(4*1024)
+#define WBUF_MAX_SIZE	(1024*1024)
+#define WBUF_MAX_NR	512
+#define WBUF_ALLOC_NR	64
+#define DIRECT_ALIGN	4096
 
 /*---------------------------------------------------------------------------*/
 /* data structres				                             */
@@ -70,13 +79,21 @@
 struct raio_io_u {
 	struct raio_event		ev_data;
 	struct xio_msg			*rsp;
-	struct raio_io_cmd		iocmd;
+	struct raio_io_portal_data	*pd;
+	char				*slot;	/* read data, if not cached */
+	struct raio_io_cmd		iocmd[RAIO_SUBMITV_MAX_EXTENTS];
+	int				iocmd_nr;
+	int				iocmd_pending;
+	char				rsp_hdr[RSP_HDR_LEN];
+	/* write data the io_u owns, see raio_io_u_take_wbufs */
+	struct xio_mempool_obj		wbuf[RAIO_SUBMITV_MAX_EXTENTS];
 
 	TAILQ_ENTRY(raio_io_u)		io_u_list;
 };
 
 struct raio_io_portal_data {
 	struct raio_bs			*bs_dev;
+	struct raio_cache_file		*cache_file;
 	int				iodepth;
 	int				io_nr;
 	int				io_u_free_nr;
@@ -85,6 +102,7 @@ struct raio_io_portal_data {
 	struct xio_msg			rsp;
 	struct xio_msg			close_rsp;
 	struct msg_pool			*rsp_pool;
+	struct xio_buf			*rsp_xbuf;
 	struct xio_context		*ctx;
 	char				rsp_hdr[512];
 
@@ -95,12 +113,234 @@ struct raio_io_session_data {
 	int				fd;
 	int				is_null;
 	int				portals_nr;
+	int				iodepth;	/* set by io setup */
+	int				direct;		/* O_DIRECT open */
 	int				pad;
 	uint64_t			fsize;
 
 	struct raio_io_portal_data	*pd;
 };
 
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static const char *raio_bs_name = "aio";
+static size_t raio_cache_size;
+
+/* the portal threads each own a cache shard */
+static __thread struct raio_cache *raio_thread_cache;
+
+/* and a pool of page aligned buffers that write data is received in */
+static __thread struct xio_mempool *raio_thread_wbuf_pool;
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_set_backingstore					     */
+/*---------------------------------------------------------------------------*/
+void raio_handler_set_backingstore(const char *name)
+{
+	raio_bs_name = name;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_set_cache						     */
+/*---------------------------------------------------------------------------*/
+void raio_handler_set_cache(size_t size)
+{
+	raio_cache_size = size;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_cache_print_stats						     */
+/*---------------------------------------------------------------------------*/
+static void raio_cache_print_stats(struct raio_cache *cache)
+{
+	struct raio_cache_stats stats;
+
+	raio_cache_get_stats(cache, &stats);
+	if (!stats.lookups)
+		return;
+
+	printf("cache: lookups:%"PRIu64", hits:%"PRIu64" (%.1f%%), " \
+	       "misses:%"PRIu64", bypassed:%"PRIu64", " \
+	       "readahead:%"PRIu64", evictions:%"PRIu64"\n",
+	       stats.lookups, stats.hits, 100.0*stats.hits/stats.lookups,
+	       stats.misses, stats.bypassed,
+	       stats.readahead, stats.evictions);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_wbuf_pool_create						     */
+/*---------------------------------------------------------------------------*/
+static struct xio_mempool *raio_wbuf_pool_create(void)
+{
+	struct xio_mempool	*pool;
+	size_t			size;
+
+	pool = xio_mempool_create(-1, XIO_MEMPOOL_FLAG_REG_MR |
+				      XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC);
+	if (!pool)
+		return NULL;
+
+	for (size = WBUF_MIN_SIZE; size <= WBUF_MAX_SIZE; size <<= 2) {
+		if (xio_mempool_add_allocator(pool, size, 0,
+					      WBUF_MAX_NR, WBUF_ALLOC_NR)) {
+			xio_mempool_destroy(pool);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_init_thread_data					     */
+/*---------------------------------------------------------------------------*/
+void raio_handler_init_thread_data(void)
+{
+	raio_thread_wbuf_pool = raio_wbuf_pool_create();
+	if (!raio_thread_wbuf_pool)
+		fprintf(stderr, "write buffers pool disabled on this portal\n");
+
+	if (!raio_cache_size)
+		return;
+
+	raio_thread_cache = raio_cache_create(raio_cache_size);
+	if (!raio_thread_cache)
+		fprintf(stderr, "cache disabled on this portal\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_free_thread_data					     */
+/*---------------------------------------------------------------------------*/
+void raio_handler_free_thread_data(void)
+{
+	if (raio_thread_cache) {
+		raio_cache_print_stats(raio_thread_cache);
+		raio_cache_destroy(raio_thread_cache);
+		raio_thread_cache = NULL;
+	}
+	if (raio_thread_wbuf_pool) {
+		xio_mempool_destroy(raio_thread_wbuf_pool);
+		raio_thread_wbuf_pool = NULL;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_assign_data_in_buf					     */
+/*---------------------------------------------------------------------------*/
+int raio_handler_assign_data_in_buf(struct xio_msg *msg)
+{
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&msg->in);
+	int			nents = vmsg_sglist_nents(&msg->in);
+	struct xio_mempool_obj	obj;
+	int			i;
+
+	if (!raio_thread_wbuf_pool)
+		return -1;
+
+	/* the pool's block is remembered in the sge until a submit
+	 * handler takes it over
+	 */
+	for (i = 0; i < nents; i++) {
+		if (xio_mempool_alloc(raio_thread_wbuf_pool,
+				      sglist[i].iov_len, &obj))
+			goto cleanup;
+		sglist[i].iov_base	= obj.addr;
+		sglist[i].mr		= obj.mr;
+		sglist[i].user_context	= obj.cache;
+	}
+
+	return 0;
+
+cleanup:
+	/* xio receives into its own buffers */
+	while (--i >= 0) {
+		obj.cache = sglist[i].user_context;
+		xio_mempool_free(&obj);
+		sglist[i].user_context = NULL;
+	}
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_in_bufs_free - drop the write data no io_u took			     */
+/*---------------------------------------------------------------------------*/
+static void raio_in_bufs_free(struct xio_msg *req)
+{
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&req->in);
+	int			nents = vmsg_sglist_nents(&req->in);
+	struct xio_mempool_obj	obj;
+	int			i;
+
+	for (i = 0; i < nents; i++) {
+		if (!sglist[i].user_context)
+			continue;
+		obj.cache = sglist[i].user_context;
+		xio_mempool_free(&obj);
+		sglist[i].user_context = NULL;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_io_u_take_wbufs - the io_u owns the write data until it is freed     */
+/*---------------------------------------------------------------------------*/
+static void raio_io_u_take_wbufs(struct raio_io_u *io_u, struct xio_msg *req)
+{
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&req->in);
+	int			nents = vmsg_sglist_nents(&req->in);
+	int			i;
+
+	for (i = 0; i < RAIO_SUBMITV_MAX_EXTENTS; i++) {
+		io_u->wbuf[i].cache = NULL;
+		if (i >= nents || !sglist[i].user_context)
+			continue;
+		io_u->wbuf[i].addr	= sglist[i].iov_base;
+		io_u->wbuf[i].length	= sglist[i].iov_len;
+		io_u->wbuf[i].mr	= sglist[i].mr;
+		io_u->wbuf[i].cache	= sglist[i].user_context;
+		sglist[i].user_context	= NULL;
+	}
+	/* a request this long is rejected anyway */
+	raio_in_bufs_free(req);
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_io_u_put_wbufs							     */
+/*---------------------------------------------------------------------------*/
+static void raio_io_u_put_wbufs(struct raio_io_u *io_u)
+{
+	int i;
+
+	for (i = 0; i < RAIO_SUBMITV_MAX_EXTENTS; i++) {
+		if (io_u->wbuf[i].cache) {
+			xio_mempool_free(&io_u->wbuf[i]);
+			io_u->wbuf[i].cache = NULL;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_io_u_direct_wbuf - write data that O_DIRECT accepts		     */
+/*---------------------------------------------------------------------------*/
+static int raio_io_u_direct_wbuf(struct raio_io_u *io_u, int i,
+				 struct xio_iovec_ex *sge)
+{
+	struct xio_mempool_obj *obj = &io_u->wbuf[i];
+
+	if (!((uintptr_t)sge->iov_base & (DIRECT_ALIGN - 1)))
+		return 0;
+
+	/* small writes arrive inline, inside xio's receive buffer */
+	if (!raio_thread_wbuf_pool ||
+	    xio_mempool_alloc(raio_thread_wbuf_pool, sge->iov_len, obj)) {
+		obj->cache = NULL;
+		return -1;
+	}
+	memcpy(obj->addr, sge->iov_base, sge->iov_len);
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_handler_init_session_data				             */
 /*---------------------------------------------------------------------------*/
@@ -189,6 +429,7 @@ static int raio_handle_open(void *prv_session_data,
 		fd = open(pathname, flags);
 		if (fd == -1)
 			goto reject;
+		sd->direct = !!(flags & O_DIRECT);
 
 	} else {
 		sd->is_null = 1;
@@ -375,6 +616,120 @@ reject:
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_portal_io_free							     */
+/*---------------------------------------------------------------------------*/
+static void raio_portal_io_free(struct raio_io_portal_data *pd)
+{
+	int j;
+
+	if (pd->bs_dev) {
+		raio_bs_close(pd->bs_dev);
+		raio_bs_exit(pd->bs_dev);
+		pd->bs_dev = NULL;
+	}
+	if (pd->cache_file) {
+		raio_cache_file_close(pd->cache_file);
+		pd->cache_file = NULL;
+		raio_cache_print_stats(raio_thread_cache);
+	}
+	if (pd->io_us_free) {
+		for (j = 0; j < pd->iodepth; j++) {
+			raio_io_u_put_wbufs(&pd->io_us_free[j]);
+			if (pd->io_us_free[j].rsp)
+				msg_pool_put(pd->rsp_pool,
+					     pd->io_us_free[j].rsp);
+		}
+	}
+
+	TAILQ_INIT(&pd->io_u_free_list);
+
+	if (pd->rsp_xbuf)
+		xio_free(&pd->rsp_xbuf);
+	free(pd->io_us_free);
+	pd->io_us_free = NULL;
+	pd->io_u_free_nr = 0;
+	if (pd->rsp_pool)
+		msg_pool_free(pd->rsp_pool);
+	pd->rsp_pool = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_portal_io_init - on the portal's thread, its bs context is bound to  */
+/* the portal's event loop						     */
+/*---------------------------------------------------------------------------*/
+static int raio_portal_io_init(struct raio_io_session_data *sd,
+			       struct raio_io_portal_data *pd)
+{
+	struct xio_iovec_ex		*sglist;
+	int				j;
+	int				retval;
+
+	if (!sd->iodepth)
+		return EINVAL;
+
+	pd->iodepth = sd->iodepth;
+	pd->io_u_free_nr = pd->iodepth + EXTRA_MSGS;
+	pd->io_us_free = calloc(pd->io_u_free_nr,
+				sizeof(struct raio_io_u));
+	pd->rsp_pool = msg_pool_alloc(pd->io_u_free_nr, 0,
+				      RAIO_SUBMITV_MAX_EXTENTS);
+	TAILQ_INIT(&pd->io_u_free_list);
+
+	/* one registered region backs the read data of all the
+	 * portal's responses, MAXBLOCKSIZE per io_u
+	 */
+	pd->rsp_xbuf = xio_alloc(pd->io_u_free_nr * MAXBLOCKSIZE);
+	if (!pd->io_us_free || !pd->rsp_pool || !pd->rsp_xbuf) {
+		retval = ENOMEM;
+		goto cleanup;
+	}
+
+	/* register each io_u in the free list */
+	for (j = 0; j < pd->io_u_free_nr; j++) {
+		pd->io_us_free[j].rsp = msg_pool_get(pd->rsp_pool);
+		pd->io_us_free[j].rsp->out.header.iov_base =
+			pd->io_us_free[j].rsp_hdr;
+		pd->io_us_free[j].pd	= pd;
+		pd->io_us_free[j].slot	= (char *)pd->rsp_xbuf->addr +
+					  j * MAXBLOCKSIZE;
+		sglist = vmsg_sglist(&pd->io_us_free[j].rsp->out);
+		sglist[0].iov_base = pd->io_us_free[j].slot;
+		sglist[0].iov_len  = MAXBLOCKSIZE;
+		sglist[0].mr	   = pd->rsp_xbuf->mr;
+		TAILQ_INSERT_TAIL(&pd->io_u_free_list,
+				  &pd->io_us_free[j],
+				  io_u_list);
+	}
+
+	if (sd->is_null)
+		pd->bs_dev = raio_bs_init(pd->ctx, "null");
+	else
+		pd->bs_dev = raio_bs_init(pd->ctx, raio_bs_name);
+	if (!pd->bs_dev) {
+		retval = ENODEV;
+		goto cleanup;
+	}
+
+	retval = -raio_bs_open(pd->bs_dev, sd->fd);
+	if (retval) {
+		raio_bs_exit(pd->bs_dev);
+		pd->bs_dev = NULL;
+		goto cleanup;
+	}
+
+	/* a failure only costs the backing store its fast path */
+	raio_bs_register_buf(pd->bs_dev, pd->rsp_xbuf->addr,
+			     pd->rsp_xbuf->length);
+
+	return 0;
+
+cleanup:
+	raio_portal_io_free(pd);
+
+	return retval;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_handle_setup				                             */
 /*---------------------------------------------------------------------------*/
@@ -384,15 +739,14 @@ static int raio_handle_setup(void *prv_session_data,
 			     char *cmd_data,
 			     struct xio_msg *req)
 {
-	int				fd, i, j;
+	int				fd;
+	int				retval = 0;
 	uint32_t			iodepth;
 	struct raio_io_session_data	*sd = prv_session_data;
 	struct raio_io_portal_data	*pd = prv_portal_data;
-	struct raio_io_portal_data	*cpd;
-
 
 	if (3*sizeof(int) != cmd->data_len) {
-		errno = EINVAL;
+		retval = EINVAL;
 		printf("io setup request rejected\n");
 		goto reject;
 	}
@@ -401,36 +755,15 @@ static int raio_handle_setup(void *prv_session_data,
 		   unpack_u32((uint32_t *)&fd,
 		   cmd_data));
 
-	for (i = 0; i < sd->portals_nr; i++) {
-		cpd = &sd->pd[i];
-		cpd->iodepth = iodepth;
-		cpd->io_u_free_nr = cpd->iodepth + EXTRA_MSGS;
-		cpd->io_us_free = calloc(cpd->io_u_free_nr,
-					 sizeof(struct raio_io_u));
-		cpd->rsp_pool = msg_pool_alloc(cpd->io_u_free_nr, 0, 1);
-		TAILQ_INIT(&cpd->io_u_free_list);
-
-		/* register each io_u in the free list */
-		for (j = 0; j < cpd->io_u_free_nr; j++) {
-			cpd->io_us_free[j].rsp = msg_pool_get(cpd->rsp_pool);
-			TAILQ_INSERT_TAIL(&cpd->io_u_free_list,
-					  &cpd->io_us_free[j],
-					  io_u_list);
-		}
-
-		if (sd->is_null)
-			cpd->bs_dev = raio_bs_init(cpd->ctx, "null");
-		else
-			cpd->bs_dev = raio_bs_init(cpd->ctx, "aio");
-
-		errno = -raio_bs_open(cpd->bs_dev, fd);
-		if (errno)
-			break;
-	}
+	/* the other portals are set up by the first I/O of their queue */
+	sd->iodepth = iodepth;
+	if (pd->io_us_free)
+		raio_portal_io_free(pd);
+	retval = raio_portal_io_init(sd, pd);
 
 reject:
-	if (errno) {
-		struct raio_answer ans = { RAIO_CMD_IO_SETUP, 0, -1, errno };
+	if (retval) {
+		struct raio_answer ans = { RAIO_CMD_IO_SETUP, 0, -1, retval };
 		pack_u32((uint32_t *)&ans.ret_errno,
 		pack_u32((uint32_t *)&ans.ret,
 		pack_u32(&ans.data_len,
@@ -530,6 +863,37 @@ int raio_reject_request(void *prv_session_data,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_handle_cache_read - returns 1 if the cache completes the read	     */
+/*---------------------------------------------------------------------------*/
+static int raio_handle_cache_read(struct raio_io_session_data *sd,
+				  struct raio_io_portal_data *pd,
+				  struct raio_io_cmd *iocmd)
+{
+	if (!raio_thread_cache || sd->is_null)
+		return 0;
+
+	/* opened on the portal's own thread, the shard is per thread */
+	if (!pd->cache_file)
+		pd->cache_file = raio_cache_file_open(raio_thread_cache,
+						      pd->bs_dev, iocmd->fd,
+						      sd->fsize);
+	if (!pd->cache_file || !raio_cache_read(pd->cache_file, iocmd))
+		return 0;
+
+	return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_handle_cache_flush - once the message's reads are handled	     */
+/*---------------------------------------------------------------------------*/
+static inline void raio_handle_cache_flush(struct raio_io_portal_data *pd)
+{
+	/* fills do not wait for a batch end the client may never mark */
+	if (pd->cache_file)
+		raio_cache_file_flush(pd->cache_file);
+}
+
 /*---------------------------------------------------------------------------*/
 /* on_cmd_submit_comp				                             */
 /*---------------------------------------------------------------------------*/
@@ -551,7 +915,10 @@ static int on_cmd_submit_comp(struct raio_io_cmd *iocmd)
 					2*sizeof(uint32_t);
 
 	sglist = vmsg_sglist(&io_u->rsp->out);
-	if (io_u->iocmd.op == RAIO_CMD_PREAD) {
+	if (io_u->iocmd[0].op == RAIO_CMD_PREAD) {
+		/* the slot, or a cache block */
+		sglist[0].iov_base	= iocmd->buf;
+		sglist[0].mr		= iocmd->mr;
 		if (iocmd->res != iocmd->bcount) {
 			if (iocmd->res < iocmd->bcount) {
 				sglist[0].iov_len = iocmd->res;
@@ -565,6 +932,8 @@ static int on_cmd_submit_comp(struct raio_io_cmd *iocmd)
 	} else {
 		vmsg_sglist_set_nents(&io_u->rsp->out, 0);
 		sglist[0].iov_len = 0;
+		if (io_u->pd->cache_file)
+			raio_cache_write(io_u->pd->cache_file);
 	}
 
 	xio_send_response(io_u->rsp);
@@ -592,9 +961,18 @@ static int raio_handle_submit(void *prv_session_data,
 	uint32_t			msg_sz = SUBMIT_BLOCK_SIZE +
 						 sizeof(uint32_t);
 
+	/* a queue's first I/O sets its portal up */
+	if (!pd->io_us_free) {
+		io_u = NULL;
+		retval = raio_portal_io_init(sd, pd);
+		if (retval)
+			goto reject;
+	}
+
 	io_u = TAILQ_FIRST(&pd->io_u_free_list);
 	if (!io_u) {
 		printf("io_u_free_list empty\n");
+		raio_in_bufs_free(req);
 		errno = ENOSR;
 		return -1;
 	}
@@ -602,6 +980,7 @@ static int raio_handle_submit(void *prv_session_data,
 	TAILQ_REMOVE(&pd->io_u_free_list, io_u, io_u_list);
 	msg_reset(io_u->rsp);
 	pd->io_u_free_nr--;
+	raio_io_u_take_wbufs(io_u, req);
 
 	if (msg_sz != cmd->data_len) {
 		retval = EINVAL;
@@ -613,43 +992,74 @@ static int raio_handle_submit(void *prv_session_data,
 	unpack_u32(&is_last_in_batch,
 		   cmd_data));
 
-	io_u->iocmd.fd			= iocb.raio_fildes;
-	io_u->iocmd.op			= iocb.raio_lio_opcode;
-	io_u->iocmd.bcount		= iocb.u.c.nbytes;
+	io_u->iocmd[0].fd		= iocb.raio_fildes;
+	io_u->iocmd[0].op		= iocb.raio_lio_opcode;
+	io_u->iocmd[0].bcount		= iocb.u.c.nbytes;
+
+	/* reads land in the io_u's slot of the response buffers */
+	if (io_u->iocmd[0].op == RAIO_CMD_PREAD &&
+	    io_u->iocmd[0].bcount > MAXBLOCKSIZE) {
+		retval = EINVAL;
+		printf("io submit request rejected, %"PRIu64" bytes read\n",
+		       io_u->iocmd[0].bcount);
+
+		goto reject;
+	}
 
-	if (io_u->iocmd.op == RAIO_CMD_PWRITE) {
+	if (io_u->iocmd[0].op == RAIO_CMD_PWRITE) {
 		sglist = vmsg_sglist(&req->in);
 
-		io_u->iocmd.buf		= sglist[0].iov_base;
-		io_u->iocmd.mr		= sglist[0].mr;
+		if (sd->direct &&
+		    raio_io_u_direct_wbuf(io_u, 0, &sglist[0])) {
+			retval = ENOMEM;
+			goto reject;
+		}
+		if (io_u->wbuf[0].cache) {
+			io_u->iocmd[0].buf	= io_u->wbuf[0].addr;
+			io_u->iocmd[0].mr	= io_u->wbuf[0].mr;
+		} else {
+			io_u->iocmd[0].buf	= sglist[0].iov_base;
+			io_u->iocmd[0].mr	= sglist[0].mr;
+		}
+		if (pd->cache_file)
+			raio_cache_write(pd->cache_file);
 	} else {
-		sglist = vmsg_sglist(&io_u->rsp->out);
-
-		io_u->iocmd.buf		= sglist[0].iov_base;
-		io_u->iocmd.mr		= sglist[0].mr;
+		io_u->iocmd[0].buf	= io_u->slot;
+		io_u->iocmd[0].mr	= pd->rsp_xbuf->mr;
 	}
-	io_u->iocmd.fsize		= sd->fsize;
-	io_u->iocmd.offset		= iocb.u.c.offset;
-	io_u->iocmd.is_last_in_batch    = is_last_in_batch;
-	io_u->iocmd.res			= 0;
-	io_u->iocmd.res2		= 0;
-	io_u->iocmd.user_context	= io_u;
-	io_u->iocmd.comp_cb		= on_cmd_submit_comp;
+	io_u->iocmd[0].fsize		= sd->fsize;
+	io_u->iocmd[0].offset		= iocb.u.c.offset;
+	io_u->iocmd[0].is_last_in_batch	= is_last_in_batch;
+	io_u->iocmd[0].res		= 0;
+	io_u->iocmd[0].res2		= 0;
+	io_u->iocmd[0].user_context	= io_u;
+	io_u->iocmd[0].comp_cb		= on_cmd_submit_comp;
+	io_u->iocmd_nr			= 1;
 
 	io_u->rsp->request		= req;
 	io_u->rsp->user_context		= io_u;
 	io_u->rsp->out.data_iov.nents	= 1;
 
+	if (io_u->iocmd[0].op == RAIO_CMD_PREAD &&
+	    raio_handle_cache_read(sd, pd, &io_u->iocmd[0])) {
+		raio_handle_cache_flush(pd);
+		return 0;
+	}
 
 	/* issues request to bs */
-	retval = -raio_bs_cmd_submit(pd->bs_dev, &io_u->iocmd);
+	retval = -raio_bs_cmd_submit(pd->bs_dev, &io_u->iocmd[0]);
 	if (retval)
 		goto reject;
 
 	return 0;
 reject:
-	TAILQ_INSERT_TAIL(&pd->io_u_free_list, io_u, io_u_list);
-	pd->io_u_free_nr++;
+	if (io_u) {
+		raio_io_u_put_wbufs(io_u);
+		TAILQ_INSERT_TAIL(&pd->io_u_free_list, io_u, io_u_list);
+		pd->io_u_free_nr++;
+	} else {
+		raio_in_bufs_free(req);
+	}
 	msg_reset(&pd->rsp);
 
 	ans.command	= RAIO_CMD_IO_SUBMIT;
@@ -671,6 +1081,244 @@ reject:
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* on_cmd_submitv_comp				                             */
+/*---------------------------------------------------------------------------*/
+static int on_cmd_submitv_comp(struct raio_io_cmd *iocmd)
+{
+	struct raio_io_u	*io_u = iocmd->user_context;
+	struct xio_iovec_ex	*sglist;
+	struct raio_answer	ans = { RAIO_CMD_IO_SUBMITV, 0, 0, 0 };
+	char			*buffer;
+	int			i;
+
+	/* answer once, when the last extent completes */
+	if (--io_u->iocmd_pending)
+		return 0;
+
+	ans.data_len = io_u->iocmd_nr*2*sizeof(uint32_t);
+
+	buffer = pack_u32((uint32_t *)&ans.ret_errno,
+		 pack_u32((uint32_t *)&ans.ret,
+		 pack_u32(&ans.data_len,
+		 pack_u32(&ans.command,
+			  io_u->rsp->out.header.iov_base))));
+
+	for (i = 0; i < io_u->iocmd_nr; i++) {
+		iocmd = &io_u->iocmd[i];
+		buffer = pack_u32((uint32_t *)&iocmd->res2,
+			 pack_u32((uint32_t *)&iocmd->res,
+				  buffer));
+	}
+
+	io_u->rsp->out.header.iov_len = sizeof(struct raio_answer) +
+					ans.data_len;
+
+	/* every extent goes back at full length so the client's sglist
+	 * lines up. res tells the valid part, the rest is cleared
+	 */
+	if (io_u->iocmd[0].op == RAIO_CMD_PREAD) {
+		sglist = vmsg_sglist(&io_u->rsp->out);
+		for (i = 0; i < io_u->iocmd_nr; i++) {
+			iocmd = &io_u->iocmd[i];
+			sglist[i].iov_base	= iocmd->buf;
+			sglist[i].mr		= iocmd->mr;
+			if (iocmd->res < 0)
+				memset(iocmd->buf, 0, iocmd->bcount);
+			else if ((uint64_t)iocmd->res < iocmd->bcount)
+				memset((char *)iocmd->buf + iocmd->res, 0,
+				       iocmd->bcount - iocmd->res);
+			sglist[i].iov_len = iocmd->bcount;
+		}
+	} else if (io_u->pd->cache_file) {
+		raio_cache_write(io_u->pd->cache_file);
+	}
+
+	xio_send_response(io_u->rsp);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* raio_handle_submitv				                             */
+/*---------------------------------------------------------------------------*/
+static int raio_handle_submitv(void *prv_session_data,
+			       void *prv_portal_data,
+			       struct raio_command *cmd,
+			       char *cmd_data,
+			       struct xio_msg *req)
+{
+	struct raio_io_portal_data	*pd = prv_portal_data;
+	struct raio_io_session_data	*sd = prv_session_data;
+	struct xio_iovec_ex		*sglist;
+	struct raio_io_cmd		*iocmd;
+	struct raio_io_u		*io_u;
+	struct raio_extent		extent;
+	struct raio_answer		ans;
+	const char			*buffer;
+	char				*slot;
+	uint64_t			rlen = 0;
+	int				retval;
+	uint32_t			i;
+	uint32_t			is_last_in_batch;
+	uint32_t			fd, op, nr;
+
+	/* a queue's first I/O sets its portal up */
+	if (!pd->io_us_free) {
+		io_u = NULL;
+		retval = raio_portal_io_init(sd, pd);
+		if (retval)
+			goto reject;
+	}
+
+	io_u = TAILQ_FIRST(&pd->io_u_free_list);
+	if (!io_u) {
+		printf("io_u_free_list empty\n");
+		raio_in_bufs_free(req);
+		errno = ENOSR;
+		return -1;
+	}
+
+	TAILQ_REMOVE(&pd->io_u_free_list, io_u, io_u_list);
+	msg_reset(io_u->rsp);
+	pd->io_u_free_nr--;
+	raio_io_u_take_wbufs(io_u, req);
+
+	if (cmd->data_len < SUBMITV_BLOCK_SIZE) {
+		retval = EINVAL;
+		printf("io submitv request rejected\n");
+
+		goto reject;
+	}
+	buffer = unpack_u32(&nr,
+		 unpack_u32(&op,
+		 unpack_u32(&fd,
+		 unpack_u32(&is_last_in_batch,
+			    cmd_data))));
+
+	if (nr == 0 || nr > RAIO_SUBMITV_MAX_EXTENTS ||
+	    cmd->data_len != SUBMITV_BLOCK_SIZE + nr*(EXTENT_BLOCK_SIZE) ||
+	    (op != RAIO_CMD_PREAD && op != RAIO_CMD_PWRITE)) {
+		retval = EINVAL;
+		printf("io submitv request rejected\n");
+
+		goto reject;
+	}
+
+	if (op == RAIO_CMD_PWRITE) {
+		sglist = vmsg_sglist(&req->in);
+		if (vmsg_sglist_nents(&req->in) != nr) {
+			retval = EINVAL;
+			printf("io submitv request rejected, %u buffers " \
+			       "for %u extents\n",
+			       vmsg_sglist_nents(&req->in), nr);
+
+			goto reject;
+		}
+		if (pd->cache_file)
+			raio_cache_write(pd->cache_file);
+	} else {
+		sglist = vmsg_sglist(&io_u->rsp->out);
+	}
+	/* reads are packed one after the other in the io_u's slot */
+	slot = io_u->slot;
+
+	for (i = 0; i < nr; i++) {
+		buffer = unpack_extent(&extent, buffer);
+		if (op == RAIO_CMD_PREAD) {
+			rlen += extent.nbytes;
+			if (rlen > MAXBLOCKSIZE) {
+				retval = EINVAL;
+				printf("io submitv request rejected, " \
+				       "%"PRIu64" bytes read\n", rlen);
+
+				goto reject;
+			}
+			sglist[i].iov_base	= slot;
+			sglist[i].iov_len	= extent.nbytes;
+			sglist[i].mr		= pd->rsp_xbuf->mr;
+			slot += extent.nbytes;
+		} else if (sglist[i].iov_len != extent.nbytes) {
+			retval = EINVAL;
+			printf("io submitv request rejected, bad extent\n");
+
+			goto reject;
+		} else if (sd->direct &&
+			   raio_io_u_direct_wbuf(io_u, i, &sglist[i])) {
+			retval = ENOMEM;
+			goto reject;
+		}
+
+		iocmd = &io_u->iocmd[i];
+		iocmd->fd		= fd;
+		iocmd->op		= op;
+		iocmd->buf		= sglist[i].iov_base;
+		iocmd->bcount		= extent.nbytes;
+		iocmd->mr		= sglist[i].mr;
+		if (io_u->wbuf[i].cache) {
+			iocmd->buf	= io_u->wbuf[i].addr;
+			iocmd->mr	= io_u->wbuf[i].mr;
+		}
+		iocmd->fsize		= sd->fsize;
+		iocmd->offset		= extent.offset;
+		iocmd->is_last_in_batch	= is_last_in_batch && (i == nr - 1);
+		iocmd->res		= 0;
+		iocmd->res2		= 0;
+		iocmd->user_context	= io_u;
+		iocmd->comp_cb		= on_cmd_submitv_comp;
+	}
+	io_u->iocmd_nr			= nr;
+	io_u->iocmd_pending		= nr;
+
+	io_u->rsp->request		= req;
+	io_u->rsp->user_context		= io_u;
+	io_u->rsp->out.data_iov.nents	= (op == RAIO_CMD_PREAD) ? nr : 0;
+
+	/* issues the extents to bs, the last one flushes the batch */
+	for (i = 0; i < nr; i++) {
+		iocmd = &io_u->iocmd[i];
+		if (op == RAIO_CMD_PREAD &&
+		    raio_handle_cache_read(sd, pd, iocmd))
+			continue;
+		retval = -raio_bs_cmd_submit(pd->bs_dev, iocmd);
+		if (retval) {
+			iocmd->res = -retval;
+			on_cmd_submitv_comp(iocmd);
+		}
+	}
+	if (op == RAIO_CMD_PREAD)
+		raio_handle_cache_flush(pd);
+
+	return 0;
+reject:
+	if (io_u) {
+		raio_io_u_put_wbufs(io_u);
+		TAILQ_INSERT_TAIL(&pd->io_u_free_list, io_u, io_u_list);
+		pd->io_u_free_nr++;
+	} else {
+		raio_in_bufs_free(req);
+	}
+	msg_reset(&pd->rsp);
+
+	ans.command	= RAIO_CMD_IO_SUBMITV;
+	ans.data_len	= 0;
+	ans.ret		= -1;
+	ans.ret_errno	= retval;
+
+	pack_u32((uint32_t *)&ans.ret_errno,
+	pack_u32((uint32_t *)&ans.ret,
+	pack_u32(&ans.data_len,
+	pack_u32(&ans.command,
+		 pd->rsp_hdr))));
+
+	pd->rsp.out.header.iov_len = sizeof(struct raio_answer);
+	pd->rsp.request = req;
+
+	xio_send_response(&pd->rsp);
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_handle_submit_comp				                     */
 /*---------------------------------------------------------------------------*/
@@ -680,8 +1328,17 @@ static int raio_handle_submit_comp(void *prv_session_data,
 {
 	struct raio_io_portal_data *pd = prv_portal_data;
 	struct raio_io_u	   *io_u = rsp->user_context;
+	int			   i;
 
 	if (io_u) {
+		/* the response no longer needs the cache blocks it was
+		 * sent from
+		 */
+		if (raio_thread_cache && io_u->iocmd[0].op == RAIO_CMD_PREAD)
+			for (i = 0; i < io_u->iocmd_nr; i++)
+				raio_cache_put(raio_thread_cache,
+					       io_u->iocmd[i].buf);
+		raio_io_u_put_wbufs(io_u);
 		TAILQ_INSERT_TAIL(&pd->io_u_free_list, io_u, io_u_list);
 		pd->io_u_free_nr++;
 	}
@@ -689,6 +1346,19 @@ static int raio_handle_submit_comp(void *prv_session_data,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* raio_handle_destroy_comp				                     */
+/*---------------------------------------------------------------------------*/
+static int raio_handle_destroy_comp(void *prv_session_data,
+				    void *prv_portal_data,
+				    struct xio_msg *rsp)
+{
+	/* each queue destroys its own portal's context */
+	raio_portal_io_free(prv_portal_data);
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* raio_handle_close_comp				                     */
 /*---------------------------------------------------------------------------*/
@@ -696,26 +1366,7 @@ static int raio_handle_close_comp(void *prv_session_data,
 				  void *prv_portal_data,
 				  struct xio_msg *rsp)
 {
-	struct raio_io_portal_data *pd = prv_portal_data;
-	int			    j;
-
-	if (pd->bs_dev) {
-		raio_bs_close(pd->bs_dev);
-		raio_bs_exit(pd->bs_dev);
-		pd->bs_dev = NULL;
-	}
-	if (pd->io_us_free) {
-		for (j = 0; j < pd->iodepth; j++)
-			msg_pool_put(pd->rsp_pool, pd->io_us_free[j].rsp);
-	}
-
-	TAILQ_INIT(&pd->io_u_free_list);
-
-	free(pd->io_us_free);
-	pd->io_us_free = NULL;
-	pd->io_u_free_nr = 0;
-	msg_pool_free(pd->rsp_pool);
-	pd->rsp_pool = NULL;
+	raio_portal_io_free(prv_portal_data);
 
 	return 0;
 }
@@ -732,6 +1383,7 @@ int raio_handler_on_req(void *prv_session_data, void *prv_portal_data,
 
 
 	if (buffer == NULL) {
+		raio_in_bufs_free(req);
 		raio_reject_request(prv_session_data,
 				    prv_portal_data,
 				    &cmd, NULL,
@@ -744,6 +1396,11 @@ int raio_handler_on_req(void *prv_session_data, void *prv_portal_data,
 	cmd_data = (char *)unpack_u32((uint32_t *)&cmd.data_len,
 			      (char *)buffer);
 
+	/* only the submit handlers take write data */
+	if (cmd.command != RAIO_CMD_IO_SUBMIT &&
+	    cmd.command != RAIO_CMD_IO_SUBMITV)
+		raio_in_bufs_free(req);
+
 	switch (cmd.command) {
 	case RAIO_CMD_IO_SUBMIT:
 		raio_handle_submit(prv_session_data,
@@ -751,6 +1408,12 @@ int raio_handler_on_req(void *prv_session_data, void *prv_portal_data,
 				   &cmd, cmd_data,
 				   req);
 		break;
+	case RAIO_CMD_IO_SUBMITV:
+		raio_handle_submitv(prv_session_data,
+				    prv_portal_data,
+				    &cmd, cmd_data,
+				    req);
+		break;
 	case RAIO_CMD_OPEN:
 		raio_handle_open(prv_session_data,
 				 prv_portal_data,
@@ -811,6 +1474,7 @@ void raio_handler_on_rsp_comp(void *prv_session_data,
 
 	switch (cmd.command) {
 	case RAIO_CMD_IO_SUBMIT:
+	case RAIO_CMD_IO_SUBMITV:
 		raio_handle_submit_comp(prv_session_data,
 					prv_portal_data,
 					rsp);
@@ -820,8 +1484,12 @@ void raio_handler_on_rsp_comp(void *prv_session_data,
 				       prv_portal_data,
 				       rsp);
 		break;
-	case RAIO_CMD_UNKNOWN:
 	case RAIO_CMD_IO_DESTROY:
+		raio_handle_destroy_comp(prv_session_data,
+					 prv_portal_data,
+					 rsp);
+		break;
+	case RAIO_CMD_UNKNOWN:
 	case RAIO_CMD_OPEN:
 	case RAIO_CMD_FSTAT:
 	case RAIO_CMD_IO_SETUP:
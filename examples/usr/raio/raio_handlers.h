@@ -38,8 +38,35 @@
 #ifndef RAIO_HANDLERS_H
 #define RAIO_HANDLERS_H
 
+#include <stddef.h>
+
 struct raio_command;
 
+/*---------------------------------------------------------------------------*/
+/* raio_handler_set_backingstore - used for all files but /dev/null	     */
+/*---------------------------------------------------------------------------*/
+void	raio_handler_set_backingstore(const char *name);
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_set_cache - bytes of read cache per portal thread	     */
+/*---------------------------------------------------------------------------*/
+void	raio_handler_set_cache(size_t size);
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_init_thread_data - called by each portal thread		     */
+/*---------------------------------------------------------------------------*/
+void	raio_handler_init_thread_data(void);
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_free_thread_data					     */
+/*---------------------------------------------------------------------------*/
+void	raio_handler_free_thread_data(void);
+
+/*---------------------------------------------------------------------------*/
+/* raio_handler_assign_data_in_buf - page aligned buffers for write data     */
+/*---------------------------------------------------------------------------*/
+int	raio_handler_assign_data_in_buf(struct xio_msg *msg);
+
 /*---------------------------------------------------------------------------*/
 /* raio_handler_init_session_data				             */
 /*---------------------------------------------------------------------------*/
@@ -42,6 +42,7 @@
 #include <inttypes.h>
 #include <sys/queue.h>
 #include "libxio.h"
+#include "raio_command.h"
 #include "raio_handlers.h"
 #include <arpa/inet.h>
 
@@ -237,6 +238,15 @@ static int on_request(struct xio_session *session, struct xio_msg *req,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* on_assign_data_in_buf callback					     */
+/*---------------------------------------------------------------------------*/
+static int on_assign_data_in_buf(struct xio_msg *msg, void *cb_user_context)
+{
+	/* write data is received straight into the portal's buffers */
+	return raio_handler_assign_data_in_buf(msg);
+}
+
 /*---------------------------------------------------------------------------*/
 /* asynchronous callbacks						     */
 /*---------------------------------------------------------------------------*/
@@ -245,7 +255,8 @@ static struct xio_session_ops  portal_server_ops = {
 	.on_new_session			=  NULL,
 	.on_msg_send_complete		=  on_response_comp,
 	.on_msg				=  on_request,
-	.on_msg_error			=  NULL
+	.on_msg_error			=  NULL,
+	.assign_data_in_buf		=  on_assign_data_in_buf
 };
 /*---------------------------------------------------------------------------*/
 /* worker thread callback						     */
@@ -268,6 +279,8 @@ static void *portal_server_cb(void *data)
 	/* create thread context for the client */
 	tdata->ctx = xio_context_create(NULL, 0, tdata->affinity);
 
+	raio_handler_init_thread_data();
+
 	/* bind a listener server to a portal/url */
 	server = xio_bind(tdata->ctx, &portal_server_ops, tdata->portal,
 			  NULL, 0, tdata);
@@ -286,6 +299,8 @@ static void *portal_server_cb(void *data)
 	xio_unbind(server);
 
 cleanup:
+	raio_handler_free_thread_data();
+
 	/* free the context */
 	xio_context_destroy(tdata->ctx);
 
@@ -483,15 +498,32 @@ int main(int argc, char *argv[])
 	uint16_t		port = atoi(argv[2]);
 	int			curr_cpu;
 	int			max_cpus;
+	int			iov_len = RAIO_SUBMITV_MAX_EXTENTS;
 
 	if (argc < 3) {
-		printf("Usage: %s <host> <port> <transport:optional>\n",
+		printf("Usage: %s <host> <port> <transport:optional> " \
+		       "<backingstore:optional> <cache MB:optional>\n",
 		       argv[0]);
 		exit(1);
 	}
+	/* aio, uring (where built), null for files other than /dev/null */
+	if (argc > 4)
+		raio_handler_set_backingstore(argv[4]);
+	/* read cache, split between the portal threads */
+	if (argc > 5)
+		raio_handler_set_cache(((size_t)atoi(argv[5]) << 20) /
+				       MAX_THREADS);
 
 	xio_init();
 
+	/* a vectored submit carries one sge per extent, both ways */
+	xio_set_opt(NULL,
+		    XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_MAX_IN_IOVLEN,
+		    &iov_len, sizeof(int));
+	xio_set_opt(NULL,
+		    XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_MAX_OUT_IOVLEN,
+		    &iov_len, sizeof(int));
+
 	curr_cpu = sched_getcpu();
 	max_cpus = sysconf(_SC_NPROCESSORS_ONLN);
 
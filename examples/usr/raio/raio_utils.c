@@ -376,3 +376,53 @@ void pack_submit_command(struct raio_iocb *iocb, int is_last_in_batch,
 	*len = sizeof(cmd) + overall_size;
 }
 
+/*---------------------------------------------------------------------------*/
+/* pack_extent								     */
+/*---------------------------------------------------------------------------*/
+char *pack_extent(struct raio_extent *extent, char *buffer)
+{
+	pack_u64(&extent->nbytes,
+	pack_u64(&extent->offset,
+		 buffer));
+	return buffer + EXTENT_BLOCK_SIZE;
+}
+
+/*---------------------------------------------------------------------------*/
+/* unpack_extent							     */
+/*---------------------------------------------------------------------------*/
+const char *unpack_extent(struct raio_extent *extent, const char *buffer)
+{
+	unpack_u64(&extent->nbytes,
+	unpack_u64(&extent->offset,
+		   buffer));
+	return buffer + EXTENT_BLOCK_SIZE;
+}
+
+/*---------------------------------------------------------------------------*/
+/* pack_submitv_command							     */
+/*---------------------------------------------------------------------------*/
+void pack_submitv_command(int fd, int opcode,
+			  struct raio_extent *extents, int nr,
+			  int is_last_in_batch,
+			  void *buf, size_t *len)
+{
+	char	*buffer = buf;
+	unsigned overall_size = SUBMITV_BLOCK_SIZE + nr*(EXTENT_BLOCK_SIZE);
+	int	i;
+
+	struct raio_command cmd = { RAIO_CMD_IO_SUBMITV, overall_size };
+
+	buffer = pack_u32((uint32_t *)&nr,
+		 pack_u32((uint32_t *)&opcode,
+		 pack_u32((uint32_t *)&fd,
+		 pack_u32((uint32_t *)&is_last_in_batch,
+		 pack_u32(&cmd.data_len,
+		 pack_u32(&cmd.command,
+			  buffer))))));
+
+	for (i = 0; i < nr; i++)
+		buffer = pack_extent(&extents[i], buffer);
+
+	*len = sizeof(cmd) + overall_size;
+}
+
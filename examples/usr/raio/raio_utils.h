@@ -39,6 +39,7 @@
 #define RAIO_UTILS_H
 
 #include <libraio.h>
+#include "raio_command.h"
 
 #define SUBMIT_BLOCK_SIZE				\
 	+ sizeof(uint32_t) /* raio_filedes */		\
@@ -46,6 +47,16 @@
 	+ sizeof(uint64_t) /* nbytes */			\
 	+ sizeof(uint64_t) /* offset */
 
+#define SUBMITV_BLOCK_SIZE				\
+	+ sizeof(uint32_t) /* is_last_in_batch */	\
+	+ sizeof(uint32_t) /* raio_filedes */		\
+	+ sizeof(uint32_t) /* raio_lio_opcode */	\
+	+ sizeof(uint32_t) /* extents nr */
+
+#define EXTENT_BLOCK_SIZE				\
+	+ sizeof(uint64_t) /* offset */			\
+	+ sizeof(uint64_t) /* nbytes */
+
 #define STAT_BLOCK_SIZE					\
 	+ sizeof(uint64_t) /* dev */			\
 	+ sizeof(uint64_t) /* ino */			\
@@ -68,6 +79,8 @@ char *pack_stat64(struct stat64 *stbuf, char *buffer);
 const char *unpack_stat64(struct stat64 *result, const char *buffer);
 char *pack_iocb(struct raio_iocb *iocb, char *buffer);
 const char *unpack_iocb(struct raio_iocb *iocb, const char *buffer);
+char *pack_extent(struct raio_extent *extent, char *buffer);
+const char *unpack_extent(struct raio_extent *extent, const char *buffer);
 
 void pack_open_command(const char *pathname, int flags,
 		       void *buf, size_t *len);
@@ -78,6 +91,10 @@ void pack_setup_command(int fd, int maxevents,
 void pack_destroy_command(int fd, void *buf, size_t *len);
 void pack_submit_command(struct raio_iocb *iocb, int is_last_in_batch,
 			 void *buf, size_t *len);
+void pack_submitv_command(int fd, int opcode,
+			  struct raio_extent *extents, int nr,
+			  int is_last_in_batch,
+			  void *buf, size_t *len);
 
 
 
@@ -1,9 +1,9 @@
 #!/bin/bash
 
 # Arguments Check
-if [ $# -ne 2 ]; then
+if [ $# -lt 2 ]; then
         echo "[$0] Missing Parameters!"
-        echo "Usage: $0 [Server IP] [Port]"
+        echo "Usage: $0 [Server IP] [Port] [File (optional)] [Queues (optional)]"
         exit 1
 fi
 
@@ -13,11 +13,20 @@ server_ip=$1
 port=$2
 file=/dev/null
 #file=/dev/ram0
+if [ $# -ge 3 ]; then
+	file=$3
+fi
+queues=4
+if [ $# -ge 4 ]; then
+	queues=$4
+fi
 block_size=1024
 loops=10
 
-# ./raio_client -a <server_addr> -p <port> -f <file_path>  -b <block_size> -l <loops>
+# ./raio_client -a <server_addr> -p <port> -f <file_path>  -b <block_size> -l <loops> [-q <queues>]
 #
-taskset -c 1 ./raio_client -a ${server_ip} -p ${port} -f ${file} -b ${block_size} -l ${loops}
-
+# a single queue, then the file's 1MB stripes spread over the server portals
+for q in 1 ${queues}; do
+	taskset -c 1 ./raio_client -a ${server_ip} -p ${port} -f ${file} -b ${block_size} -l ${loops} -q ${q}
+done
 
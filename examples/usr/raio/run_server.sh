@@ -3,7 +3,7 @@
 # Arguments Check
 if [ $# -lt 2 ]; then
         echo "[$0] Missing Parameters!"
-        echo "Usage: $0 [Server IP] [Port] [Transport (optional)]"
+        echo "Usage: $0 [Server IP] [Port] [Transport (optional)] [Backingstore (optional)] [Cache MB (optional)]"
         exit 1
 fi
 
@@ -12,10 +12,18 @@ export LD_LIBRARY_PATH=../../../src/usr/
 server_ip=$1
 port=$2
 trans="rdma"
-if [ $# -eq 3 ]; then
+if [ $# -ge 3 ]; then
 	trans=$3
 fi
+bs="aio"
+if [ $# -ge 4 ]; then
+	bs=$4
+fi
+cache=0
+if [ $# -ge 5 ]; then
+	cache=$5
+fi
 
-taskset -c 1 ./raio_server ${server_ip} ${port} ${trans}
+taskset -c 1 ./raio_server ${server_ip} ${port} ${trans} ${bs} ${cache}
 
 
@@ -93,6 +93,17 @@ enum xio_session_type {
 	XIO_SESSION_REP = XIO_SESSION_SERVER /**< deprecated		     */
 };
 
+/**
+ * @enum xio_session_flags
+ * @brief session creation flags
+ */
+enum xio_session_flags {
+	XIO_SESSION_FLAG_EARLY_DATA = 1 << 0 /**< send the first requests    */
+					     /**< along with session setup   */
+					     /**< without waiting for the    */
+					     /**< setup response	     */
+};
+
 enum xio_proto {
 	XIO_PROTO_RDMA
 };
@@ -230,6 +241,15 @@ enum xio_session_attr_mask {
 	XIO_SESSION_ATTR_URI			= 1 << 2
 };
 
+/**
+ * @enum xio_connection_pool_policy
+ * @brief connection selection policy of a client connection pool
+ */
+enum xio_connection_pool_policy {
+	XIO_CONNECTION_POOL_LEAST_OUTSTANDING,	/**< fewest queued requests   */
+	XIO_CONNECTION_POOL_CONSISTENT_HASH	/**< stable key to connection */
+};
+
 /*---------------------------------------------------------------------------*/
 /* opaque data structures                                                    */
 /*---------------------------------------------------------------------------*/
@@ -238,6 +258,8 @@ struct xio_server;		/* server handle		*/
 struct xio_session;		/* session handle		*/
 struct xio_connection;		/* connection handle		*/
 struct xio_mr;			/* registered memory handle	*/
+struct xio_connection_pool;	/* connection pool handle	*/
+struct xio_stream;		/* stream handle		*/
 
 /*---------------------------------------------------------------------------*/
 /* typedefs								     */
@@ -271,9 +293,27 @@ struct xio_session_params {
 						/**< server upon new session  */
 	size_t			private_data_len; /**< private data length    */
 	char			*uri;		  /**< the uri		      */
+	uint32_t		flags;		 /**< xio_session_flags mask  */
+	uint32_t		reserved;	 /**< structure alignment     */
 };
 
 
+/**
+ * @struct xio_connection_pool_params
+ * @brief client connection pool creation params
+ */
+struct xio_connection_pool_params {
+	struct xio_session	*session;	/**< client session	      */
+	struct xio_context	**ctxs;		/**< one connection per ctx   */
+	int			ctxs_nr;	/**< number of contexts	      */
+	enum xio_connection_pool_policy policy; /**< selection policy	      */
+	int			reconnect_delay_ms; /**< initial backoff, 0 -  */
+						/**< default (100 msec)	      */
+	int			max_reconnect_delay_ms; /**< backoff cap, 0 -  */
+						/**< default (5 sec)	      */
+	void			*conn_user_context; /**< connections user ctx */
+};
+
 /**
  * @struct xio_session_attr
  * @brief session attributes
@@ -512,6 +552,45 @@ struct xio_session_ops {
 				       void *conn_user_context);
 };
 
+/**
+ *  @struct xio_stream_ops
+ *  @brief user provided callback functions that handles stream events
+ */
+struct xio_stream_ops {
+	/* new stream notification - return non zero to reject */
+	int (*on_stream_open)(struct xio_stream *stream,
+			void *user_context);
+
+	/* chunk arrived, always release with xio_stream_release_chunk */
+	int (*on_stream_chunk)(struct xio_stream *stream,
+			struct xio_msg *chunk,
+			int last,
+			void *user_context);
+
+	/* chunk acknowledged - its buffers may be reused */
+	int (*on_stream_chunk_ack)(struct xio_stream *stream,
+			struct xio_msg *chunk,
+			void *user_context);
+
+	/* stream closed - the handle is released on return */
+	int (*on_stream_close)(struct xio_stream *stream,
+			enum xio_status status,
+			void *user_context);
+};
+
+/**
+ * @struct xio_stream_params
+ * @brief stream creation params
+ */
+struct xio_stream_params {
+	struct xio_connection	*connection;	/**< connection to stream on  */
+	struct xio_stream_ops	*ops;		/**< stream's ops callbacks   */
+	void			*user_context;	/**< stream user context      */
+	int			window;		/**< chunks in flight, 0 -    */
+						/**< default (16)	      */
+	int			pad;		/**< padding		      */
+};
+
 /**
  *  @struct xio_mem_allocator
  *  @brief user provided customed allocator hook functions for library usage
@@ -825,6 +904,20 @@ struct xio_connection *xio_connect(
  */
 int xio_disconnect(struct xio_connection *conn);
 
+/**
+ * xio_context_prewarm - keeps idle transport connections to a portal open
+ *	on a context, so connections opened later by sessions on that context
+ *	skip the transport handshake. must be called from the context's thread.
+ *
+ * @ctx: The xio context handle.
+ * @uri: portal uri to keep connections to.
+ * @idle_nr: number of idle connections to keep. 0 stops keeping them.
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_context_prewarm(struct xio_context *ctx, const char *uri,
+			int idle_nr);
+
 /**
  * free connection object
  *
@@ -906,6 +999,125 @@ int xio_send_msg(struct xio_connection *conn,
 int xio_release_msg(struct xio_msg *rsp);
 
 
+/*---------------------------------------------------------------------------*/
+/* XIO connection pool API						     */
+/*---------------------------------------------------------------------------*/
+/**
+ * xio_connection_pool_create - creates a pool of connections over a client
+ *	session, one connection per context. failed connections are drained
+ *	and replaced in the background. all pool contexts must be dispatched
+ *	by the thread that sends through the pool.
+ *	when every connection is lost the session is re-established and
+ *	on_session_established may be delivered again.
+ *
+ * @params: pool creation parameters
+ *
+ * RETURNS: xio connection pool handle, or NULL upon error.
+ */
+struct xio_connection_pool *xio_connection_pool_create(
+		struct xio_connection_pool_params *params);
+
+/**
+ * xio_connection_pool_destroy - disconnects all pool connections. the pool
+ *	is released once the last connection is torn down.
+ *
+ * @pool: The xio connection pool handle
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_connection_pool_destroy(struct xio_connection_pool *pool);
+
+/**
+ * xio_connection_pool_get - selects an online connection according to the
+ *	pool policy.
+ *
+ * @pool: The xio connection pool handle
+ * @key: affinity key, used by XIO_CONNECTION_POOL_CONSISTENT_HASH only
+ *
+ * RETURNS: xio connection handle, or NULL if no connection is online.
+ */
+struct xio_connection *xio_connection_pool_get(
+		struct xio_connection_pool *pool,
+		uint64_t key);
+
+/**
+ * xio_connection_pool_send_request - send request over a pool selected
+ *	connection.
+ *
+ * @pool: The xio connection pool handle
+ * @req: request message to send
+ * @key: affinity key, used by XIO_CONNECTION_POOL_CONSISTENT_HASH only
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_connection_pool_send_request(struct xio_connection_pool *pool,
+				     struct xio_msg *req,
+				     uint64_t key);
+
+/*---------------------------------------------------------------------------*/
+/* XIO stream API							     */
+/*---------------------------------------------------------------------------*/
+/**
+ * xio_stream_listen - accepts streams opened by the peer on a connection.
+ *	the peer's stream chunks are not delivered to on_msg.
+ *
+ * @connection: The xio connection handle
+ * @ops: stream callbacks of the accepted streams
+ * @user_context: passed to on_stream_open and used as the streams' context
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_stream_listen(struct xio_connection *connection,
+		      struct xio_stream_ops *ops,
+		      void *user_context);
+
+/**
+ * xio_stream_open - opens a stream on a connection. at most "window"
+ *	chunks are unacknowledged at any time.
+ *
+ * @params: stream creation parameters
+ *
+ * RETURNS: xio stream handle, or NULL upon error.
+ */
+struct xio_stream *xio_stream_open(struct xio_stream_params *params);
+
+/**
+ * xio_stream_write - writes the next chunk of a stream. the chunk's header
+ *	and "in" side are reserved for the stream.
+ *
+ * @stream: The xio stream handle
+ * @chunk: chunk to write
+ * @last: last chunk of the stream
+ *
+ * RETURNS: success (0), or a (negative) error value. EAGAIN is set when
+ *	the window is full.
+ */
+int xio_stream_write(struct xio_stream *stream,
+		     struct xio_msg *chunk,
+		     int last);
+
+/**
+ * xio_stream_release_chunk - acknowledges a received chunk and returns it
+ *	to the library. The chunk is released even on failure, which may
+ *	close the stream.
+ *
+ * @stream: The xio stream handle
+ * @chunk: chunk delivered by on_stream_chunk
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_stream_release_chunk(struct xio_stream *stream,
+			     struct xio_msg *chunk);
+
+/**
+ * xio_stream_set_user_context - sets the stream user context.
+ *
+ * @stream: The xio stream handle
+ * @user_context: stream user context
+ */
+void xio_stream_set_user_context(struct xio_stream *stream,
+				 void *user_context);
+
 /*---------------------------------------------------------------------------*/
 /* XIO server API							     */
 /*---------------------------------------------------------------------------*/
@@ -938,6 +1150,46 @@ struct xio_server *xio_bind(struct xio_context *ctx,
  */
 int xio_unbind(struct xio_server *server);
 
+/**
+ * xio_server_add_portal - register a worker portal for automatic session
+ *	redirect. once enabled by xio_server_set_auto_redirect, new
+ *	sessions left unanswered by on_new_session are redirected to the
+ *	least loaded portal.
+ *
+ * @server: The xio server handle (the accepting server).
+ * @portal_uri: The uri the worker is bound to.
+ * @ctx: The worker's xio context handle.
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_server_add_portal(struct xio_server *server,
+			  const char *portal_uri,
+			  struct xio_context *ctx);
+
+/**
+ * xio_server_del_portal - unregister a worker portal.
+ *
+ * @server: The xio server handle.
+ * @portal_uri: The uri used at registration.
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_server_del_portal(struct xio_server *server,
+			  const char *portal_uri);
+
+/**
+ * xio_server_set_auto_redirect - enable or disable automatic session
+ *	redirect to the registered portals. it is off by default, a
+ *	server that accepts sessions asynchronously must leave it off.
+ *
+ * @server: The xio server handle (the accepting server).
+ * @enable: Nonzero to redirect sessions left unanswered by
+ *	on_new_session, zero to leave them to the application.
+ *
+ * RETURNS: success (0), or a (negative) error value.
+ */
+int xio_server_set_auto_redirect(struct xio_server *server, int enable);
+
 /**
  * xio_get_connection - return connection handle on server.
  *
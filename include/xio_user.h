@@ -121,6 +121,17 @@ enum xio_session_type {
 	XIO_SESSION_REP = XIO_SESSION_SERVER /**< deprecated		     */
 };
 
+/**
+ * @enum xio_session_flags
+ * @brief session creation flags
+ */
+enum xio_session_flags {
+	XIO_SESSION_FLAG_EARLY_DATA = 1 << 0 /**< send the first requests    */
+					     /**< along with session setup   */
+					     /**< without waiting for the    */
+					     /**< setup response	     */
+};
+
 /**
  * @enum xio_proto
  * @brief session's transport protocol as received on the server side upon
@@ -175,6 +186,27 @@ enum xio_optname {
 	XIO_OPTNAME_TCP_SO_RCVBUF,	       /**< tcp socket receive buffer */
 	XIO_OPTNAME_TCP_DUAL_STREAM,	       /**< performance boost for the */
 					       /**< price of two fd resources */
+	XIO_OPTNAME_TCP_REUSEPORT,	       /**< number of listeners, each */
+					       /**< on its own context, that */
+					       /**< bind the same uri	      */
+	XIO_OPTNAME_TCP_REUSEPORT_STEERING,    /**< how new connections are   */
+					       /**< spread over the listeners */
+					       /**< see xio_tcp_steering      */
+};
+
+/**
+ * @enum xio_tcp_steering
+ * @brief values of XIO_OPTNAME_TCP_REUSEPORT_STEERING
+ */
+enum xio_tcp_steering {
+	XIO_TCP_STEERING_PEER_ADDR,  /**< by client address (default),     */
+				     /**< keeps the two sockets of a dual  */
+				     /**< stream connection together	   */
+	XIO_TCP_STEERING_CPU,	     /**< by the cpu that received the SYN */
+				     /**< - clients must disable dual	   */
+				     /**< stream			   */
+	XIO_TCP_STEERING_KERNEL,     /**< kernel 4-tuple hash - clients    */
+				     /**< must disable dual stream	   */
 };
 
 /**
@@ -327,6 +359,15 @@ enum xio_session_attr_mask {
 	XIO_SESSION_ATTR_URI			= 1 << 2
 };
 
+/**
+ * @enum xio_connection_pool_policy
+ * @brief connection selection policy of a client connection pool
+ */
+enum xio_connection_pool_policy {
+	XIO_CONNECTION_POOL_LEAST_OUTSTANDING,	/**< fewest queued requests   */
+	XIO_CONNECTION_POOL_CONSISTENT_HASH	/**< stable key to connection */
+};
+
 
 /*---------------------------------------------------------------------------*/
 /* opaque data structures                                                    */
@@ -337,6 +378,8 @@ struct xio_session;			     /* session handle		     */
 struct xio_connection;			     /* connection handle	     */
 struct xio_mr;				     /* registered memory handle     */
 struct xio_mempool;			     /* mempool object		     */
+struct xio_connection_pool;		     /* connection pool handle	     */
+struct xio_stream;			     /* stream handle		     */
 
 /*---------------------------------------------------------------------------*/
 /* typedefs								     */
@@ -390,9 +433,27 @@ struct xio_session_params {
 						/**< server upon new session  */
 	size_t			private_data_len; /**< private data length    */
 	char			*uri;		  /**< the uri		      */
+	uint32_t		flags;		 /**< xio_session_flags mask  */
+	uint32_t		reserved;	 /**< structure alignment     */
 };
 
 
+/**
+ * @struct xio_connection_pool_params
+ * @brief client connection pool creation params
+ */
+struct xio_connection_pool_params {
+	struct xio_session	*session;	/**< client session	      */
+	struct xio_context	**ctxs;		/**< one connection per ctx   */
+	int			ctxs_nr;	/**< number of contexts	      */
+	enum xio_connection_pool_policy policy; /**< selection policy	      */
+	int			reconnect_delay_ms; /**< initial backoff, 0 -  */
+						/**< default (100 msec)	      */
+	int			max_reconnect_delay_ms; /**< backoff cap, 0 -  */
+						/**< default (5 sec)	      */
+	void			*conn_user_context; /**< connections user ctx */
+};
+
 /**
  * @struct xio_session_attr
  * @brief session attributes
@@ -800,6 +861,81 @@ struct xio_session_ops {
 
 };
 
+/**
+ *  @struct xio_stream_ops
+ *  @brief user provided callback functions that handles stream events
+ */
+struct xio_stream_ops {
+	/**
+	 * new stream notification - receiver only
+	 *
+	 *  @param[in] stream		the stream opened by the peer
+	 *  @param[in] user_context	user private data provided in
+	 *				xio_stream_listen
+	 *  @returns 0 to accept the stream, or a non zero value to reject it
+	 */
+	int (*on_stream_open)(struct xio_stream *stream,
+			void *user_context);
+
+	/**
+	 * chunk arrived notification - receiver only. chunks are delivered
+	 * in the order they were written and the chunk's header is hidden.
+	 * the chunk must be returned with xio_stream_release_chunk, also
+	 * after the stream failed
+	 *
+	 *  @param[in] stream		the stream
+	 *  @param[in] chunk		the incoming chunk
+	 *  @param[in] last		last chunk of the stream
+	 *  @param[in] user_context	stream user context
+	 *  @returns 0
+	 */
+	int (*on_stream_chunk)(struct xio_stream *stream,
+			struct xio_msg *chunk,
+			int last,
+			void *user_context);
+
+	/**
+	 * chunk acknowledge notification - sender only. the receiver
+	 * released the chunk and its buffers may be reused
+	 *
+	 *  @param[in] stream		the stream
+	 *  @param[in] chunk		the written chunk
+	 *  @param[in] user_context	stream user context
+	 *  @returns 0
+	 */
+	int (*on_stream_chunk_ack)(struct xio_stream *stream,
+			struct xio_msg *chunk,
+			void *user_context);
+
+	/**
+	 * stream closed notification, once all chunks are acknowledged or
+	 * released. the stream handle is released on return
+	 *
+	 *  @param[in] stream		the stream
+	 *  @param[in] status		XIO_E_SUCCESS after the last chunk was
+	 *				acknowledged, otherwise the failure
+	 *				reason
+	 *  @param[in] user_context	stream user context
+	 *  @returns 0
+	 */
+	int (*on_stream_close)(struct xio_stream *stream,
+			enum xio_status status,
+			void *user_context);
+};
+
+/**
+ * @struct xio_stream_params
+ * @brief stream creation params
+ */
+struct xio_stream_params {
+	struct xio_connection	*connection;	/**< connection to stream on  */
+	struct xio_stream_ops	*ops;		/**< stream's ops callbacks   */
+	void			*user_context;	/**< stream user context      */
+	int			window;		/**< chunks in flight, 0 -    */
+						/**< default (16)	      */
+	int			pad;		/**< padding		      */
+};
+
 /**
  *  @struct xio_mem_allocator
  *  @brief user provided costumed allocator hook functions for library usage
@@ -927,6 +1063,59 @@ struct xio_buf *xio_alloc(size_t len);
  */
 int xio_free(struct xio_buf **buf);
 
+/**
+ * takes ownership of a received message's payload buffers
+ *
+ * called from within on_msg for a received request or one-way message.
+ * data that arrived in the transport's buffer pool is handed over without
+ * copying, data that arrived inline with the header is copied into pool
+ * buffers. on return msg->in points at the taken buffers, and the message
+ * must still be released (xio_release_msg or xio_send_response) as usual.
+ * the buffers may then be attached to an outgoing message on any
+ * connection, and each reference is dropped with xio_buf_put once the
+ * send has completed. the last put returns the buffer to its pool.
+ * taken buffers must not be freed with xio_free. buf->mr may be NULL when
+ * the transport does not register its pool
+ *
+ * ownership: the caller holds one reference per returned handle and the
+ * message no longer refers to the buffers once it is released, so they
+ * stay valid after xio_release_msg/xio_send_response and after the
+ * connection, session or context they arrived on is torn down. the pools
+ * belong to the transport and are destroyed by xio_shutdown, every taken
+ * buffer must be put back before that. puts may come from any thread
+ *
+ * @param[in] msg	The received message
+ * @param[out] bufs	Array receiving one handle per in sge
+ * @param[in] nbufs	Number of entries in bufs
+ *
+ * @returns number of buffers taken, or -1 on error
+ */
+int xio_msg_take_bufs(struct xio_msg *msg, struct xio_buf **bufs, int nbufs);
+
+/**
+ * takes an additional reference on a buffer returned by xio_msg_take_bufs
+ *
+ * each reference, including the one xio_msg_take_bufs returned, is
+ * dropped with its own xio_buf_put. the caller must already hold a
+ * reference on the buffer
+ *
+ * @param[in] buf	The buffer handle
+ *
+ * @returns the buffer handle
+ */
+struct xio_buf *xio_buf_get(struct xio_buf *buf);
+
+/**
+ * drops a reference on a buffer returned by xio_msg_take_bufs
+ *
+ * the last put returns the buffer to the transport's pool, the handle
+ * and the data it points to must not be used afterwards. may be called
+ * from any thread, but not after xio_shutdown
+ *
+ * @param[in] buf	The buffer handle
+ */
+void xio_buf_put(struct xio_buf *buf);
+
 /*---------------------------------------------------------------------------*/
 /* XIO errors		                                                     */
 /*---------------------------------------------------------------------------*/
@@ -1165,6 +1354,22 @@ struct xio_connection *xio_connect(
  */
 int xio_disconnect(struct xio_connection *conn);
 
+/**
+ * keeps idle transport connections (nexuses) to a portal open on a context.
+ * connections opened later by sessions on that context pick an idle one
+ * instead of paying the transport handshake. lost or consumed connections
+ * are replaced in the background. must be called from the context's thread.
+ *
+ * @param[in] ctx	The xio context handle
+ * @param[in] uri	portal uri to keep connections to
+ * @param[in] idle_nr	number of idle connections to keep. 0 stops keeping
+ *			connections to the portal
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_context_prewarm(struct xio_context *ctx, const char *uri,
+			int idle_nr);
+
 /**
  * free connection object
  *
@@ -1287,6 +1492,137 @@ int xio_poll_completions(struct xio_connection *conn,
 			 long min_nr, long nr,
 			 struct timespec *timeout);
 
+/*---------------------------------------------------------------------------*/
+/* XIO connection pool API						     */
+/*---------------------------------------------------------------------------*/
+/**
+ * creates a pool of connections over a client session, one connection per
+ * context. connections are spread over the portals advertised by the
+ * server and failed connections are drained and replaced in the
+ * background. the pool consumes the connection teardown events of its
+ * connections; all other session events are delivered as usual.
+ * when every connection is lost the pool keeps the session and
+ * re-establishes it, so on_session_established may be delivered again.
+ * destroying the session detaches it from the pool.
+ *
+ * @note the pool is not thread safe. all of its contexts must be
+ *	 dispatched by the thread that sends through the pool, e.g. by
+ *	 polling the descriptors returned by xio_context_get_poll_params
+ *	 from a single event loop.
+ *
+ * @param[in] params	pool creation parameters
+ *
+ * @returns xio connection pool handle, or NULL upon error
+ */
+struct xio_connection_pool *xio_connection_pool_create(
+		struct xio_connection_pool_params *params);
+
+/**
+ * disconnects all pool connections. the pool is released once the last
+ * connection is torn down; the session teardown event follows as usual.
+ *
+ * @param[in] pool	The xio connection pool handle
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_connection_pool_destroy(struct xio_connection_pool *pool);
+
+/**
+ * selects an online connection according to the pool policy
+ *
+ * @param[in] pool	The xio connection pool handle
+ * @param[in] key	affinity key, used by XIO_CONNECTION_POOL_CONSISTENT_HASH
+ *			only
+ *
+ * @returns xio connection handle, or NULL if no connection is online
+ */
+struct xio_connection *xio_connection_pool_get(
+		struct xio_connection_pool *pool,
+		uint64_t key);
+
+/**
+ * send request to responder over a pool selected connection
+ *
+ * @param[in] pool	The xio connection pool handle
+ * @param[in] req	request message to send
+ * @param[in] key	affinity key, used by XIO_CONNECTION_POOL_CONSISTENT_HASH
+ *			only
+ *
+ * @return success (0), or a (negative) error value
+ */
+int xio_connection_pool_send_request(struct xio_connection_pool *pool,
+				     struct xio_msg *req,
+				     uint64_t key);
+
+/*---------------------------------------------------------------------------*/
+/* XIO stream API							     */
+/*---------------------------------------------------------------------------*/
+/**
+ * accepts streams opened by the peer on a connection. the peer's stream
+ * chunks are not delivered to the session's on_msg callback
+ *
+ * @param[in] connection	The xio connection handle
+ * @param[in] ops		stream callbacks of the accepted streams
+ * @param[in] user_context	user private data passed to on_stream_open
+ *				and used as the streams' user context
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_stream_listen(struct xio_connection *connection,
+		      struct xio_stream_ops *ops,
+		      void *user_context);
+
+/**
+ * opens a stream on a connection. a large object is written as a sequence
+ * of chunks, each an ordinary request bound by the usual message size
+ * limits, so it never has to be staged in memory as a whole. at most
+ * "window" chunks are unacknowledged at any time.
+ *
+ * @param[in] params	stream creation parameters
+ *
+ * @returns xio stream handle, or NULL upon error
+ */
+struct xio_stream *xio_stream_open(struct xio_stream_params *params);
+
+/**
+ * writes the next chunk of a stream. the chunk's header and "in" side are
+ * reserved for the stream and the chunk must not be touched until
+ * on_stream_chunk_ack is called
+ *
+ * @param[in] stream	The xio stream handle
+ * @param[in] chunk	chunk to write
+ * @param[in] last	last chunk of the stream
+ *
+ * @returns success (0), or a (negative) error value. EAGAIN is set when
+ *	    the window is full; write again on the next on_stream_chunk_ack
+ */
+int xio_stream_write(struct xio_stream *stream,
+		     struct xio_msg *chunk,
+		     int last);
+
+/**
+ * acknowledges a received chunk and returns it to the library. the
+ * sender's window advances only as chunks are released, so a slow
+ * receiver throttles the sender. the chunk is released even on failure,
+ * which may close the stream
+ *
+ * @param[in] stream	The xio stream handle
+ * @param[in] chunk	chunk delivered by on_stream_chunk
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_stream_release_chunk(struct xio_stream *stream,
+			     struct xio_msg *chunk);
+
+/**
+ * sets the stream user context, e.g. from on_stream_open
+ *
+ * @param[in] stream		The xio stream handle
+ * @param[in] user_context	stream user context
+ */
+void xio_stream_set_user_context(struct xio_stream *stream,
+				 void *user_context);
+
 /*---------------------------------------------------------------------------*/
 /* XIO server API							     */
 /*---------------------------------------------------------------------------*/
@@ -1319,6 +1655,47 @@ struct xio_server *xio_bind(struct xio_context *ctx,
  */
 int xio_unbind(struct xio_server *server);
 
+/**
+ * register a worker portal for automatic session redirect. once enabled
+ * by xio_server_set_auto_redirect, new sessions that are not accepted,
+ * redirected or rejected from within on_new_session are redirected to the
+ * least loaded portal. load is measured on the portal's context by its
+ * connections, requests in flight and recent event loop utilization.
+ *
+ * @param[in] server	The xio server handle (the accepting server)
+ * @param[in] portal_uri The uri the worker is bound to
+ * @param[in] ctx	The worker's xio context handle
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_server_add_portal(struct xio_server *server,
+			  const char *portal_uri,
+			  struct xio_context *ctx);
+
+/**
+ * unregister a worker portal
+ *
+ * @param[in] server	The xio server handle
+ * @param[in] portal_uri The uri used at registration
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_server_del_portal(struct xio_server *server,
+			  const char *portal_uri);
+
+/**
+ * enable or disable automatic session redirect to the registered portals.
+ * it is off by default. a server that answers sessions asynchronously,
+ * after on_new_session returns, must leave it off.
+ *
+ * @param[in] server	The xio server handle (the accepting server)
+ * @param[in] enable	Nonzero to redirect sessions left unanswered by
+ *			on_new_session, zero to leave them to the application
+ *
+ * @returns success (0), or a (negative) error value
+ */
+int xio_server_set_auto_redirect(struct xio_server *server, int enable);
+
 /**
  * return connection handle on server
  *
@@ -1488,6 +1865,8 @@ struct xio_mempool *xio_mempool_create(int nodeid, uint32_t flags);
 /**
  * add an allocator to current set (setup only)
  *
+ * blocks are page aligned when size is a multiple of the page size
+ *
  * @param[in] mpool	  the memory pool
  * @param[in] size	  slab memory size
  * @param[in] min	  initial buffers to allocate
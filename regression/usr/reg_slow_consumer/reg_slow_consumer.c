@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "libxio.h"
+#include "reg_slow_consumer.h"
+
+#define SAMPLE_MS		100
+#define WARMUP_MS		500
+
+struct phase_result {
+	double			rate;
+	uint64_t		p50;
+	uint64_t		p99;
+	uint64_t		p999;
+	uint64_t		max;
+};
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0, int status)
+{
+	printf("Usage:\n");
+	printf("  %s [OPTIONS]\tfast and slow consumers on one server " \
+	       "context\n", argv0);
+	printf("\n");
+	printf("options:\n");
+	printf("\t-a, --addr=<addr>\t\tserver address (default 127.0.0.1)\n");
+	printf("\t-p, --port=<port>\t\tserver port (default 2061)\n");
+	printf("\t-r, --transport=<name>\t\ttransport (default tcp)\n");
+	printf("\t-f, --fast=<num>\t\tfast consumers (default 2)\n");
+	printf("\t-s, --slow=<num>\t\tslow consumers (default 2)\n");
+	printf("\t-m, --mode=<delay|stall>\tslow consumer behavior " \
+	       "(default delay)\n");
+	printf("\t-d, --delay=<ms>\t\tdelay mode: hold time of slow " \
+	       "messages (default 100)\n");
+	printf("\t-R, --push-rate=<num>\t\tstall mode: one way messages/s " \
+	       "pushed to each slow\n\t\t\t\t\tconsumer (default 10000)\n");
+	printf("\t-q, --queue-depth=<num>\t\tlibrary queue depth " \
+	       "(default: library default)\n");
+	printf("\t-o, --outstanding=<num>\t\tmessages in flight per " \
+	       "consumer (default 32)\n");
+	printf("\t-l, --len=<bytes>\t\tpayload length (default 4096)\n");
+	printf("\t-T, --time=<sec>\t\tduration of each phase (default 5)\n");
+	printf("\t-x, --max-ratio=<num>\t\tfail when the fast consumers' p99 " \
+	       "grows by more\n\t\t\t\t\tthan this factor (default 0, " \
+	       "report only)\n");
+	printf("\t-h, --help\t\t\tdisplay this help and exit\n");
+
+	exit(status);
+}
+
+/*---------------------------------------------------------------------------*/
+/* parse_cmdline							     */
+/*---------------------------------------------------------------------------*/
+static void parse_cmdline(struct sc_params *params, int argc, char **argv)
+{
+	static struct option const long_options[] = {
+		{ .name = "addr",	.has_arg = 1, .val = 'a'},
+		{ .name = "port",	.has_arg = 1, .val = 'p'},
+		{ .name = "transport",	.has_arg = 1, .val = 'r'},
+		{ .name = "fast",	.has_arg = 1, .val = 'f'},
+		{ .name = "slow",	.has_arg = 1, .val = 's'},
+		{ .name = "mode",	.has_arg = 1, .val = 'm'},
+		{ .name = "delay",	.has_arg = 1, .val = 'd'},
+		{ .name = "push-rate",	.has_arg = 1, .val = 'R'},
+		{ .name = "queue-depth", .has_arg = 1, .val = 'q'},
+		{ .name = "outstanding", .has_arg = 1, .val = 'o'},
+		{ .name = "len",	.has_arg = 1, .val = 'l'},
+		{ .name = "time",	.has_arg = 1, .val = 'T'},
+		{ .name = "max-ratio",	.has_arg = 1, .val = 'x'},
+		{ .name = "help",	.has_arg = 0, .val = 'h'},
+		{0, 0, 0, 0},
+	};
+	int c;
+
+	params->transport	= "tcp";
+	params->addr		= "127.0.0.1";
+	params->port		= 2061;
+	params->fast_nr		= 2;
+	params->slow_nr		= 2;
+	params->mode		= SC_MODE_DELAY;
+	params->delay_ms	= 100;
+	params->push_rate	= 10000;
+	params->outstanding	= 32;
+	params->msg_len		= 4096;
+	params->duration	= 5;
+
+	while ((c = getopt_long(argc, argv, "a:p:r:f:s:m:d:R:q:o:l:T:x:h",
+				long_options, NULL)) != -1) {
+		switch (c) {
+		case 'a':
+			params->addr = optarg;
+			break;
+		case 'p':
+			params->port = atoi(optarg);
+			break;
+		case 'r':
+			params->transport = optarg;
+			break;
+		case 'f':
+			params->fast_nr = atoi(optarg);
+			break;
+		case 's':
+			params->slow_nr = atoi(optarg);
+			break;
+		case 'm':
+			if (!strcmp(optarg, "delay"))
+				params->mode = SC_MODE_DELAY;
+			else if (!strcmp(optarg, "stall"))
+				params->mode = SC_MODE_STALL;
+			else
+				usage(argv[0], 1);
+			break;
+		case 'd':
+			params->delay_ms = atoi(optarg);
+			break;
+		case 'R':
+			params->push_rate = atoi(optarg);
+			break;
+		case 'q':
+			params->queue_depth = atoi(optarg);
+			break;
+		case 'o':
+			params->outstanding = atoi(optarg);
+			break;
+		case 'l':
+			params->msg_len = atoi(optarg);
+			break;
+		case 'T':
+			params->duration = atoi(optarg);
+			break;
+		case 'x':
+			params->max_ratio = atof(optarg);
+			break;
+		case 'h':
+			usage(argv[0], 0);
+			break;
+		default:
+			usage(argv[0], 1);
+			break;
+		}
+	}
+	if (optind < argc || params->fast_nr < 1 || params->slow_nr < 0 ||
+	    params->outstanding < 1 || params->msg_len < 0 ||
+	    params->duration < 1 || params->delay_ms < 0 ||
+	    params->push_rate < 0 || params->queue_depth < 0)
+		usage(argv[0], 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* get_time_ns								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* get_rss_kb								     */
+/*---------------------------------------------------------------------------*/
+static long get_rss_kb(void)
+{
+	FILE	*fp;
+	char	line[256];
+	long	rss = 0;
+
+	fp = fopen("/proc/self/status", "r");
+	if (!fp)
+		return 0;
+	while (fgets(line, sizeof(line), fp))
+		if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+			break;
+	fclose(fp);
+
+	return rss;
+}
+
+/*---------------------------------------------------------------------------*/
+/* collect								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t collect(struct sc_client **fast, int fast_nr,
+			struct perf_hist *hist)
+{
+	uint64_t	count = 0;
+	int		i;
+
+	for (i = 0; i < fast_nr; i++)
+		count += sc_client_collect(fast[i], hist);
+
+	return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/* run_phase - measures the fast consumers, sampling rss meanwhile	     */
+/*---------------------------------------------------------------------------*/
+static void run_phase(struct sc_params *params, struct sc_client **fast,
+		      struct phase_result *res, long *rss_max)
+{
+	struct perf_hist	*hist;
+	uint64_t		start, elapsed;
+	long			rss;
+
+	hist = calloc(1, sizeof(*hist));
+	if (!hist) {
+		memset(res, 0, sizeof(*res));
+		return;
+	}
+	perf_hist_reset(hist);
+
+	usleep(WARMUP_MS * 1000);
+	collect(fast, params->fast_nr, NULL);
+
+	start = get_time_ns();
+	do {
+		usleep(SAMPLE_MS * 1000);
+		rss = get_rss_kb();
+		if (rss > *rss_max)
+			*rss_max = rss;
+		elapsed = get_time_ns() - start;
+	} while (elapsed < params->duration * 1000000000ULL);
+	collect(fast, params->fast_nr, hist);
+
+	res->rate	= hist->count * 1e9 / elapsed;
+	res->p50	= perf_hist_percentile(hist, 50.0);
+	res->p99	= perf_hist_percentile(hist, 99.0);
+	res->p999	= perf_hist_percentile(hist, 99.9);
+	res->max	= hist->count ? hist->max : 0;
+
+	free(hist);
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_phase								     */
+/*---------------------------------------------------------------------------*/
+static void print_phase(const char *name, struct phase_result *res)
+{
+	printf("%-12s %12.0f %10.1f %10.1f %10.1f %10.1f\n", name, res->rate,
+	       res->p50 / 1000.0, res->p99 / 1000.0, res->p999 / 1000.0,
+	       res->max / 1000.0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct sc_params	params;
+	struct sc_server	*server;
+	struct sc_client	**fast, **slow;
+	struct sc_server_stats	stats;
+	struct phase_result	base, cont;
+	long			rss_start, rss_base, rss_max, rss_end;
+	double			p99_ratio, rate_ratio;
+	int			queue_depth = 0;
+	int			optlen = sizeof(queue_depth);
+	int			nodelay = 1;
+	int			i, retval = 0;
+
+	memset(&params, 0, sizeof(params));
+	parse_cmdline(&params, argc, argv);
+
+	xio_init();
+
+	if (params.queue_depth)
+		xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			    XIO_OPTNAME_QUEUE_DEPTH,
+			    &params.queue_depth, sizeof(params.queue_depth));
+	xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_QUEUE_DEPTH,
+		    &queue_depth, &optlen);
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_NO_DELAY,
+		    &nodelay, sizeof(nodelay));
+	if (params.outstanding > queue_depth) {
+		fprintf(stderr, "outstanding %d exceeds the queue depth %d\n",
+			params.outstanding, queue_depth);
+		retval = 1;
+		goto cleanup;
+	}
+
+	fast = calloc(params.fast_nr, sizeof(*fast));
+	slow = calloc(params.slow_nr + 1, sizeof(*slow));
+	if (!fast || !slow) {
+		retval = 1;
+		goto cleanup_arrays;
+	}
+
+	printf("fast consumers: %d, slow consumers: %d (%s", params.fast_nr,
+	       params.slow_nr,
+	       params.mode == SC_MODE_DELAY ? "delay" : "stall");
+	if (params.mode == SC_MODE_DELAY)
+		printf(" %d ms)\n", params.delay_ms);
+	else
+		printf(", %d pushes/s)\n", params.push_rate);
+	printf("outstanding: %d, payload: %d bytes, queue depth: %d, " \
+	       "phase: %d s\n", params.outstanding, params.msg_len,
+	       queue_depth, params.duration);
+
+	rss_start = get_rss_kb();
+
+	server = sc_server_start(&params);
+	if (!server) {
+		retval = 1;
+		goto cleanup_arrays;
+	}
+	for (i = 0; i < params.fast_nr; i++) {
+		fast[i] = sc_client_start(&params, SC_FAST, i);
+		if (!fast[i]) {
+			retval = 1;
+			goto cleanup_clients;
+		}
+	}
+
+	/* phase 1: fast consumers alone */
+	rss_base = 0;
+	run_phase(&params, fast, &base, &rss_base);
+
+	/* phase 2: slow consumers join the same server context */
+	for (i = 0; i < params.slow_nr; i++) {
+		slow[i] = sc_client_start(&params, SC_SLOW,
+					  params.fast_nr + i);
+		if (!slow[i]) {
+			retval = 1;
+			goto cleanup_clients;
+		}
+	}
+	rss_max = rss_base;
+	run_phase(&params, fast, &cont, &rss_max);
+	rss_end = get_rss_kb();
+	sc_server_get_stats(server, &stats);
+
+	p99_ratio  = base.p99 ? (double)cont.p99 / base.p99 : 0;
+	rate_ratio = base.rate ? cont.rate / base.rate : 0;
+
+	printf("\n%-12s %12s %10s %10s %10s %10s\n", "fast peers",
+	       "msgs/s", "p50[us]", "p99[us]", "p99.9[us]", "max[us]");
+	print_phase("baseline", &base);
+	print_phase("contention", &cont);
+	printf("p99 ratio: %.2f, throughput ratio: %.2f\n", p99_ratio,
+	       rate_ratio);
+
+	printf("\nserver: fast requests %" PRIu64 ", slow requests %" PRIu64
+	       ", slow one way %" PRIu64 "\n", stats.fast_reqs,
+	       stats.slow_reqs, stats.slow_one_way);
+	if (params.mode == SC_MODE_DELAY)
+		printf("server: held messages %" PRIu64 " (max %" PRIu64
+		       ")\n", stats.held, stats.held_max);
+	else
+		printf("server: pushes sent %" PRIu64 ", back pressured %"
+		       PRIu64 ", no buffer %" PRIu64 "\n", stats.pushes_sent,
+		       stats.pushes_rejected, stats.pushes_no_buf);
+	printf("memory: rss start %ld kB, baseline peak %ld kB, contention " \
+	       "peak %ld kB (%+ld kB), end %ld kB\n", rss_start, rss_base,
+	       rss_max, rss_max - rss_base, rss_end);
+
+	if (params.max_ratio > 0) {
+		if (!base.rate || !cont.rate || p99_ratio > params.max_ratio) {
+			printf("[fail] p99 ratio %.2f exceeds %.2f\n",
+			       p99_ratio, params.max_ratio);
+			retval = 1;
+		} else {
+			printf("[pass]\n");
+		}
+	}
+
+cleanup_clients:
+	for (i = 0; i < params.slow_nr; i++)
+		if (slow[i])
+			sc_client_stop(slow[i]);
+	for (i = 0; i < params.fast_nr; i++)
+		if (fast[i])
+			sc_client_stop(fast[i]);
+	sc_server_stop(server);
+
+cleanup_arrays:
+	free(slow);
+	free(fast);
+
+cleanup:
+	xio_shutdown();
+
+	return retval;
+}
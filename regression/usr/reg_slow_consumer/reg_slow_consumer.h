@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef REG_SLOW_CONSUMER_H
+#define REG_SLOW_CONSUMER_H
+
+#include <stdint.h>
+#include "xio_perftest_histogram.h"
+
+/*
+ * fast and slow peers share one server context. fast peers run a closed
+ * loop of requests and measure latency, slow peers misbehave in one of two
+ * ways:
+ *  delay - the server holds their requests and one way messages for
+ *	    "delay_ms" before responding / calling xio_release_msg
+ *  stall - they stop running their event loop, i.e. stop reading the
+ *	    socket, while the server keeps pushing one way messages to them
+ */
+
+enum sc_class {
+	SC_FAST,
+	SC_SLOW,
+};
+
+enum sc_mode {
+	SC_MODE_DELAY,
+	SC_MODE_STALL,
+};
+
+struct sc_params {
+	const char		*transport;
+	const char		*addr;
+	int			port;
+	int			fast_nr;
+	int			slow_nr;
+	int			queue_depth;
+	int			outstanding;
+	int			msg_len;
+	int			delay_ms;
+	int			push_rate;
+	int			duration;
+	enum sc_mode		mode;
+	double			max_ratio;
+};
+
+/* server side counters, cumulative since start */
+struct sc_server_stats {
+	uint64_t		fast_reqs;
+	uint64_t		slow_reqs;
+	uint64_t		slow_one_way;
+	uint64_t		held;
+	uint64_t		held_max;
+	uint64_t		pushes_sent;
+	uint64_t		pushes_rejected;
+	uint64_t		pushes_no_buf;
+};
+
+struct sc_server;
+struct sc_client;
+
+/*---------------------------------------------------------------------------*/
+/* server								     */
+/*---------------------------------------------------------------------------*/
+struct sc_server *sc_server_start(struct sc_params *params);
+
+void sc_server_get_stats(struct sc_server *server,
+			 struct sc_server_stats *stats);
+
+void sc_server_stop(struct sc_server *server);
+
+/*---------------------------------------------------------------------------*/
+/* clients								     */
+/*---------------------------------------------------------------------------*/
+struct sc_client *sc_client_start(struct sc_params *params,
+				  enum sc_class class, int id);
+
+/* folds the client's latencies since the last call into hist */
+uint64_t sc_client_collect(struct sc_client *client, struct perf_hist *hist);
+
+void sc_client_stop(struct sc_client *client);
+
+#endif /* REG_SLOW_CONSUMER_H */
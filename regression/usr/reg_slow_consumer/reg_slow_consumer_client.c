@@ -0,0 +1,493 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libxio.h"
+#include "reg_utils.h"
+#include "reg_slow_consumer.h"
+
+#define DRAIN_TIMEOUT_NS	(5 * 1000000000ULL)
+
+struct sc_req {
+	struct xio_msg			msg;	/* must be first */
+	uint64_t			start_ns;
+	int				one_way;
+	int				pad;
+};
+
+struct sc_client {
+	struct sc_params		*params;
+	enum sc_class			class;
+	int				id;
+	struct xio_context		*ctx;
+	struct xio_session		*session;
+	struct xio_connection		*connection;
+	struct sc_req			*reqs;
+	struct sc_req			**parked;
+	struct xio_buf			*out_xbuf;
+	struct xio_buf			*in_xbuf;
+	int				outstanding;
+	int				parked_nr;
+	int				disconnecting;
+	volatile int			stop;
+	volatile int			closed;
+	int				stalled;
+	int				established;
+	int				pad;
+	uint64_t			pushes_recv;
+	pthread_mutex_t			stall_lock;
+	pthread_cond_t			stall_cond;
+	pthread_spinlock_t		hist_lock;
+	int				pad1;
+	struct perf_hist		hist;
+	pthread_t			thread_id;
+};
+
+/*---------------------------------------------------------------------------*/
+/* get_time_ns								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* prepare_msg								     */
+/*---------------------------------------------------------------------------*/
+static void prepare_msg(struct sc_client *client, struct xio_msg *msg)
+{
+	struct xio_iovec_ex	*sglist;
+	int			msg_len = client->params->msg_len;
+
+	msg->in.header.iov_len	= 0;
+	msg->out.header.iov_len	= 0;
+
+	sglist = vmsg_sglist(&msg->out);
+	if (msg_len) {
+		sglist[0].iov_base	= client->out_xbuf->addr;
+		sglist[0].iov_len	= msg_len;
+		sglist[0].mr		= client->out_xbuf->mr;
+		vmsg_sglist_set_nents(&msg->out, 1);
+	} else {
+		vmsg_sglist_set_nents(&msg->out, 0);
+	}
+
+	/* large responses land in a shared, discarded, buffer */
+	sglist = vmsg_sglist(&msg->in);
+	if (msg_len > 8000) {
+		sglist[0].iov_base	= client->in_xbuf->addr;
+		sglist[0].iov_len	= client->in_xbuf->length;
+		sglist[0].mr		= client->in_xbuf->mr;
+		vmsg_sglist_set_nents(&msg->in, 1);
+	} else {
+		vmsg_sglist_set_nents(&msg->in, 0);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* send_one								     */
+/*---------------------------------------------------------------------------*/
+static int send_one(struct sc_client *client, struct sc_req *req)
+{
+	struct xio_msg		*msg = &req->msg;
+	int			retval;
+
+	prepare_msg(client, msg);
+	req->start_ns = get_time_ns();
+
+	if (req->one_way) {
+		msg->type	= XIO_MSG_TYPE_ONE_WAY;
+		msg->flags	= XIO_MSG_FLAG_IMM_SEND_COMP;
+		retval = xio_send_msg(client->connection, msg);
+	} else {
+		msg->type	= XIO_MSG_TYPE_REQ;
+		msg->flags	= 0;
+		retval = xio_send_request(client->connection, msg);
+	}
+	if (retval == -1) {
+		ERROR("client %d: send failed. %s\n", client->id,
+		      xio_strerror(xio_errno()));
+		return -1;
+	}
+	client->outstanding++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* complete_one								     */
+/*---------------------------------------------------------------------------*/
+static void complete_one(struct sc_client *client, struct sc_req *req)
+{
+	client->outstanding--;
+
+	if (!client->stop) {
+		/* a one way message completes once sent, it is resent along
+		 * with the next response so that the server's hold time
+		 * paces both kinds
+		 */
+		if (req->one_way) {
+			client->parked[client->parked_nr++] = req;
+			return;
+		}
+		send_one(client, req);
+		if (client->parked_nr)
+			send_one(client, client->parked[--client->parked_nr]);
+		return;
+	}
+
+	if (client->outstanding == 0)
+		xio_context_stop_loop(client->ctx, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg(struct xio_session *session,
+		  struct xio_msg *msg,
+		  int more_in_batch,
+		  void *cb_user_context)
+{
+	struct sc_client	*client = cb_user_context;
+	struct sc_req		*req = (struct sc_req *)msg;
+
+	/* one way traffic pushed by the server */
+	if (msg->type == XIO_MSG_TYPE_ONE_WAY) {
+		client->pushes_recv++;
+		xio_release_msg(msg);
+		return 0;
+	}
+
+	if (client->class == SC_FAST) {
+		pthread_spin_lock(&client->hist_lock);
+		perf_hist_record(&client->hist, get_time_ns() - req->start_ns);
+		pthread_spin_unlock(&client->hist_lock);
+	}
+	xio_release_response(msg);
+	complete_one(client, req);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_ow_msg_send_complete						     */
+/*---------------------------------------------------------------------------*/
+static int on_ow_msg_send_complete(struct xio_session *session,
+				   struct xio_msg *msg,
+				   void *cb_user_context)
+{
+	struct sc_client	*client = cb_user_context;
+
+	complete_one(client, (struct sc_req *)msg);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error, struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct sc_client	*client = cb_user_context;
+
+	client->stop = 1;
+	if (--client->outstanding == 0)
+		xio_context_stop_loop(client->ctx, 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* assign_data_in_buf							     */
+/*---------------------------------------------------------------------------*/
+static int assign_data_in_buf(struct xio_msg *msg, void *cb_user_context)
+{
+	struct sc_client	*client = cb_user_context;
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&msg->in);
+
+	vmsg_sglist_set_nents(&msg->in, 1);
+	sglist[0].iov_base	= client->in_xbuf->addr;
+	sglist[0].iov_len	= client->in_xbuf->length;
+	sglist[0].mr		= client->in_xbuf->mr;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct sc_client	*client = cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		client->established = 1;
+		xio_context_stop_loop(client->ctx, 0);
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+	case XIO_SESSION_CONNECTION_DISCONNECTED_EVENT:
+		ERROR("client %d: %s. reason: %s\n", client->id,
+		      xio_session_event_str(event_data->event),
+		      xio_strerror(event_data->reason));
+		client->stop = 1;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		client->connection = NULL;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		client->closed = 1;
+		xio_context_stop_loop(client->ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+static struct xio_session_ops client_ops = {
+	.on_session_event		=  on_session_event,
+	.on_session_established		=  NULL,
+	.on_msg				=  on_msg,
+	.on_ow_msg_send_complete	=  on_ow_msg_send_complete,
+	.on_msg_error			=  on_msg_error,
+	.assign_data_in_buf		=  assign_data_in_buf
+};
+
+/*---------------------------------------------------------------------------*/
+/* stall								     */
+/*---------------------------------------------------------------------------*/
+static void stall(struct sc_client *client)
+{
+	/* flush what was queued, then stop polling the socket altogether */
+	while (!client->established && !client->stop)
+		xio_context_run_loop(client->ctx, 100);
+	xio_context_run_loop(client->ctx, 10);
+
+	pthread_mutex_lock(&client->stall_lock);
+	client->stalled = 1;
+	while (!client->stop)
+		pthread_cond_wait(&client->stall_cond, &client->stall_lock);
+	client->stalled = 0;
+	pthread_mutex_unlock(&client->stall_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* client_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *client_thread(void *data)
+{
+	struct sc_client		*client = data;
+	struct sc_params		*params = client->params;
+	struct xio_session_params	sparams;
+	char				url[256];
+	int				class = client->class;
+	uint64_t			stop_ns = 0;
+	int				i;
+
+	sprintf(url, "%s://%s:%d", params->transport, params->addr,
+		params->port);
+
+	client->ctx = xio_context_create(NULL, 0, -1);
+	if (!client->ctx) {
+		ERROR("client %d: context creation failed\n", client->id);
+		return NULL;
+	}
+
+	memset(&sparams, 0, sizeof(sparams));
+	sparams.type			= XIO_SESSION_CLIENT;
+	sparams.ses_ops			= &client_ops;
+	sparams.user_context		= client;
+	sparams.uri			= url;
+	sparams.private_data		= &class;
+	sparams.private_data_len	= sizeof(class);
+
+	client->session = xio_session_create(&sparams);
+	if (!client->session) {
+		ERROR("client %d: session creation failed\n", client->id);
+		goto cleanup;
+	}
+
+	client->connection = xio_connect(client->session, client->ctx, 0,
+					 NULL, client);
+	if (!client->connection) {
+		ERROR("client %d: connect failed\n", client->id);
+		goto cleanup_session;
+	}
+
+	/* slow peers in delay mode mix in one way messages, which the server
+	 * holds before calling xio_release_msg
+	 */
+	for (i = 0; i < params->outstanding; i++) {
+		client->reqs[i].one_way = (class == SC_SLOW &&
+					   params->mode == SC_MODE_DELAY &&
+					   (i & 1));
+		if (send_one(client, &client->reqs[i]))
+			break;
+	}
+
+	if (class == SC_SLOW && params->mode == SC_MODE_STALL)
+		stall(client);
+
+	/* on stop, give messages in flight a bounded time to complete */
+	while (!client->closed) {
+		if (client->stop && !stop_ns)
+			stop_ns = get_time_ns();
+		if (stop_ns && !client->disconnecting && client->connection &&
+		    (!client->outstanding ||
+		     get_time_ns() - stop_ns > DRAIN_TIMEOUT_NS)) {
+			xio_disconnect(client->connection);
+			client->disconnecting = 1;
+		}
+		xio_context_run_loop(client->ctx, 100);
+	}
+
+cleanup_session:
+	xio_session_destroy(client->session);
+cleanup:
+	xio_context_destroy(client->ctx);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sc_client_start							     */
+/*---------------------------------------------------------------------------*/
+struct sc_client *sc_client_start(struct sc_params *params,
+				  enum sc_class class, int id)
+{
+	struct sc_client	*client;
+	int			len = params->msg_len ? params->msg_len : 1;
+
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	client->params	= params;
+	client->class	= class;
+	client->id	= id;
+	client->reqs	= calloc(params->outstanding, sizeof(*client->reqs));
+	client->parked	= calloc(params->outstanding,
+				 sizeof(*client->parked));
+	client->out_xbuf = xio_alloc(len);
+	client->in_xbuf	= xio_alloc(len);
+	if (!client->reqs || !client->parked || !client->out_xbuf ||
+	    !client->in_xbuf)
+		goto cleanup;
+
+	perf_hist_reset(&client->hist);
+	pthread_spin_init(&client->hist_lock, PTHREAD_PROCESS_PRIVATE);
+	pthread_mutex_init(&client->stall_lock, NULL);
+	pthread_cond_init(&client->stall_cond, NULL);
+
+	if (pthread_create(&client->thread_id, NULL, client_thread, client))
+		goto cleanup_sync;
+
+	return client;
+
+cleanup_sync:
+	pthread_cond_destroy(&client->stall_cond);
+	pthread_mutex_destroy(&client->stall_lock);
+	pthread_spin_destroy(&client->hist_lock);
+cleanup:
+	if (client->in_xbuf)
+		xio_free(&client->in_xbuf);
+	if (client->out_xbuf)
+		xio_free(&client->out_xbuf);
+	free(client->parked);
+	free(client->reqs);
+	free(client);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sc_client_collect							     */
+/*---------------------------------------------------------------------------*/
+uint64_t sc_client_collect(struct sc_client *client, struct perf_hist *hist)
+{
+	uint64_t	count;
+
+	pthread_spin_lock(&client->hist_lock);
+	count = client->hist.count;
+	if (hist)
+		perf_hist_merge(hist, &client->hist);
+	perf_hist_reset(&client->hist);
+	pthread_spin_unlock(&client->hist_lock);
+
+	return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sc_client_stop							     */
+/*---------------------------------------------------------------------------*/
+void sc_client_stop(struct sc_client *client)
+{
+	/* a stalled client resumes reading and drains like any other */
+	pthread_mutex_lock(&client->stall_lock);
+	client->stop = 1;
+	pthread_cond_signal(&client->stall_cond);
+	pthread_mutex_unlock(&client->stall_lock);
+
+	pthread_join(client->thread_id, NULL);
+
+	pthread_cond_destroy(&client->stall_cond);
+	pthread_mutex_destroy(&client->stall_lock);
+	pthread_spin_destroy(&client->hist_lock);
+	xio_free(&client->in_xbuf);
+	xio_free(&client->out_xbuf);
+	free(client->parked);
+	free(client->reqs);
+	free(client);
+}
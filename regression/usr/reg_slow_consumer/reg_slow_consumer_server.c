@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <sys/queue.h>
+#include <sys/timerfd.h>
+
+#include "libxio.h"
+#include "obj_pool.h"
+#include "reg_utils.h"
+#include "reg_slow_consumer.h"
+
+#define EXTRA_QDEPTH		128
+#define TICK_NS			1000000
+
+struct sc_held {
+	struct xio_msg			*msg;
+	uint64_t			due_ns;
+	TAILQ_ENTRY(sc_held)		held_list_entry;
+};
+
+struct sc_peer {
+	struct sc_server		*server;
+	struct xio_session		*session;
+	struct xio_connection		*connection;
+	enum sc_class			class;
+	int				closing;
+	/* stall mode: one way messages in flight and accrued push budget */
+	int				pushes_in_flight;
+	int				pad;
+	double				push_credit;
+	TAILQ_HEAD(, sc_held)		held_list;
+	TAILQ_ENTRY(sc_peer)		peers_list_entry;
+};
+
+struct sc_server {
+	struct sc_params		*params;
+	struct xio_context		*ctx;
+	struct obj_pool			*rsp_pool;
+	struct obj_pool			*push_pool;
+	struct xio_buf			*out_xbuf;
+	struct xio_buf			*in_xbuf;
+	struct sc_server_stats		stats;
+	pthread_spinlock_t		lock;
+	int				timer_fd;
+	int				queue_depth;
+	int				bound;
+	TAILQ_HEAD(, sc_peer)		peers_list;
+	pthread_barrier_t		barr;
+	pthread_t			thread_id;
+};
+
+/*---------------------------------------------------------------------------*/
+/* get_time_ns								     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* msg_obj_init								     */
+/*---------------------------------------------------------------------------*/
+static void msg_obj_init(void *user_context, void *obj)
+{
+	struct xio_msg *msg = obj;
+
+	msg->out.header.iov_len		= 0;
+	msg->in.header.iov_len		= 0;
+	vmsg_sglist_set_nents(&msg->in, 0);
+	vmsg_sglist_set_nents(&msg->out, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* fill_payload								     */
+/*---------------------------------------------------------------------------*/
+static void fill_payload(struct sc_server *server, struct xio_msg *msg)
+{
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&msg->out);
+
+	msg->in.header.iov_len	= 0;
+	msg->out.header.iov_len	= 0;
+	vmsg_sglist_set_nents(&msg->in, 0);
+
+	if (!server->params->msg_len) {
+		vmsg_sglist_set_nents(&msg->out, 0);
+		return;
+	}
+	/* payload content is irrelevant, every message shares one buffer */
+	sglist[0].iov_base	= server->out_xbuf->addr;
+	sglist[0].iov_len	= server->params->msg_len;
+	sglist[0].mr		= server->out_xbuf->mr;
+	vmsg_sglist_set_nents(&msg->out, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* send_response							     */
+/*---------------------------------------------------------------------------*/
+static void send_response(struct sc_server *server, struct xio_msg *req)
+{
+	struct xio_msg	*rsp;
+
+	rsp = obj_pool_get(server->rsp_pool);
+	if (!rsp) {
+		ERROR("response pool is empty\n");
+		return;
+	}
+	rsp->request		= req;
+	rsp->user_context	= server->rsp_pool;
+	fill_payload(server, rsp);
+
+	if (xio_send_response(rsp) == -1) {
+		ERROR("xio_send_response failed. %s\n",
+		      xio_strerror(xio_errno()));
+		obj_pool_put(server->rsp_pool, rsp);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* release_held								     */
+/*---------------------------------------------------------------------------*/
+static void release_held(struct sc_server *server, struct sc_held *held)
+{
+	if (held->msg->type == XIO_MSG_TYPE_ONE_WAY)
+		xio_release_msg(held->msg);
+	else
+		send_response(server, held->msg);
+	free(held);
+
+	pthread_spin_lock(&server->lock);
+	server->stats.held--;
+	pthread_spin_unlock(&server->lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg(struct xio_session *session,
+		  struct xio_msg *msg,
+		  int more_in_batch,
+		  void *cb_user_context)
+{
+	struct sc_peer		*peer = cb_user_context;
+	struct sc_server	*server = peer->server;
+	struct sc_held		*held;
+	int			one_way = (msg->type == XIO_MSG_TYPE_ONE_WAY);
+
+	pthread_spin_lock(&server->lock);
+	if (peer->class == SC_FAST)
+		server->stats.fast_reqs++;
+	else if (one_way)
+		server->stats.slow_one_way++;
+	else
+		server->stats.slow_reqs++;
+	pthread_spin_unlock(&server->lock);
+
+	if (peer->class == SC_FAST || server->params->mode != SC_MODE_DELAY)
+		goto process;
+
+	/* slow consumer: keep the message, and the receive resources behind
+	 * it, until it is due
+	 */
+	held = calloc(1, sizeof(*held));
+	if (!held)
+		goto process;
+	held->msg	= msg;
+	held->due_ns	= get_time_ns() +
+			  server->params->delay_ms * 1000000ULL;
+	TAILQ_INSERT_TAIL(&peer->held_list, held, held_list_entry);
+
+	pthread_spin_lock(&server->lock);
+	if (++server->stats.held > server->stats.held_max)
+		server->stats.held_max = server->stats.held;
+	pthread_spin_unlock(&server->lock);
+
+	return 0;
+
+process:
+	if (one_way)
+		xio_release_msg(msg);
+	else
+		send_response(server, msg);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_send_complete							     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_send_complete(struct xio_session *session,
+				struct xio_msg *msg,
+				void *cb_user_context)
+{
+	obj_pool_put(msg->user_context, msg);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_ow_msg_send_complete						     */
+/*---------------------------------------------------------------------------*/
+static int on_ow_msg_send_complete(struct xio_session *session,
+				   struct xio_msg *msg,
+				   void *cb_user_context)
+{
+	struct sc_peer		*peer = cb_user_context;
+
+	peer->pushes_in_flight--;
+	obj_pool_put(msg->user_context, msg);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error, struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct sc_peer		*peer = cb_user_context;
+
+	peer->closing = 1;
+	if (msg->user_context == peer->server->push_pool)
+		peer->pushes_in_flight--;
+	obj_pool_put(msg->user_context, msg);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* assign_data_in_buf							     */
+/*---------------------------------------------------------------------------*/
+static int assign_data_in_buf(struct xio_msg *msg, void *cb_user_context)
+{
+	struct sc_peer		*peer = cb_user_context;
+	struct sc_server	*server = peer->server;
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&msg->in);
+
+	/* payloads are discarded, held messages included */
+	vmsg_sglist_set_nents(&msg->in, 1);
+	sglist[0].iov_base	= server->in_xbuf->addr;
+	sglist[0].iov_len	= server->in_xbuf->length;
+	sglist[0].mr		= server->in_xbuf->mr;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* push_messages - stall mode, keeps one way traffic flowing to the peer     */
+/*---------------------------------------------------------------------------*/
+static void push_messages(struct sc_server *server, struct sc_peer *peer)
+{
+	struct xio_msg	*msg;
+	uint64_t	sent = 0, rejected = 0, no_buf = 0;
+
+	peer->push_credit += server->params->push_rate / 1000.0;
+	for (; peer->push_credit >= 1; peer->push_credit -= 1) {
+		/* beyond the queue depth the library would only fail the
+		 * send, count it as back pressure instead
+		 */
+		if (peer->pushes_in_flight >= server->queue_depth) {
+			rejected++;
+			continue;
+		}
+		msg = obj_pool_get(server->push_pool);
+		if (!msg) {
+			no_buf++;
+			continue;
+		}
+		msg->user_context = server->push_pool;
+		fill_payload(server, msg);
+		if (xio_send_msg(peer->connection, msg) == -1) {
+			obj_pool_put(server->push_pool, msg);
+			rejected++;
+			continue;
+		}
+		peer->pushes_in_flight++;
+		sent++;
+	}
+
+	pthread_spin_lock(&server->lock);
+	server->stats.pushes_sent	+= sent;
+	server->stats.pushes_rejected	+= rejected;
+	server->stats.pushes_no_buf	+= no_buf;
+	pthread_spin_unlock(&server->lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_tick								     */
+/*---------------------------------------------------------------------------*/
+static void on_tick(int fd, int events, void *data)
+{
+	struct sc_server	*server = data;
+	struct sc_peer		*peer;
+	struct sc_held		*held, *tmp_held;
+	uint64_t		expirations, now;
+
+	if (read(fd, &expirations, sizeof(expirations)) == -1)
+		return;
+
+	now = get_time_ns();
+	TAILQ_FOREACH(peer, &server->peers_list, peers_list_entry) {
+		if (peer->class != SC_SLOW || !peer->connection ||
+		    peer->closing)
+			continue;
+
+		TAILQ_FOREACH_SAFE(held, tmp_held, &peer->held_list,
+				   held_list_entry) {
+			if (held->due_ns > now)
+				break;
+			TAILQ_REMOVE(&peer->held_list, held, held_list_entry);
+			release_held(server, held);
+		}
+		if (server->params->mode == SC_MODE_STALL)
+			push_messages(server, peer);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* find_peer								     */
+/*---------------------------------------------------------------------------*/
+static struct sc_peer *find_peer(struct sc_server *server,
+				 struct xio_session *session)
+{
+	struct sc_peer	*peer;
+
+	TAILQ_FOREACH(peer, &server->peers_list, peers_list_entry)
+		if (peer->session == session)
+			return peer;
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct sc_server		*server = cb_user_context;
+	struct sc_peer			*peer = find_peer(server, session);
+	struct sc_held			*held;
+	struct xio_connection_attr	attr;
+
+	switch (event_data->event) {
+	case XIO_SESSION_NEW_CONNECTION_EVENT:
+		if (!peer)
+			break;
+		/* route the connection's callbacks to its peer */
+		peer->connection = event_data->conn;
+		memset(&attr, 0, sizeof(attr));
+		attr.user_context = peer;
+		xio_modify_connection(event_data->conn, &attr,
+				      XIO_CONNECTION_ATTR_USER_CTX);
+		break;
+	case XIO_SESSION_CONNECTION_DISCONNECTED_EVENT:
+	case XIO_SESSION_CONNECTION_CLOSED_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+		if (peer)
+			peer->closing = 1;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		if (peer) {
+			/* the library reclaimed whatever was still held */
+			while ((held = TAILQ_FIRST(&peer->held_list))) {
+				TAILQ_REMOVE(&peer->held_list, held,
+					     held_list_entry);
+				free(held);
+				pthread_spin_lock(&server->lock);
+				server->stats.held--;
+				pthread_spin_unlock(&server->lock);
+			}
+			peer->connection = NULL;
+		}
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		if (peer) {
+			TAILQ_REMOVE(&server->peers_list, peer,
+				     peers_list_entry);
+			free(peer);
+		}
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	struct sc_server	*server = cb_user_context;
+	struct sc_peer		*peer;
+	int			class = SC_FAST;
+
+	if (req->private_data_len >= sizeof(class))
+		memcpy(&class, req->private_data, sizeof(class));
+
+	peer = calloc(1, sizeof(*peer));
+	if (!peer) {
+		xio_reject(session, XIO_E_NO_BUFS, NULL, 0);
+		return 0;
+	}
+	peer->server	= server;
+	peer->session	= session;
+	peer->class	= class;
+	TAILQ_INIT(&peer->held_list);
+	TAILQ_INSERT_TAIL(&server->peers_list, peer, peers_list_entry);
+
+	/* all peers are served by the listening context */
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg_send_complete		=  on_msg_send_complete,
+	.on_ow_msg_send_complete	=  on_ow_msg_send_complete,
+	.on_msg				=  on_msg,
+	.on_msg_error			=  on_msg_error,
+	.assign_data_in_buf		=  assign_data_in_buf
+};
+
+/*---------------------------------------------------------------------------*/
+/* server_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *server_thread(void *data)
+{
+	struct sc_server	*server = data;
+	struct sc_params	*params = server->params;
+	struct xio_server	*listener = NULL;
+	struct itimerspec	its;
+	char			url[256];
+	int			peers = params->fast_nr + params->slow_nr;
+	int			optlen = sizeof(server->queue_depth);
+
+	if (xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_QUEUE_DEPTH,
+			&server->queue_depth, &optlen))
+		server->queue_depth = params->outstanding;
+
+	server->ctx = xio_context_create(NULL, 0, -1);
+	server->out_xbuf = xio_alloc(params->msg_len ? params->msg_len : 1);
+	server->in_xbuf = xio_alloc(params->msg_len ? params->msg_len : 1);
+	/* responses to a stalled peer stay in flight, so size for the
+	 * library's queue depth rather than the clients' window
+	 */
+	server->rsp_pool = obj_pool_init(peers * (server->queue_depth +
+						  EXTRA_QDEPTH),
+					 sizeof(struct xio_msg), NULL,
+					 msg_obj_init);
+	server->push_pool = obj_pool_init(params->slow_nr *
+					  (server->queue_depth +
+					   EXTRA_QDEPTH) + 1,
+					  sizeof(struct xio_msg), NULL,
+					  msg_obj_init);
+	server->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+					  TFD_NONBLOCK | TFD_CLOEXEC);
+	if (!server->ctx || !server->out_xbuf || !server->in_xbuf ||
+	    !server->rsp_pool || !server->push_pool || server->timer_fd == -1) {
+		pthread_barrier_wait(&server->barr);
+		goto cleanup;
+	}
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_nsec	= TICK_NS;
+	its.it_interval.tv_nsec	= TICK_NS;
+	timerfd_settime(server->timer_fd, 0, &its, NULL);
+	xio_context_add_ev_handler(server->ctx, server->timer_fd, XIO_POLLIN,
+				   on_tick, server);
+
+	sprintf(url, "%s://%s:%d", params->transport, params->addr,
+		params->port);
+	listener = xio_bind(server->ctx, &server_ops, url, NULL, 0, server);
+	if (!listener)
+		ERROR("failed to bind %s. %s\n", url,
+		      xio_strerror(xio_errno()));
+	server->bound = (listener != NULL);
+
+	pthread_barrier_wait(&server->barr);
+
+	if (listener) {
+		xio_context_run_loop(server->ctx, XIO_INFINITE);
+		xio_unbind(listener);
+	}
+	xio_context_del_ev_handler(server->ctx, server->timer_fd);
+
+cleanup:
+	if (server->timer_fd != -1)
+		close(server->timer_fd);
+	if (server->push_pool)
+		obj_pool_free(server->push_pool, NULL, NULL);
+	if (server->rsp_pool)
+		obj_pool_free(server->rsp_pool, NULL, NULL);
+	if (server->in_xbuf)
+		xio_free(&server->in_xbuf);
+	if (server->out_xbuf)
+		xio_free(&server->out_xbuf);
+	if (server->ctx)
+		xio_context_destroy(server->ctx);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sc_server_start							     */
+/*---------------------------------------------------------------------------*/
+struct sc_server *sc_server_start(struct sc_params *params)
+{
+	struct sc_server	*server;
+
+	server = calloc(1, sizeof(*server));
+	if (!server)
+		return NULL;
+
+	server->params = params;
+	server->timer_fd = -1;
+	TAILQ_INIT(&server->peers_list);
+	pthread_spin_init(&server->lock, PTHREAD_PROCESS_PRIVATE);
+	pthread_barrier_init(&server->barr, NULL, 2);
+
+	pthread_create(&server->thread_id, NULL, server_thread, server);
+	pthread_barrier_wait(&server->barr);
+
+	if (!server->bound) {
+		pthread_join(server->thread_id, NULL);
+		pthread_barrier_destroy(&server->barr);
+		pthread_spin_destroy(&server->lock);
+		free(server);
+		return NULL;
+	}
+
+	return server;
+}
+
+/*---------------------------------------------------------------------------*/
+/* sc_server_get_stats							     */
+/*---------------------------------------------------------------------------*/
+void sc_server_get_stats(struct sc_server *server,
+			 struct sc_server_stats *stats)
+{
+	pthread_spin_lock(&server->lock);
+	*stats = server->stats;
+	pthread_spin_unlock(&server->lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* sc_server_stop							     */
+/*---------------------------------------------------------------------------*/
+void sc_server_stop(struct sc_server *server)
+{
+	xio_context_stop_loop(server->ctx, 0);
+	pthread_join(server->thread_id, NULL);
+
+	pthread_barrier_destroy(&server->barr);
+	pthread_spin_destroy(&server->lock);
+	free(server);
+}
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# Configuring Running Directory
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+cd $DIR
+
+export LD_LIBRARY_PATH=../../../src/usr/
+
+# fast consumers must keep their p99 within 3x of the baseline while slow
+# consumers share the server context, in both misbehaving modes
+rc=0
+for mode in delay stall
+do
+	./reg_slow_consumer -m ${mode} -T 5 -x 3 "$@" 2>&1 | \
+		tee /tmp/reg_slow_consumer_${mode}.txt
+	if [ ${PIPESTATUS[0]} -ne 0 ]; then
+		rc=1
+	fi
+done
+
+exit $rc
@@ -76,6 +76,9 @@ void xio_set_error(int errnum);
 #define XIO_MSG_RSP_FLAG_FIRST		0x1
 #define XIO_MSG_RSP_FLAG_LAST		0x2
 
+/* request flags - a stream chunk or its acknowledge, above the user flags */
+#define XIO_MSG_FLAG_STREAM		(1 << 16)
+
 /**
  *  TLV types
  */
@@ -161,12 +164,17 @@ struct __attribute__((__packed__)) xio_tlv {
 
 struct __attribute__((__packed__)) xio_session_hdr {
 	uint32_t		dest_session_id;
-	uint32_t		pad;
+	uint32_t		src_session_id;
 	uint64_t		serial_num;
 	uint32_t		flags;
 	uint32_t		receipt_result;
 };
 
+/* destination of requests sent before the session setup response - the
+ * peer resolves the session by the header's src_session_id
+ */
+#define XIO_SESSION_ID_EARLY	0xffffffff
+
 /* setup flags */
 #define XIO_CID			1
 
@@ -246,6 +254,9 @@ size_t		xio_read_tlv(uint32_t *type, uint64_t *len, void **value,
 size_t		memcpyv(struct xio_iovec *dst, int dsize,
 			struct xio_iovec *src, int ssize);
 
+size_t		memcpyv_ex(struct xio_iovec_ex *dst, int dsize,
+			   struct xio_iovec_ex *src, int ssize);
+
 size_t		memclonev(struct xio_iovec *dst, int dsize,
 			  struct xio_iovec *src, int ssize);
 
@@ -46,6 +46,8 @@
 #include "xio_session.h"
 #include "xio_context.h"
 #include "xio_sg_table.h"
+#include "xio_stream.h"
+#include "xio_connection_pool.h"
 
 #define MSG_POOL_SZ			1024
 #define XIO_CONNECTION_TIMEOUT		60000
@@ -162,8 +164,11 @@ char *xio_connection_state_str(enum xio_connection_state state)
 /*---------------------------------------------------------------------------*/
 static int xio_is_connection_online(struct xio_connection *connection)
 {
-	    return connection->session->state == XIO_SESSION_STATE_ONLINE &&
-		   connection->state == XIO_CONNECTION_STATE_ONLINE;
+	if (unlikely(connection->early_data))
+		return connection->session->state == XIO_SESSION_STATE_CONNECT;
+
+	return connection->session->state == XIO_SESSION_STATE_ONLINE &&
+	       connection->state == XIO_CONNECTION_STATE_ONLINE;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -232,9 +237,11 @@ struct xio_connection *xio_connection_init(struct xio_session *session,
 		memcpy(&connection->ses_ops, &session->ses_ops,
 		       sizeof(session->ses_ops));
 
+		INIT_LIST_HEAD(&connection->connections_list_entry);
 		INIT_LIST_HEAD(&connection->io_tasks_list);
 		INIT_LIST_HEAD(&connection->post_io_tasks_list);
 		INIT_LIST_HEAD(&connection->pre_send_list);
+		INIT_LIST_HEAD(&connection->early_tasks_list);
 
 		xio_msg_list_init(&connection->reqs_msgq);
 		xio_msg_list_init(&connection->rsps_msgq);
@@ -246,10 +253,47 @@ struct xio_connection *xio_connection_init(struct xio_session *session,
 
 		kref_init(&connection->kref);
 		list_add_tail(&connection->ctx_list_entry, &ctx->ctx_list);
+		atomic_inc(&ctx->load.conns_nr);
+
+		connection->stats = xio_stats_shm_conn_get(ctx);
+		if (connection->stats) {
+			struct xio_stats_conn *slot = connection->stats;
+
+			xio_stats_write_begin(slot);
+			slot->session_id	= session->session_id;
+			slot->conn_idx		= conn_idx;
+			slot->session_type	= session->type;
+			if (session->uri)
+				strncpy(slot->uri, session->uri,
+					sizeof(slot->uri) - 1);
+			xio_stats_write_end(slot);
+		}
 
 		return connection;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stats_sample						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_stats_sample(struct xio_connection *connection)
+{
+	struct xio_stats_conn *slot = connection->stats;
+	struct xio_tasks_pool *pool;
+
+	slot->queued_msgs	= connection->queued_msgs;
+	slot->ctx_queued_msgs	=
+		atomic_read(&connection->ctx->load.queued_msgs);
+
+	if (!connection->nexus)
+		return;
+	pool = connection->nexus->primary_tasks_pool;
+	if (!pool)
+		return;
+	slot->pool_used		= pool->curr_used;
+	slot->pool_alloced	= pool->curr_alloced;
+	slot->pool_max_used	= pool->max_used;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_discard_receipt_req					     */
 /*---------------------------------------------------------------------------*/
@@ -372,10 +416,15 @@ int xio_connection_send(struct xio_connection *connection,
 		xio_connection_discard_receipt_req(msg);
 
 	hdr.flags		= msg->flags;
-	hdr.dest_session_id	= connection->session->peer_session_id;
+	hdr.src_session_id	= connection->session->session_id;
+	if (unlikely(connection->early_data) && !task->is_control)
+		hdr.dest_session_id = XIO_SESSION_ID_EARLY;
+	else
+		hdr.dest_session_id = connection->session->peer_session_id;
 	xio_session_write_header(task, &hdr);
 
 	/* send it */
+	xio_task_stamp(task, XIO_TASK_STAMP_NEXUS);
 	retval = xio_nexus_send(connection->nexus, task);
 	if (retval != 0) {
 		rc = (retval == -EAGAIN) ? EAGAIN : xio_errno();
@@ -413,7 +462,7 @@ int xio_connection_flush_msgs(struct xio_connection *connection)
 						 pmsg, pdata);
 		if ((pmsg->type == XIO_MSG_TYPE_REQ) ||
 		    (pmsg->type == XIO_ONE_WAY_REQ))
-			connection->queued_msgs--;
+			xio_connection_queued_dec(connection);
 
 		if (connection->queued_msgs < 0)
 			ERROR_LOG("queued_msgs:%d\n",
@@ -439,6 +488,48 @@ int xio_connection_flush_msgs(struct xio_connection *connection)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_rewind_early_msgs					     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_rewind_early_msgs(struct xio_connection *connection,
+				      struct xio_nexus *nexus)
+{
+	struct xio_msg		*pmsg, *tmp_pmsg, *omsg = NULL;
+	struct xio_tasks_slab	*slab;
+	struct xio_task		*task;
+	uint32_t		i;
+
+	/* the peer discarded the requests sent ahead of the setup response.
+	 * requeue them, in order, for the connection that takes over
+	 */
+
+	/* their tasks stay with the old nexus transport, which returns them
+	 * to its pool on close - cut them off the requeued messages
+	 */
+	list_for_each_entry(slab, &nexus->primary_tasks_pool->slabs_list,
+			    slabs_list_entry) {
+		for (i = 0; i < slab->nr; i++) {
+			task = slab->array[i];
+			if (task->connection == connection &&
+			    !task->is_control && IS_REQUEST(task->tlv_type))
+				task->omsg = NULL;
+		}
+	}
+
+	if (!xio_msg_list_empty(&connection->reqs_msgq))
+		omsg = xio_msg_list_first(&connection->reqs_msgq);
+	xio_msg_list_foreach_safe(pmsg, &connection->in_flight_reqs_msgq,
+				  tmp_pmsg, pdata) {
+		xio_msg_list_remove(&connection->in_flight_reqs_msgq,
+				    pmsg, pdata);
+		if (omsg)
+			xio_msg_list_insert_before(omsg, pmsg, pdata);
+		else
+			xio_msg_list_insert_tail(&connection->reqs_msgq,
+						 pmsg, pdata);
+	}
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_notify_req_msgs_flush					     */
 /*---------------------------------------------------------------------------*/
@@ -496,6 +587,10 @@ int xio_connection_notify_msgs_flush(struct xio_connection *connection)
 
 	xio_connection_notify_rsp_msgs_flush(connection);
 
+	xio_connection_load_drop(connection);
+
+	xio_streams_flush(connection);
+
 	connection->is_flushed = 1;
 
 	return 0;
@@ -508,6 +603,8 @@ int xio_connection_flush_tasks(struct xio_connection *connection)
 {
 	struct xio_task		*ptask, *pnext_task;
 
+	xio_connection_load_drop(connection);
+
 	if (!(connection->nexus))
 		return 0;
 
@@ -524,6 +621,19 @@ int xio_connection_flush_tasks(struct xio_connection *connection)
 		}
 	}
 
+	if (!list_empty(&connection->early_tasks_list)) {
+		TRACE_LOG("early_tasks_list not empty!\n");
+		list_for_each_entry_safe(ptask, pnext_task,
+					 &connection->early_tasks_list,
+					 tasks_list_entry) {
+			TRACE_LOG("early_tasks_list: task %p, " \
+				  "type 0x%x ltid:%d\n",
+				  ptask,
+				  ptask->tlv_type, ptask->ltid);
+			xio_tasks_pool_put(ptask);
+		}
+	}
+
 	if (!list_empty(&connection->pre_send_list)) {
 		TRACE_LOG("pre_send_list not empty!\n");
 		list_for_each_entry_safe(ptask, pnext_task,
@@ -844,10 +954,13 @@ int xio_send_request(struct xio_connection *connection,
 		xio_stat_add(stats, XIO_STAT_TX_BYTES,
 			     vmsg->header.iov_len +
 			     tbl_length(sgtbl_ops, sgtbl));
+		xio_connection_stats_tx(connection,
+					vmsg->header.iov_len +
+					tbl_length(sgtbl_ops, sgtbl));
 
 		pmsg->sn = xio_session_get_sn(connection->session);
 		pmsg->type = XIO_MSG_TYPE_REQ;
-		connection->queued_msgs++;
+		xio_connection_queued_inc(connection);
 		if (nr == -1)
 			xio_msg_list_insert_tail(&connection->reqs_msgq, pmsg,
 						 pdata);
@@ -898,6 +1011,9 @@ int xio_send_response(struct xio_msg *msg)
 			retval = -1;
 			goto send;
 		}
+		/* request is answered - no longer loads the context */
+		xio_connection_load_dec(connection);
+
 		if (unlikely(
 		     (connection->state != XIO_CONNECTION_STATE_ONLINE  &&
 		     connection->state != XIO_CONNECTION_STATE_ESTABLISHED &&
@@ -917,6 +1033,9 @@ int xio_send_response(struct xio_msg *msg)
 		/* Server latency */
 		xio_stat_add(stats, XIO_STAT_APPDELAY,
 			     get_cycles() - task->imsg.timestamp);
+		xio_connection_stats_lat(connection, XIO_STATS_HIST_APP,
+					 get_cycles() - task->imsg.timestamp);
+		pmsg->timestamp = get_cycles();
 
 		valid = xio_session_is_valid_out_msg(connection->session, pmsg);
 		if (!valid) {
@@ -934,6 +1053,9 @@ int xio_send_response(struct xio_msg *msg)
 		xio_stat_add(stats, XIO_STAT_TX_BYTES,
 			     vmsg->header.iov_len +
 			     tbl_length(sgtbl_ops, sgtbl));
+		xio_connection_stats_tx(connection,
+					vmsg->header.iov_len +
+					tbl_length(sgtbl_ops, sgtbl));
 
 		pmsg->flags = XIO_MSG_RSP_FLAG_LAST;
 		if ((pmsg->request->flags &
@@ -1059,11 +1181,14 @@ int xio_send_msg(struct xio_connection *connection,
 		xio_stat_add(stats, XIO_STAT_TX_BYTES,
 			     vmsg->header.iov_len +
 			     tbl_length(sgtbl_ops, sgtbl));
+		xio_connection_stats_tx(connection,
+					vmsg->header.iov_len +
+					tbl_length(sgtbl_ops, sgtbl));
 
 		pmsg->sn = xio_session_get_sn(connection->session);
 		pmsg->type = XIO_ONE_WAY_REQ;
 
-		connection->queued_msgs++;
+		xio_connection_queued_inc(connection);
 		if (nr == -1)
 			xio_msg_list_insert_tail(&connection->reqs_msgq, pmsg,
 						 pdata);
@@ -1093,7 +1218,8 @@ send:
 int xio_connection_xmit_msgs(struct xio_connection *connection)
 {
 	if (connection->state == XIO_CONNECTION_STATE_ONLINE ||
-	    connection->state == XIO_CONNECTION_STATE_FIN_WAIT_1) {
+	    connection->state == XIO_CONNECTION_STATE_FIN_WAIT_1 ||
+	    connection->early_data) {
 		return xio_connection_xmit(connection);
 	}
 
@@ -1126,7 +1252,12 @@ static void xio_connection_release(struct kref *kref)
 				 &connection->fin_work);
 
 	xio_free_ow_msg_pool(connection);
+	xio_streams_free(connection);
 	list_del(&connection->ctx_list_entry);
+	atomic_dec(&connection->ctx->load.conns_nr);
+	xio_connection_load_drop(connection);
+	if (connection->stats)
+		xio_stats_shm_conn_put(connection->stats);
 
 	kfree(connection);
 }
@@ -1183,7 +1314,7 @@ int xio_release_response(struct xio_msg *msg)
 			return -1;
 		}
 		connection = task->connection;
-		connection->queued_msgs--;
+		xio_connection_queued_dec(connection);
 		list_move_tail(&task->tasks_list_entry,
 			       &connection->post_io_tasks_list);
 
@@ -1267,7 +1398,7 @@ static void xio_fin_req_timeout(void *data)
 	/* flush all messages back to user */
 	xio_connection_notify_msgs_flush(connection);
 
-	connection->state = XIO_CONNECTION_STATE_CLOSED;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_CLOSED);
 
 
 	if (!connection->disable_notify)
@@ -1381,7 +1512,7 @@ int xio_disconnect_initial_connection(struct xio_connection *connection)
 		  xio_connection_state_str(connection->state),
 		  xio_connection_state_str(XIO_CONNECTION_STATE_FIN_WAIT_1));
 
-	connection->state = XIO_CONNECTION_STATE_FIN_WAIT_1;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_FIN_WAIT_1);
 	/* we don't want to send all queued messages yet - send directly */
 	retval = xio_connection_send(connection, msg);
 	if (retval == -EAGAIN)
@@ -1403,7 +1534,7 @@ static void xio_pre_disconnect(void *_connection)
 	if (connection->state != XIO_CONNECTION_STATE_ONLINE)
 		return;
 
-	connection->state = XIO_CONNECTION_STATE_FIN_WAIT_1;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_FIN_WAIT_1);
 	xio_send_fin_req(connection);
 
 	if (!connection->disable_notify) {
@@ -1677,6 +1808,18 @@ static inline void xio_session_teardown(void *_session)
 	xio_session_notify_teardown(session, session->teardown_reason);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_schedule_teardown					     */
+/*---------------------------------------------------------------------------*/
+int xio_session_schedule_teardown(struct xio_session *session,
+				  struct xio_context *ctx, int reason)
+{
+	session->teardown_reason = reason;
+
+	return xio_ctx_add_work(ctx, session, xio_session_teardown,
+				&session->teardown_work);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_post_destroy						     */
 /*---------------------------------------------------------------------------*/
@@ -1722,10 +1865,16 @@ int xio_connection_post_destroy(struct xio_connection *connection)
 		retval = xio_connection_close(session->redir_connection);
 		session->redir_connection = NULL;
 		TRACE_LOG("redirected connection is closed\n");
+	} else if (list_empty(&connection->connections_list_entry)) {
+		/* a lead stand-in whose close outlived the session setup */
+		retval = xio_connection_close(connection);
 	} else {
 		spin_lock(&session->connections_list_lock);
-		if (session->connections_nr == 1)  {
-			session->state = XIO_SESSION_STATE_CLOSING;
+		/* a connection pool keeps the session to refill it */
+		if (session->connections_nr == 1 &&
+		    !xio_connection_pool_holds_session(session->cpool)) {
+			xio_session_set_state(session,
+					      XIO_SESSION_STATE_CLOSING);
 			destroy_session = 1;
 		}
 		session->connections_nr--;
@@ -1762,14 +1911,9 @@ int xio_connection_post_destroy(struct xio_connection *connection)
 		spin_lock(&session->connections_list_lock);
 		destroy_session = (session->connections_nr == 0);
 		spin_unlock(&session->connections_list_lock);
-		if (destroy_session) {
-			session->teardown_reason = reason;
-			retval = xio_ctx_add_work(
-					ctx,
-					session,
-					xio_session_teardown,
-					&session->teardown_work);
-		}
+		if (destroy_session)
+			retval = xio_session_schedule_teardown(session, ctx,
+							       reason);
 	}
 
 	return 0;
@@ -1819,7 +1963,8 @@ int xio_connection_destroy(struct xio_connection *connection)
 			  xio_connection_state_str(connection->state),
 			  xio_connection_state_str(
 				  XIO_CONNECTION_STATE_LAST_ACK));
-		connection->state = XIO_CONNECTION_STATE_LAST_ACK;
+		xio_connection_set_state(connection,
+					 XIO_CONNECTION_STATE_LAST_ACK);
 	} else {
 		DEBUG_LOG("connection:%p, state:%s\n", connection,
 			  xio_connection_state_str(connection->state));
@@ -1863,7 +2008,7 @@ int xio_connection_disconnected(struct xio_connection *connection)
 	/* flush all messages back to user */
 	xio_connection_notify_msgs_flush(connection);
 
-	connection->state	 = XIO_CONNECTION_STATE_DISCONNECTED;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_DISCONNECTED);
 
 	if (connection->nexus) {
 		if (connection->session->lead_connection &&
@@ -1909,7 +2054,7 @@ int xio_connection_refused(struct xio_connection *connection)
 	/* flush all messages back to user */
 	xio_connection_notify_msgs_flush(connection);
 
-	connection->state	 = XIO_CONNECTION_STATE_DISCONNECTED;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_DISCONNECTED);
 
 	xio_session_notify_connection_teardown(connection->session,
 					       connection);
@@ -1934,7 +2079,7 @@ int xio_connection_error_event(struct xio_connection *connection,
 	/* flush all messages back to user */
 	xio_connection_notify_msgs_flush(connection);
 
-	connection->state	 = XIO_CONNECTION_STATE_ERROR;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_ERROR);
 	xio_session_notify_connection_teardown(connection->session,
 					       connection);
 
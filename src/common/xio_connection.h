@@ -39,6 +39,8 @@
 #define XIO_CONNECTION_H
 
 #include "xio_msg_list.h"
+#include "xio_stats_shm.h"
+#include "xio_trace.h"
 
 
 enum xio_connection_state {
@@ -80,9 +82,10 @@ struct xio_connection {
 	uint16_t			disable_notify;
 	uint16_t			in_close;
 	uint16_t			is_flushed;
-	uint16_t			pad[3];
+	uint16_t			early_data; /* sending ahead of setup */
 	uint32_t			close_reason;
 	uint32_t			queued_msgs;
+	uint32_t			load_msgs; /* share of ctx load */
 	struct kref			kref;
 	int32_t				send_req_toggle;
 
@@ -101,13 +104,119 @@ struct xio_connection {
 	struct list_head		io_tasks_list;
 	struct list_head		post_io_tasks_list;
 	struct list_head		pre_send_list;
+	struct list_head		early_tasks_list; /* parked on server */
 	struct list_head		connections_list_entry;
 	struct list_head		ctx_list_entry;
 	struct xio_session_ops		ses_ops;
 	void				*cb_user_context;
+	struct xio_stats_conn		*stats;	/* shared memory slot */
+	struct xio_stream_conn		*streams; /* streams on connection */
 
 };
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stats_sample						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_stats_sample(struct xio_connection *connection);
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stats_tx						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_stats_tx(struct xio_connection *connection,
+					   uint64_t bytes)
+{
+	struct xio_stats_conn *slot = connection->stats;
+
+	if (!slot)
+		return;
+	xio_stats_write_begin(slot);
+	slot->tx_msgs++;
+	slot->tx_bytes += bytes;
+	xio_connection_stats_sample(connection);
+	xio_stats_write_end(slot);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stats_rx						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_stats_rx(struct xio_connection *connection,
+					   int msgs, uint64_t bytes)
+{
+	struct xio_stats_conn *slot = connection->stats;
+
+	if (!slot)
+		return;
+	xio_stats_write_begin(slot);
+	slot->rx_msgs += msgs;
+	slot->rx_bytes += bytes;
+	xio_connection_stats_sample(connection);
+	xio_stats_write_end(slot);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stats_lat						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_stats_lat(struct xio_connection *connection,
+					    int hist, uint64_t cycles)
+{
+	struct xio_stats_conn *slot = connection->stats;
+
+	if (!slot)
+		return;
+	xio_stats_write_begin(slot);
+	xio_stats_hist_add(slot, hist, cycles);
+	xio_stats_write_end(slot);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_load_inc						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_load_inc(struct xio_connection *connection)
+{
+	connection->load_msgs++;
+	atomic_inc(&connection->ctx->load.queued_msgs);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_load_dec						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_load_dec(struct xio_connection *connection)
+{
+	if (!connection->load_msgs)
+		return;
+	connection->load_msgs--;
+	atomic_dec(&connection->ctx->load.queued_msgs);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_load_drop						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_load_drop(struct xio_connection *connection)
+{
+	/* flushed and unanswered messages stop loading the context */
+	atomic_sub(connection->load_msgs,
+		   &connection->ctx->load.queued_msgs);
+	connection->load_msgs = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_queued_inc						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_queued_inc(struct xio_connection *connection)
+{
+	connection->queued_msgs++;
+	xio_connection_load_inc(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_queued_dec						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_queued_dec(struct xio_connection *connection)
+{
+	connection->queued_msgs--;
+	xio_connection_load_dec(connection);
+}
+
 struct xio_connection *xio_connection_init(
 		struct xio_session *session,
 		struct xio_context *ctx, int conn_idx,
@@ -144,6 +253,7 @@ static inline void xio_connection_set_state(
 				struct xio_connection *connection,
 				enum xio_connection_state state)
 {
+	xio_trace3(connection_state, connection, connection->state, state);
 	connection->state = state;
 }
 
@@ -182,6 +292,9 @@ int xio_connection_error_event(struct xio_connection *connection,
 
 int xio_connection_flush_msgs(struct xio_connection *connection);
 
+void xio_connection_rewind_early_msgs(struct xio_connection *connection,
+				      struct xio_nexus *nexus);
+
 int xio_connection_flush_tasks(struct xio_connection *connection);
 
 int xio_connection_notify_msgs_flush(struct xio_connection *connection);
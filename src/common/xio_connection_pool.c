@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_common.h"
+#include "xio_protocol.h"
+#include "xio_observer.h"
+#include "xio_task.h"
+#include "xio_context.h"
+#include "xio_transport.h"
+#include "xio_hash.h"
+#include "xio_session.h"
+#include "xio_connection.h"
+#include "xio_connection_pool.h"
+
+#define XIO_CPOOL_RECONNECT_DELAY_MS		100
+#define XIO_CPOOL_MAX_RECONNECT_DELAY_MS	5000
+
+/*---------------------------------------------------------------------------*/
+/* enums								     */
+/*---------------------------------------------------------------------------*/
+enum xio_cpool_slot_state {
+	XIO_CPOOL_SLOT_DOWN,		/* no connection, maybe reconnecting  */
+	XIO_CPOOL_SLOT_CONNECTING,	/* connect issued, not yet online     */
+	XIO_CPOOL_SLOT_ACTIVE,		/* online, eligible for new requests  */
+	XIO_CPOOL_SLOT_DRAINING,	/* failed, waiting for teardown	      */
+};
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_cpool_slot {
+	struct xio_connection_pool	*pool;
+	struct xio_connection		*connection;
+	struct xio_context		*ctx;
+	enum xio_cpool_slot_state	state;
+	int				reconnect_delay_ms;
+	xio_delayed_work_handle_t	reconnect_work;
+};
+
+struct xio_connection_pool {
+	struct xio_session		*session;
+	struct xio_cpool_slot		*slots;
+	void				*conn_user_context;
+	enum xio_connection_pool_policy	policy;
+	int				slots_nr;
+	int				live_nr;  /* slots owning a connection */
+	int				next_slot;
+	int				min_reconnect_delay_ms;
+	int				max_reconnect_delay_ms;
+	int				closing;
+	int				teardown_reason; /* last connection's */
+};
+
+/*---------------------------------------------------------------------------*/
+/* forward declarations							     */
+/*---------------------------------------------------------------------------*/
+static void xio_cpool_reconnect(void *data);
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_slot_usable						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_cpool_slot_usable(struct xio_cpool_slot *slot)
+{
+	return slot->state == XIO_CPOOL_SLOT_ACTIVE &&
+	       slot->connection->state == XIO_CONNECTION_STATE_ONLINE;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_score							     */
+/*---------------------------------------------------------------------------*/
+/* rendezvous (highest random weight) score of key on slot. only the keys   */
+/* owned by a failed slot move when it leaves the pool and no floating	     */
+/* point is needed, so the same code runs in the kernel			     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_cpool_score(uint64_t key, int slot_idx)
+{
+	uint64_t x = key ^ ((uint64_t)(slot_idx + 1) * 0x9e3779b97f4a7c15ULL);
+
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+
+	return x;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_find_slot							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_cpool_slot *xio_cpool_find_slot(
+		struct xio_connection_pool *pool,
+		struct xio_connection *connection)
+{
+	int i;
+
+	for (i = 0; i < pool->slots_nr; i++)
+		if (pool->slots[i].connection == connection)
+			return &pool->slots[i];
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_cpool_free(struct xio_connection_pool *pool)
+{
+	if (pool->session && pool->session->cpool == pool)
+		pool->session->cpool = NULL;
+	kfree(pool->slots);
+	kfree(pool);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_cancel_reconnects						     */
+/*---------------------------------------------------------------------------*/
+static void xio_cpool_cancel_reconnects(struct xio_connection_pool *pool)
+{
+	struct xio_cpool_slot *slot;
+	int i;
+
+	for (i = 0; i < pool->slots_nr; i++) {
+		slot = &pool->slots[i];
+		if (xio_is_delayed_work_pending(&slot->reconnect_work))
+			xio_ctx_del_delayed_work(slot->ctx,
+						 &slot->reconnect_work);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_slot_connect						     */
+/*---------------------------------------------------------------------------*/
+static int xio_cpool_slot_connect(struct xio_cpool_slot *slot)
+{
+	struct xio_connection_pool *pool = slot->pool;
+
+	/* every connection was lost and the server side session went with
+	 * them - set the session up from scratch
+	 */
+	if (pool->session->connections_nr == 0 &&
+	    pool->session->state != XIO_SESSION_STATE_INIT)
+		xio_session_client_reset(pool->session);
+
+	/* conn_idx 0 lets the session rotate over the advertised portals,
+	 * so a replacement lands on the next portal rather than the one
+	 * that just failed
+	 */
+	slot->connection = xio_connect(pool->session, slot->ctx, 0, NULL,
+				       pool->conn_user_context);
+	if (slot->connection == NULL) {
+		slot->state = XIO_CPOOL_SLOT_DOWN;
+		return -1;
+	}
+	slot->state = XIO_CPOOL_SLOT_CONNECTING;
+	pool->live_nr++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_schedule_reconnect						     */
+/*---------------------------------------------------------------------------*/
+static void xio_cpool_schedule_reconnect(struct xio_cpool_slot *slot)
+{
+	struct xio_connection_pool *pool = slot->pool;
+	int retval;
+
+	if (pool->closing)
+		return;
+
+	/* do not resurrect a session that is rejected or torn down */
+	if (!xio_connection_pool_holds_session(pool))
+		return;
+
+	DEBUG_LOG("pool:%p slot:%p reconnect in %d msec\n",
+		  pool, slot, slot->reconnect_delay_ms);
+
+	retval = xio_ctx_add_delayed_work(slot->ctx,
+					  slot->reconnect_delay_ms, slot,
+					  xio_cpool_reconnect,
+					  &slot->reconnect_work);
+	if (retval != 0) {
+		ERROR_LOG("pool:%p failed to schedule reconnect\n", pool);
+		return;
+	}
+
+	slot->reconnect_delay_ms *= 2;
+	if (slot->reconnect_delay_ms > pool->max_reconnect_delay_ms)
+		slot->reconnect_delay_ms = pool->max_reconnect_delay_ms;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_cpool_reconnect							     */
+/*---------------------------------------------------------------------------*/
+static void xio_cpool_reconnect(void *data)
+{
+	struct xio_cpool_slot *slot = data;
+
+	if (slot->pool->closing || slot->connection)
+		return;
+
+	if (xio_cpool_slot_connect(slot) != 0) {
+		WARN_LOG("pool:%p slot:%p reconnect failed\n",
+			 slot->pool, slot);
+		xio_cpool_schedule_reconnect(slot);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_on_event						     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_pool_on_event(struct xio_connection_pool *pool,
+				 struct xio_session_event_data *event)
+{
+	struct xio_cpool_slot *slot;
+
+	if (event->conn == NULL)
+		return 0;
+
+	slot = xio_cpool_find_slot(pool, event->conn);
+	if (slot == NULL)
+		return 0;
+
+	switch (event->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		if (pool->closing) {
+			xio_disconnect(slot->connection);
+			break;
+		}
+		slot->state = XIO_CPOOL_SLOT_ACTIVE;
+		slot->reconnect_delay_ms = pool->min_reconnect_delay_ms;
+		break;
+	case XIO_SESSION_CONNECTION_CLOSED_EVENT:
+	case XIO_SESSION_CONNECTION_DISCONNECTED_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+		/* stop routing to it, in flight requests are flushed back
+		 * to the user via on_msg_error
+		 */
+		slot->state = XIO_CPOOL_SLOT_DRAINING;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		/* the pool owns its connections - release and replace */
+		pool->teardown_reason = event->reason;
+		slot->connection = NULL;
+		slot->state = XIO_CPOOL_SLOT_DOWN;
+		pool->live_nr--;
+		xio_connection_destroy(event->conn);
+		if (pool->closing) {
+			if (pool->live_nr == 0)
+				xio_cpool_free(pool);
+		} else {
+			xio_cpool_schedule_reconnect(slot);
+		}
+		return 1;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_holds_session					     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_pool_holds_session(struct xio_connection_pool *pool)
+{
+	if (pool == NULL || pool->closing)
+		return 0;
+
+	switch (pool->session->state) {
+	case XIO_SESSION_STATE_REJECTED:
+	case XIO_SESSION_STATE_CLOSING:
+	case XIO_SESSION_STATE_CLOSED:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_detach						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_pool_detach(struct xio_connection_pool *pool)
+{
+	/* the session is going away under the pool; the handle stays valid
+	 * until the application calls xio_connection_pool_destroy
+	 */
+	xio_cpool_cancel_reconnects(pool);
+	pool->closing = 1;
+	pool->session->cpool = NULL;
+	pool->session = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_create						     */
+/*---------------------------------------------------------------------------*/
+struct xio_connection_pool *xio_connection_pool_create(
+		struct xio_connection_pool_params *params)
+{
+	struct xio_connection_pool *pool;
+	struct xio_cpool_slot *slot;
+	int i;
+
+	if (params == NULL || params->session == NULL ||
+	    params->ctxs == NULL || params->ctxs_nr <= 0) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid connection pool parameters\n");
+		return NULL;
+	}
+	if (params->session->type != XIO_SESSION_CLIENT ||
+	    params->session->cpool) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("session:%p can not host a connection pool\n",
+			  params->session);
+		return NULL;
+	}
+
+	pool = kcalloc(1, sizeof(*pool), GFP_KERNEL);
+	if (pool == NULL) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("calloc failed. %m\n");
+		return NULL;
+	}
+	pool->slots = kcalloc(params->ctxs_nr, sizeof(*pool->slots),
+			      GFP_KERNEL);
+	if (pool->slots == NULL) {
+		kfree(pool);
+		xio_set_error(ENOMEM);
+		ERROR_LOG("calloc failed. %m\n");
+		return NULL;
+	}
+
+	pool->session			= params->session;
+	pool->policy			= params->policy;
+	pool->conn_user_context		= params->conn_user_context;
+	pool->slots_nr			= params->ctxs_nr;
+	pool->min_reconnect_delay_ms	= params->reconnect_delay_ms ?
+					  params->reconnect_delay_ms :
+					  XIO_CPOOL_RECONNECT_DELAY_MS;
+	pool->max_reconnect_delay_ms	= params->max_reconnect_delay_ms ?
+					  params->max_reconnect_delay_ms :
+					  XIO_CPOOL_MAX_RECONNECT_DELAY_MS;
+	if (pool->max_reconnect_delay_ms < pool->min_reconnect_delay_ms)
+		pool->max_reconnect_delay_ms = pool->min_reconnect_delay_ms;
+
+	params->session->cpool = pool;
+
+	for (i = 0; i < pool->slots_nr; i++) {
+		slot = &pool->slots[i];
+		slot->pool = pool;
+		slot->ctx = params->ctxs[i];
+		slot->reconnect_delay_ms = pool->min_reconnect_delay_ms;
+		if (xio_cpool_slot_connect(slot) != 0)
+			xio_cpool_schedule_reconnect(slot);
+	}
+	if (pool->live_nr == 0) {
+		ERROR_LOG("session:%p, no pool connection could be opened\n",
+			  params->session);
+		xio_cpool_cancel_reconnects(pool);
+		xio_cpool_free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_destroy						     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_pool_destroy(struct xio_connection_pool *pool)
+{
+	struct xio_session *session;
+	struct xio_context *ctx;
+	int i, reason;
+
+	if (pool == NULL) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	pool->closing = 1;
+	xio_cpool_cancel_reconnects(pool);
+
+	/* connections still connecting are closed once established */
+	for (i = 0; i < pool->slots_nr; i++)
+		if (pool->slots[i].connection)
+			xio_disconnect(pool->slots[i].connection);
+
+	/* otherwise released on the last connection teardown */
+	if (pool->live_nr == 0) {
+		session	= pool->session;
+		ctx	= pool->slots[0].ctx;
+		reason	= pool->teardown_reason;
+		xio_cpool_free(pool);
+		/* the pool held an empty session open - release it now */
+		if (session && session->connections_nr == 0) {
+			xio_session_set_state(session,
+					      XIO_SESSION_STATE_CLOSING);
+			xio_session_schedule_teardown(session, ctx, reason);
+		}
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_get						     */
+/*---------------------------------------------------------------------------*/
+struct xio_connection *xio_connection_pool_get(
+		struct xio_connection_pool *pool,
+		uint64_t key)
+{
+	struct xio_cpool_slot	*slot, *best = NULL;
+	uint64_t		score, best_score = 0;
+	int			i, idx;
+
+	if (pool->policy == XIO_CONNECTION_POOL_CONSISTENT_HASH) {
+		for (i = 0; i < pool->slots_nr; i++) {
+			slot = &pool->slots[i];
+			if (!xio_cpool_slot_usable(slot))
+				continue;
+			score = xio_cpool_score(key, i);
+			if (best == NULL || score > best_score) {
+				best = slot;
+				best_score = score;
+			}
+		}
+	} else {
+		/* least outstanding - start the scan after the last pick
+		 * so that ties are spread round robin
+		 */
+		idx = pool->next_slot;
+		for (i = 0; i < pool->slots_nr; i++) {
+			slot = &pool->slots[idx];
+			if (++idx == pool->slots_nr)
+				idx = 0;
+			if (!xio_cpool_slot_usable(slot))
+				continue;
+			if (best == NULL ||
+			    slot->connection->queued_msgs <
+			    best->connection->queued_msgs)
+				best = slot;
+		}
+		if (best)
+			pool->next_slot = (best - pool->slots + 1) %
+					  pool->slots_nr;
+	}
+	if (best == NULL) {
+		xio_set_error(ENOTCONN);
+		return NULL;
+	}
+
+	return best->connection;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_pool_send_request					     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_pool_send_request(struct xio_connection_pool *pool,
+				     struct xio_msg *req,
+				     uint64_t key)
+{
+	struct xio_connection *connection;
+
+	if (pool == NULL || req == NULL) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	connection = xio_connection_pool_get(pool, key);
+	if (connection == NULL)
+		return -1;
+
+	return xio_send_request(connection, req);
+}
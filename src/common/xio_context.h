@@ -73,6 +73,14 @@ struct xio_statistics {
 	char		*name[XIO_STAT_LAST];
 };
 
+/* load figures of a context, written by the context's thread and read
+ * by the accepting server's thread when it balances new sessions
+ */
+struct xio_context_load {
+	atomic_t	conns_nr;	/* connections bound to the context   */
+	atomic_t	queued_msgs;	/* requests in flight on the context  */
+};
+
 struct xio_context {
 	void				*ev_loop;
 	int				cpuid;
@@ -81,6 +89,7 @@ struct xio_context {
 	unsigned int			flags;
 	uint64_t			worker;
 	struct xio_statistics		stats;
+	struct xio_context_load		load;
 	void				*user_context;
 	struct xio_workqueue		*workqueue;
 	struct list_head		ctx_list;  /* per context storage */
@@ -199,6 +208,11 @@ void xio_ctx_remove_event(struct xio_context *ctx,
 /*---------------------------------------------------------------------------*/
 int xio_context_is_loop_stopping(struct xio_context *ctx);
 
+/*---------------------------------------------------------------------------*/
+/* xio_context_get_loop_util						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_get_loop_util(struct xio_context *ctx);
+
 
 /*---------------------------------------------------------------------------*/
 /* xio_context_modify_ev_handler					     */
@@ -45,6 +45,7 @@
 #include "xio_task.h"
 #include "xio_transport.h"
 #include "xio_nexus_cache.h"
+#include "xio_nexus_warm.h"
 #include "xio_nexus.h"
 #include "xio_session.h"
 
@@ -188,6 +189,26 @@ struct xio_observer *xio_nexus_observer_lookup(struct xio_nexus *nexus,
 	return NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_observer_find						     */
+/*---------------------------------------------------------------------------*/
+struct xio_observer *xio_nexus_observer_find(
+		struct xio_nexus *nexus,
+		int (*match)(struct xio_observer *observer, void *arg),
+		void *arg)
+{
+	struct xio_observers_htbl_node	*node;
+
+	list_for_each_entry(node,
+			    &nexus->observers_htbl,
+			    observers_htbl_node) {
+		if (match(node->observer, arg))
+			return node->observer;
+	}
+
+	return NULL;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_reg_observer						     */
 /*---------------------------------------------------------------------------*/
@@ -617,7 +638,8 @@ static int xio_nexus_on_recv_setup_rsp(struct xio_nexus *nexus,
 			/* Stop timer */
 			xio_nexus_cancel_dwork(nexus);
 			/* Kill nexus */
-			nexus->state = XIO_NEXUS_STATE_DISCONNECTED;
+			xio_nexus_state_set(nexus,
+					    XIO_NEXUS_STATE_DISCONNECTED);
 			TRACE_LOG("nexus state changed to disconnected\n");
 			xio_observable_notify_all_observers(
 					&nexus->observable,
@@ -653,7 +675,7 @@ static int xio_nexus_on_recv_setup_rsp(struct xio_nexus *nexus,
 			ERROR_LOG("create primary pool failed\n");
 			return -1;
 		}
-		nexus->state = XIO_NEXUS_STATE_CONNECTED;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_CONNECTED);
 
 		xio_observable_notify_all_observers(&nexus->observable,
 						    XIO_NEXUS_EVENT_ESTABLISHED,
@@ -696,7 +718,7 @@ static int xio_nexus_on_recv_setup_rsp(struct xio_nexus *nexus,
 			ERROR_LOG("recreate primary pool failed\n");
 			return -1;
 		}
-		nexus->state = XIO_NEXUS_STATE_CONNECTED;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_CONNECTED);
 
 		/* Tell session to re-initiate transmission */
 		xio_observable_notify_all_observers(&nexus->observable,
@@ -726,7 +748,7 @@ static int xio_nexus_on_send_setup_rsp_comp(struct xio_nexus *nexus,
 		nexus_event = XIO_NEXUS_EVENT_ESTABLISHED;
 
 	/* Set new state */
-	nexus->state = XIO_NEXUS_STATE_CONNECTED;
+	xio_nexus_state_set(nexus, XIO_NEXUS_STATE_CONNECTED);
 	xio_observable_notify_all_observers(&nexus->observable,
 					    nexus_event,
 					    NULL);
@@ -1102,7 +1124,7 @@ static void xio_nexus_release_cb(void *data)
 		xio_nexus_cache_remove(nexus->cid);
 
 	if (nexus->state != XIO_NEXUS_STATE_DISCONNECTED) {
-		nexus->state = XIO_NEXUS_STATE_CLOSED;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_CLOSED);
 		TRACE_LOG("nexus state changed to closed\n");
 	}
 
@@ -1204,6 +1226,7 @@ struct xio_nexus *xio_nexus_create(struct xio_nexus *parent_nexus,
 			  xio_on_context_event);
 
 	INIT_LIST_HEAD(&nexus->tx_queue);
+	INIT_LIST_HEAD(&nexus->warm_list_entry);
 
 	xio_context_reg_observer(transport_hndl->ctx, &nexus->ctx_observer);
 
@@ -1318,6 +1341,10 @@ static void xio_nexus_on_transport_error(struct xio_nexus *nexus,
 
 	nexus_event_data.error.reason =  event_data->error.reason;
 
+	/* a failed connect must not be handed out by the nexus cache */
+	if (nexus->state == XIO_NEXUS_STATE_CONNECTING)
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_DISCONNECTED);
+
 	xio_observable_notify_all_observers(&nexus->observable,
 					    XIO_NEXUS_EVENT_ERROR,
 					    &nexus_event_data);
@@ -1369,7 +1396,7 @@ static void xio_nexus_on_transport_disconnected(struct xio_nexus *nexus,
 
 	/* Can't reconnect */
 
-	nexus->state = XIO_NEXUS_STATE_DISCONNECTED;
+	xio_nexus_state_set(nexus, XIO_NEXUS_STATE_DISCONNECTED);
 	TRACE_LOG("nexus state changed to disconnected nexus:%p\n", nexus);
 
 	if (!xio_observable_is_empty(&nexus->observable)) {
@@ -1391,6 +1418,8 @@ static int xio_nexus_on_new_message(struct xio_nexus *nexus,
 	int	retval = -1;
 	struct xio_task	*task = event_data->msg.task;
 
+	xio_task_stamp(task, XIO_TASK_STAMP_RECV);
+
 	switch (task->tlv_type) {
 	case XIO_NEXUS_SETUP_RSP:
 		retval = xio_nexus_on_recv_setup_rsp(nexus, task);
@@ -1591,7 +1620,8 @@ static int xio_nexus_on_transport_event(void *observer, void *sender,
 		if (nexus->state == XIO_NEXUS_STATE_RECONNECT) {
 			xio_nexus_client_reconnect_failed(nexus);
 		} else {
-			nexus->state = XIO_NEXUS_STATE_DISCONNECTED;
+			xio_nexus_state_set(nexus,
+					    XIO_NEXUS_STATE_DISCONNECTED);
 			TRACE_LOG("nexus state changed to disconnected\n");
 			xio_observable_notify_all_observers(
 					&nexus->observable,
@@ -1666,14 +1696,15 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 				 const char *portal_uri,
 				 struct xio_observer  *observer, uint32_t oid)
 {
-	struct xio_transport		*transport;
 	struct xio_nexus			*nexus;
-	char				proto[8];
 
 
 	/* look for opened nexus */
 	nexus = xio_nexus_cache_find(ctx, portal_uri);
 	if (nexus != NULL) {
+		/* an idle warm nexus is taken - let the keeper refill */
+		if (nexus->warm && list_empty(&nexus->observers_htbl))
+			xio_nexus_warm_consumed(nexus->warm);
 		if (observer) {
 			xio_observable_reg_observer(&nexus->observable,
 						    observer);
@@ -1693,6 +1724,21 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 		return nexus;
 	}
 
+	return xio_nexus_open_new(ctx, portal_uri, observer, oid);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_open_new		                                             */
+/*---------------------------------------------------------------------------*/
+struct xio_nexus *xio_nexus_open_new(struct xio_context *ctx,
+				     const char *portal_uri,
+				     struct xio_observer *observer,
+				     uint32_t oid)
+{
+	struct xio_transport		*transport;
+	struct xio_nexus			*nexus;
+	char				proto[8];
+
 	/* extract portal from uri */
 	if (xio_uri_get_proto(portal_uri, proto, sizeof(proto)) != 0) {
 		xio_set_error(XIO_E_ADDR_ERROR);
@@ -1725,6 +1771,7 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 			  xio_nexus_on_transport_event);
 	XIO_OBSERVABLE_INIT(&nexus->observable, nexus);
 	INIT_LIST_HEAD(&nexus->tx_queue);
+	INIT_LIST_HEAD(&nexus->warm_list_entry);
 
 	xio_nexus_init_observers_htbl(nexus);
 
@@ -1747,7 +1794,7 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 	}
 	nexus->transport	= transport;
 	kref_init(&nexus->kref);
-	nexus->state = XIO_NEXUS_STATE_OPEN;
+	xio_nexus_state_set(nexus, XIO_NEXUS_STATE_OPEN);
 
 	if (nexus->transport->get_pools_setup_ops) {
 		nexus->transport->get_pools_setup_ops(nexus->transport_hndl,
@@ -1855,7 +1902,10 @@ int xio_nexus_connect(struct xio_nexus *nexus, const char *portal_uri,
 			ERROR_LOG("transport connect failed\n");
 			goto cleanup3;
 		}
-		nexus->state = XIO_NEXUS_STATE_CONNECTING;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_CONNECTING);
+
+		/* offer the nexus to other sessions on this context */
+		xio_nexus_cache_index(nexus);
 		break;
 	case XIO_NEXUS_STATE_CONNECTED:
 		xio_nexus_notify_observer(nexus, observer,
@@ -1903,7 +1953,7 @@ int xio_nexus_listen(struct xio_nexus *nexus, const char *portal_uri,
 				  portal_uri);
 			return -1;
 		}
-		nexus->state = XIO_NEXUS_STATE_LISTEN;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_LISTEN);
 		nexus->is_listener = 1;
 	}
 
@@ -2186,6 +2236,19 @@ int xio_nexus_cancel_rsp(struct xio_nexus *nexus, struct xio_task *task,
 	return -1;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_take_in_bufs						     */
+/*---------------------------------------------------------------------------*/
+int xio_nexus_take_in_bufs(struct xio_nexus *nexus, struct xio_task *task,
+			   struct xio_mempool_obj *objs, int nents)
+{
+	if (nexus->transport->take_in_bufs)
+		return nexus->transport->take_in_bufs(nexus->transport_hndl,
+						      task, objs, nents);
+	xio_set_error(XIO_E_NOT_SUPPORTED);
+	return -1;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_server_reconnect_timeout					     */
 /*---------------------------------------------------------------------------*/
@@ -2194,7 +2257,7 @@ static void xio_nexus_server_reconnect_timeout(void *data)
 	struct xio_nexus *nexus = data;
 
 	/* No reconnect within timeout */
-	nexus->state = XIO_NEXUS_STATE_DISCONNECTED;
+	xio_nexus_state_set(nexus, XIO_NEXUS_STATE_DISCONNECTED);
 	TRACE_LOG("nexus state changed to disconnected\n");
 	xio_observable_notify_all_observers(&nexus->observable,
 					    XIO_NEXUS_EVENT_DISCONNECTED,
@@ -2247,7 +2310,7 @@ static void xio_nexus_client_reconnect_timeout(void *data)
 				&nexus->close_time_hndl);
 	} else {
 		/* retries number exceeded */
-		nexus->state = XIO_NEXUS_STATE_DISCONNECTED;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_DISCONNECTED);
 		TRACE_LOG("nexus state changed to disconnected\n");
 		xio_observable_notify_all_observers(
 				&nexus->observable,
@@ -2277,7 +2340,7 @@ static void xio_nexus_client_reconnect_failed(void *data)
 			ERROR_LOG("adding delayed work failed\n");
 	} else {
 		/* retries number exceeded */
-		nexus->state = XIO_NEXUS_STATE_DISCONNECTED;
+		xio_nexus_state_set(nexus, XIO_NEXUS_STATE_DISCONNECTED);
 		TRACE_LOG("nexus state changed to disconnected\n");
 		xio_observable_notify_all_observers(
 				&nexus->observable,
@@ -42,6 +42,7 @@
 #include "xio_context.h"
 #include "xio_transport.h"
 #include "sys/hashtable.h"
+#include "xio_trace.h"
 
 /*---------------------------------------------------------------------------*/
 /* defines	                                                             */
@@ -52,6 +53,13 @@
 /* typedefs								     */
 /*---------------------------------------------------------------------------*/
 struct xio_nexus;
+struct xio_nexus_warm;
+
+/* (context, portal) index key of client nexuses */
+struct xio_key_portal {
+	struct xio_context	*ctx;
+	char			*uri;
+};
 
 /*---------------------------------------------------------------------------*/
 /* enum									     */
@@ -155,7 +163,14 @@ struct xio_nexus {
 	char				*portal_uri;
 	char				*out_if_addr;
 
-	HT_ENTRY(xio_nexus, xio_key_int32) nexus_htbl;
+	/* portal index entry, valid while portal_indexed */
+	struct xio_key_portal		portal_key;
+	uint32_t			portal_hash;
+	int				portal_indexed;
+
+	/* client side nexus kept open while idle */
+	struct xio_nexus_warm		*warm;
+	struct list_head		warm_list_entry;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -171,6 +186,14 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 				 struct xio_observer *observer,
 				 uint32_t oid);
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_open_new							     */
+/*---------------------------------------------------------------------------*/
+struct xio_nexus *xio_nexus_open_new(struct xio_context *ctx,
+				     const char *portal_uri,
+				     struct xio_observer *observer,
+				     uint32_t oid);
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_connect							     */
 /*---------------------------------------------------------------------------*/
@@ -218,6 +241,12 @@ int xio_nexus_cancel_rsp(struct xio_nexus *nexus,
 			 struct xio_task *task, enum xio_status result,
 			 void *ulp_msg, size_t ulp_msg_sz);
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_take_in_bufs						     */
+/*---------------------------------------------------------------------------*/
+int xio_nexus_take_in_bufs(struct xio_nexus *nexus, struct xio_task *task,
+			   struct xio_mempool_obj *objs, int nents);
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_set_opt							     */
 /*---------------------------------------------------------------------------*/
@@ -267,6 +296,14 @@ void xio_nexus_unreg_observer(struct xio_nexus *nexus,
 struct xio_observer *xio_nexus_observer_lookup(struct xio_nexus *nexus,
 					       uint32_t id);
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_observer_find						     */
+/*---------------------------------------------------------------------------*/
+struct xio_observer *xio_nexus_observer_find(
+		struct xio_nexus *nexus,
+		int (*match)(struct xio_observer *observer, void *arg),
+		void *arg);
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_notify_observer						     */
 /*---------------------------------------------------------------------------*/
@@ -345,6 +382,7 @@ static inline enum xio_nexus_state xio_nexus_state_get(struct xio_nexus *nexus)
 static inline void xio_nexus_state_set(struct xio_nexus *nexus,
 				       enum xio_nexus_state state)
 {
+	xio_trace3(nexus_state, nexus, nexus->state, state);
 	nexus->state = state;
 }
 
@@ -40,29 +40,29 @@
 #include "xio_task.h"
 #include "xio_observer.h"
 #include "xio_nexus.h"
+#include "xio_nexus_warm.h"
+#include "xio_rcu_htbl.h"
 #include "xio_nexus_cache.h"
 
 
-static HT_HEAD(, xio_nexus, HASHTABLE_PRIME_SMALL)  nexus_cache;
-static spinlock_t cs_lock;
+#define XIO_NEXUS_CACHE_MIN_SIZE	128
+#define XIO_PORTAL_INDEX_MIN_SIZE	32
+
+static struct xio_rcu_htbl nexus_cache;
+static struct xio_rcu_htbl portal_index;	/* by (context, portal) hash */
 
 /*---------------------------------------------------------------------------*/
-/* xio_nexus_cache_add				                             */
+/* (context, portal) key helpers					     */
 /*---------------------------------------------------------------------------*/
-static int nexus_cache_add(struct xio_nexus *nexus, int nexus_id)
+static inline uint32_t xio_portal_hash(const struct xio_key_portal *k)
 {
-	struct xio_nexus *c;
-	struct xio_key_int32  key = {
-		nexus_id
-	};
-
-	HT_LOOKUP(&nexus_cache, &key, c, nexus_htbl);
-	if (c != NULL)
-		return -1;
-
-	HT_INSERT(&nexus_cache, &key, nexus, nexus_htbl);
+	return int64_hash((uint64_t)(uintptr_t)(k->ctx)) ^ str_hash(k->uri);
+}
 
-	return 0;
+static inline int xio_portal_cmp(const struct xio_key_portal *k1,
+				 const struct xio_key_portal *k2)
+{
+	return (k1->ctx == k2->ctx) && (strcmp(k1->uri, k2->uri) == 0);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -71,18 +71,20 @@ static int nexus_cache_add(struct xio_nexus *nexus, int nexus_id)
 int xio_nexus_cache_remove(int nexus_id)
 {
 	struct xio_nexus *c;
-	struct xio_key_int32  key;
 
-	spin_lock(&cs_lock);
-	key.id = nexus_id;
-	HT_LOOKUP(&nexus_cache, &key, c, nexus_htbl);
-	if (c == NULL) {
-		spin_unlock(&cs_lock);
+	c = xio_rcu_htbl_remove(&nexus_cache, nexus_id);
+	if (c == NULL)
 		return -1;
+
+	if (c->portal_indexed) {
+		xio_rcu_htbl_remove_obj(&portal_index, c->portal_hash, c);
+		c->portal_indexed = 0;
+		/* portal lookups may still be ranking it */
+		synchronize_rcu();
 	}
 
-	HT_REMOVE(&nexus_cache, c, xio_nexus, nexus_htbl);
-	spin_unlock(&cs_lock);
+	/* no longer offered to sessions - stop keeping it warm */
+	xio_nexus_warm_detach(c);
 
 	return 0;
 }
@@ -92,15 +94,7 @@ int xio_nexus_cache_remove(int nexus_id)
 /*---------------------------------------------------------------------------*/
 struct xio_nexus *xio_nexus_cache_lookup(int nexus_id)
 {
-	struct xio_nexus *c;
-	struct xio_key_int32  key;
-
-	spin_lock(&cs_lock);
-	key.id = nexus_id;
-	HT_LOOKUP(&nexus_cache, &key, c, nexus_htbl);
-	spin_unlock(&cs_lock);
-
-	return c;
+	return xio_rcu_htbl_lookup(&nexus_cache, nexus_id);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -110,15 +104,80 @@ int xio_nexus_cache_add(struct xio_nexus *nexus,
 			int *nexus_id)
 {
 	static int cid;  /* = 0 global nexus provider */
-	int retval;
+	int id;
+
+	id = __sync_fetch_and_add(&cid, 1);
+
+	if (xio_rcu_htbl_insert(&nexus_cache, id, nexus))
+		return -1;
+	*nexus_id = id;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_cache_index						     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_cache_index(struct xio_nexus *nexus)
+{
+	if (nexus->portal_indexed)
+		return;
+
+	nexus->portal_key.ctx	= nexus->transport_hndl->ctx;
+	nexus->portal_key.uri	= nexus->portal_uri;
+	nexus->portal_hash	= xio_portal_hash(&nexus->portal_key);
+	if (xio_rcu_htbl_insert_dup(&portal_index, nexus->portal_hash, nexus))
+		return;
+	nexus->portal_indexed	= 1;
+}
 
-	spin_lock(&cs_lock);
-	retval = nexus_cache_add(nexus, cid);
-	if (retval == 0)
-		*nexus_id = cid++;
-	spin_unlock(&cs_lock);
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_cache_rank							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_nexus_cache_rank(struct xio_nexus *nexus)
+{
+	switch (nexus->state) {
+	case XIO_NEXUS_STATE_REJECTED:
+	case XIO_NEXUS_STATE_CLOSED:
+	case XIO_NEXUS_STATE_DISCONNECTED:
+		/* never hand out a nexus that is on its way down */
+		return 0;
+	case XIO_NEXUS_STATE_CONNECTED:
+		/* an idle warm nexus spares the handshake and is not shared */
+		if (nexus->warm && list_empty(&nexus->observers_htbl))
+			return 3;
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+struct xio_nexus_cache_match {
+	struct xio_key_portal		key;
+	struct xio_nexus		*found;
+	int				best;
+	int				pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_cache_visit						     */
+/*---------------------------------------------------------------------------*/
+static int xio_nexus_cache_visit(void *obj, void *arg)
+{
+	struct xio_nexus		*nexus = obj;
+	struct xio_nexus_cache_match	*match = arg;
+	int				rank;
+
+	/* hashes of different portals may collide */
+	if (!xio_portal_cmp(&match->key, &nexus->portal_key))
+		return 0;
+	rank = xio_nexus_cache_rank(nexus);
+	if (rank > match->best) {
+		match->best = rank;
+		match->found = nexus;
+	}
 
-	return retval;
+	return (rank == 3);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -128,21 +187,17 @@ struct xio_nexus *xio_nexus_cache_find(
 		struct xio_context *ctx,
 		const char *portal_uri)
 {
-	struct xio_nexus *nexus;
-
-	spin_lock(&cs_lock);
-	HT_FOREACH(nexus, &nexus_cache, nexus_htbl) {
-		if (nexus->transport_hndl->portal_uri) {
-			if (
-		(strcmp(nexus->transport_hndl->portal_uri, portal_uri) == 0) &&
-		(nexus->transport_hndl->ctx == ctx)) {
-				spin_unlock(&cs_lock);
-				return nexus;
-			}
-		}
-	}
-	spin_unlock(&cs_lock);
-	return  NULL;
+	struct xio_nexus_cache_match match = {
+		{ ctx, (char *)portal_uri },
+		NULL,
+		0,
+		0
+	};
+
+	xio_rcu_htbl_lookup_each(&portal_index, xio_portal_hash(&match.key),
+				 xio_nexus_cache_visit, &match);
+
+	return match.found;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -150,13 +205,16 @@ struct xio_nexus *xio_nexus_cache_find(
 /*---------------------------------------------------------------------------*/
 void nexus_cache_construct(void)
 {
-	HT_INIT(&nexus_cache, xio_int32_hash, xio_int32_cmp, xio_int32_cp);
-	spin_lock_init(&cs_lock);
+	if (xio_rcu_htbl_init(&nexus_cache, XIO_NEXUS_CACHE_MIN_SIZE) ||
+	    xio_rcu_htbl_init(&portal_index, XIO_PORTAL_INDEX_MIN_SIZE))
+		ERROR_LOG("nexus cache allocation failed\n");
 }
 
-/*
+/*---------------------------------------------------------------------------*/
+/* nexus_cache_destruct				                     */
+/*---------------------------------------------------------------------------*/
 void nexus_cache_destruct(void)
 {
+	xio_rcu_htbl_destroy(&portal_index);
+	xio_rcu_htbl_destroy(&nexus_cache);
 }
-*/
-
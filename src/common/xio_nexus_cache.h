@@ -52,6 +52,11 @@ struct xio_session;
 /*---------------------------------------------------------------------------*/
 void nexus_cache_construct(void);
 
+/*---------------------------------------------------------------------------*/
+/* nexus_cache_destruct							     */
+/*---------------------------------------------------------------------------*/
+void nexus_cache_destruct(void);
+
 int xio_nexus_cache_add(
 		struct xio_nexus *nexus,
 		int *nexus_id);
@@ -62,6 +67,9 @@ int xio_nexus_cache_remove(
 struct xio_nexus *xio_nexus_cache_lookup(
 		int nexus_id);
 
+void xio_nexus_cache_index(
+		struct xio_nexus *nexus);
+
 struct xio_nexus *xio_nexus_cache_find(
 		struct xio_context *ctx,
 		const char *portal_uri);
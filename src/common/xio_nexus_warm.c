@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_hash.h"
+#include "xio_task.h"
+#include "xio_context.h"
+#include "xio_transport.h"
+#include "xio_nexus.h"
+#include "xio_nexus_warm.h"
+
+#define XIO_NEXUS_WARM_INTERVAL_MS	1000
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_nexus_warm {
+	struct xio_context		*ctx;
+	char				*uri;
+	int				idle_nr;
+	int				pad;
+	struct list_head		nexus_list;	/* nexuses kept open  */
+	struct list_head		warm_list_entry;
+	struct xio_observer		ctx_observer;
+	xio_ctx_work_t			refill_work;
+	xio_ctx_delayed_work_t		timer_work;
+};
+
+static LIST_HEAD(warm_list);
+static spinlock_t warm_lock;	/* warm_list and the keepers' nexus lists */
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_construct						     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_warm_construct(void)
+{
+	spin_lock_init(&warm_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_find							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_nexus_warm *xio_nexus_warm_find(struct xio_context *ctx,
+						  const char *uri)
+{
+	struct xio_nexus_warm *warm;
+
+	spin_lock(&warm_lock);
+	list_for_each_entry(warm, &warm_list, warm_list_entry) {
+		if (warm->ctx == ctx && strcmp(warm->uri, uri) == 0) {
+			spin_unlock(&warm_lock);
+			return warm;
+		}
+	}
+	spin_unlock(&warm_lock);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_is_dead						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_nexus_warm_is_dead(struct xio_nexus *nexus)
+{
+	switch (nexus->state) {
+	case XIO_NEXUS_STATE_REJECTED:
+	case XIO_NEXUS_STATE_CLOSED:
+	case XIO_NEXUS_STATE_DISCONNECTED:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_detach						     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_warm_detach(struct xio_nexus *nexus)
+{
+	spin_lock(&warm_lock);
+	list_del_init(&nexus->warm_list_entry);
+	spin_unlock(&warm_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_put_list - closes the nexuses moved to put_list	     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_warm_put_list(struct list_head *put_list, int release)
+{
+	struct xio_nexus *nexus;
+
+	/* closing may detach other nexuses, so take one at a time */
+	for (;;) {
+		spin_lock(&warm_lock);
+		nexus = list_first_entry_or_null(put_list, struct xio_nexus,
+						 warm_list_entry);
+		if (nexus)
+			list_del_init(&nexus->warm_list_entry);
+		spin_unlock(&warm_lock);
+		if (!nexus)
+			break;
+
+		nexus->warm = NULL;
+		/* unless the context is closing - it destroys the nexus */
+		if (release)
+			xio_nexus_close(nexus, NULL);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_open							     */
+/*---------------------------------------------------------------------------*/
+static int xio_nexus_warm_open(struct xio_nexus_warm *warm)
+{
+	struct xio_nexus *nexus;
+
+	nexus = xio_nexus_open_new(warm->ctx, warm->uri, NULL, 0);
+	if (nexus == NULL) {
+		ERROR_LOG("failed to open warm nexus to %s\n", warm->uri);
+		return -1;
+	}
+	if (xio_nexus_connect(nexus, warm->uri, NULL, NULL) != 0) {
+		ERROR_LOG("failed to connect warm nexus to %s\n", warm->uri);
+		xio_nexus_close(nexus, NULL);
+		return -1;
+	}
+	/* the keeper owns the reference taken by the open */
+	nexus->warm = warm;
+	spin_lock(&warm_lock);
+	list_add_tail(&nexus->warm_list_entry, &warm->nexus_list);
+	spin_unlock(&warm_lock);
+
+	TRACE_LOG("warm nexus opened. nexus:%p, uri:%s\n", nexus, warm->uri);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_refill						     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_warm_refill(struct xio_nexus_warm *warm)
+{
+	struct xio_nexus	*nexus, *next_nexus;
+	LIST_HEAD(put_list);
+	int			idle = 0;
+
+	spin_lock(&warm_lock);
+	list_for_each_entry_safe(nexus, next_nexus, &warm->nexus_list,
+				 warm_list_entry) {
+		if (xio_nexus_warm_is_dead(nexus)) {
+			list_move_tail(&nexus->warm_list_entry, &put_list);
+			continue;
+		}
+		/* nexuses serving sessions are kept but not counted */
+		if (!list_empty(&nexus->observers_htbl))
+			continue;
+		if (++idle > warm->idle_nr)
+			list_move_tail(&nexus->warm_list_entry, &put_list);
+	}
+	spin_unlock(&warm_lock);
+	xio_nexus_warm_put_list(&put_list, 1);
+
+	for (; idle < warm->idle_nr; idle++) {
+		if (xio_nexus_warm_open(warm) != 0)
+			break;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_refill_handler					     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_warm_refill_handler(void *data)
+{
+	xio_nexus_warm_refill(data);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_timer_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_warm_timer_handler(void *data)
+{
+	struct xio_nexus_warm *warm = data;
+
+	/* reconnects lost nexuses and trims surplus ones */
+	xio_nexus_warm_refill(warm);
+
+	if (xio_ctx_add_delayed_work(warm->ctx, XIO_NEXUS_WARM_INTERVAL_MS,
+				     warm, xio_nexus_warm_timer_handler,
+				     &warm->timer_work) != 0)
+		ERROR_LOG("xio_ctx_add_delayed_work failed.\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_consumed						     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_warm_consumed(struct xio_nexus_warm *warm)
+{
+	if (xio_is_work_pending(&warm->refill_work))
+		return;
+
+	if (xio_ctx_add_work(warm->ctx, warm, xio_nexus_warm_refill_handler,
+			     &warm->refill_work) != 0)
+		ERROR_LOG("xio_ctx_add_work failed.\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_warm_free(struct xio_nexus_warm *warm, int release)
+{
+	LIST_HEAD(put_list);
+
+	spin_lock(&warm_lock);
+	list_del(&warm->warm_list_entry);
+	list_splice_init(&warm->nexus_list, &put_list);
+	spin_unlock(&warm_lock);
+
+	if (xio_is_work_pending(&warm->refill_work))
+		xio_ctx_del_work(warm->ctx, &warm->refill_work);
+	if (xio_is_delayed_work_pending(&warm->timer_work))
+		xio_ctx_del_delayed_work(warm->ctx, &warm->timer_work);
+
+	xio_nexus_warm_put_list(&put_list, release);
+	xio_context_unreg_observer(warm->ctx, &warm->ctx_observer);
+
+	kfree(warm->uri);
+	kfree(warm);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_warm_on_context_event					     */
+/*---------------------------------------------------------------------------*/
+static int xio_nexus_warm_on_context_event(void *observer, void *sender,
+					   int event, void *event_data)
+{
+	if (event == XIO_CONTEXT_EVENT_CLOSE) {
+		TRACE_LOG("context: [close] ctx:%p\n", sender);
+		xio_nexus_warm_free(observer, 0);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_context_prewarm							     */
+/*---------------------------------------------------------------------------*/
+int xio_context_prewarm(struct xio_context *ctx, const char *uri,
+			int idle_nr)
+{
+	struct xio_nexus_warm *warm;
+
+	if (!ctx || !uri || idle_nr < 0) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid parameters\n");
+		return -1;
+	}
+
+	warm = xio_nexus_warm_find(ctx, uri);
+	if (idle_nr == 0) {
+		if (warm)
+			xio_nexus_warm_free(warm, 1);
+		return 0;
+	}
+
+	if (!warm) {
+		warm = kcalloc(1, sizeof(*warm), GFP_KERNEL);
+		if (!warm) {
+			xio_set_error(ENOMEM);
+			ERROR_LOG("kcalloc failed. %m\n");
+			return -1;
+		}
+		warm->uri = kstrdup(uri, GFP_KERNEL);
+		if (!warm->uri) {
+			xio_set_error(ENOMEM);
+			ERROR_LOG("kstrdup failed. %m\n");
+			kfree(warm);
+			return -1;
+		}
+		warm->ctx = ctx;
+		INIT_LIST_HEAD(&warm->nexus_list);
+		XIO_OBSERVER_INIT(&warm->ctx_observer, warm,
+				  xio_nexus_warm_on_context_event);
+		xio_context_reg_observer(ctx, &warm->ctx_observer);
+
+		spin_lock(&warm_lock);
+		list_add_tail(&warm->warm_list_entry, &warm_list);
+		spin_unlock(&warm_lock);
+
+		xio_ctx_add_delayed_work(ctx, XIO_NEXUS_WARM_INTERVAL_MS,
+					 warm, xio_nexus_warm_timer_handler,
+					 &warm->timer_work);
+	}
+	warm->idle_nr = idle_nr;
+
+	xio_nexus_warm_refill(warm);
+
+	return 0;
+}
@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_common.h"
+#include "xio_hash.h"
+#include "xio_rcu_htbl.h"
+
+/* grow above one entry per bucket, shrink below one per four */
+#define XIO_RCU_HTBL_MAX_SIZE		(1U << 20)
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_rcu_htbl_node {
+	struct hlist_node		link[2];	/* one per array      */
+	void				*obj;
+	uint32_t			key;
+	uint32_t			pad;
+	struct rcu_head			rcu;
+};
+
+struct xio_rcu_htbl_tbl {
+	unsigned int			size;		/* power of two	      */
+	unsigned int			lidx;		/* link set in use    */
+	struct hlist_head		buckets[0];
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_entry							     */
+/*---------------------------------------------------------------------------*/
+static inline struct xio_rcu_htbl_node *xio_rcu_htbl_entry(
+		struct hlist_node *pos, unsigned int lidx)
+{
+	return container_of(pos - lidx, struct xio_rcu_htbl_node, link[0]);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_bucket							     */
+/*---------------------------------------------------------------------------*/
+static inline struct hlist_head *xio_rcu_htbl_bucket(
+		struct xio_rcu_htbl_tbl *tbl, uint32_t key)
+{
+	return &tbl->buckets[int32_hash(key) & (tbl->size - 1)];
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_alloc							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_rcu_htbl_tbl *xio_rcu_htbl_alloc(unsigned int size)
+{
+	struct xio_rcu_htbl_tbl *tbl;
+
+	tbl = kcalloc(1, sizeof(*tbl) + size * sizeof(struct hlist_head),
+		      GFP_KERNEL);
+	if (tbl)
+		tbl->size = size;
+
+	return tbl;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_wanted_size						     */
+/*---------------------------------------------------------------------------*/
+static inline unsigned int xio_rcu_htbl_wanted_size(struct xio_rcu_htbl *ht,
+						    unsigned int nr)
+{
+	unsigned int size = ht->size;
+
+	if (nr > size && size < XIO_RCU_HTBL_MAX_SIZE)
+		return size << 1;
+	if (nr < (size >> 2) && size > ht->min_size)
+		return size >> 1;
+
+	return size;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_prealloc - new array for after the update, if one is due   */
+/*---------------------------------------------------------------------------*/
+static struct xio_rcu_htbl_tbl *xio_rcu_htbl_prealloc(
+		struct xio_rcu_htbl *ht, int delta)
+{
+	unsigned int size;
+
+	/* unlocked peek - the decision is taken again under the lock */
+	if (ht->resizing)
+		return NULL;
+	size = xio_rcu_htbl_wanted_size(ht, ht->nr + delta);
+	if (size == ht->size)
+		return NULL;
+
+	return xio_rcu_htbl_alloc(size);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_retire - frees the array replaced by a resize		     */
+/*---------------------------------------------------------------------------*/
+static void xio_rcu_htbl_retire(struct xio_rcu_htbl *ht,
+				struct xio_rcu_htbl_tbl *otbl)
+{
+	/* resizes are rare (log n), waiting here keeps the next one unblocked */
+	synchronize_rcu();
+
+	/* its link set may be reused by the next resize */
+	ht->resizing = 0;
+	kfree(otbl);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_free_node						     */
+/*---------------------------------------------------------------------------*/
+static void xio_rcu_htbl_free_node(struct rcu_head *head)
+{
+	kfree(container_of(head, struct xio_rcu_htbl_node, rcu));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_resize - called under ht->lock. returns the array that is  */
+/* to be retired, or NULL if ntbl was not used				     */
+/*---------------------------------------------------------------------------*/
+static struct xio_rcu_htbl_tbl *xio_rcu_htbl_resize(
+		struct xio_rcu_htbl *ht,
+		struct xio_rcu_htbl_tbl *ntbl)
+{
+	struct xio_rcu_htbl_tbl		*tbl;
+	struct xio_rcu_htbl_node	*node;
+	struct hlist_node		*pos;
+	unsigned int			i;
+
+	if (!ntbl || ht->resizing ||
+	    ntbl->size != xio_rcu_htbl_wanted_size(ht, ht->nr))
+		return NULL;
+
+	tbl = rcu_dereference_protected(ht->tbl, 1);
+	ntbl->lidx = !tbl->lidx;
+
+	/* ntbl is not published yet, readers still walk tbl links */
+	for (i = 0; i < tbl->size; i++) {
+		for (pos = tbl->buckets[i].first; pos; pos = pos->next) {
+			node = xio_rcu_htbl_entry(pos, tbl->lidx);
+			hlist_add_head(&node->link[ntbl->lidx],
+				       xio_rcu_htbl_bucket(ntbl, node->key));
+		}
+	}
+	rcu_assign_pointer(ht->tbl, ntbl);
+	ht->size     = ntbl->size;
+	ht->resizing = 1;
+
+	return tbl;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_find - called under ht->lock. a NULL obj matches any	     */
+/*---------------------------------------------------------------------------*/
+static struct xio_rcu_htbl_node *xio_rcu_htbl_find(
+		struct xio_rcu_htbl_tbl *tbl, uint32_t key, void *obj)
+{
+	struct xio_rcu_htbl_node	*node;
+	struct hlist_node		*pos;
+
+	for (pos = xio_rcu_htbl_bucket(tbl, key)->first; pos;
+	     pos = pos->next) {
+		node = xio_rcu_htbl_entry(pos, tbl->lidx);
+		if (node->key == key && (!obj || node->obj == obj))
+			return node;
+	}
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_init							     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_init(struct xio_rcu_htbl *ht, unsigned int min_size)
+{
+	struct xio_rcu_htbl_tbl *tbl;
+	unsigned int		size = 1;
+
+	while (size < min_size)
+		size <<= 1;
+
+	tbl = xio_rcu_htbl_alloc(size);
+	if (!tbl) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+
+	spin_lock_init(&ht->lock);
+	ht->nr		= 0;
+	ht->size	= size;
+	ht->min_size	= size;
+	ht->resizing	= 0;
+	RCU_INIT_POINTER(ht->tbl, tbl);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_destroy							     */
+/*---------------------------------------------------------------------------*/
+void xio_rcu_htbl_destroy(struct xio_rcu_htbl *ht)
+{
+	struct xio_rcu_htbl_tbl		*tbl;
+	struct hlist_node		*pos, *next;
+	unsigned int			i;
+
+	/* free the nodes of earlier removals */
+	rcu_barrier();
+
+	tbl = rcu_dereference_protected(ht->tbl, 1);
+	for (i = 0; i < tbl->size; i++) {
+		for (pos = tbl->buckets[i].first; pos; pos = next) {
+			next = pos->next;
+			kfree(xio_rcu_htbl_entry(pos, tbl->lidx));
+		}
+	}
+	kfree(tbl);
+	RCU_INIT_POINTER(ht->tbl, NULL);
+	ht->nr = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* __xio_rcu_htbl_insert						     */
+/*---------------------------------------------------------------------------*/
+static int __xio_rcu_htbl_insert(struct xio_rcu_htbl *ht, uint32_t key,
+				 void *obj, int unique)
+{
+	struct xio_rcu_htbl_node	*node;
+	struct xio_rcu_htbl_tbl		*tbl, *ntbl, *otbl;
+
+	node = kcalloc(1, sizeof(*node), GFP_KERNEL);
+	if (!node) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	node->key = key;
+	node->obj = obj;
+
+	ntbl = xio_rcu_htbl_prealloc(ht, 1);
+
+	spin_lock(&ht->lock);
+	tbl = rcu_dereference_protected(ht->tbl, 1);
+	if (unique && xio_rcu_htbl_find(tbl, key, NULL)) {
+		spin_unlock(&ht->lock);
+		kfree(ntbl);
+		kfree(node);
+		xio_set_error(EEXIST);
+		return -1;
+	}
+	hlist_add_head_rcu(&node->link[tbl->lidx],
+			   xio_rcu_htbl_bucket(tbl, key));
+	ht->nr++;
+	otbl = xio_rcu_htbl_resize(ht, ntbl);
+	spin_unlock(&ht->lock);
+
+	if (otbl)
+		xio_rcu_htbl_retire(ht, otbl);
+	else
+		kfree(ntbl);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* __xio_rcu_htbl_remove						     */
+/*---------------------------------------------------------------------------*/
+static void *__xio_rcu_htbl_remove(struct xio_rcu_htbl *ht, uint32_t key,
+				   void *match)
+{
+	struct xio_rcu_htbl_node	*node;
+	struct xio_rcu_htbl_tbl		*tbl, *ntbl, *otbl;
+	void				*obj;
+
+	ntbl = xio_rcu_htbl_prealloc(ht, -1);
+
+	spin_lock(&ht->lock);
+	tbl = rcu_dereference_protected(ht->tbl, 1);
+	node = xio_rcu_htbl_find(tbl, key, match);
+	if (!node) {
+		spin_unlock(&ht->lock);
+		kfree(ntbl);
+		return NULL;
+	}
+	hlist_del_rcu(&node->link[tbl->lidx]);
+	ht->nr--;
+	otbl = xio_rcu_htbl_resize(ht, ntbl);
+	spin_unlock(&ht->lock);
+
+	obj = node->obj;
+	call_rcu(&node->rcu, xio_rcu_htbl_free_node);
+	if (otbl)
+		xio_rcu_htbl_retire(ht, otbl);
+	else
+		kfree(ntbl);
+
+	return obj;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_insert							     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_insert(struct xio_rcu_htbl *ht, uint32_t key, void *obj)
+{
+	return __xio_rcu_htbl_insert(ht, key, obj, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_insert_dup						     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_insert_dup(struct xio_rcu_htbl *ht, uint32_t key, void *obj)
+{
+	return __xio_rcu_htbl_insert(ht, key, obj, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_remove							     */
+/*---------------------------------------------------------------------------*/
+void *xio_rcu_htbl_remove(struct xio_rcu_htbl *ht, uint32_t key)
+{
+	return __xio_rcu_htbl_remove(ht, key, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_remove_obj						     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_remove_obj(struct xio_rcu_htbl *ht, uint32_t key, void *obj)
+{
+	return __xio_rcu_htbl_remove(ht, key, obj) ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_lookup_each						     */
+/*---------------------------------------------------------------------------*/
+void xio_rcu_htbl_lookup_each(struct xio_rcu_htbl *ht, uint32_t key,
+			      int (*visit)(void *obj, void *arg), void *arg)
+{
+	struct xio_rcu_htbl_tbl		*tbl;
+	struct xio_rcu_htbl_node	*node;
+	struct hlist_node		*pos;
+
+	rcu_read_lock();
+	tbl = rcu_dereference(ht->tbl);
+	for (pos = rcu_dereference(hlist_first_rcu(
+				xio_rcu_htbl_bucket(tbl, key)));
+	     pos; pos = rcu_dereference(hlist_next_rcu(pos))) {
+		node = xio_rcu_htbl_entry(pos, tbl->lidx);
+		if (node->key == key && visit(node->obj, arg))
+			break;
+	}
+	rcu_read_unlock();
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_lookup							     */
+/*---------------------------------------------------------------------------*/
+void *xio_rcu_htbl_lookup(struct xio_rcu_htbl *ht, uint32_t key)
+{
+	struct xio_rcu_htbl_tbl		*tbl;
+	struct xio_rcu_htbl_node	*node;
+	struct hlist_node		*pos;
+	void				*obj = NULL;
+
+	rcu_read_lock();
+	tbl = rcu_dereference(ht->tbl);
+	for (pos = rcu_dereference(hlist_first_rcu(
+				xio_rcu_htbl_bucket(tbl, key)));
+	     pos; pos = rcu_dereference(hlist_next_rcu(pos))) {
+		node = xio_rcu_htbl_entry(pos, tbl->lidx);
+		if (node->key == key) {
+			obj = node->obj;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return obj;
+}
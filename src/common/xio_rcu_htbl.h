@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_RCU_HTBL_H
+#define XIO_RCU_HTBL_H
+
+/*
+ * hash table of objects keyed by a 32 bit id. lookups run under
+ * rcu_read_lock only; writers serialize on a spinlock. the bucket array
+ * doubles or halves with the number of entries. every entry carries two
+ * link sets, so a resize links all entries into the new array while
+ * readers keep walking the old one. the resizing writer frees the old
+ * array after a grace period, so insert and remove may sleep.
+ */
+
+/*---------------------------------------------------------------------------*/
+/* forward declarations							     */
+/*---------------------------------------------------------------------------*/
+struct xio_rcu_htbl_tbl;
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_rcu_htbl {
+	struct xio_rcu_htbl_tbl __rcu	*tbl;
+	spinlock_t			lock;		/* writers	      */
+	unsigned int			nr;		/* entries	      */
+	unsigned int			size;		/* buckets	      */
+	unsigned int			min_size;
+	volatile int			resizing;	/* old array retiring */
+	int				pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_init							     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_init(struct xio_rcu_htbl *ht, unsigned int min_size);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_destroy - caller guarantees no concurrent users		     */
+/*---------------------------------------------------------------------------*/
+void xio_rcu_htbl_destroy(struct xio_rcu_htbl *ht);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_insert - fails if the key is already present		     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_insert(struct xio_rcu_htbl *ht, uint32_t key, void *obj);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_insert_dup - the key may already be present		     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_insert_dup(struct xio_rcu_htbl *ht, uint32_t key, void *obj);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_remove - returns the removed object or NULL		     */
+/*---------------------------------------------------------------------------*/
+void *xio_rcu_htbl_remove(struct xio_rcu_htbl *ht, uint32_t key);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_remove_obj - removes obj from under a repeated key	     */
+/*---------------------------------------------------------------------------*/
+int xio_rcu_htbl_remove_obj(struct xio_rcu_htbl *ht, uint32_t key, void *obj);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_lookup_each - lock free, visits every object of key until   */
+/* visit returns non zero. objects are only valid inside visit		     */
+/*---------------------------------------------------------------------------*/
+void xio_rcu_htbl_lookup_each(struct xio_rcu_htbl *ht, uint32_t key,
+			      int (*visit)(void *obj, void *arg), void *arg);
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_htbl_lookup - lock free					     */
+/*---------------------------------------------------------------------------*/
+void *xio_rcu_htbl_lookup(struct xio_rcu_htbl *ht, uint32_t key);
+
+#endif /*XIO_RCU_HTBL_H */
@@ -46,7 +46,22 @@
 #include "xio_nexus.h"
 #include "xio_session.h"
 #include "xio_connection.h"
+#include "xio_server.h"
 
+/* weights of the load figures when balancing sessions over portals */
+#define XIO_PORTAL_CONN_WEIGHT		16	/* per connection	      */
+#define XIO_PORTAL_QUEUED_WEIGHT	1	/* per request in flight      */
+#define XIO_PORTAL_UTIL_WEIGHT		4	/* per loop busy percent      */
+
+struct xio_server_portal {
+	struct list_head		portals_list_entry;
+	char				*uri;
+	struct xio_context		*ctx;
+	/* sessions redirected whose connections have not arrived yet */
+	uint32_t			pending;
+	uint32_t			last_conns_nr;
+	cycles_t			pending_stamp;
+};
 
 struct xio_server {
 	struct xio_nexus		*listener;
@@ -55,8 +70,11 @@ struct xio_server {
 	struct xio_context		*ctx;
 	struct xio_session_ops		ops;
 	uint32_t			session_flags;
-	uint32_t			pad;
+	uint32_t			portals_nr;
 	void				*cb_private_data;
+	struct list_head		portals_list;
+	spinlock_t			portals_lock;
+	int				auto_redirect;
 };
 
 static int xio_on_nexus_event(void *observer, void *notifier, int event,
@@ -106,6 +124,7 @@ static int xio_on_new_message(struct xio_server *server,
 
 	params.type		= XIO_SESSION_SERVER;
 	params.initial_sn	= 0;
+	params.flags		= 0;
 	params.ses_ops		= &server->ops;
 	params.uri		= server->uri;
 	params.private_data	= NULL;
@@ -129,6 +148,7 @@ static int xio_on_new_message(struct xio_server *server,
 
 		/* get transport class routines */
 		session->validators_cls = xio_nexus_get_validators_cls(nexus);
+		session->server = server;
 
 		connection =
 			xio_session_alloc_connection(session,
@@ -186,7 +206,7 @@ static int xio_on_new_message(struct xio_server *server,
 		task->connection = connection;
 
 		/* This in a multiple-portal situation */
-		session->state = XIO_SESSION_STATE_ONLINE;
+		xio_session_set_state(session, XIO_SESSION_STATE_ONLINE);
 		xio_connection_set_state(connection,
 					 XIO_CONNECTION_STATE_ONLINE);
 	} else {
@@ -291,6 +311,8 @@ struct xio_server *xio_bind(struct xio_context *ctx,
 
 	server->session_flags = session_flags;
 	memcpy(&server->ops, ops, sizeof(*ops));
+	INIT_LIST_HEAD(&server->portals_list);
+	spin_lock_init(&server->portals_lock);
 
 	XIO_OBSERVER_INIT(&server->observer, server, xio_on_nexus_event);
 
@@ -326,13 +348,188 @@ cleanup:
 /*---------------------------------------------------------------------------*/
 int xio_unbind(struct xio_server *server)
 {
+	struct xio_server_portal *portal, *tmp_portal;
 	int retval = 0;
 
 	xio_nexus_close(server->listener, NULL);
+	list_for_each_entry_safe(portal, tmp_portal, &server->portals_list,
+				 portals_list_entry) {
+		list_del(&portal->portals_list_entry);
+		kfree(portal->uri);
+		kfree(portal);
+	}
 	kfree(server->uri);
 	kfree(server);
 
 	return retval;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_server_add_portal						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_add_portal(struct xio_server *server,
+			  const char *portal_uri,
+			  struct xio_context *ctx)
+{
+	struct xio_server_portal *portal;
+
+	if ((server == NULL) || (portal_uri == NULL) || (ctx == NULL)) {
+		ERROR_LOG("invalid parameters server:%p, uri:%p, ctx:%p\n",
+			  server, portal_uri, ctx);
+		xio_set_error(EINVAL);
+		return -1;
+	}
+
+	portal = kcalloc(1, sizeof(*portal), GFP_KERNEL);
+	if (portal == NULL) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	portal->uri = kstrdup(portal_uri, GFP_KERNEL);
+	if (portal->uri == NULL) {
+		kfree(portal);
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	portal->ctx = ctx;
+	portal->last_conns_nr = atomic_read(&ctx->load.conns_nr);
+
+	spin_lock(&server->portals_lock);
+	list_add_tail(&portal->portals_list_entry, &server->portals_list);
+	server->portals_nr++;
+	spin_unlock(&server->portals_lock);
+
+	TRACE_LOG("server:%p, portal %s added\n", server, portal_uri);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_del_portal						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_del_portal(struct xio_server *server,
+			  const char *portal_uri)
+{
+	struct xio_server_portal *portal, *found = NULL;
+
+	if ((server == NULL) || (portal_uri == NULL)) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+
+	spin_lock(&server->portals_lock);
+	list_for_each_entry(portal, &server->portals_list,
+			    portals_list_entry) {
+		if (strcmp(portal->uri, portal_uri) == 0) {
+			list_del(&portal->portals_list_entry);
+			server->portals_nr--;
+			found = portal;
+			break;
+		}
+	}
+	spin_unlock(&server->portals_lock);
+
+	if (found == NULL) {
+		xio_set_error(ENOENT);
+		return -1;
+	}
+	kfree(found->uri);
+	kfree(found);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_portal_load						     */
+/*---------------------------------------------------------------------------*/
+static uint64_t xio_server_portal_load(struct xio_server_portal *portal,
+				       cycles_t now, uint64_t hertz)
+{
+	struct xio_context	*ctx = portal->ctx;
+	uint32_t		conns_nr = atomic_read(&ctx->load.conns_nr);
+	uint32_t		queued_msgs = atomic_read(&ctx->load.queued_msgs);
+	uint32_t		arrived;
+
+	/* connections that showed up consume pending redirects */
+	if (conns_nr > portal->last_conns_nr) {
+		arrived = conns_nr - portal->last_conns_nr;
+		portal->pending = (arrived < portal->pending) ?
+				  portal->pending - arrived : 0;
+	}
+	portal->last_conns_nr = conns_nr;
+
+	/* forget redirected clients that never showed up */
+	if (portal->pending && (now - portal->pending_stamp) > hertz)
+		portal->pending = 0;
+
+	return (uint64_t)(conns_nr + portal->pending) * XIO_PORTAL_CONN_WEIGHT +
+	       (uint64_t)queued_msgs * XIO_PORTAL_QUEUED_WEIGHT +
+	       (uint64_t)xio_context_get_loop_util(ctx) *
+	       XIO_PORTAL_UTIL_WEIGHT;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_redirect_session						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_redirect_session(struct xio_server *server,
+				struct xio_session *session)
+{
+	struct xio_server_portal	*portal, *best = NULL;
+	uint64_t			load, best_load = 0;
+	cycles_t			now = get_cycles();
+	char				uri[256];
+	const char			*portals[1] = { uri };
+
+	spin_lock(&server->portals_lock);
+	list_for_each_entry(portal, &server->portals_list,
+			    portals_list_entry) {
+		load = xio_server_portal_load(portal, now,
+					      server->ctx->stats.hertz);
+		if (best == NULL || load < best_load) {
+			best = portal;
+			best_load = load;
+		}
+	}
+	if (best == NULL) {
+		spin_unlock(&server->portals_lock);
+		xio_set_error(ENOENT);
+		return -1;
+	}
+	/* account for the session until its connection arrives, so that
+	 * a burst of new sessions does not pile on one portal
+	 */
+	best->pending++;
+	best->pending_stamp = now;
+	strncpy(uri, best->uri, sizeof(uri) - 1);
+	uri[sizeof(uri) - 1] = 0;
+	spin_unlock(&server->portals_lock);
+
+	DEBUG_LOG("server:%p, session:%p redirected to %s, load:%llu\n",
+		  server, session, uri, best_load);
+
+	return xio_redirect(session, portals, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_set_auto_redirect						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_set_auto_redirect(struct xio_server *server, int enable)
+{
+	if (server == NULL) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	server->auto_redirect = enable ? 1 : 0;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_auto_redirect						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_auto_redirect(struct xio_server *server)
+{
+	return server && server->auto_redirect && server->portals_nr;
+}
+
 
@@ -38,6 +38,19 @@
 #ifndef XIO_SERVER_H
 #define XIO_SERVER_H
 
+struct xio_server;
+struct xio_session;
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_auto_redirect						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_auto_redirect(struct xio_server *server);
+
+/*---------------------------------------------------------------------------*/
+/* xio_server_redirect_session						     */
+/*---------------------------------------------------------------------------*/
+int xio_server_redirect_session(struct xio_server *server,
+				struct xio_session *session);
 
 #endif /*XIO_SERVER_H */
 
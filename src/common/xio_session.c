@@ -48,6 +48,8 @@
 #include "xio_nexus.h"
 #include "xio_session.h"
 #include "xio_connection.h"
+#include "xio_connection_pool.h"
+#include "xio_stream.h"
 #include "xio_session_priv.h"
 #include "xio_sg_table.h"
 
@@ -62,6 +64,35 @@ static int xio_on_ow_req_send_comp(struct xio_connection *connection,
 				   struct xio_task *task);
 static int xio_on_rsp_send_comp(struct xio_connection *connection,
 				struct xio_task *task);
+/*---------------------------------------------------------------------------*/
+/* xio_session_stats_stage						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_session_stats_stage(struct xio_connection *connection,
+					   int hist, uint64_t from,
+					   uint64_t to)
+{
+	/* stamps survive task recycling, skip ones left from a prior use */
+	if (!from || to < from)
+		return;
+	xio_connection_stats_lat(connection, hist, to - from);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_stats_tx_stages						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_session_stats_tx_stages(
+		struct xio_connection *connection,
+		struct xio_task *task, uint64_t submitted)
+{
+	if (likely(!xio_stats_stages))
+		return;
+	xio_session_stats_stage(connection, XIO_STATS_HIST_CONN_QUEUE,
+				submitted, task->stamp[XIO_TASK_STAMP_NEXUS]);
+	xio_session_stats_stage(connection, XIO_STATS_HIST_TX_QUEUE,
+				task->stamp[XIO_TASK_STAMP_NEXUS],
+				task->stamp[XIO_TASK_STAMP_SENT]);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_session_alloc_connection						     */
 /*---------------------------------------------------------------------------*/
@@ -175,6 +206,16 @@ struct xio_connection *xio_session_find_connection_by_ctx(
 	return NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_match_peer						     */
+/*---------------------------------------------------------------------------*/
+static int xio_session_match_peer(struct xio_observer *observer, void *arg)
+{
+	struct xio_session *session = observer->impl;
+
+	return session && session->peer_session_id == *(uint32_t *)arg;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_find_session							     */
 /*---------------------------------------------------------------------------*/
@@ -184,6 +225,7 @@ struct xio_session *xio_find_session(struct xio_task *task)
 	struct xio_observer	*observer;
 	struct xio_session	*session;
 	uint32_t		dest_session_id;
+	uint32_t		src_session_id;
 
 	xio_mbuf_push(&task->mbuf);
 
@@ -194,6 +236,21 @@ struct xio_session *xio_find_session(struct xio_task *task)
 
 	dest_session_id = ntohl(tmp_hdr->dest_session_id);
 
+	if (dest_session_id == XIO_SESSION_ID_EARLY) {
+		/* request sent ahead of the setup response - the peer does
+		 * not know our id yet, match by its own session id
+		 */
+		src_session_id = ntohl(tmp_hdr->src_session_id);
+		observer = xio_nexus_observer_find(task->nexus,
+						   xio_session_match_peer,
+						   &src_session_id);
+		if (observer == NULL) {
+			ERROR_LOG("failed to find session\n");
+			return NULL;
+		}
+		return observer->impl;
+	}
+
 	observer = xio_nexus_observer_lookup(task->nexus, dest_session_id);
 	if (observer != NULL &&  observer->impl)
 		return observer->impl;
@@ -222,6 +279,7 @@ void xio_session_write_header(struct xio_task *task,
 
 	/* fill header */
 	PACK_LVAL(hdr, tmp_hdr,  dest_session_id);
+	PACK_LVAL(hdr, tmp_hdr,  src_session_id);
 	PACK_LLVAL(hdr, tmp_hdr, serial_num);
 	PACK_LVAL(hdr, tmp_hdr, flags);
 	PACK_LVAL(hdr, tmp_hdr, receipt_result);
@@ -243,6 +301,7 @@ void xio_session_read_header(struct xio_task *task,
 	/* fill request */
 	UNPACK_LLVAL(tmp_hdr, hdr, serial_num);
 	UNPACK_LVAL(tmp_hdr, hdr, dest_session_id);
+	UNPACK_LVAL(tmp_hdr, hdr, src_session_id);
 	UNPACK_LVAL(tmp_hdr, hdr, flags);
 	UNPACK_LVAL(tmp_hdr, hdr, receipt_result);
 
@@ -316,6 +375,10 @@ void xio_session_notify_connection_established(
 		.reason		   = XIO_E_SUCCESS,
 	};
 
+	if (session->cpool &&
+	    xio_connection_pool_on_event(session->cpool, &event))
+		return;
+
 	if (session->ses_ops.on_session_event)
 		session->ses_ops.on_session_event(
 				session, &event,
@@ -335,6 +398,11 @@ void xio_session_notify_connection_closed(struct xio_session *session,
 		.conn = connection,
 		.conn_user_context = connection->cb_user_context
 	};
+
+	if (session->cpool &&
+	    xio_connection_pool_on_event(session->cpool, &event))
+		return;
+
 	if (session->ses_ops.on_session_event)
 		session->ses_ops.on_session_event(
 				session, &event,
@@ -356,6 +424,10 @@ void xio_session_notify_connection_disconnected(
 		.conn_user_context = connection->cb_user_context
 	};
 
+	if (session->cpool &&
+	    xio_connection_pool_on_event(session->cpool, &event))
+		return;
+
 	if (session->ses_ops.on_session_event)
 		session->ses_ops.on_session_event(
 				session, &event,
@@ -376,6 +448,10 @@ void xio_session_notify_connection_refused(struct xio_session *session,
 		.conn_user_context = connection->cb_user_context
 	};
 
+	if (session->cpool &&
+	    xio_connection_pool_on_event(session->cpool, &event))
+		return;
+
 	if (session->ses_ops.on_session_event)
 		session->ses_ops.on_session_event(
 				session, &event,
@@ -395,6 +471,10 @@ void xio_session_notify_connection_teardown(struct xio_session *session,
 		.conn_user_context = connection->cb_user_context
 	};
 
+	if (session->cpool &&
+	    xio_connection_pool_on_event(session->cpool, &event))
+		return;
+
 	if (session->ses_ops.on_session_event)
 		session->ses_ops.on_session_event(
 				session, &event,
@@ -415,6 +495,10 @@ void xio_session_notify_connection_error(struct xio_session *session,
 		.conn_user_context = connection->cb_user_context
 	};
 
+	if (session->cpool &&
+	    xio_connection_pool_on_event(session->cpool, &event))
+		return;
+
 	if (session->ses_ops.on_session_event)
 		session->ses_ops.on_session_event(
 				session, &event,
@@ -437,7 +521,7 @@ static void xio_session_pre_teardown(struct xio_session *session)
 	kfree(session->portals_array);
 	kfree(session->hs_private_data);
 	kfree(session->uri);
-	session->state = XIO_SESSION_STATE_CLOSED;
+	xio_session_set_state(session, XIO_SESSION_STATE_CLOSED);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -482,7 +566,7 @@ void xio_close_time_wait(void *data)
 	xio_connection_notify_msgs_flush(connection);
 
 
-	connection->state = XIO_CONNECTION_STATE_CLOSED;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_CLOSED);
 
 	if (!connection->disable_notify)
 		xio_session_notify_connection_teardown(connection->session,
@@ -501,7 +585,7 @@ void xio_handle_last_ack(void *data)
 		  xio_connection_state_str(connection->state),
 		  xio_connection_state_str(XIO_CONNECTION_STATE_CLOSED));
 
-	connection->state = XIO_CONNECTION_STATE_CLOSED;
+	xio_connection_set_state(connection, XIO_CONNECTION_STATE_CLOSED);
 
 	xio_connection_destroy(connection);
 }
@@ -547,7 +631,7 @@ int xio_on_fin_rsp_recv(struct xio_connection *connection,
 		  xio_connection_state_str(connection->state),
 		  xio_connection_state_str(transition->next_state));
 
-	connection->state = transition->next_state;
+	xio_connection_set_state(connection, transition->next_state);
 
 	if (connection->state == XIO_CONNECTION_STATE_TIME_WAIT) {
 		int retval = xio_ctx_add_delayed_work(
@@ -612,7 +696,7 @@ int xio_on_fin_rsp_send_comp(struct xio_connection *connection,
 		  xio_connection_state_str(connection->state),
 		  xio_connection_state_str(transition->next_state));
 
-	connection->state = transition->next_state;
+	xio_connection_set_state(connection, transition->next_state);
 
 	/* transition from online to close_wait - notify the application */
 	if (connection->state == XIO_CONNECTION_STATE_CLOSE_WAIT) {
@@ -651,6 +735,52 @@ int xio_on_fin_rsp_send_comp(struct xio_connection *connection,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_is_early_req						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_session_is_early_req(struct xio_task *task)
+{
+	struct xio_session_hdr	*tmp_hdr;
+
+	xio_mbuf_push(&task->mbuf);
+	tmp_hdr = xio_mbuf_set_session_hdr(&task->mbuf);
+	xio_mbuf_pop(&task->mbuf);
+
+	return ntohl(tmp_hdr->dest_session_id) == XIO_SESSION_ID_EARLY;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_hold_early_req						     */
+/*---------------------------------------------------------------------------*/
+static int xio_session_hold_early_req(struct xio_connection *connection,
+				      struct xio_task *task)
+{
+	struct xio_session *session = connection->session;
+
+	if (session->type != XIO_SESSION_SERVER)
+		return 0;
+
+	/* the session is not answered yet, or earlier requests still wait
+	 * for the setup response to complete - keep the arrival order
+	 */
+	if (session->state == XIO_SESSION_STATE_INIT ||
+	    !list_empty(&connection->early_tasks_list)) {
+		list_move_tail(&task->tasks_list_entry,
+			       &connection->early_tasks_list);
+		return 1;
+	}
+	/* answered by accept with portals, redirect or reject */
+	if (session->state != XIO_SESSION_STATE_ONLINE &&
+	    xio_session_is_early_req(task)) {
+		DEBUG_LOG("early request dropped. session:%p, state:%d\n",
+			  session, session->state);
+		xio_tasks_pool_put(task);
+		return 1;
+	}
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_on_req_recv				                             */
 /*---------------------------------------------------------------------------*/
@@ -664,6 +794,9 @@ static int xio_on_req_recv(struct xio_connection *connection,
 	struct xio_sg_table_ops	*sgtbl_ops;
 	void			*sgtbl;
 
+	if (unlikely(xio_session_hold_early_req(connection, task)))
+		return 0;
+
 	sgtbl		= xio_sg_table_get(&msg->in);
 	sgtbl_ops	= xio_sg_table_ops_get(msg->in.sgl_type);
 
@@ -687,12 +820,24 @@ static int xio_on_req_recv(struct xio_connection *connection,
 		xio_task_addref(task);
 
 	msg->timestamp = get_cycles();
+	if (unlikely(xio_stats_stages))
+		xio_session_stats_stage(connection, XIO_STATS_HIST_DELIVER,
+					task->stamp[XIO_TASK_STAMP_RECV],
+					msg->timestamp);
+	if (task->tlv_type == XIO_MSG_REQ)
+		xio_connection_load_inc(connection);
 	xio_stat_inc(stats, XIO_STAT_RX_MSG);
 	xio_stat_add(stats, XIO_STAT_RX_BYTES,
 		     vmsg->header.iov_len + tbl_length(sgtbl_ops, sgtbl));
+	xio_connection_stats_rx(connection, 1,
+				vmsg->header.iov_len +
+				tbl_length(sgtbl_ops, sgtbl));
 
 	/* notify the upper layer */
-	if (task->status) {
+	if (unlikely(msg->flags & XIO_MSG_FLAG_STREAM)) {
+		xio_stream_on_chunk(connection, msg, task->status);
+		task->status = 0;
+	} else if (task->status) {
 		xio_session_notify_msg_error(connection, msg, task->status);
 		task->status = 0;
 	} else {
@@ -718,6 +863,29 @@ static int xio_on_req_recv(struct xio_connection *connection,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_flush_early_reqs						     */
+/*---------------------------------------------------------------------------*/
+void xio_session_flush_early_reqs(struct xio_connection *connection)
+{
+	struct xio_task		*ptask, *pnext_task;
+	LIST_HEAD(early_tasks_list);
+
+	if (list_empty(&connection->early_tasks_list))
+		return;
+
+	list_splice_init(&connection->early_tasks_list, &early_tasks_list);
+
+	/* deliver on plain accept, otherwise the client resends them */
+	list_for_each_entry_safe(ptask, pnext_task, &early_tasks_list,
+				 tasks_list_entry) {
+		if (connection->session->state == XIO_SESSION_STATE_ONLINE)
+			xio_on_req_recv(connection, ptask);
+		else
+			xio_tasks_pool_put(ptask);
+	}
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_on_rsp_recv				                             */
 /*---------------------------------------------------------------------------*/
@@ -752,6 +920,18 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 	xio_stat_add(stats, XIO_STAT_DELAY,
 		     get_cycles() - omsg->timestamp);
 	xio_stat_inc(stats, XIO_STAT_RX_MSG);
+	xio_connection_stats_lat(connection, XIO_STATS_HIST_RTT,
+				 get_cycles() - omsg->timestamp);
+	if (unlikely(xio_stats_stages)) {
+		xio_session_stats_tx_stages(connection, sender_task,
+					    omsg->timestamp);
+		xio_session_stats_stage(connection, XIO_STATS_HIST_WIRE_PEER,
+					sender_task->stamp[XIO_TASK_STAMP_SENT],
+					task->stamp[XIO_TASK_STAMP_RECV]);
+		xio_session_stats_stage(connection, XIO_STATS_HIST_DELIVER,
+					task->stamp[XIO_TASK_STAMP_RECV],
+					get_cycles());
+	}
 
 	task->connection = connection;
 
@@ -782,7 +962,7 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 
 		omsg->sn	  = msg->sn; /* one way do have response */
 		omsg->receipt_res = hdr.receipt_result;
-		connection->queued_msgs--;
+		xio_connection_queued_dec(connection);
 		if (connection->ses_ops.on_msg_delivered)
 			connection->ses_ops.on_msg_delivered(
 				    connection->session,
@@ -827,9 +1007,16 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 			xio_stat_add(stats, XIO_STAT_RX_BYTES,
 				     vmsg->header.iov_len +
 				     tbl_length(sgtbl_ops, sgtbl));
+			xio_connection_stats_rx(connection, 1,
+						vmsg->header.iov_len +
+						tbl_length(sgtbl_ops, sgtbl));
 
 			omsg->request	= msg;
-			if (task->status) {
+			if (unlikely(omsg->flags & XIO_MSG_FLAG_STREAM)) {
+				xio_stream_on_ack(connection, omsg,
+						  task->status);
+				task->status = 0;
+			} else if (task->status) {
 				xio_session_notify_msg_error(
 					connection, omsg, task->status);
 				task->status = 0;
@@ -863,6 +1050,8 @@ static int xio_on_rsp_send_comp(
 		goto xmit;
 	}
 
+	xio_session_stats_tx_stages(connection, task, task->omsg->timestamp);
+
 	/* remove the message from in flight queue */
 	xio_connection_remove_in_flight(connection, task->omsg);
 
@@ -878,7 +1067,9 @@ static int xio_on_rsp_send_comp(
 		/* send completion notification only to responder to
 		 * release responses
 		 */
-		if (connection->ses_ops.on_msg_send_complete) {
+		if (unlikely(xio_stream_is_ack(connection, task->omsg))) {
+			xio_stream_on_ack_sent(connection, task->omsg);
+		} else if (connection->ses_ops.on_msg_send_complete) {
 			connection->ses_ops.on_msg_send_complete(
 					connection->session, task->omsg,
 					connection->cb_user_context);
@@ -901,7 +1092,7 @@ static int xio_on_ow_req_send_comp(
 		struct xio_connection *connection,
 		struct xio_task *task)
 {
-	if (connection->is_flushed) {
+	if (connection->is_flushed || unlikely(!task->omsg)) {
 		xio_tasks_pool_put(task);
 		goto xmit;
 	}
@@ -912,9 +1103,12 @@ static int xio_on_ow_req_send_comp(
 		struct xio_msg *omsg = task->omsg;
 		xio_stat_add(stats, XIO_STAT_DELAY,
 			     get_cycles() - omsg->timestamp);
+		xio_connection_stats_lat(connection, XIO_STATS_HIST_RTT,
+					 get_cycles() - omsg->timestamp);
+		xio_session_stats_tx_stages(connection, task, omsg->timestamp);
 
 		xio_connection_remove_in_flight(connection, task->omsg);
-		connection->queued_msgs--;
+		xio_connection_queued_dec(connection);
 
 		/* send completion notification to
 		 * release request
@@ -932,10 +1126,15 @@ static int xio_on_ow_req_send_comp(
 			struct xio_msg *omsg = task->omsg;
 			xio_stat_add(stats, XIO_STAT_DELAY,
 				     get_cycles() - omsg->timestamp);
+			xio_connection_stats_lat(connection,
+						 XIO_STATS_HIST_RTT,
+						 get_cycles() - omsg->timestamp);
+			xio_session_stats_tx_stages(connection, task,
+						    omsg->timestamp);
 
 			xio_connection_remove_in_flight(connection, task->omsg);
 			task->omsg->flags = task->omsg_flags;
-			connection->queued_msgs--;
+			xio_connection_queued_dec(connection);
 
 			if (connection->ses_ops.on_msg_delivered)
 				connection->ses_ops.on_msg_delivered(
@@ -1035,6 +1234,13 @@ int xio_on_nexus_message_error(struct xio_session *session,
 {
 	struct xio_task *task = event_data->msg_error.task;
 
+	/* an early request already requeued for another nexus */
+	if (unlikely(!task->omsg)) {
+		if (IS_REQUEST(task->tlv_type))
+			xio_tasks_pool_put(task);
+		return 0;
+	}
+
 	xio_connection_remove_msg_from_queue(task->connection, task->omsg);
 
 	if (task->session->ses_ops.on_msg_error)
@@ -1069,7 +1275,7 @@ int xio_on_nexus_error(struct xio_session *session, struct xio_nexus *nexus,
 	switch (session->state) {
 	case XIO_SESSION_STATE_CONNECT:
 	case XIO_SESSION_STATE_REDIRECTED:
-		session->state = XIO_SESSION_STATE_REFUSED;
+		xio_session_set_state(session, XIO_SESSION_STATE_REFUSED);
 		while (!list_empty(&session->connections_list)) {
 			connection = list_first_entry(
 					&session->connections_list,
@@ -1458,6 +1664,7 @@ struct xio_session *xio_session_create(struct xio_session_params *params)
 
 	session->trans_sn		= params->initial_sn;
 	session->state			= XIO_SESSION_STATE_INIT;
+	session->flags			= params->flags;
 
 	memcpy(&session->ses_ops, params->ses_ops,
 	       sizeof(*params->ses_ops));
@@ -1501,8 +1708,11 @@ int xio_session_destroy(struct xio_session *session)
 		return 0;
 
 	TRACE_LOG("session destroy:%p\n", session);
-	session->state = XIO_SESSION_STATE_CLOSING;
+	xio_session_set_state(session, XIO_SESSION_STATE_CLOSING);
 	if (list_empty(&session->connections_list)) {
+		/* the pool may outlive the session - cut it loose */
+		if (session->cpool)
+			xio_connection_pool_detach(session->cpool);
 		xio_session_pre_teardown(session);
 		if (!session->in_notify)
 			xio_session_post_teardown(session);
@@ -1636,6 +1846,10 @@ int xio_session_notify_cancel(struct xio_connection *connection,
 int xio_session_notify_msg_error(struct xio_connection *connection,
 				 struct xio_msg *msg, enum xio_status result)
 {
+	if (unlikely((msg->flags & XIO_MSG_FLAG_STREAM) ||
+		     xio_stream_is_ack(connection, msg)))
+		return xio_stream_on_msg_error(connection, msg, result);
+
 	/* notify the upper layer */
 	if (connection->ses_ops.on_msg_error)
 		connection->ses_ops.on_msg_error(
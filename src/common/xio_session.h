@@ -41,6 +41,7 @@
 #include "xio_hash.h"
 #include "xio_context.h"
 #include "sys/hashtable.h"
+#include "xio_trace.h"
 
 /*---------------------------------------------------------------------------*/
 /* forward declarations			                                     */
@@ -70,11 +71,10 @@ struct xio_session {
 	uint32_t			session_id;
 	uint32_t			peer_session_id;
 	uint32_t			connections_nr;
-	uint32_t			pad;
+	uint32_t			flags;	   /* xio_session_flags */
 
 	struct list_head		sessions_list_entry;
 	struct list_head		connections_list;
-	HT_ENTRY(xio_session, xio_key_int32) sessions_htbl;
 
 	struct xio_session_ops		ses_ops;
 	struct xio_transport_msg_validators_cls	*validators_cls;
@@ -117,12 +117,24 @@ struct xio_session {
 	int				disable_teardown;
 	struct xio_connection		*lead_connection;
 	struct xio_connection		*redir_connection;
+	struct xio_connection_pool	*cpool;	   /* client connection pool */
+	struct xio_server		*server;   /* accepting server	     */
 	xio_work_handle_t		teardown_work;
 
 };
 
 /*---------------------------------------------------------------------------*/
 /* functions								     */
+/*---------------------------------------------------------------------------*/
+/* xio_session_set_state						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_session_set_state(struct xio_session *session,
+					 enum xio_session_state state)
+{
+	xio_trace3(session_state, session, session->state, state);
+	session->state = state;
+}
+
 /*---------------------------------------------------------------------------*/
 void xio_session_write_header(
 		struct xio_task *task,
@@ -234,5 +246,10 @@ void xio_session_notify_rejected(struct xio_session *session);
 
 void xio_session_post_teardown(struct xio_session *session);
 
+int xio_session_schedule_teardown(struct xio_session *session,
+				  struct xio_context *ctx, int reason);
+
+void xio_session_client_reset(struct xio_session *session);
+
 #endif /*XIO_SESSION_H */
 
@@ -148,8 +148,13 @@ int xio_on_connection_hello_rsp_recv(struct xio_connection *connection,
 	xio_tasks_pool_put(task);
 
 
-	/* set the new connection to ESTABLISHED */
+	/* set the new connection to ESTABLISHED, a connection added to an
+	 * online session is online right away - it is usable and can be
+	 * disconnected like the others
+	 */
 	xio_connection_set_state(connection,
+				 session->state == XIO_SESSION_STATE_ONLINE ?
+				 XIO_CONNECTION_STATE_ONLINE :
 				 XIO_CONNECTION_STATE_ESTABLISHED);
 	xio_session_notify_connection_established(session, connection);
 
@@ -167,7 +172,8 @@ int xio_on_connection_hello_rsp_recv(struct xio_connection *connection,
 		}
 		spin_unlock(&session->connections_list_lock);
 		if (is_last) {
-			session->state = XIO_SESSION_STATE_ONLINE;
+			xio_session_set_state(session,
+					      XIO_SESSION_STATE_ONLINE);
 			TRACE_LOG("session state is now ONLINE. session:%p\n",
 				  session);
 			if (session->ses_ops.on_session_established)
@@ -506,6 +512,33 @@ static int xio_prep_portal(struct xio_connection *connection)
 }
 
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_client_reset						     */
+/*---------------------------------------------------------------------------*/
+void xio_session_client_reset(struct xio_session *session)
+{
+	int i;
+
+	/* forget the previous setup so that the next xio_connect runs the
+	 * session setup again, possibly against a restarted server
+	 */
+	for (i = 0; i < session->services_array_len; i++)
+		kfree(session->services_array[i]);
+	for (i = 0; i < session->portals_array_len; i++)
+		kfree(session->portals_array[i]);
+	kfree(session->services_array);
+	kfree(session->portals_array);
+	session->services_array		= NULL;
+	session->portals_array		= NULL;
+	session->services_array_len	= 0;
+	session->portals_array_len	= 0;
+	session->last_opened_portal	= 0;
+	session->lead_connection	= NULL;
+	session->redir_connection	= NULL;
+
+	xio_session_set_state(session, XIO_SESSION_STATE_INIT);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_on_setup_rsp_recv			                             */
 /*---------------------------------------------------------------------------*/
@@ -517,7 +550,10 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 	struct xio_new_session_rsp	*rsp = &session->new_ses_rsp;
 	int				retval = 0;
 	struct xio_connection		*tmp_connection;
+	int				early_data = connection->early_data;
 
+	/* from here on the connection follows the regular online rules */
+	connection->early_data = 0;
 
 	retval = xio_read_setup_rsp(connection, task, &action);
 
@@ -551,7 +587,8 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 			session->disable_teardown = 0;
 
 			if (session->connections_nr > 1) {
-				session->state = XIO_SESSION_STATE_ACCEPTED;
+				xio_session_set_state(
+					session, XIO_SESSION_STATE_ACCEPTED);
 
 				/* open new connections */
 				retval = xio_session_accept_connection(session);
@@ -561,8 +598,10 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 					return -1;
 				}
 			} else {
-				session->state = XIO_SESSION_STATE_ONLINE;
-				connection->state = XIO_CONNECTION_STATE_ONLINE;
+				xio_session_set_state(session,
+						      XIO_SESSION_STATE_ONLINE);
+				xio_connection_set_state(connection,
+						XIO_CONNECTION_STATE_ONLINE);
 				TRACE_LOG(
 				     "session state is now ONLINE. session:%p\n",
 				     session);
@@ -596,19 +635,27 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 			connection->nexus = NULL;
 			session->lead_connection = tmp_connection;
 
+			/* the server dropped the early requests - resend them
+			 * once the connection to the portal is up
+			 */
+			if (early_data)
+				xio_connection_rewind_early_msgs(
+						connection, tmp_connection->nexus);
+
 			/* close the lead/redirected connection */
 			/* temporary disable teardown */
 			session->disable_teardown = 1;
 			session->lead_connection->disable_notify = 1;
-			session->lead_connection->state	=
-					XIO_CONNECTION_STATE_ONLINE;
+			xio_connection_set_state(session->lead_connection,
+						 XIO_CONNECTION_STATE_ONLINE);
 			xio_disconnect(session->lead_connection);
 
 			/* temporary disable teardown - on cached nexuss close
 			 * callback may jump immediately and since there are no
 			 * connections. teardown may notified
 			 */
-			session->state = XIO_SESSION_STATE_ACCEPTED;
+			xio_session_set_state(session,
+					      XIO_SESSION_STATE_ACCEPTED);
 			/* open new connections */
 			retval = xio_session_accept_connection(session);
 			if (retval != 0) {
@@ -627,7 +674,14 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 		TRACE_LOG("session state is now REDIRECT. session:%p\n",
 			  session);
 
-		session->state = XIO_SESSION_STATE_REDIRECTED;
+		xio_session_set_state(session, XIO_SESSION_STATE_REDIRECTED);
+
+		/* the server dropped the early requests - resend them to the
+		 * redirected server
+		 */
+		if (early_data)
+			xio_connection_rewind_early_msgs(connection,
+							 connection->nexus);
 
 		/* open new connections */
 		retval = xio_session_redirect_connection(session);
@@ -639,7 +693,8 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 		/* close the lead connection */
 		session->disable_teardown = 1;
 		session->lead_connection->disable_notify = 1;
-		session->lead_connection->state	= XIO_CONNECTION_STATE_ONLINE;
+		xio_connection_set_state(session->lead_connection,
+					 XIO_CONNECTION_STATE_ONLINE);
 		xio_disconnect_initial_connection(session->lead_connection);
 
 		return 0;
@@ -650,7 +705,7 @@ int xio_on_setup_rsp_recv(struct xio_connection *connection,
 		xio_session_notify_connection_established(session,
 							  connection);
 
-		session->state = XIO_SESSION_STATE_REJECTED;
+		xio_session_set_state(session, XIO_SESSION_STATE_REJECTED);
 		session->disable_teardown = 0;
 		session->lead_connection = NULL;
 
@@ -691,7 +746,7 @@ int xio_on_nexus_refused(struct xio_session *session,
 	switch (session->state) {
 	case XIO_SESSION_STATE_CONNECT:
 	case XIO_SESSION_STATE_REDIRECTED:
-		session->state = XIO_SESSION_STATE_REFUSED;
+		xio_session_set_state(session, XIO_SESSION_STATE_REFUSED);
 		list_for_each_entry_safe(curr_connection, next_connection,
 					 &session->connections_list,
 					 connections_list_entry) {
@@ -711,6 +766,22 @@ int xio_on_nexus_refused(struct xio_session *session,
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_start_early_data						     */
+/*---------------------------------------------------------------------------*/
+static void xio_session_start_early_data(struct xio_session *session,
+					 struct xio_connection *connection)
+{
+	if (!(session->flags & XIO_SESSION_FLAG_EARLY_DATA))
+		return;
+
+	/* the setup request is on the wire - queued requests may follow it
+	 * on the same nexus and the server holds them until it answers
+	 */
+	connection->early_data = 1;
+	xio_connection_xmit_msgs(connection);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_on_client_nexus_established					     */
 /*---------------------------------------------------------------------------*/
@@ -747,6 +818,9 @@ int xio_on_client_nexus_established(struct xio_session *session,
 				session->ses_ops.on_session_event(
 						session, &ev_data,
 						session->cb_user_context);
+		} else if (retval == 0) {
+			xio_session_start_early_data(session,
+						     session->lead_connection);
 		}
 
 		break;
@@ -756,7 +830,7 @@ int xio_on_client_nexus_established(struct xio_session *session,
 			ERROR_LOG("setup request creation failed\n");
 			return -1;
 		}
-		session->state = XIO_SESSION_STATE_CONNECT;
+		xio_session_set_state(session, XIO_SESSION_STATE_CONNECT);
 
 		msg->type      = XIO_SESSION_SETUP_REQ;
 
@@ -771,6 +845,9 @@ int xio_on_client_nexus_established(struct xio_session *session,
 				session->ses_ops.on_session_event(
 						session, &ev_data,
 						session->cb_user_context);
+		} else if (retval == 0) {
+			xio_session_start_early_data(session,
+						     session->redir_connection);
 		}
 		break;
 	case XIO_SESSION_STATE_ACCEPTED:
@@ -960,13 +1037,13 @@ struct xio_connection *xio_connect(struct xio_session  *session,
 		/* get transport class routines */
 		session->validators_cls = xio_nexus_get_validators_cls(nexus);
 
-		session->state = XIO_SESSION_STATE_CONNECT;
+		xio_session_set_state(session, XIO_SESSION_STATE_CONNECT);
 
 		retval = xio_nexus_connect(nexus, portal,
 					   &session->observer, out_if);
 		if (retval != 0) {
 			ERROR_LOG("connection connect failed\n");
-			session->state = XIO_SESSION_STATE_INIT;
+			xio_session_set_state(session, XIO_SESSION_STATE_INIT);
 			goto cleanup;
 		}
 	} else if ((session->state == XIO_SESSION_STATE_CONNECT) ||
@@ -112,6 +112,11 @@ int xio_on_nexus_message_error(struct xio_session *session,
 			       struct xio_nexus *nexus,
 			       union xio_nexus_event_data *event_data);
 
+/*---------------------------------------------------------------------------*/
+/* xio_session_flush_early_reqs						     */
+/*---------------------------------------------------------------------------*/
+void xio_session_flush_early_reqs(struct xio_connection *connection);
+
 /*---------------------------------------------------------------------------*/
 /* xio_session_read_header						     */
 /*---------------------------------------------------------------------------*/
@@ -50,6 +50,7 @@
 #include "xio_nexus.h"
 #include "xio_connection.h"
 #include "xio_session_priv.h"
+#include "xio_server.h"
 
 /*---------------------------------------------------------------------------*/
 /* xio_on_setup_req_recv			                             */
@@ -133,7 +134,17 @@ int xio_on_setup_req_recv(struct xio_connection *connection,
 					connection->cb_user_context);
 		if (retval)
 			goto cleanup2;
-	} else {
+	}
+	if (session->state == XIO_SESSION_STATE_INIT &&
+	    xio_server_auto_redirect(session->server)) {
+		/* not answered by the user - balance over the portals */
+		retval = xio_server_redirect_session(session->server, session);
+		if (retval) {
+			ERROR_LOG("failed to redirect session. session:%p\n",
+				  session);
+			goto cleanup2;
+		}
+	} else if (!connection->ses_ops.on_new_session) {
 		retval = xio_accept(session, NULL, 0, NULL, 0);
 		if (retval) {
 			ERROR_LOG("failed to auto accept session. session:%p\n",
@@ -180,7 +191,7 @@ int xio_on_connection_hello_req_recv(struct xio_connection *connection,
 
 	xio_connection_send_hello_rsp(connection, task);
 
-	connection->session->state = XIO_SESSION_STATE_ONLINE;
+	xio_session_set_state(connection->session, XIO_SESSION_STATE_ONLINE);
 	connection->session->disable_teardown = 0;
 
 	TRACE_LOG("session state is now ONLINE. session:%p\n",
@@ -405,14 +416,14 @@ int xio_accept(struct xio_session *session,
 		/* server side state is changed to ACCEPT, will be move to
 		 * ONLINE state when first "hello" message arrives
 		 */
-		session->state = XIO_SESSION_STATE_ACCEPTED;
+		xio_session_set_state(session, XIO_SESSION_STATE_ACCEPTED);
 		/* temporary disable teardown */
 		session->disable_teardown = 1;
 		TRACE_LOG("session state is now ACCEPT. session:%p\n",
 			  session);
 	} else {
 		/* server side state is changed to ONLINE, immediately  */
-		session->state = XIO_SESSION_STATE_ONLINE;
+		xio_session_set_state(session, XIO_SESSION_STATE_ONLINE);
 		TRACE_LOG("session state changed to ONLINE. session:%p\n",
 			  session);
 	}
@@ -449,7 +460,7 @@ int xio_redirect(struct xio_session *session,
 	}
 	if (portals_array_len != 0) {
 		/* server side state is changed to ACCEPT */
-		session->state = XIO_SESSION_STATE_REDIRECTED;
+		xio_session_set_state(session, XIO_SESSION_STATE_REDIRECTED);
 		TRACE_LOG("session state is now REDIRECTED. session:%p\n",
 			  session);
 	}
@@ -488,7 +499,7 @@ int xio_reject(struct xio_session *session,
 		return -1;
 	}
 	/* server side state is changed to REJECTED */
-	session->state = XIO_SESSION_STATE_REJECTED;
+	xio_session_set_state(session, XIO_SESSION_STATE_REJECTED);
 	TRACE_LOG("session state is now REJECT. session:%p\n",
 		  session);
 
@@ -528,6 +539,9 @@ int xio_on_setup_rsp_send_comp(struct xio_connection *connection,
 	/* time to set new callback */
 	DEBUG_LOG("task recycled\n");
 
+	/* requests that arrived along with the setup request */
+	xio_session_flush_early_reqs(connection);
+
 	switch (connection->session->state) {
 	case XIO_SESSION_STATE_ACCEPTED:
 	case XIO_SESSION_STATE_REJECTED:
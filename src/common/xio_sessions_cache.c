@@ -43,48 +43,21 @@
 #include "xio_transport.h"
 #include "xio_task.h"
 #include "xio_session.h"
+#include "xio_rcu_htbl.h"
 #include "xio_sessions_cache.h"
 
-static HT_HEAD(, xio_session, HASHTABLE_PRIME_SMALL)  sessions_cache;
-static spinlock_t ss_lock;
-
-/*---------------------------------------------------------------------------*/
-/* sessions_cache_add							     */
-/*---------------------------------------------------------------------------*/
-static int sessions_cache_add(struct xio_session *session,
-			      uint32_t session_id)
-{
-	struct xio_session *s;
-	struct xio_key_int32  key = {
-		session_id
-	};
-	HT_LOOKUP(&sessions_cache, &key, s, sessions_htbl);
-	if (s != NULL)
-		return -1;
+#define XIO_SESSIONS_CACHE_MIN_SIZE	128
 
-	HT_INSERT(&sessions_cache, &key, session, sessions_htbl);
-
-	return 0;
-}
+static struct xio_rcu_htbl sessions_cache;
+static spinlock_t ss_lock;
 
 /*---------------------------------------------------------------------------*/
 /* xio_sessions_cache_remove				                     */
 /*---------------------------------------------------------------------------*/
 int xio_sessions_cache_remove(uint32_t session_id)
 {
-	struct xio_session *s;
-	struct xio_key_int32  key;
-
-	spin_lock(&ss_lock);
-	key.id = session_id;
-	HT_LOOKUP(&sessions_cache, &key, s, sessions_htbl);
-	if (s == NULL) {
-		spin_unlock(&ss_lock);
+	if (xio_rcu_htbl_remove(&sessions_cache, session_id) == NULL)
 		return -1;
-	}
-
-	HT_REMOVE(&sessions_cache, s, xio_session, sessions_htbl);
-	spin_unlock(&ss_lock);
 
 	return 0;
 }
@@ -94,15 +67,7 @@ int xio_sessions_cache_remove(uint32_t session_id)
 /*---------------------------------------------------------------------------*/
 struct xio_session *xio_sessions_cache_lookup(uint32_t session_id)
 {
-	struct xio_session *s;
-	struct xio_key_int32  key;
-
-	spin_lock(&ss_lock);
-	key.id = session_id;
-	HT_LOOKUP(&sessions_cache, &key, s, sessions_htbl);
-	spin_unlock(&ss_lock);
-
-	return s;
+	return xio_rcu_htbl_lookup(&sessions_cache, session_id);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -112,15 +77,17 @@ int xio_sessions_cache_add(struct xio_session *session,
 			   uint32_t *session_id)
 {
 	static uint32_t sid;  /* = 0 global session provider */
-	int retval;
+	uint32_t id;
 
 	spin_lock(&ss_lock);
-	retval = sessions_cache_add(session, sid);
-	if (retval == 0)
-		*session_id = sid++;
+	id = sid++;
 	spin_unlock(&ss_lock);
 
-	return retval;
+	if (xio_rcu_htbl_insert(&sessions_cache, id, session))
+		return -1;
+	*session_id = id;
+
+	return 0;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -128,12 +95,15 @@ int xio_sessions_cache_add(struct xio_session *session,
 /*---------------------------------------------------------------------------*/
 void sessions_cache_construct(void)
 {
-	HT_INIT(&sessions_cache, xio_int32_hash, xio_int32_cmp, xio_int32_cp);
+	if (xio_rcu_htbl_init(&sessions_cache, XIO_SESSIONS_CACHE_MIN_SIZE))
+		ERROR_LOG("sessions cache allocation failed\n");
 	spin_lock_init(&ss_lock);
 }
 
-/*
+/*---------------------------------------------------------------------------*/
+/* sessions_cache_destruct				                     */
+/*---------------------------------------------------------------------------*/
 void sessions_cache_destruct(void)
 {
+	xio_rcu_htbl_destroy(&sessions_cache);
 }
-*/
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_STATS_SHM_H
+#define XIO_STATS_SHM_H
+
+/*
+ * Layout of the statistics segment a process publishes under
+ * /dev/shm/xio-stats.<pid> when XIO_STATS_SHM is set in its environment.
+ * This header is shared by the library (the writer) and by external
+ * readers such as xio_stat, so it must only use fixed size types.
+ *
+ * Each connection owns one slot and only the thread running the
+ * connection's context writes it.  Writers bracket every update with
+ * xio_stats_write_begin/end; readers copy a slot and retry while the
+ * sequence is odd or changed under them, so reading never blocks the
+ * event loop nor resets anything.
+ */
+#define XIO_STATS_SHM_MAGIC		0x53544158	/* "XATS" */
+#define XIO_STATS_SHM_VERSION		2
+#define XIO_STATS_SHM_NAME		"/xio-stats.%d"
+#define XIO_STATS_SHM_CONNS		1024
+#define XIO_STATS_URI_LEN		64
+
+/* header flags */
+#define XIO_STATS_SHM_F_STAGES		0x1	/* stage histograms filled */
+
+/* latency histograms are log2 bucketed in cpu cycles. bucket i counts
+ * samples in [2^(i-1), 2^i), the last bucket absorbs everything above
+ */
+#define XIO_STATS_HIST_BUCKETS		40
+
+enum xio_stats_hist {
+	XIO_STATS_HIST_RTT,		/* request sent to response received */
+	XIO_STATS_HIST_APP,		/* request delivered to response sent */
+	/* per stage breakdown, only filled when XIO_STATS_STAGES is set */
+	XIO_STATS_HIST_CONN_QUEUE,	/* submitted to handed to nexus */
+	XIO_STATS_HIST_TX_QUEUE,	/* handed to nexus to written to wire */
+	XIO_STATS_HIST_WIRE_PEER,	/* written to wire to response received */
+	XIO_STATS_HIST_DELIVER,		/* received to application callback */
+	XIO_STATS_HIST_LAST
+};
+
+struct xio_stats_shm_hdr {
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			conns_nr;	/* slots in segment */
+	uint32_t			hist_buckets;
+	uint64_t			hertz;		/* cycles per second */
+	int32_t				pid;
+	uint32_t			slot_size;
+	uint32_t			flags;
+	uint32_t			pad;
+	uint64_t			reserved[3];	/* keep header 64B */
+};
+
+struct xio_stats_conn {
+	uint32_t			seq;		/* odd while written */
+	uint32_t			in_use;
+	uint64_t			ctx;		/* context identifier */
+	uint32_t			session_id;
+	uint16_t			conn_idx;
+	uint16_t			session_type;
+	int32_t				cpuid;
+	uint32_t			pad;
+	char				uri[XIO_STATS_URI_LEN];
+
+	uint64_t			tx_msgs;
+	uint64_t			tx_bytes;
+	uint64_t			rx_msgs;
+	uint64_t			rx_bytes;
+
+	/* sampled on every update */
+	uint32_t			queued_msgs;	/* connection backlog */
+	uint32_t			ctx_queued_msgs;
+	uint16_t			pool_used;	/* nexus task pool */
+	uint16_t			pool_alloced;
+	uint16_t			pool_max_used;
+	uint16_t			pad1;
+
+	uint64_t			hist[XIO_STATS_HIST_LAST]
+					    [XIO_STATS_HIST_BUCKETS];
+	uint64_t			reserved[6];	/* keep slot 64B aligned */
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_write_begin						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stats_write_begin(struct xio_stats_conn *slot)
+{
+	slot->seq++;
+	smp_wmb();
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_write_end							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stats_write_end(struct xio_stats_conn *slot)
+{
+	smp_wmb();
+	slot->seq++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_hist_add							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stats_hist_add(struct xio_stats_conn *slot,
+				      int hist, uint64_t cycles)
+{
+	int bucket = cycles ? 64 - __builtin_clzll(cycles) : 0;
+
+	if (bucket >= XIO_STATS_HIST_BUCKETS)
+		bucket = XIO_STATS_HIST_BUCKETS - 1;
+	slot->hist[hist][bucket]++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* forward declarations							     */
+/*---------------------------------------------------------------------------*/
+struct xio_context;
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_get - claim a connection slot, NULL when the segment  */
+/* is disabled or full							     */
+/*---------------------------------------------------------------------------*/
+struct xio_stats_conn *xio_stats_shm_conn_get(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_put						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_conn_put(struct xio_stats_conn *slot);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_destruct - unmap and unlink the segment at library exit    */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_destruct(void);
+
+#endif /*XIO_STATS_SHM_H */
@@ -0,0 +1,641 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_common.h"
+#include "xio_protocol.h"
+#include "xio_observer.h"
+#include "xio_task.h"
+#include "xio_context.h"
+#include "xio_transport.h"
+#include "xio_msg_list.h"
+#include "xio_session.h"
+#include "xio_connection.h"
+#include "xio_stream.h"
+
+#define XIO_STREAM_DEFAULT_WINDOW	16
+#define XIO_STREAM_MAX_WINDOW		1024
+
+/*---------------------------------------------------------------------------*/
+/* enums								     */
+/*---------------------------------------------------------------------------*/
+enum xio_stream_hdr_flags {
+	XIO_STREAM_FLAG_OPEN	= 1 << 0,	/* first chunk of the stream  */
+	XIO_STREAM_FLAG_FIN	= 1 << 1,	/* last chunk of the stream   */
+	XIO_STREAM_FLAG_REJECT	= 1 << 2,	/* ack - chunk not delivered  */
+};
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+/* carried in the chunk's header and echoed in its acknowledge */
+struct __attribute__((__packed__)) xio_stream_hdr {
+	uint32_t			stream_id;
+	uint32_t			seq;
+	uint16_t			flags;
+	uint16_t			pad;
+};
+
+/* sender - one per unacknowledged chunk */
+struct xio_stream_slot {
+	struct xio_stream_hdr		hdr;
+	uint32_t			pad;
+	struct xio_stream		*stream;
+	struct xio_stream_slot		*next;	/* free list */
+};
+
+/* receiver - acknowledge (response) of a chunk */
+struct xio_stream_rsp {
+	struct xio_msg			msg;
+	struct xio_stream_hdr		hdr;
+	uint32_t			pad;
+	struct xio_stream		*stream; /* NULL if not delivered */
+	struct xio_stream_rsp		*next;	 /* free list */
+	struct list_head		rsps_list_entry;
+};
+
+struct xio_stream_conn {
+	struct xio_stream_ops		ops;	/* of accepted streams */
+	void				*user_context;
+	struct list_head		streams_list;
+	struct list_head		rsps_list;
+	struct xio_stream_rsp		*free_rsps;
+	uint32_t			next_id;
+	int				listening;
+};
+
+struct xio_stream {
+	struct xio_connection		*connection;
+	struct xio_stream_ops		ops;
+	void				*user_context;
+	struct list_head		streams_list_entry;
+	struct xio_stream_slot		*slots;
+	struct xio_stream_slot		*free_slots;
+	uint32_t			id;
+	uint32_t			seq;	/* next chunk to write/deliver */
+	uint32_t			outstanding; /* not yet acknowledged */
+	uint16_t			local;	/* opened on this side */
+	uint16_t			fin;	/* last chunk written/delivered */
+	uint16_t			closing;
+	uint16_t			pad;
+	enum xio_status			status;
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_conn_get							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_stream_conn *xio_stream_conn_get(
+		struct xio_connection *connection)
+{
+	struct xio_stream_conn *sconn = connection->streams;
+
+	if (sconn)
+		return sconn;
+
+	sconn = kcalloc(1, sizeof(*sconn), GFP_KERNEL);
+	if (sconn == NULL) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("calloc failed. %m\n");
+		return NULL;
+	}
+	INIT_LIST_HEAD(&sconn->streams_list);
+	INIT_LIST_HEAD(&sconn->rsps_list);
+	connection->streams = sconn;
+
+	return sconn;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_lookup							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_stream *xio_stream_lookup(struct xio_stream_conn *sconn,
+					    uint32_t id)
+{
+	struct xio_stream *stream;
+
+	list_for_each_entry(stream, &sconn->streams_list, streams_list_entry) {
+		if (!stream->local && stream->id == id)
+			return stream;
+	}
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_alloc							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_stream *xio_stream_alloc(struct xio_connection *connection,
+					   struct xio_stream_conn *sconn,
+					   uint32_t id, int window)
+{
+	struct xio_stream *stream;
+	int i;
+
+	stream = kcalloc(1, sizeof(*stream), GFP_KERNEL);
+	if (stream == NULL)
+		goto nomem;
+	if (window) {
+		stream->slots = kcalloc(window, sizeof(*stream->slots),
+					GFP_KERNEL);
+		if (stream->slots == NULL) {
+			kfree(stream);
+			goto nomem;
+		}
+		for (i = window - 1; i >= 0; i--) {
+			stream->slots[i].stream = stream;
+			stream->slots[i].next = stream->free_slots;
+			stream->free_slots = &stream->slots[i];
+		}
+		stream->local = 1;
+	}
+	stream->connection = connection;
+	stream->id = id;
+	list_add_tail(&stream->streams_list_entry, &sconn->streams_list);
+
+	return stream;
+
+nomem:
+	xio_set_error(ENOMEM);
+	ERROR_LOG("calloc failed. %m\n");
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_stream_free(struct xio_stream *stream)
+{
+	list_del(&stream->streams_list_entry);
+	kfree(stream->slots);
+	kfree(stream);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_try_close							     */
+/*---------------------------------------------------------------------------*/
+/* a stream is done once its last chunk or a failure is seen and all of its */
+/* chunks are acknowledged						     */
+/*---------------------------------------------------------------------------*/
+static void xio_stream_try_close(struct xio_stream *stream)
+{
+	if (stream->closing || stream->outstanding ||
+	    (!stream->fin && stream->status == XIO_E_SUCCESS))
+		return;
+
+	stream->closing = 1;
+	if (stream->ops.on_stream_close)
+		stream->ops.on_stream_close(stream, stream->status,
+					    stream->user_context);
+	xio_stream_free(stream);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_fail							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stream_fail(struct xio_stream *stream,
+				   enum xio_status status)
+{
+	if (stream->status == XIO_E_SUCCESS)
+		stream->status = status;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_chunk_done						     */
+/*---------------------------------------------------------------------------*/
+static int xio_stream_chunk_done(struct xio_msg *chunk,
+				 enum xio_status status)
+{
+	struct xio_stream_slot	*slot = container_of(chunk->out.header.iov_base,
+						     struct xio_stream_slot,
+						     hdr);
+	struct xio_stream	*stream = slot->stream;
+
+	slot->next = stream->free_slots;
+	stream->free_slots = slot;
+	stream->outstanding--;
+	if (status != XIO_E_SUCCESS)
+		xio_stream_fail(stream, status);
+
+	chunk->out.header.iov_base = NULL;
+	chunk->out.header.iov_len = 0;
+	chunk->flags &= ~XIO_MSG_FLAG_STREAM;
+
+	if (stream->ops.on_stream_chunk_ack)
+		stream->ops.on_stream_chunk_ack(stream, chunk,
+						stream->user_context);
+	xio_stream_try_close(stream);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_send_ack							     */
+/*---------------------------------------------------------------------------*/
+static int xio_stream_send_ack(struct xio_connection *connection,
+			       struct xio_stream *stream,
+			       struct xio_msg *chunk,
+			       uint16_t flags)
+{
+	struct xio_stream_conn	*sconn = connection->streams;
+	struct xio_stream_rsp	*rsp = sconn->free_rsps;
+
+	if (rsp) {
+		sconn->free_rsps = rsp->next;
+	} else {
+		rsp = kcalloc(1, sizeof(*rsp), GFP_KERNEL);
+		if (rsp == NULL) {
+			xio_set_error(ENOMEM);
+			ERROR_LOG("calloc failed. %m\n");
+			return -1;
+		}
+		list_add_tail(&rsp->rsps_list_entry, &sconn->rsps_list);
+	}
+	memset(&rsp->msg, 0, sizeof(rsp->msg));
+	rsp->hdr.stream_id		= htonl(stream ? stream->id : 0);
+	rsp->hdr.seq			= 0;
+	rsp->hdr.flags			= htons(flags);
+	rsp->stream			= stream;
+	rsp->msg.request		= chunk;
+	rsp->msg.out.header.iov_base	= &rsp->hdr;
+	rsp->msg.out.header.iov_len	= sizeof(rsp->hdr);
+	/* marks the response as a stream acknowledge */
+	rsp->msg.user_context		= sconn;
+
+	/* a discarded acknowledge comes back through on_msg_error */
+	if (xio_send_response(&rsp->msg) != 0) {
+		ERROR_LOG("connection:%p failed to acknowledge chunk:%p\n",
+			  connection, chunk);
+		/* nothing will complete it - the chunk is done with */
+		rsp->stream = NULL;
+		rsp->next = sconn->free_rsps;
+		sconn->free_rsps = rsp;
+		if (stream) {
+			stream->outstanding--;
+			xio_stream_try_close(stream);
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_on_chunk							     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_on_chunk(struct xio_connection *connection,
+			struct xio_msg *chunk,
+			enum xio_status status)
+{
+	struct xio_stream_conn	*sconn = xio_stream_conn_get(connection);
+	struct xio_stream_hdr	*hdr = chunk->in.header.iov_base;
+	struct xio_stream	*stream = NULL;
+	uint32_t		id, seq;
+	uint16_t		flags;
+
+	if (sconn == NULL)
+		return -1;
+
+	if (chunk->in.header.iov_len < sizeof(*hdr)) {
+		ERROR_LOG("connection:%p stream chunk without header\n",
+			  connection);
+		return xio_stream_send_ack(connection, NULL, chunk,
+					   XIO_STREAM_FLAG_REJECT);
+	}
+	id	= ntohl(hdr->stream_id);
+	seq	= ntohl(hdr->seq);
+	flags	= ntohs(hdr->flags);
+
+	stream = xio_stream_lookup(sconn, id);
+	if (stream == NULL && (flags & XIO_STREAM_FLAG_OPEN) &&
+	    sconn->listening && status == XIO_E_SUCCESS) {
+		stream = xio_stream_alloc(connection, sconn, id, 0);
+		if (stream) {
+			stream->ops = sconn->ops;
+			stream->user_context = sconn->user_context;
+			if (stream->ops.on_stream_open &&
+			    stream->ops.on_stream_open(stream,
+						       sconn->user_context)) {
+				xio_stream_free(stream);
+				stream = NULL;
+			}
+		}
+	}
+	/* unknown, rejected or already closed stream */
+	if (stream == NULL)
+		return xio_stream_send_ack(connection, NULL, chunk,
+					   XIO_STREAM_FLAG_REJECT);
+
+	if (status == XIO_E_SUCCESS && seq != stream->seq) {
+		ERROR_LOG("stream:%p out of order chunk. expected:%u, got:%u\n",
+			  stream, stream->seq, seq);
+		status = XIO_E_MSG_INVALID;
+	}
+	if (status != XIO_E_SUCCESS || stream->status != XIO_E_SUCCESS) {
+		xio_stream_fail(stream, status);
+		xio_stream_send_ack(connection, NULL, chunk,
+				    XIO_STREAM_FLAG_REJECT);
+		xio_stream_try_close(stream);
+		return 0;
+	}
+
+	stream->seq++;
+	stream->outstanding++;
+	if (flags & XIO_STREAM_FLAG_FIN)
+		stream->fin = 1;
+
+	/* the stream header is not part of the user data */
+	chunk->in.header.iov_base = NULL;
+	chunk->in.header.iov_len = 0;
+
+	if (stream->ops.on_stream_chunk)
+		stream->ops.on_stream_chunk(stream, chunk, stream->fin,
+					    stream->user_context);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_on_ack							     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_on_ack(struct xio_connection *connection,
+		      struct xio_msg *chunk,
+		      enum xio_status status)
+{
+	struct xio_msg		*rsp = chunk->request;
+	struct xio_stream_hdr	*hdr = rsp->in.header.iov_base;
+
+	if (status == XIO_E_SUCCESS &&
+	    (rsp->in.header.iov_len < sizeof(*hdr) ||
+	     (ntohs(hdr->flags) & XIO_STREAM_FLAG_REJECT)))
+		status = XIO_E_MSG_DISCARDED;
+
+	xio_release_response(chunk);
+
+	return xio_stream_chunk_done(chunk, status);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_on_ack_sent						     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_on_ack_sent(struct xio_connection *connection,
+			   struct xio_msg *msg)
+{
+	struct xio_stream_conn	*sconn = connection->streams;
+	struct xio_stream_rsp	*rsp = container_of(msg,
+						    struct xio_stream_rsp,
+						    msg);
+	struct xio_stream	*stream = rsp->stream;
+
+	rsp->stream = NULL;
+	rsp->next = sconn->free_rsps;
+	sconn->free_rsps = rsp;
+
+	if (stream) {
+		stream->outstanding--;
+		xio_stream_try_close(stream);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_on_msg_error						     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_on_msg_error(struct xio_connection *connection,
+			    struct xio_msg *msg,
+			    enum xio_status result)
+{
+	/* acknowledge that could not be sent */
+	if (xio_stream_is_ack(connection, msg))
+		return xio_stream_on_ack_sent(connection, msg);
+
+	/* chunk that was flushed or discarded before it was answered */
+	return xio_stream_chunk_done(msg, result);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_streams_flush							     */
+/*---------------------------------------------------------------------------*/
+void xio_streams_flush(struct xio_connection *connection)
+{
+	struct xio_stream_conn	*sconn = connection->streams;
+	struct xio_stream	*stream, *tmp_stream;
+	struct xio_stream_rsp	*rsp;
+
+	if (sconn == NULL)
+		return;
+
+	/* acknowledges on the wire may never complete */
+	list_for_each_entry(rsp, &sconn->rsps_list, rsps_list_entry) {
+		if (rsp->stream) {
+			rsp->stream->outstanding--;
+			rsp->stream = NULL;
+		}
+	}
+	/* receivers close once the chunks they hold are released */
+	list_for_each_entry_safe(stream, tmp_stream, &sconn->streams_list,
+				 streams_list_entry) {
+		xio_stream_fail(stream, XIO_E_MSG_FLUSHED);
+		xio_stream_try_close(stream);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_streams_free							     */
+/*---------------------------------------------------------------------------*/
+void xio_streams_free(struct xio_connection *connection)
+{
+	struct xio_stream_conn	*sconn = connection->streams;
+	struct xio_stream	*stream, *tmp_stream;
+	struct xio_stream_rsp	*rsp, *tmp_rsp;
+
+	if (sconn == NULL)
+		return;
+
+	list_for_each_entry_safe(stream, tmp_stream, &sconn->streams_list,
+				 streams_list_entry)
+		xio_stream_free(stream);
+
+	list_for_each_entry_safe(rsp, tmp_rsp, &sconn->rsps_list,
+				 rsps_list_entry) {
+		list_del(&rsp->rsps_list_entry);
+		kfree(rsp);
+	}
+	kfree(sconn);
+	connection->streams = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_listen							     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_listen(struct xio_connection *connection,
+		      struct xio_stream_ops *ops,
+		      void *user_context)
+{
+	struct xio_stream_conn *sconn;
+
+	if (connection == NULL || ops == NULL) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	sconn = xio_stream_conn_get(connection);
+	if (sconn == NULL)
+		return -1;
+
+	sconn->ops		= *ops;
+	sconn->user_context	= user_context;
+	sconn->listening	= 1;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_open							     */
+/*---------------------------------------------------------------------------*/
+struct xio_stream *xio_stream_open(struct xio_stream_params *params)
+{
+	struct xio_stream_conn	*sconn;
+	struct xio_stream	*stream;
+	int			window;
+
+	if (params == NULL || params->connection == NULL ||
+	    params->ops == NULL || params->window < 0 ||
+	    params->window > XIO_STREAM_MAX_WINDOW) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid stream parameters\n");
+		return NULL;
+	}
+	window = params->window ? params->window : XIO_STREAM_DEFAULT_WINDOW;
+
+	sconn = xio_stream_conn_get(params->connection);
+	if (sconn == NULL)
+		return NULL;
+
+	stream = xio_stream_alloc(params->connection, sconn, sconn->next_id,
+				  window);
+	if (stream == NULL)
+		return NULL;
+	sconn->next_id++;
+
+	stream->ops		= *params->ops;
+	stream->user_context	= params->user_context;
+
+	return stream;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_write							     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_write(struct xio_stream *stream,
+		     struct xio_msg *chunk,
+		     int last)
+{
+	struct xio_stream_slot	*slot;
+	uint16_t		flags = 0;
+
+	if (stream == NULL || chunk == NULL || !stream->local ||
+	    stream->fin || stream->closing) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	if (stream->status != XIO_E_SUCCESS) {
+		xio_set_error(ECONNABORTED);
+		return -1;
+	}
+	slot = stream->free_slots;
+	if (slot == NULL) {
+		xio_set_error(EAGAIN);
+		return -1;
+	}
+	stream->free_slots = slot->next;
+
+	if (stream->seq == 0)
+		flags |= XIO_STREAM_FLAG_OPEN;
+	if (last)
+		flags |= XIO_STREAM_FLAG_FIN;
+	slot->hdr.stream_id	= htonl(stream->id);
+	slot->hdr.seq		= htonl(stream->seq);
+	slot->hdr.flags		= htons(flags);
+
+	chunk->out.header.iov_base	= &slot->hdr;
+	chunk->out.header.iov_len	= sizeof(slot->hdr);
+	/* a reused chunk may still point at its previous acknowledge */
+	chunk->in.header.iov_base	= NULL;
+	chunk->in.header.iov_len	= 0;
+	vmsg_sglist_set_nents(&chunk->in, 0);
+	/* chunks are acknowledged by their response, never by a receipt */
+	chunk->flags &= ~XIO_MSG_FLAG_REQUEST_READ_RECEIPT;
+	chunk->flags |= XIO_MSG_FLAG_STREAM;
+
+	if (xio_send_request(stream->connection, chunk) != 0) {
+		chunk->flags &= ~XIO_MSG_FLAG_STREAM;
+		slot->next = stream->free_slots;
+		stream->free_slots = slot;
+		return -1;
+	}
+
+	stream->seq++;
+	stream->outstanding++;
+	if (last)
+		stream->fin = 1;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_release_chunk						     */
+/*---------------------------------------------------------------------------*/
+int xio_stream_release_chunk(struct xio_stream *stream,
+			     struct xio_msg *chunk)
+{
+	if (stream == NULL || chunk == NULL || stream->local) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+
+	return xio_stream_send_ack(stream->connection, stream, chunk, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stream_set_user_context						     */
+/*---------------------------------------------------------------------------*/
+void xio_stream_set_user_context(struct xio_stream *stream,
+				 void *user_context)
+{
+	stream->user_context = user_context;
+}
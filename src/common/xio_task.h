@@ -40,6 +40,7 @@
 
 #include "libxio.h"
 #include "xio_mbuf.h"
+#include "xio_trace.h"
 
 
 enum xio_task_state {
@@ -50,6 +51,17 @@ enum xio_task_state {
 	XIO_TASK_STATE_CANCEL_PENDING,      /* mark for rdma read task */
 };
 
+/* points a message passes, recorded when stage statistics are enabled */
+enum xio_task_stamp {
+	XIO_TASK_STAMP_NEXUS,		/* handed to the nexus */
+	XIO_TASK_STAMP_SENT,		/* written to the wire */
+	XIO_TASK_STAMP_RECV,		/* received from the transport */
+	XIO_TASK_STAMP_LAST
+};
+
+/* set once the process publishes stage histograms */
+extern int xio_stats_stages;
+
 /*---------------------------------------------------------------------------*/
 /* forward declarations							     */
 /*---------------------------------------------------------------------------*/
@@ -87,6 +99,7 @@ struct xio_task {
 
 	struct xio_vmsg		in_receipt;     /* save in of message with */
 						/* receipt */
+	uint64_t		stamp[XIO_TASK_STAMP_LAST];
 };
 
 struct xio_tasks_pool_hooks {
@@ -175,6 +188,15 @@ static void xio_task_reset(struct xio_task *task)
 	*/
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_task_stamp							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_task_stamp(struct xio_task *task, int point)
+{
+	if (unlikely(xio_stats_stages))
+		task->stamp[point] = get_cycles();
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_task_addref							     */
 /*---------------------------------------------------------------------------*/
@@ -203,6 +225,7 @@ static inline void xio_task_release(struct kref *kref)
 				pool->params.pool_hooks.context, task);
 	pool->curr_free++;
 	pool->curr_used--;
+	xio_trace2(task_put, pool, task);
 
 	list_move(&task->tasks_list_entry, &pool->stack);
 }
@@ -252,6 +275,7 @@ static inline struct xio_task *xio_tasks_pool_get(struct xio_tasks_pool *q)
 
 	kref_init(&t->kref);
 	t->tlv_type = 0xbeef;  /* poison the type */
+	xio_trace2(task_get, q, t);
 
 	if (q->params.pool_hooks.task_post_get)
 		q->params.pool_hooks.task_post_get(
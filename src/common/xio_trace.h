@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_TRACE_H
+#define XIO_TRACE_H
+
+/*
+ * Static tracepoints, exported as USDT probes of provider "libxio" when
+ * <sys/sdt.h> is available at configure time.  A probe is a single nop
+ * until perf or bpftrace attaches to it, e.g.
+ *
+ *	bpftrace -e 'usdt:/usr/local/lib/libxio.so:libxio:connection_state
+ *		     { printf("%p %d -> %d\n", arg0, arg1, arg2); }'
+ *
+ * Probes:
+ *	connection_state	(connection, old state, new state)
+ *	nexus_state		(nexus, old state, new state)
+ *	session_state		(session, old state, new state)
+ *	task_get		(pool, task)
+ *	task_put		(pool, task)
+ *	tcp_tx_stage		(task, stage)
+ *	tcp_tx_sent		(task)
+ *	tcp_rx_stage		(task, stage)
+ *
+ * Without sdt support, and in the kernel module, they compile away.
+ * Arguments are not evaluated then, so they must be free of side effects.
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define xio_trace1(name, a1)						\
+	DTRACE_PROBE1(libxio, name, a1)
+#define xio_trace2(name, a1, a2)					\
+	DTRACE_PROBE2(libxio, name, a1, a2)
+#define xio_trace3(name, a1, a2, a3)					\
+	DTRACE_PROBE3(libxio, name, a1, a2, a3)
+#else
+#define xio_trace1(name, a1)			do { } while (0)
+#define xio_trace2(name, a1, a2)		do { } while (0)
+#define xio_trace3(name, a1, a2, a3)		do { } while (0)
+#endif
+
+#endif /*XIO_TRACE_H */
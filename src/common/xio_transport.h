@@ -45,6 +45,7 @@ struct xio_task;
 struct xio_observer;
 struct xio_observable;
 struct xio_tasks_pool_ops;
+struct xio_mempool_obj;
 
 /*---------------------------------------------------------------------------*/
 /* enums								     */
@@ -241,6 +242,10 @@ struct xio_transport {
 			      struct xio_task *task, enum xio_status result,
 			      void *ulp_msg, size_t ulp_msg_len);
 
+	int	(*take_in_bufs)(struct xio_transport_base *trans_hndl,
+				struct xio_task *task,
+				struct xio_mempool_obj *objs, int nents);
+
 	struct list_head transports_list_entry;
 };
 
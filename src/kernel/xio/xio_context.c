@@ -50,6 +50,7 @@
 #include "xio_common.h"
 #include "xio_context.h"
 #include "xio_ev_loop.h"
+#include "xio_stats_shm.h"
 
 /*---------------------------------------------------------------------------*/
 /* xio_context_reg_observer						     */
@@ -324,6 +325,33 @@ int xio_context_is_loop_stopping(struct xio_context *ctx)
 	return ev_loop->is_stopping(ev_loop->loop_object);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_context_get_loop_util						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_get_loop_util(struct xio_context *ctx)
+{
+	/* kernel loops do not account idle time */
+	return 0;
+}
+
+int xio_stats_stages;
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_get						     */
+/*---------------------------------------------------------------------------*/
+struct xio_stats_conn *xio_stats_shm_conn_get(struct xio_context *ctx)
+{
+	/* kernel contexts publish through debugfs only */
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_put						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_conn_put(struct xio_stats_conn *slot)
+{
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ctx_add_work							     */
 /*---------------------------------------------------------------------------*/
@@ -44,6 +44,7 @@
 #include "xio_common.h"
 #include "xio_sessions_cache.h"
 #include "xio_nexus_cache.h"
+#include "xio_nexus_warm.h"
 #include "xio_nexus.h"
 #include "xio_task.h"
 #include "xio_context.h"
@@ -76,12 +77,18 @@ static int __init xio_init_module(void)
 
 	sessions_cache_construct();
 	nexus_cache_construct();
+	xio_nexus_warm_construct();
 
 	return 0;
 }
 
 static void __exit xio_cleanup_module(void)
 {
+	/* rcu callbacks live in this module */
+	rcu_barrier();
+	nexus_cache_destruct();
+	sessions_cache_destruct();
+
 	if (xio_root) {
 		debugfs_remove_recursive(xio_root);
 		xio_root = NULL;
@@ -144,6 +151,9 @@ EXPORT_SYMBOL(xio_bind);
 EXPORT_SYMBOL(xio_accept);
 EXPORT_SYMBOL(xio_reject);
 EXPORT_SYMBOL(xio_unbind);
+EXPORT_SYMBOL(xio_server_add_portal);
+EXPORT_SYMBOL(xio_server_del_portal);
+EXPORT_SYMBOL(xio_server_set_auto_redirect);
 EXPORT_SYMBOL(xio_connect);
 EXPORT_SYMBOL(xio_disconnect);
 
@@ -152,6 +162,19 @@ EXPORT_SYMBOL(xio_connection_destroy);
 EXPORT_SYMBOL(xio_modify_connection);
 EXPORT_SYMBOL(xio_query_connection);
 
+EXPORT_SYMBOL(xio_connection_pool_create);
+EXPORT_SYMBOL(xio_connection_pool_destroy);
+EXPORT_SYMBOL(xio_connection_pool_get);
+EXPORT_SYMBOL(xio_connection_pool_send_request);
+
+EXPORT_SYMBOL(xio_stream_listen);
+EXPORT_SYMBOL(xio_stream_open);
+EXPORT_SYMBOL(xio_stream_write);
+EXPORT_SYMBOL(xio_stream_release_chunk);
+EXPORT_SYMBOL(xio_stream_set_user_context);
+
+EXPORT_SYMBOL(xio_context_prewarm);
+
 EXPORT_SYMBOL(xio_query_session);
 EXPORT_SYMBOL(xio_modify_session);
 
@@ -45,6 +45,8 @@
 #include <linux/slab.h>
 #include <linux/list.h>
 #include <linux/llist.h>
+#include <linux/rcupdate.h>
+#include <linux/rculist.h>
 
 #include <linux/net.h>
 #include <linux/in.h>
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <libxio.h>
+#include "xio_os.h"
+#include "xio_stats_shm.h"
+
+#define MAX_RETRIES	1000
+
+struct conn_view {
+	struct xio_stats_conn	cur;
+	struct xio_stats_conn	prev;
+	int			valid;
+	int			pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *app)
+{
+	printf("Usage: %s [-i interval_sec] [-c count] [-s] <pid>\n", app);
+	printf("\tprints the statistics a process started with " \
+	       "XIO_STATS_SHM=1 publishes\n");
+	printf("\t-s adds the per stage latency breakdown, the process " \
+	       "must also set XIO_STATS_STAGES=1\n");
+	exit(1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* read_slot - seqlock read side, never blocks the writer		     */
+/*---------------------------------------------------------------------------*/
+static int read_slot(struct xio_stats_conn *src, struct xio_stats_conn *dst)
+{
+	uint32_t	s1, s2;
+	int		i;
+
+	for (i = 0; i < MAX_RETRIES; i++) {
+		s1 = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+		if (s1 & 1) {
+			sched_yield();
+			continue;
+		}
+		memcpy(dst, src, sizeof(*dst));
+		smp_rmb();
+		s2 = __atomic_load_n(&src->seq, __ATOMIC_RELAXED);
+		if (s1 == s2)
+			return 0;
+	}
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* hist_usec - upper bound of the bucket holding the given percentile	     */
+/*---------------------------------------------------------------------------*/
+static double hist_usec(const uint64_t *cur, const uint64_t *prev,
+			double pct, uint64_t hertz)
+{
+	uint64_t	total = 0, acc = 0, target;
+	int		i;
+
+	for (i = 0; i < XIO_STATS_HIST_BUCKETS; i++)
+		total += cur[i] - (prev ? prev[i] : 0);
+	if (total == 0)
+		return 0;
+
+	target = (uint64_t)(total * pct / 100.0 + 0.5);
+	if (target == 0)
+		target = 1;
+	for (i = 0; i < XIO_STATS_HIST_BUCKETS; i++) {
+		acc += cur[i] - (prev ? prev[i] : 0);
+		if (acc >= target)
+			break;
+	}
+	if (i == XIO_STATS_HIST_BUCKETS)
+		i--;
+
+	return (double)(1ULL << i) * 1000000.0 / hertz;
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_conn								     */
+/*---------------------------------------------------------------------------*/
+static void print_conn(struct conn_view *v, double secs, uint64_t hertz)
+{
+	struct xio_stats_conn	*c = &v->cur;
+	struct xio_stats_conn	*p = v->valid ? &v->prev : NULL;
+	double			div = p ? secs : 1.0;
+
+	printf("%-3d %-6u %-4u %-3s %10.0f %10.0f %9.2f %9.2f %6u %6u " \
+	       "%5u/%-5u %9.1f %9.1f %9.1f %9.1f  %s\n",
+	       c->cpuid, c->session_id, c->conn_idx,
+	       c->session_type == XIO_SESSION_CLIENT ? "cli" : "srv",
+	       (c->tx_msgs - (p ? p->tx_msgs : 0)) / div,
+	       (c->rx_msgs - (p ? p->rx_msgs : 0)) / div,
+	       (c->tx_bytes - (p ? p->tx_bytes : 0)) / div / 1048576.0,
+	       (c->rx_bytes - (p ? p->rx_bytes : 0)) / div / 1048576.0,
+	       c->queued_msgs, c->ctx_queued_msgs,
+	       c->pool_used, c->pool_alloced,
+	       hist_usec(c->hist[XIO_STATS_HIST_RTT],
+			 p ? p->hist[XIO_STATS_HIST_RTT] : NULL, 50, hertz),
+	       hist_usec(c->hist[XIO_STATS_HIST_RTT],
+			 p ? p->hist[XIO_STATS_HIST_RTT] : NULL, 99, hertz),
+	       hist_usec(c->hist[XIO_STATS_HIST_APP],
+			 p ? p->hist[XIO_STATS_HIST_APP] : NULL, 50, hertz),
+	       hist_usec(c->hist[XIO_STATS_HIST_APP],
+			 p ? p->hist[XIO_STATS_HIST_APP] : NULL, 99, hertz),
+	       c->uri);
+}
+
+/*---------------------------------------------------------------------------*/
+/* print_stages								     */
+/*---------------------------------------------------------------------------*/
+static void print_stages(struct conn_view *v, uint64_t hertz)
+{
+	static const char *names[XIO_STATS_HIST_LAST] = {
+		[XIO_STATS_HIST_APP]		= "app",
+		[XIO_STATS_HIST_CONN_QUEUE]	= "conn_queue",
+		[XIO_STATS_HIST_TX_QUEUE]	= "tx_queue",
+		[XIO_STATS_HIST_WIRE_PEER]	= "wire+peer",
+		[XIO_STATS_HIST_DELIVER]	= "deliver",
+	};
+	struct xio_stats_conn	*c = &v->cur;
+	struct xio_stats_conn	*p = v->valid ? &v->prev : NULL;
+	int			i;
+
+	printf("    p50/p99 usec:");
+	for (i = 0; i < XIO_STATS_HIST_LAST; i++) {
+		if (!names[i])
+			continue;
+		printf(" %s %.1f/%.1f", names[i],
+		       hist_usec(c->hist[i], p ? p->hist[i] : NULL,
+				 50, hertz),
+		       hist_usec(c->hist[i], p ? p->hist[i] : NULL,
+				 99, hertz));
+	}
+	printf("\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_stats_shm_hdr	*hdr;
+	struct xio_stats_conn		*slots;
+	struct conn_view		*views;
+	struct stat			st;
+	char				name[64];
+	int				interval = 1, count = -1;
+	int				stages = 0;
+	int				opt, fd, pid;
+	uint32_t			i;
+
+	while ((opt = getopt(argc, argv, "i:c:sh")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'c':
+			count = atoi(optarg);
+			break;
+		case 's':
+			stages = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc || interval <= 0)
+		usage(argv[0]);
+	pid = atoi(argv[optind]);
+
+	snprintf(name, sizeof(name), XIO_STATS_SHM_NAME, pid);
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		fprintf(stderr, "no statistics for pid %d: %m\n", pid);
+		return 1;
+	}
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*hdr)) {
+		fprintf(stderr, "invalid statistics segment %s\n", name);
+		return 1;
+	}
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED) {
+		fprintf(stderr, "mmap failed: %m\n");
+		return 1;
+	}
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) !=
+	    XIO_STATS_SHM_MAGIC ||
+	    hdr->version != XIO_STATS_SHM_VERSION ||
+	    hdr->slot_size != sizeof(*slots) ||
+	    hdr->hist_buckets != XIO_STATS_HIST_BUCKETS ||
+	    sizeof(*hdr) + (size_t)hdr->conns_nr * sizeof(*slots) >
+	    (size_t)st.st_size) {
+		fprintf(stderr, "statistics segment %s has unknown layout\n",
+			name);
+		return 1;
+	}
+	slots = (struct xio_stats_conn *)(hdr + 1);
+	if (stages && !(hdr->flags & XIO_STATS_SHM_F_STAGES))
+		fprintf(stderr, "pid %d runs without XIO_STATS_STAGES, " \
+			"stage histograms stay empty\n", pid);
+	views = calloc(hdr->conns_nr, sizeof(*views));
+	if (!views) {
+		fprintf(stderr, "calloc failed\n");
+		return 1;
+	}
+
+	while (count) {
+		printf("%-3s %-6s %-4s %-3s %10s %10s %9s %9s %6s %6s " \
+		       "%11s %9s %9s %9s %9s  %s\n",
+		       "cpu", "ses", "conn", "dir", "tx_msg/s", "rx_msg/s",
+		       "tx_MB/s", "rx_MB/s", "queue", "ctx_q",
+		       "pool", "rtt_p50", "rtt_p99", "app_p50", "app_p99",
+		       "uri");
+		for (i = 0; i < hdr->conns_nr; i++) {
+			struct conn_view *v = &views[i];
+
+			if (!__atomic_load_n(&slots[i].in_use,
+					     __ATOMIC_RELAXED)) {
+				v->valid = 0;
+				continue;
+			}
+			if (read_slot(&slots[i], &v->cur) || !v->cur.in_use)
+				continue;
+			/* a recycled slot starts a new history */
+			if (v->valid && (v->prev.ctx != v->cur.ctx ||
+					 v->prev.session_id !=
+					 v->cur.session_id ||
+					 v->prev.tx_msgs > v->cur.tx_msgs))
+				v->valid = 0;
+			print_conn(v, interval, hdr->hertz);
+			if (stages)
+				print_stages(v, hdr->hertz);
+			v->prev = v->cur;
+			v->valid = 1;
+		}
+		printf("\n");
+		fflush(stdout);
+		if (count > 0)
+			count--;
+		if (count)
+			sleep(interval);
+	}
+
+	free(views);
+	munmap(hdr, st.st_size);
+
+	return 0;
+}
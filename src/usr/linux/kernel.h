@@ -17,6 +17,9 @@
 #define likely(x)		__builtin_expect(!!(x), 1)
 #define unlikely(x)		__builtin_expect(!!(x), 0)
 
+#define smp_wmb()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_rmb()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+
 #define __ALIGN_XIO_MASK(x, mask)	(((x) + (mask)) & ~(mask))
 #define __ALIGN_XIO(x, a)		__ALIGN_XIO_MASK(x, (typeof(x))(a)-1)
 #define ALIGN(x, a)			__ALIGN_XIO((x), (a))
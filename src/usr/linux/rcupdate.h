@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LINUX_RCUPDATE_H
+#define _LINUX_RCUPDATE_H
+
+/*
+ * user space read-copy-update. readers publish the grace period counter
+ * they started in; synchronize_rcu() advances the counter and waits for
+ * every reader that is still inside an older read side section. readers
+ * never block and never write shared cache lines.
+ */
+
+#define __rcu
+
+struct rcu_head {
+	struct rcu_head *next;
+	void (*func)(struct rcu_head *head);
+};
+
+struct xio_rcu_reader {
+	uint64_t		ctr;	/* grace period entered, 0 - idle     */
+	int			nesting;
+	int			pad;
+	struct list_head	readers_list_entry;
+};
+
+extern __thread struct xio_rcu_reader	*xio_rcu_reader;
+extern uint64_t				xio_rcu_gp_ctr;
+
+struct xio_rcu_reader *xio_rcu_register_thread(void);
+
+/*---------------------------------------------------------------------------*/
+/* rcu_read_lock							     */
+/*---------------------------------------------------------------------------*/
+static inline void rcu_read_lock(void)
+{
+	struct xio_rcu_reader *r = xio_rcu_reader;
+
+	if (unlikely(!r))
+		r = xio_rcu_register_thread();
+
+	if (r->nesting++ == 0) {
+		__atomic_store_n(&r->ctr,
+				 __atomic_load_n(&xio_rcu_gp_ctr,
+						 __ATOMIC_RELAXED),
+				 __ATOMIC_RELAXED);
+		/* pairs with the barrier in synchronize_rcu */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* rcu_read_unlock							     */
+/*---------------------------------------------------------------------------*/
+static inline void rcu_read_unlock(void)
+{
+	struct xio_rcu_reader *r = xio_rcu_reader;
+
+	if (--r->nesting == 0)
+		__atomic_store_n(&r->ctr, 0, __ATOMIC_RELEASE);
+}
+
+#define rcu_dereference(p)		__atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define rcu_dereference_protected(p, c)	(p)
+#define rcu_assign_pointer(p, v)	__atomic_store_n(&(p), (v), \
+							 __ATOMIC_RELEASE)
+#define RCU_INIT_POINTER(p, v)		((p) = (v))
+
+/*---------------------------------------------------------------------------*/
+/* synchronize_rcu - waits until all pre-existing readers are done	     */
+/*---------------------------------------------------------------------------*/
+void synchronize_rcu(void);
+
+/*---------------------------------------------------------------------------*/
+/* call_rcu - invokes func once all pre-existing readers are done	     */
+/*---------------------------------------------------------------------------*/
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+
+/*---------------------------------------------------------------------------*/
+/* rcu_barrier - invokes all pending callbacks				     */
+/*---------------------------------------------------------------------------*/
+void rcu_barrier(void);
+
+#endif /* _LINUX_RCUPDATE_H */
@@ -323,6 +323,7 @@ static int xio_rdma_xmit(struct xio_rdma_transport *rdma_hndl)
 			rdma_hndl->reqs_in_flight_nr++;
 		else
 			rdma_hndl->rsps_in_flight_nr++;
+		xio_task_stamp(task, XIO_TASK_STAMP_SENT);
 		list_move_tail(&task->tasks_list_entry,
 			       &rdma_hndl->in_flight_list);
 	}
@@ -4291,3 +4292,19 @@ int xio_rdma_cancel_rsp(struct xio_transport_base *transport,
 				    &cancel_hdr, ulp_msg, ulp_msg_sz);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_rdma_take_in_bufs						     */
+/*---------------------------------------------------------------------------*/
+int xio_rdma_take_in_bufs(struct xio_transport_base *transport,
+			  struct xio_task *task,
+			  struct xio_mempool_obj *objs, int nents)
+{
+	struct xio_rdma_transport *rdma_hndl =
+		(struct xio_rdma_transport *)transport;
+	struct xio_rdma_task	*rdma_task = task->dd_data;
+
+	return xio_transport_take_in_bufs(rdma_hndl->rdma_mempool, &task->imsg,
+					  rdma_task->read_sge,
+					  rdma_task->read_num_sge,
+					  objs, nents);
+}
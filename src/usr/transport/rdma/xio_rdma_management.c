@@ -3074,6 +3074,7 @@ struct xio_transport xio_rdma_transport = {
 	.get_opt		= xio_rdma_get_opt,
 	.cancel_req		= xio_rdma_cancel_req,
 	.cancel_rsp		= xio_rdma_cancel_rsp,
+	.take_in_bufs		= xio_rdma_take_in_bufs,
 	.get_pools_setup_ops	= xio_rdma_get_pools_ops,
 	.set_pools_cls		= xio_rdma_set_pools_cls,
 
@@ -481,6 +481,10 @@ int xio_rdma_cancel_rsp(struct xio_transport_base *transport,
 			struct xio_task *task, enum xio_status result,
 			void *ulp_msg, size_t ulp_msg_sz);
 
+int xio_rdma_take_in_bufs(struct xio_transport_base *transport,
+			  struct xio_task *task,
+			  struct xio_mempool_obj *objs, int nents);
+
 /* xio_rdma_management.c */
 void xio_rdma_calc_pool_size(struct xio_rdma_transport *rdma_hndl);
 
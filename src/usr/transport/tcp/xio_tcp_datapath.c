@@ -924,11 +924,14 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 			tcp_task->sn = tcp_hndl->sn;
 			tcp_hndl->sn++;
 			tcp_task->txd.stage = XIO_TCP_TX_IN_SEND_CTL;
+			xio_trace2(tcp_tx_stage, task, XIO_TCP_TX_IN_SEND_CTL);
 			/*fallthrough*/
 		case XIO_TCP_TX_IN_SEND_CTL:
 			/* for single socket, ctl_msg_len is zero */
 			if (tcp_task->txd.ctl_msg_len == 0) {
 				tcp_task->txd.stage = XIO_TCP_TX_IN_SEND_DATA;
+				xio_trace2(tcp_tx_stage, task,
+					   XIO_TCP_TX_IN_SEND_DATA);
 				break;
 			}
 
@@ -966,6 +969,8 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 			for (i = 0; i < iov_len; i++) {
 				tcp_task = task->dd_data;
 				tcp_task->txd.stage = XIO_TCP_TX_IN_SEND_DATA;
+				xio_trace2(tcp_tx_stage, task,
+					   XIO_TCP_TX_IN_SEND_DATA);
 				tcp_task->txd.ctl_msg_len = 0;
 				task = list_first_entry_or_null(
 						&task->tasks_list_entry,
@@ -1065,6 +1070,8 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 
 				tcp_hndl->tx_ready_tasks_num--;
 
+				xio_task_stamp(task, XIO_TASK_STAMP_SENT);
+				xio_trace1(tcp_tx_sent, task);
 				list_move_tail(&task->tasks_list_entry,
 					       &tcp_hndl->in_flight_list);
 
@@ -3254,6 +3261,7 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 			tcp_task->rxd.msg.msg_iov = tcp_task->rxd.msg_iov;
 			tcp_task->rxd.msg.msg_iovlen = 1;
 			tcp_task->rxd.stage = XIO_TCP_RX_TLV;
+			xio_trace2(tcp_rx_stage, task, XIO_TCP_RX_TLV);
 			/*fallthrough*/
 		case XIO_TCP_RX_TLV:
 			retval = tcp_hndl->sock.ops->rx_ctl_work(
@@ -3281,6 +3289,7 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 			tcp_task->rxd.msg.msg_iovlen = 1;
 			tcp_task->rxd.tot_iov_byte_len = task->mbuf.tlv.len;
 			tcp_task->rxd.stage = XIO_TCP_RX_HEADER;
+			xio_trace2(tcp_rx_stage, task, XIO_TCP_RX_HEADER);
 			/*fallthrough*/
 		case XIO_TCP_RX_HEADER:
 			retval = tcp_hndl->sock.ops->rx_ctl_work(
@@ -3334,6 +3343,7 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 				}
 			}
 			tcp_task->rxd.stage = XIO_TCP_RX_IO_DATA;
+			xio_trace2(tcp_rx_stage, task, XIO_TCP_RX_IO_DATA);
 			/*fallthrough*/
 		case XIO_TCP_RX_IO_DATA:
 			++count;
@@ -3550,3 +3560,20 @@ int xio_tcp_cancel_rsp(struct xio_transport_base *transport,
 	return xio_tcp_send_cancel(tcp_hndl, XIO_CANCEL_RSP,
 				   &cancel_hdr, ulp_msg, ulp_msg_sz);
 }
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_take_in_bufs							     */
+/*---------------------------------------------------------------------------*/
+int xio_tcp_take_in_bufs(struct xio_transport_base *transport,
+			 struct xio_task *task,
+			 struct xio_mempool_obj *objs, int nents)
+{
+	struct xio_tcp_transport *tcp_hndl =
+		(struct xio_tcp_transport *)transport;
+	struct xio_tcp_task	*tcp_task = task->dd_data;
+
+	return xio_transport_take_in_bufs(tcp_hndl->tcp_mempool, &task->imsg,
+					  tcp_task->read_sge,
+					  tcp_task->read_num_sge,
+					  objs, nents);
+}
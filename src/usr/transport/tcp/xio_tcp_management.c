@@ -37,6 +37,7 @@
  */
 
 #include <linux/tcp.h>
+#include <linux/filter.h>
 #include <sys/epoll.h>
 #include "xio_common.h"
 #include "xio_observer.h"
@@ -57,6 +58,8 @@
 #define XIO_OPTVAL_DEF_TCP_SO_SNDBUF			4194304
 #define XIO_OPTVAL_DEF_TCP_SO_RCVBUF			4194304
 #define XIO_OPTVAL_DEF_TCP_DUAL_SOCK			1
+#define XIO_OPTVAL_DEF_TCP_REUSEPORT			0
+#define XIO_OPTVAL_DEF_TCP_REUSEPORT_STEERING		XIO_TCP_STEERING_PEER_ADDR
 
 #define XIO_OPTVAL_MIN_TCP_BUF_THRESHOLD		256
 #define XIO_OPTVAL_MAX_TCP_BUF_THRESHOLD		65536
@@ -89,6 +92,8 @@ struct xio_tcp_options			tcp_options = {
 	.tcp_so_sndbuf			= XIO_OPTVAL_DEF_TCP_SO_SNDBUF,
 	.tcp_so_rcvbuf			= XIO_OPTVAL_DEF_TCP_SO_RCVBUF,
 	.tcp_dual_sock			= XIO_OPTVAL_DEF_TCP_DUAL_SOCK,
+	.tcp_reuseport			= XIO_OPTVAL_DEF_TCP_REUSEPORT,
+	.tcp_reuseport_steering		= XIO_OPTVAL_DEF_TCP_REUSEPORT_STEERING,
 };
 
 /*---------------------------------------------------------------------------*/
@@ -1088,6 +1093,66 @@ void xio_tcp_listener_ev_handler(int fd, int events, void *user_context)
 	}
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_attach_steering						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_attach_steering(int fd, int shards)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+	/* the program returns the index of the listener within the
+	 * reuseport group. out of range indices fall back to the kernel hash
+	 */
+	struct sock_filter cpu_code[] = {
+		{ BPF_LD  | BPF_W   | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		{ BPF_ALU | BPF_MOD | BPF_K,   0, 0, shards },
+		{ BPF_RET | BPF_A,	       0, 0, 0 },
+	};
+	struct sock_filter addr_code[] = {
+		/* ip version */
+		{ BPF_LD  | BPF_B   | BPF_ABS, 0, 0, SKF_NET_OFF },
+		{ BPF_ALU | BPF_RSH | BPF_K,   0, 0, 4 },
+		{ BPF_JMP | BPF_JEQ | BPF_K,   0, 2, 4 },
+		/* ipv4 source address */
+		{ BPF_LD  | BPF_W   | BPF_ABS, 0, 0, SKF_NET_OFF + 12 },
+		{ BPF_JMP | BPF_JA,	       0, 0, 1 },
+		/* low word of ipv6 source address */
+		{ BPF_LD  | BPF_W   | BPF_ABS, 0, 0, SKF_NET_OFF + 20 },
+		{ BPF_ALU | BPF_MUL | BPF_K,   0, 0, 0x9e3779b1 },
+		{ BPF_ALU | BPF_RSH | BPF_K,   0, 0, 16 },
+		{ BPF_ALU | BPF_MOD | BPF_K,   0, 0, shards },
+		{ BPF_RET | BPF_A,	       0, 0, 0 },
+	};
+	struct sock_fprog prog;
+
+	switch (tcp_options.tcp_reuseport_steering) {
+	case XIO_TCP_STEERING_CPU:
+		prog.len	= sizeof(cpu_code) / sizeof(cpu_code[0]);
+		prog.filter	= cpu_code;
+		break;
+	case XIO_TCP_STEERING_PEER_ADDR:
+		prog.len	= sizeof(addr_code) / sizeof(addr_code[0]);
+		prog.filter	= addr_code;
+		break;
+	default:
+		return 0;
+	}
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+		       &prog, sizeof(prog)) == 0)
+		return 0;
+	/* built against newer headers than the running kernel */
+	if (errno != ENOPROTOOPT) {
+		xio_set_error(errno);
+		ERROR_LOG("attaching steering program failed. " \
+			  "(errno=%d %m)\n", errno);
+		return -1;
+	}
+#endif
+	WARN_LOG("reuseport steering not supported, using kernel hash. " \
+		 "clients must disable dual stream\n");
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_listen							     */
 /*---------------------------------------------------------------------------*/
@@ -1111,6 +1176,21 @@ static int xio_tcp_listen(struct xio_transport_base *transport,
 	}
 	tcp_hndl->base.is_client = 0;
 
+	/* shard the listener - every context binding the uri gets a socket
+	 * of the same reuseport group
+	 */
+	if (tcp_options.tcp_reuseport) {
+		int optval = 1;
+
+		retval = setsockopt(tcp_hndl->sock.cfd, SOL_SOCKET,
+				    SO_REUSEPORT, &optval, sizeof(optval));
+		if (retval) {
+			xio_set_error(errno);
+			ERROR_LOG("setsockopt failed. (errno=%d %m)\n", errno);
+			goto exit;
+		}
+	}
+
 	/* bind */
 	retval = bind(tcp_hndl->sock.cfd,
 		      (struct sockaddr *)&sa.sa_stor,
@@ -1131,6 +1211,13 @@ static int xio_tcp_listen(struct xio_transport_base *transport,
 		goto exit;
 	}
 
+	if (tcp_options.tcp_reuseport > 1) {
+		retval = xio_tcp_attach_steering(tcp_hndl->sock.cfd,
+						 tcp_options.tcp_reuseport);
+		if (retval)
+			goto exit;
+	}
+
 	/* add to epoll */
 	retval = xio_context_add_ev_handler(
 			tcp_hndl->base.ctx,
@@ -2245,6 +2332,25 @@ static int xio_tcp_set_opt(void *xio_obj,
 		tcp_options.tcp_dual_sock = *((int *)optval);
 		return 0;
 		break;
+	case XIO_OPTNAME_TCP_REUSEPORT:
+		VALIDATE_SZ(sizeof(int));
+		if (*(int *)optval < 0) {
+			xio_set_error(EINVAL);
+			return -1;
+		}
+		tcp_options.tcp_reuseport = *((int *)optval);
+		return 0;
+		break;
+	case XIO_OPTNAME_TCP_REUSEPORT_STEERING:
+		VALIDATE_SZ(sizeof(int));
+		if (*(int *)optval < XIO_TCP_STEERING_PEER_ADDR ||
+		    *(int *)optval > XIO_TCP_STEERING_KERNEL) {
+			xio_set_error(EINVAL);
+			return -1;
+		}
+		tcp_options.tcp_reuseport_steering = *((int *)optval);
+		return 0;
+		break;
 	default:
 		break;
 	}
@@ -2310,6 +2416,16 @@ static int xio_tcp_get_opt(void  *xio_obj,
 		*optlen = sizeof(int);
 		return 0;
 		break;
+	case XIO_OPTNAME_TCP_REUSEPORT:
+		*((int *)optval) = tcp_options.tcp_reuseport;
+		*optlen = sizeof(int);
+		return 0;
+		break;
+	case XIO_OPTNAME_TCP_REUSEPORT_STEERING:
+		*((int *)optval) = tcp_options.tcp_reuseport_steering;
+		*optlen = sizeof(int);
+		return 0;
+		break;
 	default:
 		break;
 	}
@@ -2479,6 +2595,7 @@ struct xio_transport xio_tcp_transport = {
 	.get_opt		= xio_tcp_get_opt,
 	.cancel_req		= xio_tcp_cancel_req,
 	.cancel_rsp		= xio_tcp_cancel_rsp,
+	.take_in_bufs		= xio_tcp_take_in_bufs,
 	.get_pools_setup_ops	= xio_tcp_get_pools_ops,
 	.set_pools_cls		= xio_tcp_set_pools_cls,
 
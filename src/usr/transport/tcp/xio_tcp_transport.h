@@ -128,6 +128,8 @@ struct xio_tcp_options {
 	int			tcp_so_sndbuf;
 	int			tcp_so_rcvbuf;
 	int			tcp_dual_sock;
+	int			tcp_reuseport;
+	int			tcp_reuseport_steering;
 	int			pad;
 };
 
@@ -381,6 +383,10 @@ int xio_tcp_cancel_rsp(struct xio_transport_base *transport,
 		       struct xio_task *task, enum xio_status result,
 		       void *ulp_msg, size_t ulp_msg_sz);
 
+int xio_tcp_take_in_bufs(struct xio_transport_base *transport,
+			 struct xio_task *task,
+			 struct xio_mempool_obj *objs, int nents);
+
 int xio_tcp_send_connect_msg(int fd, struct xio_tcp_connect_msg *msg);
 
 size_t xio_tcp_single_sock_set_txd(struct xio_task *task);
@@ -295,7 +295,11 @@ static struct xio_mem_block *xio_mem_slot_resize(struct xio_mem_slot *slot,
 	else if (slot->pool->flags & XIO_MEMPOOL_FLAG_NUMA_ALLOC)
 		region->buf = unuma_alloc(data_alloc_sz, slot->pool->nodeid);
 	else if (slot->pool->flags & XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC)
-		region->buf = ucalloc(data_alloc_sz, sizeof(uint8_t));
+		/* page aligned, like the huge pages, so that blocks sized in
+		 * sectors can go to O_DIRECT
+		 */
+		region->buf = umemalign(page_size,
+					ALIGN(data_alloc_sz, page_size));
 
 	if (region->buf == NULL) {
 		ufree(region);
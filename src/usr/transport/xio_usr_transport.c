@@ -47,6 +47,15 @@
 #include "xio_usr_transport.h"
 #include "xio_transport_mempool.h"
 #include "xio_common.h"
+#include "xio_sg_table.h"
+#include "xio_nexus.h"
+
+struct xio_buf_ref {
+	struct xio_buf			buf;
+	struct xio_mempool_obj		obj;
+	struct kref			kref;
+	int				pad;
+};
 
 #ifndef HAVE_INFINIBAND_VERBS_H
 
@@ -213,3 +222,162 @@ struct xio_mempool *xio_transport_mempool_array_get(
 	}
 	return mempool_array[ctx->nodeid];
 }
+
+/*---------------------------------------------------------------------------*/
+/* xio_transport_take_in_bufs						     */
+/*---------------------------------------------------------------------------*/
+int xio_transport_take_in_bufs(struct xio_mempool *mempool,
+			       struct xio_msg *msg,
+			       struct xio_mempool_obj *read_sge,
+			       int read_num_sge,
+			       struct xio_mempool_obj *objs, int nents)
+{
+	void			*sgtbl;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sg;
+	int			i, j;
+
+	sgtbl		= xio_sg_table_get(&msg->in);
+	sgtbl_ops	= xio_sg_table_ops_get(msg->in.sgl_type);
+
+	if ((int)tbl_nents(sgtbl_ops, sgtbl) > nents) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+
+	/* allocate copies for data that does not live in the pool first,
+	 * so that a failure leaves the message untouched
+	 */
+	for_each_sge(sgtbl, sgtbl_ops, sg, i) {
+		memset(&objs[i], 0, sizeof(objs[i]));
+		if (i < read_num_sge && read_sge[i].cache &&
+		    read_sge[i].addr == sge_addr(sgtbl_ops, sg))
+			continue;
+		if (!sge_addr(sgtbl_ops, sg) || !sge_length(sgtbl_ops, sg))
+			continue;
+		if (!mempool ||
+		    xio_mempool_alloc(mempool, sge_length(sgtbl_ops, sg),
+				      &objs[i])) {
+			ERROR_LOG("mempool is empty for %zd bytes\n",
+				  sge_length(sgtbl_ops, sg));
+			xio_set_error(XIO_E_NO_BUFS);
+			goto cleanup;
+		}
+	}
+
+	for_each_sge(sgtbl, sgtbl_ops, sg, i) {
+		if (objs[i].cache) {
+			memcpy(objs[i].addr, sge_addr(sgtbl_ops, sg),
+			       sge_length(sgtbl_ops, sg));
+		} else if (i < read_num_sge && read_sge[i].cache &&
+			   read_sge[i].addr == sge_addr(sgtbl_ops, sg)) {
+			/* move the pool object, the task no longer owns it */
+			objs[i] = read_sge[i];
+			objs[i].length = sge_length(sgtbl_ops, sg);
+			read_sge[i].cache = NULL;
+		} else {
+			continue;
+		}
+		sge_set_addr(sgtbl_ops, sg, objs[i].addr);
+		sge_set_mr(sgtbl_ops, sg, objs[i].mr);
+	}
+
+	return tbl_nents(sgtbl_ops, sgtbl);
+
+cleanup:
+	for (j = 0; j < i; j++)
+		xio_mempool_free(&objs[j]);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_buf_release							     */
+/*---------------------------------------------------------------------------*/
+static void xio_buf_release(struct kref *kref)
+{
+	struct xio_buf_ref *ref = container_of(kref, struct xio_buf_ref, kref);
+
+	xio_mempool_free(&ref->obj);
+	ufree(ref);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_msg_take_bufs							     */
+/*---------------------------------------------------------------------------*/
+int xio_msg_take_bufs(struct xio_msg *msg, struct xio_buf **bufs, int nbufs)
+{
+	struct xio_task		*task;
+	struct xio_mempool_obj	objs[MAX_SGE];
+	struct xio_buf_ref	*refs[MAX_SGE];
+	struct xio_sg_table_ops	*sgtbl_ops;
+	int			i, nents;
+
+	if (!msg || !bufs ||
+	    (msg->type != XIO_MSG_TYPE_REQ &&
+	     msg->type != XIO_MSG_TYPE_ONE_WAY)) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	task		= container_of(msg, struct xio_task, imsg);
+	sgtbl_ops	= xio_sg_table_ops_get(msg->in.sgl_type);
+	nents		= tbl_nents(sgtbl_ops, xio_sg_table_get(&msg->in));
+	if (!task->nexus || nents > nbufs || nents > MAX_SGE) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+
+	/* allocate the handles up front - once the transport gave up the
+	 * buffers there is no way back
+	 */
+	for (i = 0; i < nents; i++) {
+		refs[i] = ucalloc(1, sizeof(*refs[i]));
+		if (!refs[i]) {
+			xio_set_error(ENOMEM);
+			ERROR_LOG("calloc failed. (errno=%d %m)\n", errno);
+			goto cleanup;
+		}
+	}
+
+	if (xio_nexus_take_in_bufs(task->nexus, task, objs, nents) != nents)
+		goto cleanup;
+
+	for (i = 0; i < nents; i++) {
+		refs[i]->obj		= objs[i];
+		refs[i]->buf.addr	= objs[i].addr;
+		refs[i]->buf.length	= objs[i].length;
+		refs[i]->buf.mr		= objs[i].mr;
+		kref_init(&refs[i]->kref);
+		bufs[i] = &refs[i]->buf;
+	}
+
+	return nents;
+
+cleanup:
+	while (i--)
+		ufree(refs[i]);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_buf_get								     */
+/*---------------------------------------------------------------------------*/
+struct xio_buf *xio_buf_get(struct xio_buf *buf)
+{
+	struct xio_buf_ref *ref = container_of(buf, struct xio_buf_ref, buf);
+
+	kref_get(&ref->kref);
+
+	return buf;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_buf_put								     */
+/*---------------------------------------------------------------------------*/
+void xio_buf_put(struct xio_buf *buf)
+{
+	struct xio_buf_ref *ref = container_of(buf, struct xio_buf_ref, buf);
+
+	kref_put(&ref->kref, xio_buf_release);
+}
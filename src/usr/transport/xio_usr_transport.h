@@ -148,6 +148,19 @@ struct xio_mempool *xio_transport_mempool_array_get(
 		int mempool_array_len,
 		int reg_mr);
 
+/* move a received message's in data to pool objects owned by the caller:
+ * sges already in read_sge pool objects are moved and cleared from
+ * read_sge, so releasing the task no longer frees them, the rest are
+ * copied into objects from mempool. msg->in is pointed at the objects.
+ * the caller frees each object with xio_mempool_free, the objects live
+ * until the transport destroys its pools at library shutdown
+ */
+int xio_transport_take_in_bufs(struct xio_mempool *mempool,
+			       struct xio_msg *msg,
+			       struct xio_mempool_obj *read_sge,
+			       int read_num_sge,
+			       struct xio_mempool_obj *objs, int nents);
+
 
 
 #endif  /* XIO_COMMON_TRANSPORT_H */
@@ -545,6 +545,14 @@ inline int xio_context_is_loop_stopping(struct xio_context *ctx)
 	return xio_ev_loop_is_stopping(ctx->ev_loop);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_context_get_loop_util						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_get_loop_util(struct xio_context *ctx)
+{
+	return xio_ev_loop_get_util(ctx->ev_loop);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ctx_add_work							     */
 /*---------------------------------------------------------------------------*/
@@ -53,6 +53,7 @@
 #endif
 
 #define MAX_DELETED_EVENTS	1024
+#define UTIL_WINDOW_MSEC	100
 
 extern double                    g_mhz;
 
@@ -64,8 +65,12 @@ struct xio_ev_loop {
 	int				stop_loop;
 	int				wakeup_event;
 	int				wakeup_armed;
-	int				pad;
+	int				util;	/* busy percent, last window */
 	int				deleted_events_nr;
+	cycles_t			util_window;
+	cycles_t			util_start;
+	cycles_t			idle_cycles;
+	cycles_t			wait_start; /* 0 unless in epoll_wait */
 	struct xio_ev_data		*deleted_events[MAX_DELETED_EVENTS];
 	struct list_head		poll_events_list;
 	struct list_head		events_list;
@@ -239,6 +244,8 @@ void *xio_ev_loop_create()
 	loop->stop_loop		= 0;
 	loop->wakeup_armed	= 0;
 	loop->deleted_events_nr = 0;
+	loop->util_window	= (cycles_t)(g_mhz * 1000 * UTIL_WINDOW_MSEC);
+	loop->util_start	= get_cycles();
 	loop->efd		= epoll_create(4096);
 	if (loop->efd == -1) {
 		xio_set_error(errno);
@@ -333,6 +340,25 @@ static int xio_ev_loop_exec_scheduled(struct xio_ev_loop *loop)
 	return work_remains;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_account_idle						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_ev_loop_account_idle(struct xio_ev_loop *loop,
+					    cycles_t idle_start)
+{
+	cycles_t now = get_cycles();
+	cycles_t elapsed;
+
+	loop->idle_cycles += now - idle_start;
+	elapsed = now - loop->util_start;
+	if (elapsed < loop->util_window)
+		return;
+
+	loop->util = 100 - (int)((loop->idle_cycles * 100) / elapsed);
+	loop->util_start = now;
+	loop->idle_cycles = 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ev_loop_run_helper                                                    */
 /*---------------------------------------------------------------------------*/
@@ -346,6 +372,7 @@ static inline int xio_ev_loop_run_helper(void *loop_hndl, int timeout)
 	int			tmout;
 	int			wait_time = timeout;
 	cycles_t		start_cycle  = 0;
+	cycles_t		idle_start;
 
 	if (timeout != -1)
 		start_cycle = get_cycles();
@@ -358,7 +385,11 @@ retry:
 		while (loop->deleted_events_nr)
 			ufree(loop->deleted_events[--loop->deleted_events_nr]);
 
+	idle_start = get_cycles();
+	loop->wait_start = idle_start;
 	nevent = epoll_wait(loop->efd, events, ARRAY_SIZE(events), tmout);
+	loop->wait_start = 0;
+	xio_ev_loop_account_idle(loop, idle_start);
 	if (unlikely(nevent < 0)) {
 		if (errno != EINTR) {
 			xio_set_error(errno);
@@ -439,6 +470,33 @@ retry:
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_get_util							     */
+/*---------------------------------------------------------------------------*/
+int xio_ev_loop_get_util(void *loop_hndl)
+{
+	struct xio_ev_loop *loop = loop_hndl;
+	cycles_t wait_start = *(volatile cycles_t *)&loop->wait_start;
+	cycles_t now, elapsed, idle;
+
+	/* a loop blocked in epoll_wait never closes its window - once the
+	 * window expired, count the wait in progress as idle time
+	 */
+	if (!wait_start)
+		return loop->util;
+
+	now = get_cycles();
+	elapsed = now - loop->util_start;
+	if (elapsed < loop->util_window || now < wait_start)
+		return loop->util;
+
+	idle = loop->idle_cycles + (now - wait_start);
+	if (idle >= elapsed)
+		return 0;
+
+	return 100 - (int)((idle * 100) / elapsed);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ev_loop_run_timeout						     */
 /*---------------------------------------------------------------------------*/
@@ -99,6 +99,15 @@ int xio_ev_loop_is_stopping(void *loop_hndl);
  */
 void xio_ev_loop_destroy(void **loop);
 
+/**
+ * event loop utilization
+ *
+ * @param[in] loop	the dispatcher context
+ *
+ * @returns percent of the last 100 msec window spent outside epoll_wait
+ */
+int xio_ev_loop_get_util(void *loop);
+
 /**
  * add event handlers on dispatcher
  *
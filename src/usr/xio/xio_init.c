@@ -42,6 +42,8 @@
 #include "xio_tls.h"
 #include "xio_sessions_cache.h"
 #include "xio_nexus_cache.h"
+#include "xio_nexus_warm.h"
+#include "xio_stats_shm.h"
 #include "xio_observer.h"
 #include "xio_transport.h"
 
@@ -81,7 +83,13 @@ static void xio_dtor()
 
 		xio_unreg_transport(transport_tbl[i]);
 	}
+	/* run callbacks of objects released to the caches */
+	rcu_barrier();
+	nexus_cache_destruct();
+	sessions_cache_destruct();
+	xio_stats_shm_destruct();
 	xio_thread_data_destruct();
+	xio_log_async_destruct();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -95,9 +103,11 @@ static void xio_ctor()
 	if (page_size < 0)
 		page_size = 4096;
 	g_mhz = get_cpu_mhz(0);
+	xio_log_async_construct();
 	xio_thread_data_construct();
 	sessions_cache_construct();
 	nexus_cache_construct();
+	xio_nexus_warm_construct();
 
 	for (i = 0; i < transport_tbl_sz; i++) {
 		xio_reg_transport(transport_tbl[i]);
@@ -50,21 +50,52 @@
 #define XIO_F_PRINTF(fmtarg, varg) \
 	__attribute__((__format__(printf, fmtarg, varg)))
 
+#define XIO_LOG_MAX_ARGS	16
+
+/*
+ * A log call site.  With asynchronous logging each site is a static
+ * object: records carry a pointer to it plus the raw arguments and the
+ * formatting happens later, on the log thread.
+ */
+struct xio_log_site {
+	const char		*file;
+	const char		*function;
+	const char		*format;
+	unsigned		line;
+	unsigned		severity;
+	int			state;		/* argument types parsed */
+	uint8_t			nargs;
+	uint8_t			types[XIO_LOG_MAX_ARGS];
+	uint8_t			pad[3];
+};
+
 /*---------------------------------------------------------------------------*/
 /* enum									     */
 /*---------------------------------------------------------------------------*/
 extern int		xio_logging_level;
 extern xio_log_fn	xio_vlog_fn;
+extern int		xio_log_async;
 
 extern void xio_vlog(const char *file, unsigned line, const char *function,
 		     unsigned level, const char *fmt, ...);
 
+extern void xio_log_record(struct xio_log_site *site, ...);
+
+/* fatal messages are never deferred, the process may not live to print */
 #define xio_log(level, fmt, ...) \
 	do { \
 		if (unlikely(((level) < XIO_LOG_LEVEL_LAST) &&  \
 					(level) <= xio_logging_level)) { \
-			xio_vlog_fn(__FILE__, __LINE__, __func__, (level), \
-				    fmt, ## __VA_ARGS__); \
+			if (xio_log_async && \
+			    (level) > XIO_LOG_LEVEL_FATAL) { \
+				static struct xio_log_site __xio_site = { \
+					__FILE__, __func__, fmt, \
+					__LINE__, (level), 0, 0, {0}, {0} }; \
+				xio_log_record(&__xio_site, ## __VA_ARGS__); \
+			} else { \
+				xio_vlog_fn(__FILE__, __LINE__, __func__, \
+					    (level), fmt, ## __VA_ARGS__); \
+			} \
 		} \
 	} while (0)
 
@@ -83,6 +114,10 @@ extern void xio_vlog(const char *file, unsigned line, const char *function,
 
 void xio_read_logging_level(void);
 
+void xio_log_async_construct(void);
+
+void xio_log_async_destruct(void);
+
 static inline int xio_set_log_level(enum xio_log_level level)
 {
 	xio_logging_level = level;
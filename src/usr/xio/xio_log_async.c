@@ -0,0 +1,653 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_log.h"
+
+/* records are fixed size so a slot never straddles the ring end */
+#define XIO_LOG_REC_DATA	104
+#define XIO_LOG_RING_SIZE	4096
+#define XIO_LOG_IDLE_USEC	1000
+#define XIO_LOG_STR_MAX		(XIO_LOG_REC_DATA - sizeof(uint16_t))
+
+enum xio_log_site_state {
+	XIO_LOG_SITE_NEW,
+	XIO_LOG_SITE_BINARY,	/* arguments copied raw */
+	XIO_LOG_SITE_TEXT,	/* unsupported format, preformatted */
+};
+
+enum xio_log_arg {
+	XIO_LOG_ARG_INT,
+	XIO_LOG_ARG_LONG,
+	XIO_LOG_ARG_DOUBLE,
+	XIO_LOG_ARG_PTR,
+	XIO_LOG_ARG_STR,
+	XIO_LOG_ARG_ERRNO,	/* %m, errno at record time */
+};
+
+enum xio_log_ring_state {
+	XIO_LOG_RING_LIVE,
+	XIO_LOG_RING_ORPHAN,	/* thread exited */
+	XIO_LOG_RING_DETACHED,	/* library destructed, thread alive */
+};
+
+struct xio_log_rec {
+	const struct xio_log_site	*site;
+	uint64_t			cycles;
+	uint32_t			len;
+	int32_t				saved_errno;
+	uint8_t				data[XIO_LOG_REC_DATA];
+};
+
+struct xio_log_ring {
+	/* producer side */
+	uint64_t			head;
+	uint64_t			dropped;
+	uint64_t			pad0[6];
+	/* consumer side */
+	uint64_t			tail;
+	uint64_t			reported;
+	int				state;
+	uint32_t			mask;
+	struct list_head		rings_list_entry;
+	uint64_t			pad1[3];
+	struct xio_log_rec		rec[];
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+extern double				g_mhz;
+
+int					xio_log_async;
+
+static __thread struct xio_log_ring	*xio_log_ring;
+static __thread uint32_t		xio_log_ring_gen;
+static uint32_t				log_gen;
+static LIST_HEAD(rings_list);
+static DEFINE_MUTEX(rings_mutex);
+static pthread_key_t			ring_key;
+static pthread_once_t			ring_key_once = PTHREAD_ONCE_INIT;
+static int				ring_key_err;
+static pthread_t			log_thread;
+static volatile int			log_thread_stop;
+static uint32_t				ring_size = XIO_LOG_RING_SIZE;
+static struct timeval			base_tv;
+static uint64_t				base_cycles;
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_scan - walk one conversion starting after '%', collect the	     */
+/* argument types it consumes. returns NULL for unsupported conversions	     */
+/*---------------------------------------------------------------------------*/
+static const char *xio_log_scan(const char *p, uint8_t *types, int *nargs)
+{
+	int longs = 0;
+
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		if (*nargs >= XIO_LOG_MAX_ARGS)
+			return NULL;
+		types[(*nargs)++] = XIO_LOG_ARG_INT;
+		p++;
+	}
+	while (isdigit(*p))
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			if (*nargs >= XIO_LOG_MAX_ARGS)
+				return NULL;
+			types[(*nargs)++] = XIO_LOG_ARG_INT;
+			p++;
+		}
+		while (isdigit(*p))
+			p++;
+	}
+	while (*p && strchr("hlqjzt", *p)) {
+		if (*p != 'h')
+			longs++;
+		p++;
+	}
+	if (*nargs >= XIO_LOG_MAX_ARGS)
+		return NULL;
+
+	switch (*p) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		types[(*nargs)++] = longs ? XIO_LOG_ARG_LONG : XIO_LOG_ARG_INT;
+		break;
+	case 'c':
+		types[(*nargs)++] = XIO_LOG_ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+		types[(*nargs)++] = XIO_LOG_ARG_DOUBLE;
+		break;
+	case 'p':
+		types[(*nargs)++] = XIO_LOG_ARG_PTR;
+		break;
+	case 's':
+		if (longs)
+			return NULL;
+		types[(*nargs)++] = XIO_LOG_ARG_STR;
+		break;
+	case 'm':
+		types[(*nargs)++] = XIO_LOG_ARG_ERRNO;
+		break;
+	default:
+		return NULL;
+	}
+
+	return p + 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_site_parse							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_site_parse(struct xio_log_site *site)
+{
+	const char	*p = site->format;
+	int		nargs = 0;
+	int		state = XIO_LOG_SITE_BINARY;
+
+	while (*p) {
+		if (*p++ != '%')
+			continue;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+		p = xio_log_scan(p, site->types, &nargs);
+		if (!p) {
+			state = XIO_LOG_SITE_TEXT;
+			break;
+		}
+	}
+	site->nargs = nargs;
+	/* concurrent first users parse the same result */
+	__atomic_store_n(&site->state, state, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_key_destroy						     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_ring_key_destroy(void *data)
+{
+	struct xio_log_ring *ring = data;
+
+	/* the log thread frees it once drained, unless it was detached */
+	if (__atomic_exchange_n(&ring->state, XIO_LOG_RING_ORPHAN,
+				__ATOMIC_ACQ_REL) == XIO_LOG_RING_DETACHED)
+		ufree(ring);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_key_create - the key outlives library instances, it frees    */
+/* detached rings of threads that exit					     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_ring_key_create(void)
+{
+	ring_key_err = pthread_key_create(&ring_key, xio_log_ring_key_destroy);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_create							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_log_ring *xio_log_ring_create(void)
+{
+	struct xio_log_ring *ring;
+
+	ring = ucalloc(1, sizeof(*ring) +
+		       ring_size * sizeof(struct xio_log_rec));
+	if (!ring)
+		return NULL;
+	ring->mask = ring_size - 1;
+
+	pthread_setspecific(ring_key, ring);
+	mutex_lock(&rings_mutex);
+	list_add_tail(&ring->rings_list_entry, &rings_list);
+	mutex_unlock(&rings_mutex);
+
+	xio_log_ring = ring;
+	xio_log_ring_gen = __atomic_load_n(&log_gen, __ATOMIC_ACQUIRE);
+
+	return ring;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_record							     */
+/*---------------------------------------------------------------------------*/
+void xio_log_record(struct xio_log_site *site, ...)
+{
+	struct xio_log_ring	*ring;
+	struct xio_log_rec	*rec;
+	va_list			args;
+	uint64_t		head, tail;
+	uint8_t			*ptr, *end;
+	int			saved_errno = errno;
+	int			i;
+
+	ring = xio_log_ring;
+	if (unlikely(!ring || xio_log_ring_gen !=
+			      __atomic_load_n(&log_gen, __ATOMIC_ACQUIRE))) {
+		/* detached by a previous library instance, only this
+		 * thread still refers to it. a ring created while the
+		 * previous instance was detaching is still listed, keep it
+		 */
+		if (ring && __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) !=
+			    XIO_LOG_RING_DETACHED) {
+			xio_log_ring_gen = __atomic_load_n(&log_gen,
+							   __ATOMIC_ACQUIRE);
+		} else {
+			if (ring) {
+				xio_log_ring = NULL;
+				pthread_setspecific(ring_key, NULL);
+				ufree(ring);
+			}
+			ring = xio_log_ring_create();
+			if (!ring)
+				goto exit;
+		}
+	}
+	head = ring->head;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (unlikely(head - tail > ring->mask)) {
+		__atomic_store_n(&ring->dropped, ring->dropped + 1,
+				 __ATOMIC_RELAXED);
+		goto exit;
+	}
+	if (unlikely(__atomic_load_n(&site->state, __ATOMIC_ACQUIRE) ==
+		     XIO_LOG_SITE_NEW))
+		xio_log_site_parse(site);
+
+	rec		 = &ring->rec[head & ring->mask];
+	rec->site	 = site;
+	rec->cycles	 = get_cycles();
+	rec->saved_errno = saved_errno;
+
+	va_start(args, site);
+	if (site->state == XIO_LOG_SITE_TEXT) {
+		errno = saved_errno;
+		i = vsnprintf((char *)rec->data, sizeof(rec->data),
+			      site->format, args);
+		rec->len = (i < 0) ? 0 : min(i, (int)sizeof(rec->data) - 1);
+		va_end(args);
+		goto publish;
+	}
+
+	ptr = rec->data;
+	end = rec->data + sizeof(rec->data);
+	for (i = 0; i < site->nargs; i++) {
+		union {
+			int		i;
+			long long	l;
+			double		d;
+			void		*p;
+		} v;
+		const char	*s;
+		uint16_t	slen;
+
+		switch (site->types[i]) {
+		case XIO_LOG_ARG_INT:
+			v.i = va_arg(args, int);
+			if (ptr + sizeof(v.i) > end)
+				goto truncated;
+			memcpy(ptr, &v.i, sizeof(v.i));
+			ptr += sizeof(v.i);
+			break;
+		case XIO_LOG_ARG_LONG:
+			v.l = va_arg(args, long long);
+			if (ptr + sizeof(v.l) > end)
+				goto truncated;
+			memcpy(ptr, &v.l, sizeof(v.l));
+			ptr += sizeof(v.l);
+			break;
+		case XIO_LOG_ARG_DOUBLE:
+			v.d = va_arg(args, double);
+			if (ptr + sizeof(v.d) > end)
+				goto truncated;
+			memcpy(ptr, &v.d, sizeof(v.d));
+			ptr += sizeof(v.d);
+			break;
+		case XIO_LOG_ARG_PTR:
+			v.p = va_arg(args, void *);
+			if (ptr + sizeof(v.p) > end)
+				goto truncated;
+			memcpy(ptr, &v.p, sizeof(v.p));
+			ptr += sizeof(v.p);
+			break;
+		case XIO_LOG_ARG_STR:
+			s = va_arg(args, const char *);
+			if (!s)
+				s = "(null)";
+			if (ptr + sizeof(slen) > end)
+				goto truncated;
+			slen = min(strlen(s),
+				   (size_t)(end - ptr - sizeof(slen)));
+			memcpy(ptr, &slen, sizeof(slen));
+			memcpy(ptr + sizeof(slen), s, slen);
+			ptr += sizeof(slen) + slen;
+			break;
+		case XIO_LOG_ARG_ERRNO:
+			break;
+		}
+	}
+truncated:
+	va_end(args);
+	rec->len = ptr - rec->data;
+
+publish:
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+exit:
+	errno = saved_errno;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_format_one - format a single conversion spec			     */
+/*---------------------------------------------------------------------------*/
+static int xio_log_format_one(char *out, size_t size, const char *spec,
+			      const int *stars, int nstars,
+			      int type, const void *val, int saved_errno)
+{
+	int		i;
+	long long	l;
+	double		d;
+	void		*p;
+
+#define XIO_LOG_SNPRINTF(v)						\
+	((nstars == 0) ? snprintf(out, size, spec, v) :			\
+	 (nstars == 1) ? snprintf(out, size, spec, stars[0], v) :	\
+			 snprintf(out, size, spec, stars[0], stars[1], v))
+
+	switch (type) {
+	case XIO_LOG_ARG_INT:
+		memcpy(&i, val, sizeof(i));
+		return XIO_LOG_SNPRINTF(i);
+	case XIO_LOG_ARG_LONG:
+		memcpy(&l, val, sizeof(l));
+		return XIO_LOG_SNPRINTF(l);
+	case XIO_LOG_ARG_DOUBLE:
+		memcpy(&d, val, sizeof(d));
+		return XIO_LOG_SNPRINTF(d);
+	case XIO_LOG_ARG_PTR:
+		memcpy(&p, val, sizeof(p));
+		return XIO_LOG_SNPRINTF(p);
+	case XIO_LOG_ARG_STR:
+		return XIO_LOG_SNPRINTF((const char *)val);
+	case XIO_LOG_ARG_ERRNO:
+		return XIO_LOG_SNPRINTF(strerror(saved_errno));
+	}
+#undef XIO_LOG_SNPRINTF
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_decode - rebuild the text of a binary record			     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_decode(const struct xio_log_rec *rec,
+			   char *buf, size_t size)
+{
+	const struct xio_log_site	*site = rec->site;
+	const char			*p = site->format, *start;
+	const uint8_t			*ptr = rec->data;
+	const uint8_t			*end = rec->data + rec->len;
+	char				spec[32];
+	char				str[XIO_LOG_REC_DATA];
+	uint8_t				types[XIO_LOG_MAX_ARGS];
+	size_t				len = 0;
+	int				stars[2], nstars, ntypes, i, n;
+	uint16_t			slen;
+	const void			*val;
+
+	if (site->state == XIO_LOG_SITE_TEXT) {
+		snprintf(buf, size, "%.*s", (int)rec->len, rec->data);
+		return;
+	}
+
+	while (*p && len < size - 1) {
+		if (*p != '%' || p[1] == '%') {
+			buf[len++] = *p;
+			p += (*p == '%') ? 2 : 1;
+			continue;
+		}
+		start = p++;
+		ntypes = 0;
+		p = xio_log_scan(p, types, &ntypes);
+		if (!p || (size_t)(p - start) >= sizeof(spec))
+			break;
+		memcpy(spec, start, p - start);
+		spec[p - start] = 0;
+		if (spec[p - start - 1] == 'm')
+			spec[p - start - 1] = 's';
+
+		/* leading '*' widths then the value itself */
+		nstars = 0;
+		val = NULL;
+		for (i = 0; i < ntypes; i++) {
+			if (types[i] == XIO_LOG_ARG_ERRNO)
+				continue;
+			if (types[i] == XIO_LOG_ARG_STR) {
+				if (ptr + sizeof(slen) > end)
+					goto truncated;
+				memcpy(&slen, ptr, sizeof(slen));
+				memcpy(str, ptr + sizeof(slen), slen);
+				str[slen] = 0;
+				ptr += sizeof(slen) + slen;
+				val = str;
+				continue;
+			}
+			n = (types[i] == XIO_LOG_ARG_INT) ? sizeof(int) : 8;
+			if (ptr + n > end)
+				goto truncated;
+			if (i < ntypes - 1)
+				memcpy(&stars[nstars++], ptr, sizeof(int));
+			else
+				val = ptr;
+			ptr += n;
+		}
+		n = xio_log_format_one(buf + len, size - len, spec,
+				       stars, nstars, types[ntypes - 1], val,
+				       rec->saved_errno);
+		if (n > 0)
+			len = min(len + n, size - 1);
+	}
+	buf[len] = 0;
+	return;
+
+truncated:
+	snprintf(buf + len, size - len, "<truncated>\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_emit								     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_emit(const struct xio_log_rec *rec)
+{
+	const struct xio_log_site	*site = rec->site;
+	static const char * const level_str[] = {
+		"FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"
+	};
+	const char			*short_file;
+	char				buf[2048];
+	char				buf2[48];
+	struct timeval			tv;
+	struct tm			t;
+	uint64_t			usec;
+
+	xio_log_decode(rec, buf, sizeof(buf));
+
+	/* a user log function gets the text, timing is theirs */
+	if (xio_vlog_fn != xio_vlog) {
+		xio_vlog_fn(site->file, site->line, site->function,
+			    site->severity, "%s", buf);
+		return;
+	}
+
+	usec = (rec->cycles - base_cycles) / g_mhz;
+	tv.tv_sec  = base_tv.tv_sec + (base_tv.tv_usec + usec) / 1000000;
+	tv.tv_usec = (base_tv.tv_usec + usec) % 1000000;
+	localtime_r(&tv.tv_sec, &t);
+
+	short_file = strrchr(site->file, '/');
+	short_file = (short_file == NULL) ? site->file : short_file + 1;
+	snprintf(buf2, sizeof(buf2), "%s:%u", short_file, site->line);
+
+	fprintf(stderr,
+		"[%04d/%02d/%02d-%02d:%02d:%02d.%05ld] %-28s [%-5s] - %s",
+		t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+		t.tm_hour, t.tm_min, t.tm_sec, (long)tv.tv_usec, buf2,
+		level_str[site->severity], buf);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_drain							     */
+/*---------------------------------------------------------------------------*/
+static int xio_log_drain(void)
+{
+	struct xio_log_ring	*ring, *tmp;
+	uint64_t		head, tail, dropped;
+	int			orphan, nr = 0;
+
+	mutex_lock(&rings_mutex);
+	list_for_each_entry_safe(ring, tmp, &rings_list, rings_list_entry) {
+		orphan	= (__atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) ==
+			   XIO_LOG_RING_ORPHAN);
+		head	= __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		for (tail = ring->tail; tail != head; tail++, nr++) {
+			xio_log_emit(&ring->rec[tail & ring->mask]);
+			__atomic_store_n(&ring->tail, tail + 1,
+					 __ATOMIC_RELEASE);
+		}
+		dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		if (dropped != ring->reported) {
+			fprintf(stderr, "xio log: %llu records dropped\n",
+				(unsigned long long)(dropped - ring->reported));
+			ring->reported = dropped;
+		}
+		if (orphan) {
+			list_del(&ring->rings_list_entry);
+			ufree(ring);
+		}
+	}
+	mutex_unlock(&rings_mutex);
+	if (nr)
+		fflush(stderr);
+
+	return nr;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *xio_log_thread(void *data)
+{
+	while (!log_thread_stop) {
+		if (!xio_log_drain())
+			usleep(XIO_LOG_IDLE_USEC);
+	}
+	xio_log_drain();
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_async_construct						     */
+/*---------------------------------------------------------------------------*/
+void xio_log_async_construct(void)
+{
+	char	*val = getenv("XIO_LOG_ASYNC");
+	int	size;
+
+	if (val == NULL || atoi(val) <= 0)
+		return;
+
+	/* "1" enables the default ring, larger values set records/thread */
+	size = atoi(val);
+	if (size > 1) {
+		ring_size = 1;
+		while (ring_size < (uint32_t)size)
+			ring_size <<= 1;
+	}
+
+	pthread_once(&ring_key_once, xio_log_ring_key_create);
+	if (ring_key_err) {
+		errno = ring_key_err;
+		ERROR_LOG("pthread_key_create failed. %m\n");
+		return;
+	}
+	gettimeofday(&base_tv, NULL);
+	base_cycles = get_cycles();
+	__atomic_add_fetch(&log_gen, 1, __ATOMIC_RELEASE);
+
+	log_thread_stop = 0;
+	if (pthread_create(&log_thread, NULL, xio_log_thread, NULL)) {
+		ERROR_LOG("log thread creation failed. %m\n");
+		return;
+	}
+	xio_log_async = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_async_destruct						     */
+/*---------------------------------------------------------------------------*/
+void xio_log_async_destruct(void)
+{
+	struct xio_log_ring *ring, *tmp;
+
+	if (!xio_log_async)
+		return;
+
+	xio_log_async = 0;
+	log_thread_stop = 1;
+	pthread_join(log_thread, NULL);
+
+	/* a live thread may be inside a record or hold the ring in its tls,
+	 * it frees the ring on its next record or on exit
+	 */
+	mutex_lock(&rings_mutex);
+	list_for_each_entry_safe(ring, tmp, &rings_list, rings_list_entry) {
+		list_del(&ring->rings_list_entry);
+		if (__atomic_exchange_n(&ring->state, XIO_LOG_RING_DETACHED,
+					__ATOMIC_ACQ_REL) ==
+		    XIO_LOG_RING_ORPHAN)
+			ufree(ring);
+	}
+	mutex_unlock(&rings_mutex);
+	/* the next instance does not reuse the tls rings */
+	__atomic_add_fetch(&log_gen, 1, __ATOMIC_RELEASE);
+}
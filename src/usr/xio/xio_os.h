@@ -79,6 +79,8 @@
 #include <linux/printk.h>
 #include <linux/atomic.h>
 #include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/rculist.h>
 #include <linux/usr.h>
 #include <linux/netlink.h>
 #include <linux/debugfs.h>
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_log.h"
+
+/* callbacks queued before a grace period is forced */
+#define XIO_RCU_BATCH		32
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+uint64_t			xio_rcu_gp_ctr = 1;
+__thread struct xio_rcu_reader	*xio_rcu_reader;
+
+static LIST_HEAD(readers_list);
+static DEFINE_MUTEX(readers_mutex);
+static pthread_key_t		reader_key;
+static pthread_once_t		reader_key_once = PTHREAD_ONCE_INIT;
+
+static spinlock_t		cb_lock;
+static struct rcu_head		*cb_list;
+static int			cb_nr;
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_unregister_thread						     */
+/*---------------------------------------------------------------------------*/
+static void xio_rcu_unregister_thread(void *data)
+{
+	struct xio_rcu_reader *r = data;
+
+	mutex_lock(&readers_mutex);
+	list_del(&r->readers_list_entry);
+	mutex_unlock(&readers_mutex);
+
+	ufree(r);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_reader_key_create						     */
+/*---------------------------------------------------------------------------*/
+static void xio_rcu_reader_key_create(void)
+{
+	if (pthread_key_create(&reader_key, xio_rcu_unregister_thread))
+		ERROR_LOG("pthread_key_create failed. %m\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_register_thread						     */
+/*---------------------------------------------------------------------------*/
+struct xio_rcu_reader *xio_rcu_register_thread(void)
+{
+	struct xio_rcu_reader *r;
+
+	r = ucalloc(1, sizeof(*r));
+	if (!r) {
+		ERROR_LOG("FATAL ERROR: rcu reader allocation failed\n");
+		abort();
+	}
+
+	pthread_once(&reader_key_once, xio_rcu_reader_key_create);
+	pthread_setspecific(reader_key, r);
+
+	mutex_lock(&readers_mutex);
+	list_add_tail(&r->readers_list_entry, &readers_list);
+	mutex_unlock(&readers_mutex);
+
+	xio_rcu_reader = r;
+
+	return r;
+}
+
+/*---------------------------------------------------------------------------*/
+/* synchronize_rcu							     */
+/*---------------------------------------------------------------------------*/
+void synchronize_rcu(void)
+{
+	struct xio_rcu_reader	*r;
+	uint64_t		gp, ctr;
+
+	/* removals done by the caller are visible before readers are read */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	mutex_lock(&readers_mutex);
+	gp = __atomic_add_fetch(&xio_rcu_gp_ctr, 1, __ATOMIC_SEQ_CST);
+	list_for_each_entry(r, &readers_list, readers_list_entry) {
+		for (;;) {
+			ctr = __atomic_load_n(&r->ctr, __ATOMIC_ACQUIRE);
+			if (ctr == 0 || ctr >= gp)
+				break;
+			sched_yield();
+		}
+	}
+	mutex_unlock(&readers_mutex);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_rcu_flush							     */
+/*---------------------------------------------------------------------------*/
+static void xio_rcu_flush(void)
+{
+	struct rcu_head *head, *next;
+
+	spin_lock(&cb_lock);
+	head	= cb_list;
+	cb_list	= NULL;
+	cb_nr	= 0;
+	spin_unlock(&cb_lock);
+
+	if (!head)
+		return;
+
+	synchronize_rcu();
+
+	while (head) {
+		next = head->next;
+		head->func(head);
+		head = next;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* call_rcu								     */
+/*---------------------------------------------------------------------------*/
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+	int nr;
+
+	head->func = func;
+
+	spin_lock(&cb_lock);
+	head->next = cb_list;
+	cb_list	   = head;
+	nr	   = ++cb_nr;
+	spin_unlock(&cb_lock);
+
+	/* a reader waiting for its own grace period would never return */
+	if (nr >= XIO_RCU_BATCH &&
+	    !(xio_rcu_reader && xio_rcu_reader->nesting))
+		xio_rcu_flush();
+}
+
+/*---------------------------------------------------------------------------*/
+/* rcu_barrier								     */
+/*---------------------------------------------------------------------------*/
+void rcu_barrier(void)
+{
+	xio_rcu_flush();
+}
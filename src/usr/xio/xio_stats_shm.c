@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "xio_os.h"
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_context.h"
+#include "xio_stats_shm.h"
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+extern double				g_mhz;
+
+static DEFINE_MUTEX(shm_mutex);
+static struct xio_stats_shm_hdr		*shm_hdr;
+static struct xio_stats_conn		*shm_slots;
+static size_t				shm_size;
+static uint32_t				shm_hint;
+static int				shm_state;	/* 0 unset, -1 off */
+static char				shm_name[64];
+
+int					xio_stats_stages;
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_open							     */
+/*---------------------------------------------------------------------------*/
+static int xio_stats_shm_open(void)
+{
+	char		*val = getenv("XIO_STATS_SHM");
+	int		conns_nr;
+	int		fd;
+	void		*addr;
+
+	if (val == NULL || atoi(val) <= 0)
+		return -1;
+
+	/* "1" enables the default size, larger values set the slot count */
+	conns_nr = atoi(val);
+	if (conns_nr == 1)
+		conns_nr = XIO_STATS_SHM_CONNS;
+
+	shm_size = sizeof(*shm_hdr) + conns_nr * sizeof(*shm_slots);
+	snprintf(shm_name, sizeof(shm_name), XIO_STATS_SHM_NAME, getpid());
+
+	fd = shm_open(shm_name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		ERROR_LOG("shm_open %s failed. (errno=%d %m)\n",
+			  shm_name, errno);
+		return -1;
+	}
+	if (ftruncate(fd, shm_size)) {
+		ERROR_LOG("ftruncate %s failed. (errno=%d %m)\n",
+			  shm_name, errno);
+		goto cleanup;
+	}
+	addr = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, 0);
+	if (addr == MAP_FAILED) {
+		ERROR_LOG("mmap %s failed. (errno=%d %m)\n",
+			  shm_name, errno);
+		goto cleanup;
+	}
+	close(fd);
+
+	shm_hdr		= addr;
+	shm_slots	= (struct xio_stats_conn *)(shm_hdr + 1);
+
+	shm_hdr->version	= XIO_STATS_SHM_VERSION;
+	shm_hdr->conns_nr	= conns_nr;
+	shm_hdr->hist_buckets	= XIO_STATS_HIST_BUCKETS;
+	shm_hdr->hertz		= g_mhz * 1000000.0 + 0.5;
+	shm_hdr->pid		= getpid();
+	shm_hdr->slot_size	= sizeof(*shm_slots);
+
+	/* per message stage stamps cost a few cycle reads per message */
+	val = getenv("XIO_STATS_STAGES");
+	if (val && atoi(val) > 0) {
+		xio_stats_stages = 1;
+		shm_hdr->flags |= XIO_STATS_SHM_F_STAGES;
+	}
+
+	/* readers trust the header once the magic shows up */
+	smp_wmb();
+	shm_hdr->magic		= XIO_STATS_SHM_MAGIC;
+
+	DEBUG_LOG("statistics published in /dev/shm%s\n", shm_name);
+
+	return 0;
+
+cleanup:
+	close(fd);
+	shm_unlink(shm_name);
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_reset						     */
+/*---------------------------------------------------------------------------*/
+static void xio_stats_shm_conn_reset(struct xio_stats_conn *slot,
+				     struct xio_context *ctx)
+{
+	xio_stats_write_begin(slot);
+	memset(&slot->in_use, 0,
+	       sizeof(*slot) - offsetof(struct xio_stats_conn, in_use));
+	if (ctx) {
+		slot->ctx	= (uint64_t)(uintptr_t)ctx;
+		slot->cpuid	= ctx->cpuid;
+		slot->in_use	= 1;
+	}
+	xio_stats_write_end(slot);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_get						     */
+/*---------------------------------------------------------------------------*/
+struct xio_stats_conn *xio_stats_shm_conn_get(struct xio_context *ctx)
+{
+	struct xio_stats_conn	*slot = NULL;
+	uint32_t		i, idx;
+
+	mutex_lock(&shm_mutex);
+	if (shm_state == 0)
+		shm_state = xio_stats_shm_open() ? -1 : 1;
+	if (shm_state < 0)
+		goto exit;
+
+	for (i = 0; i < shm_hdr->conns_nr; i++) {
+		idx = (shm_hint + i) % shm_hdr->conns_nr;
+		if (!shm_slots[idx].in_use) {
+			slot = &shm_slots[idx];
+			shm_hint = idx + 1;
+			break;
+		}
+	}
+	if (slot)
+		xio_stats_shm_conn_reset(slot, ctx);
+	else
+		DEBUG_LOG("statistics segment is full, " \
+			  "connection is not published\n");
+exit:
+	mutex_unlock(&shm_mutex);
+
+	return slot;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_conn_put						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_conn_put(struct xio_stats_conn *slot)
+{
+	mutex_lock(&shm_mutex);
+	xio_stats_shm_conn_reset(slot, NULL);
+	mutex_unlock(&shm_mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_destruct						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_destruct(void)
+{
+	mutex_lock(&shm_mutex);
+	if (shm_state > 0) {
+		munmap(shm_hdr, shm_size);
+		shm_unlink(shm_name);
+		shm_hdr = NULL;
+		shm_slots = NULL;
+	}
+	shm_state = 0;
+	mutex_unlock(&shm_mutex);
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define EARLY_REQS_NR		32
+#define EARLY_HDR_LEN		32
+
+struct early_client {
+	struct xio_context	*ctx;
+	struct xio_connection	*conn;
+	int			nrsps;
+	int			nerrors;
+	int			established;
+	int			pad;
+	struct xio_msg		reqs[EARLY_REQS_NR];
+	char			hdrs[EARLY_REQS_NR][EARLY_HDR_LEN];
+};
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct early_client *client = cb_user_context;
+
+	printf("session event: %s. reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+		client->nerrors++;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(client->ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_established						     */
+/*---------------------------------------------------------------------------*/
+static int on_session_established(struct xio_session *session,
+				  struct xio_new_session_rsp *rsp,
+				  void *cb_user_context)
+{
+	struct early_client *client = cb_user_context;
+
+	client->established++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *rsp,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	struct early_client	*client = cb_user_context;
+	char			expected[EARLY_HDR_LEN];
+
+	/* every request answered once, in the order it was sent */
+	snprintf(expected, sizeof(expected), "early %d", client->nrsps);
+	if (rsp->in.header.iov_len != strlen(expected) + 1 ||
+	    strcmp(rsp->in.header.iov_base, expected)) {
+		fprintf(stderr, "response %d out of order: %.*s\n",
+			client->nrsps, (int)rsp->in.header.iov_len,
+			(char *)rsp->in.header.iov_base);
+		client->nerrors++;
+	}
+	client->nrsps++;
+
+	xio_release_response(rsp);
+
+	if (client->nrsps == EARLY_REQS_NR)
+		xio_disconnect(client->conn);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error,
+			struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct early_client *client = cb_user_context;
+
+	fprintf(stderr, "message error: %s\n", xio_strerror(error));
+	client->nerrors++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_session_established		=  on_session_established,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct early_client		client;
+	struct xio_session_params	params;
+	struct xio_session		*session;
+	const char			*transport = XIO_DEF_TRANSPORT;
+	char				url[256];
+	int				i;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [transport]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		transport = argv[3];
+
+	xio_init();
+
+	memset(&client, 0, sizeof(client));
+	client.ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &ses_ops;
+	params.user_context	= &client;
+	params.uri		= url;
+	params.flags		= XIO_SESSION_FLAG_EARLY_DATA;
+
+	session = xio_session_create(&params);
+	if (session == NULL) {
+		fprintf(stderr, "session creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	client.conn = xio_connect(session, client.ctx, 0, NULL, &client);
+
+	/* queue the requests ahead of the session setup response */
+	for (i = 0; i < EARLY_REQS_NR; i++) {
+		struct xio_msg *req = &client.reqs[i];
+
+		snprintf(client.hdrs[i], EARLY_HDR_LEN, "early %d", i);
+		req->out.header.iov_base = client.hdrs[i];
+		req->out.header.iov_len	 = strlen(client.hdrs[i]) + 1;
+		req->out.sgl_type	 = XIO_SGL_TYPE_IOV;
+		req->in.sgl_type	 = XIO_SGL_TYPE_IOV;
+		if (xio_send_request(client.conn, req) == -1) {
+			fprintf(stderr, "sending request failed. %s\n",
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+	}
+
+	xio_context_run_loop(client.ctx, XIO_INFINITE);
+
+	printf("responses %d/%d, errors %d, established %d\n",
+	       client.nrsps, EARLY_REQS_NR, client.nerrors,
+	       client.established);
+
+	xio_context_destroy(client.ctx);
+
+	xio_shutdown();
+
+	return (client.nrsps == EARLY_REQS_NR && !client.nerrors) ? 0 : 1;
+}
+
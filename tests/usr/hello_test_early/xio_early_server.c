@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define EARLY_REQS_NR		32
+
+enum early_mode {
+	EARLY_MODE_ACCEPT,	/* plain accept - requests delivered */
+	EARLY_MODE_PORTAL,	/* accept with portals - client resends */
+	EARLY_MODE_REDIRECT	/* redirect - client resends */
+};
+
+struct early_server {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	int			is_portal;
+	int			pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static enum early_mode		mode = EARLY_MODE_ACCEPT;
+static struct early_server	listener;
+static struct early_server	portal;
+static char			portal_url[256];
+static int			served;
+static struct xio_msg		rsps[EARLY_REQS_NR];
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct early_server *srv = cb_user_context;
+
+	printf("session event: %s. session:%p, connection:%p, reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       session, event_data->conn,
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		/* a redirected session ends before the one that answers */
+		if (mode == EARLY_MODE_REDIRECT && !srv->is_portal)
+			break;
+		if (__sync_fetch_and_add(&served, 0) >= EARLY_REQS_NR) {
+			xio_context_stop_loop(listener.ctx, 0);
+			xio_context_stop_loop(portal.ctx, 0);
+		}
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	struct early_server	*srv = cb_user_context;
+	const char		*portals[] = { portal_url };
+
+	if (srv->is_portal || mode == EARLY_MODE_ACCEPT)
+		xio_accept(session, NULL, 0, NULL, 0);
+	else if (mode == EARLY_MODE_PORTAL)
+		xio_accept(session, portals, 1, NULL, 0);
+	else
+		xio_redirect(session, portals, 1);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_request								     */
+/*---------------------------------------------------------------------------*/
+static int on_request(struct xio_session *session,
+		      struct xio_msg *req,
+		      int more_in_batch,
+		      void *cb_user_context)
+{
+	int			nr = __sync_fetch_and_add(&served, 1);
+	struct xio_msg		*rsp = &rsps[nr % EARLY_REQS_NR];
+
+	/* echo the request header back */
+	memset(rsp, 0, sizeof(*rsp));
+	rsp->request		= req;
+	rsp->out.header		= req->in.header;
+	rsp->out.sgl_type	= XIO_SGL_TYPE_IOV;
+
+	if (xio_send_response(rsp) == -1)
+		fprintf(stderr, "sending response failed. %s\n",
+			xio_strerror(xio_errno()));
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg				=  on_request,
+};
+
+/*---------------------------------------------------------------------------*/
+/* portal_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *portal_thread(void *data)
+{
+	xio_context_run_loop(portal.ctx, XIO_INFINITE);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	printf("Usage: %s server_addr port [accept|portal|redirect] " \
+	       "[transport]\n", argv0);
+	exit(1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	const char	*transport = XIO_DEF_TRANSPORT;
+	char		url[256];
+	pthread_t	tid;
+	int		port;
+
+	if (argc < 3)
+		usage(argv[0]);
+	port = atoi(argv[2]);
+	if (argc > 3) {
+		if (!strcmp(argv[3], "portal"))
+			mode = EARLY_MODE_PORTAL;
+		else if (!strcmp(argv[3], "redirect"))
+			mode = EARLY_MODE_REDIRECT;
+		else if (strcmp(argv[3], "accept"))
+			usage(argv[0]);
+	}
+	if (argc > 4)
+		transport = argv[4];
+
+	xio_init();
+
+	listener.ctx = xio_context_create(NULL, 0, -1);
+	portal.ctx = xio_context_create(NULL, 0, -1);
+	portal.is_portal = 1;
+
+	sprintf(url, "%s://%s:%d", transport, argv[1], port);
+	sprintf(portal_url, "%s://%s:%d", transport, argv[1], port + 1);
+
+	listener.server = xio_bind(listener.ctx, &server_ops, url, NULL, 0,
+				   &listener);
+	portal.server = xio_bind(portal.ctx, &server_ops, portal_url, NULL, 0,
+				 &portal);
+	if (listener.server == NULL || portal.server == NULL) {
+		fprintf(stderr, "bind failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	printf("listen to %s, portal %s\n", url, portal_url);
+
+	pthread_create(&tid, NULL, portal_thread, NULL);
+	xio_context_run_loop(listener.ctx, XIO_INFINITE);
+	pthread_join(tid, NULL);
+
+	printf("served %d requests\n", served);
+
+	xio_unbind(portal.server);
+	xio_unbind(listener.server);
+	xio_context_destroy(portal.ctx);
+	xio_context_destroy(listener.ctx);
+
+	xio_shutdown();
+
+	return 0;
+}
+
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define POOL_CTXS_NR		2
+#define POOL_REQS_NR		64
+#define POOL_WINDOW		4	/* requests in flight */
+#define POOL_MAX_CONNS		8
+
+struct pool_req {
+	struct xio_msg		msg;
+	int			busy;
+	int			pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_context		*ctxs[POOL_CTXS_NR];
+static struct xio_connection_pool	*pool;
+static struct pool_req			reqs[POOL_WINDOW];
+static int				answered_by[POOL_MAX_CONNS + 1];
+static int				nsent;
+static int				nrsps;
+static int				nflushed;
+static int				nerrors;
+static int				done;
+
+/*---------------------------------------------------------------------------*/
+/* find_req								     */
+/*---------------------------------------------------------------------------*/
+static struct pool_req *find_req(struct xio_msg *msg)
+{
+	int i;
+
+	for (i = 0; i < POOL_WINDOW; i++)
+		if (&reqs[i].msg == msg)
+			return &reqs[i];
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* send_requests - keep the window full over the pool			     */
+/*---------------------------------------------------------------------------*/
+static void send_requests(void)
+{
+	struct pool_req *r;
+	int		i;
+
+	for (i = 0; i < POOL_WINDOW && nsent < POOL_REQS_NR; i++) {
+		r = &reqs[i];
+		if (r->busy)
+			continue;
+		memset(&r->msg, 0, sizeof(r->msg));
+		r->msg.out.sgl_type = XIO_SGL_TYPE_IOV;
+		r->msg.in.sgl_type  = XIO_SGL_TYPE_IOV;
+		/* no connection online yet, retry on the next round */
+		if (xio_connection_pool_send_request(pool, &r->msg, 0) == -1)
+			break;
+		r->busy = 1;
+		nsent++;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	printf("session event: %s. connection:%p, reason: %s\n",
+	       xio_session_event_str(event_data->event), event_data->conn,
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_REJECT_EVENT:
+		nerrors++;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		done = 1;
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *rsp,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	struct pool_req *r = find_req(rsp);
+	int		id = 0;
+
+	if (rsp->in.header.iov_base &&
+	    sscanf(rsp->in.header.iov_base, "conn %d", &id) == 1 &&
+	    id > 0 && id <= POOL_MAX_CONNS)
+		answered_by[id]++;
+	else
+		nerrors++;
+	xio_release_response(rsp);
+	if (r)
+		r->busy = 0;
+	nrsps++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error,
+			struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct pool_req *r = find_req(msg);
+
+	/* flushed off the evicted connection, send it again */
+	printf("message error: %s\n", xio_strerror(error));
+	if (r == NULL) {
+		nerrors++;
+		return 0;
+	}
+	r->busy = 0;
+	nsent--;
+	nflushed++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_session_params		params;
+	struct xio_connection_pool_params	pool_params;
+	struct xio_session			*session;
+	const char				*transport = XIO_DEF_TRANSPORT;
+	char					url[256];
+	int					i, nconns = 0;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [transport]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		transport = argv[3];
+
+	xio_init();
+
+	for (i = 0; i < POOL_CTXS_NR; i++)
+		ctxs[i] = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &ses_ops;
+	params.uri		= url;
+
+	session = xio_session_create(&params);
+	if (session == NULL) {
+		fprintf(stderr, "session creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+
+	memset(&pool_params, 0, sizeof(pool_params));
+	pool_params.session		= session;
+	pool_params.ctxs		= ctxs;
+	pool_params.ctxs_nr		= POOL_CTXS_NR;
+	pool_params.policy		= XIO_CONNECTION_POOL_LEAST_OUTSTANDING;
+	pool_params.reconnect_delay_ms	= 50;
+	pool = xio_connection_pool_create(&pool_params);
+	if (pool == NULL) {
+		fprintf(stderr, "pool creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+
+	/* the pool is not thread safe, one thread dispatches all contexts */
+	while (!done) {
+		for (i = 0; i < POOL_CTXS_NR; i++)
+			xio_context_run_loop(ctxs[i], 10);
+		if (pool == NULL)
+			continue;
+		if (nrsps < POOL_REQS_NR) {
+			send_requests();
+			continue;
+		}
+		xio_connection_pool_destroy(pool);
+		pool = NULL;
+	}
+
+	for (i = 1; i <= POOL_MAX_CONNS; i++) {
+		if (!answered_by[i])
+			continue;
+		printf("connection %d answered %d requests\n", i,
+		       answered_by[i]);
+		nconns++;
+	}
+	printf("responses %d/%d, flushed %d, errors %d\n", nrsps,
+	       POOL_REQS_NR, nflushed, nerrors);
+
+	for (i = 0; i < POOL_CTXS_NR; i++)
+		xio_context_destroy(ctxs[i]);
+
+	xio_shutdown();
+
+	/* both pooled connections and the replacement of the evicted one
+	 * carried requests
+	 */
+	return (nrsps == POOL_REQS_NR && !nerrors && nconns == 3) ? 0 : 1;
+}
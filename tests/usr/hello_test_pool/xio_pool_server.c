@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define POOL_MAX_CONNS		8
+#define POOL_EVICT_AT		16	/* requests before the first is cut */
+#define POOL_RSPS_NR		64
+#define POOL_HDR_LEN		32
+
+struct pool_conn {
+	struct xio_connection	*conn;
+	int			id;
+	int			served;
+	char			hdr[POOL_HDR_LEN];
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_context	*ctx;
+static struct pool_conn		conns[POOL_MAX_CONNS];
+static struct xio_msg		rsps[POOL_RSPS_NR];
+static int			conns_nr;
+static int			served;
+static int			evicted;
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct xio_connection_attr	conn_attr;
+	struct pool_conn		*pc;
+
+	printf("session event: %s. session:%p, connection:%p, reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       session, event_data->conn,
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_NEW_CONNECTION_EVENT:
+		if (conns_nr == POOL_MAX_CONNS) {
+			xio_disconnect(event_data->conn);
+			break;
+		}
+		/* tell the client which connection answered */
+		pc = &conns[conns_nr++];
+		pc->conn = event_data->conn;
+		pc->id	 = conns_nr;
+		sprintf(pc->hdr, "conn %d", pc->id);
+		conn_attr.user_context = pc;
+		xio_modify_connection(event_data->conn, &conn_attr,
+				      XIO_CONNECTION_ATTR_USER_CTX);
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_request								     */
+/*---------------------------------------------------------------------------*/
+static int on_request(struct xio_session *session,
+		      struct xio_msg *req,
+		      int more_in_batch,
+		      void *cb_user_context)
+{
+	struct pool_conn	*pc = cb_user_context;
+	struct xio_msg		*rsp = &rsps[served++ % POOL_RSPS_NR];
+
+	memset(rsp, 0, sizeof(*rsp));
+	rsp->request			= req;
+	rsp->out.header.iov_base	= pc->hdr;
+	rsp->out.header.iov_len		= strlen(pc->hdr) + 1;
+	rsp->out.sgl_type		= XIO_SGL_TYPE_IOV;
+	if (xio_send_response(rsp) == -1)
+		fprintf(stderr, "sending response failed. %s\n",
+			xio_strerror(xio_errno()));
+
+	/* cut the first connection, the pool must replace it */
+	if (++pc->served == POOL_EVICT_AT && pc->id == 1 && !evicted) {
+		printf("disconnecting connection %d\n", pc->id);
+		evicted = 1;
+		xio_disconnect(pc->conn);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg				=  on_request,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_server	*server;
+	const char		*transport = XIO_DEF_TRANSPORT;
+	char			url[256];
+	int			i;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [transport]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		transport = argv[3];
+
+	xio_init();
+
+	ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+	server = xio_bind(ctx, &server_ops, url, NULL, 0, NULL);
+	if (server == NULL) {
+		fprintf(stderr, "bind failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	printf("listen to %s\n", url);
+
+	xio_context_run_loop(ctx, XIO_INFINITE);
+
+	for (i = 0; i < conns_nr; i++)
+		printf("connection %d served %d requests\n", conns[i].id,
+		       conns[i].served);
+	printf("served %d requests over %d connections\n", served,
+	       conns_nr);
+
+	xio_unbind(server);
+	xio_context_destroy(ctx);
+
+	xio_shutdown();
+
+	/* two pooled connections, plus the one replacing the evicted */
+	return (evicted && conns_nr == 3) ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define REDIRECT_WORKERS_NR	2
+#define REDIRECT_SESSIONS_NR	4
+#define REDIRECT_HDR_LEN	32
+
+struct redirect_session {
+	struct xio_session	*session;
+	struct xio_connection	*conn;
+	struct xio_msg		req;
+	char			hdr[REDIRECT_HDR_LEN];
+	char			answered_by[REDIRECT_HDR_LEN];
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_context	*ctx;
+static struct redirect_session	sessions[REDIRECT_SESSIONS_NR];
+static int			nrsps;
+static int			nerrors;
+static int			teardowns;
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	printf("session event: %s. reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+		nerrors++;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		if (++teardowns == REDIRECT_SESSIONS_NR)
+			xio_context_stop_loop(ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *rsp,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	struct redirect_session	*rs = cb_user_context;
+	int			i;
+
+	snprintf(rs->answered_by, sizeof(rs->answered_by), "%.*s",
+		 (int)rsp->in.header.iov_len,
+		 (char *)rsp->in.header.iov_base);
+	xio_release_response(rsp);
+
+	/* keep every session open until all are answered, so that each
+	 * one loads its worker while the next is balanced
+	 */
+	if (++nrsps < REDIRECT_SESSIONS_NR)
+		return 0;
+	for (i = 0; i < REDIRECT_SESSIONS_NR; i++)
+		xio_disconnect(sessions[i].conn);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error,
+			struct xio_msg *msg,
+			void *cb_user_context)
+{
+	fprintf(stderr, "message error: %s\n", xio_strerror(error));
+	nerrors++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* check_answers							     */
+/*---------------------------------------------------------------------------*/
+static int check_answers(const char *mode)
+{
+	int used[REDIRECT_WORKERS_NR + 1] = { 0 };
+	int i, id, nused = 0;
+
+	for (i = 0; i < REDIRECT_SESSIONS_NR; i++) {
+		printf("session %d answered by %s\n", i,
+		       sessions[i].answered_by);
+		if (sscanf(sessions[i].answered_by, "worker %d", &id) != 1)
+			id = 0;
+		if (id < 0 || id > REDIRECT_WORKERS_NR)
+			return -1;
+		if (!used[id]++)
+			nused++;
+	}
+	/* deferred sessions stay on the listener, auto ones are spread */
+	if (!strcmp(mode, "defer"))
+		return (used[0] == REDIRECT_SESSIONS_NR) ? 0 : -1;
+
+	return (!used[0] && nused == REDIRECT_WORKERS_NR) ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_session_params	params;
+	const char			*transport = XIO_DEF_TRANSPORT;
+	const char			*mode = "auto";
+	char				url[256];
+	int				i;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [auto|defer] [transport]\n",
+		       argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		mode = argv[3];
+	if (argc > 4)
+		transport = argv[4];
+
+	xio_init();
+
+	ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	for (i = 0; i < REDIRECT_SESSIONS_NR; i++) {
+		struct redirect_session *rs = &sessions[i];
+
+		memset(&params, 0, sizeof(params));
+		params.type		= XIO_SESSION_CLIENT;
+		params.ses_ops		= &ses_ops;
+		params.user_context	= rs;
+		params.uri		= url;
+
+		rs->session = xio_session_create(&params);
+		if (rs->session == NULL) {
+			fprintf(stderr, "session creation failed. %s\n",
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+		rs->conn = xio_connect(rs->session, ctx, 0, NULL, rs);
+
+		snprintf(rs->hdr, REDIRECT_HDR_LEN, "session %d", i);
+		rs->req.out.header.iov_base	= rs->hdr;
+		rs->req.out.header.iov_len	= strlen(rs->hdr) + 1;
+		rs->req.out.sgl_type		= XIO_SGL_TYPE_IOV;
+		rs->req.in.sgl_type		= XIO_SGL_TYPE_IOV;
+		if (xio_send_request(rs->conn, &rs->req) == -1) {
+			fprintf(stderr, "sending request failed. %s\n",
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+	}
+
+	xio_context_run_loop(ctx, XIO_INFINITE);
+
+	printf("responses %d/%d, errors %d\n", nrsps,
+	       REDIRECT_SESSIONS_NR, nerrors);
+
+	xio_context_destroy(ctx);
+
+	xio_shutdown();
+
+	if (nrsps != REDIRECT_SESSIONS_NR || nerrors)
+		return 1;
+
+	return check_answers(mode) ? 1 : 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define REDIRECT_WORKERS_NR	2
+#define REDIRECT_SESSIONS_NR	4
+#define REDIRECT_HDR_LEN	32
+
+enum redirect_mode {
+	REDIRECT_MODE_AUTO,	/* unanswered sessions go to the workers */
+	REDIRECT_MODE_DEFER	/* the listener accepts after the callback */
+};
+
+struct redirect_server {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	int			id;	/* 0 - listener, workers from 1 */
+	int			pad;
+	pthread_t		tid;
+	char			url[256];
+	char			hdr[REDIRECT_HDR_LEN];
+	struct xio_msg		rsps[REDIRECT_SESSIONS_NR];
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static enum redirect_mode	mode = REDIRECT_MODE_AUTO;
+static struct redirect_server	listener;
+static struct redirect_server	workers[REDIRECT_WORKERS_NR];
+static struct xio_session	*deferred[REDIRECT_SESSIONS_NR];
+static int			deferred_nr;
+static int			served;
+static int			done;
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct redirect_server *srv = cb_user_context;
+	int			i;
+
+	printf("server %d session event: %s. session:%p, reason: %s\n",
+	       srv->id, xio_session_event_str(event_data->event),
+	       session, xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		/* a redirected session ends before the one that answers */
+		if (mode == REDIRECT_MODE_AUTO && !srv->id)
+			break;
+		if (__sync_add_and_fetch(&done, 1) < REDIRECT_SESSIONS_NR)
+			break;
+		for (i = 0; i < REDIRECT_WORKERS_NR; i++)
+			xio_context_stop_loop(workers[i].ctx, 0);
+		xio_context_stop_loop(listener.ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	struct redirect_server *srv = cb_user_context;
+
+	/* the listener leaves the session unanswered, either to the auto
+	 * redirect or to the deferred accept in the main loop
+	 */
+	if (srv->id)
+		xio_accept(session, NULL, 0, NULL, 0);
+	else if (mode == REDIRECT_MODE_DEFER)
+		deferred[deferred_nr++] = session;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_request								     */
+/*---------------------------------------------------------------------------*/
+static int on_request(struct xio_session *session,
+		      struct xio_msg *req,
+		      int more_in_batch,
+		      void *cb_user_context)
+{
+	struct redirect_server	*srv = cb_user_context;
+	int			nr = __sync_fetch_and_add(&served, 1);
+	struct xio_msg		*rsp = &srv->rsps[nr % REDIRECT_SESSIONS_NR];
+
+	/* answer with the server that got the session */
+	memset(rsp, 0, sizeof(*rsp));
+	rsp->request			= req;
+	rsp->out.header.iov_base	= srv->hdr;
+	rsp->out.header.iov_len		= strlen(srv->hdr) + 1;
+	rsp->out.sgl_type		= XIO_SGL_TYPE_IOV;
+
+	if (xio_send_response(rsp) == -1)
+		fprintf(stderr, "sending response failed. %s\n",
+			xio_strerror(xio_errno()));
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg				=  on_request,
+};
+
+/*---------------------------------------------------------------------------*/
+/* worker_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *worker_thread(void *data)
+{
+	struct redirect_server *worker = data;
+
+	xio_context_run_loop(worker->ctx, XIO_INFINITE);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_bind								     */
+/*---------------------------------------------------------------------------*/
+static int server_bind(struct redirect_server *srv, int id,
+		       const char *transport, const char *addr, int port)
+{
+	srv->id = id;
+	srv->ctx = xio_context_create(NULL, 0, -1);
+	sprintf(srv->url, "%s://%s:%d", transport, addr, port);
+	if (id)
+		sprintf(srv->hdr, "worker %d", id);
+	else
+		sprintf(srv->hdr, "listener");
+
+	srv->server = xio_bind(srv->ctx, &server_ops, srv->url, NULL, 0, srv);
+	if (srv->server == NULL) {
+		fprintf(stderr, "bind to %s failed. %s\n", srv->url,
+			xio_strerror(xio_errno()));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	printf("Usage: %s server_addr port [auto|defer] [transport]\n",
+	       argv0);
+	exit(1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	const char	*transport = XIO_DEF_TRANSPORT;
+	int		port, i;
+
+	if (argc < 3)
+		usage(argv[0]);
+	port = atoi(argv[2]);
+	if (argc > 3) {
+		if (!strcmp(argv[3], "defer"))
+			mode = REDIRECT_MODE_DEFER;
+		else if (strcmp(argv[3], "auto"))
+			usage(argv[0]);
+	}
+	if (argc > 4)
+		transport = argv[4];
+
+	xio_init();
+
+	if (server_bind(&listener, 0, transport, argv[1], port))
+		return 1;
+	for (i = 0; i < REDIRECT_WORKERS_NR; i++) {
+		if (server_bind(&workers[i], i + 1, transport, argv[1],
+				port + i + 1))
+			return 1;
+		if (xio_server_add_portal(listener.server, workers[i].url,
+					  workers[i].ctx)) {
+			fprintf(stderr, "adding portal failed. %s\n",
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+	}
+	/* portals are registered in both modes, only auto balances */
+	if (mode == REDIRECT_MODE_AUTO)
+		xio_server_set_auto_redirect(listener.server, 1);
+	printf("listen to %s, %d workers\n", listener.url,
+	       REDIRECT_WORKERS_NR);
+
+	for (i = 0; i < REDIRECT_WORKERS_NR; i++)
+		pthread_create(&workers[i].tid, NULL, worker_thread,
+			       &workers[i]);
+
+	while (__sync_fetch_and_add(&done, 0) < REDIRECT_SESSIONS_NR) {
+		xio_context_run_loop(listener.ctx, 10);
+		/* answer outside of on_new_session */
+		for (i = 0; i < deferred_nr; i++)
+			xio_accept(deferred[i], NULL, 0, NULL, 0);
+		deferred_nr = 0;
+	}
+
+	for (i = 0; i < REDIRECT_WORKERS_NR; i++)
+		pthread_join(workers[i].tid, NULL);
+
+	printf("served %d requests\n", served);
+
+	for (i = 0; i < REDIRECT_WORKERS_NR; i++) {
+		xio_server_del_portal(listener.server, workers[i].url);
+		xio_unbind(workers[i].server);
+		xio_context_destroy(workers[i].ctx);
+	}
+	xio_unbind(listener.server);
+	xio_context_destroy(listener.ctx);
+
+	xio_shutdown();
+
+	return 0;
+}
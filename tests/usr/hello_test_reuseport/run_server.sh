@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Get Running Directory
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+cd $DIR
+
+
+# Arguments Check
+if [ $# -lt 2 ]; then
+        echo "[$0] Missing Parameters!"
+        echo "Usage: $0 Server-IP Port [mode: addr, cpu, kernel or nocbpf. default=addr] [transport. default=tcp]"
+        exit 1
+fi
+
+export LD_LIBRARY_PATH=../../../src/usr/
+
+server_ip=$1
+port=$2
+
+if [ -z "$3" ]
+then
+	mode="addr"
+else
+	mode=$3
+fi
+
+if [ -z "$4" ]
+then
+	trans="tcp"
+else
+	trans=$4
+fi
+
+./xio_reuseport_server ${server_ip} ${port} ${mode} ${trans}
+
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"tcp"
+#define REUSEPORT_SESSIONS_NR	8
+#define REUSEPORT_HDR_LEN	32
+
+struct reuseport_session {
+	struct xio_session	*session;
+	struct xio_connection	*conn;
+	int			id;
+	int			answered;
+	struct xio_msg		req;
+	char			hdr[REUSEPORT_HDR_LEN];
+};
+
+struct reuseport_client {
+	struct xio_context	*ctx;
+	int			nrsps;
+	int			nerrors;
+	int			nteardowns;
+	int			pad;
+	struct reuseport_session sessions[REUSEPORT_SESSIONS_NR];
+};
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct reuseport_client *client = cb_user_context;
+
+	printf("session event: %s. reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+	case XIO_SESSION_CONNECTION_ERROR_EVENT:
+		client->nerrors++;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		if (++client->nteardowns == REUSEPORT_SESSIONS_NR)
+			xio_context_stop_loop(client->ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *rsp,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	struct reuseport_client	 *client = cb_user_context;
+	struct reuseport_session *s = rsp->user_context;
+
+	printf("session %d answered by %.*s\n", s->id,
+	       (int)rsp->in.header.iov_len, (char *)rsp->in.header.iov_base);
+	if (strncmp(rsp->in.header.iov_base, "shard ", 6))
+		client->nerrors++;
+	s->answered++;
+	client->nrsps++;
+
+	xio_release_response(rsp);
+	xio_disconnect(s->conn);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error,
+			struct xio_msg *msg,
+			void *cb_user_context)
+{
+	struct reuseport_client *client = cb_user_context;
+
+	fprintf(stderr, "message error: %s\n", xio_strerror(error));
+	client->nerrors++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct reuseport_client		client;
+	struct xio_session_params	params;
+	const char			*transport = XIO_DEF_TRANSPORT;
+	const char			*mode = "addr";
+	char				url[256];
+	int				dual_stream = 0;
+	int				i;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [addr|cpu|kernel|nocbpf] " \
+		       "[transport]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		mode = argv[3];
+	if (argc > 4)
+		transport = argv[4];
+
+	xio_init();
+
+	/* the control and data streams of a connection may land on
+	 * different shards unless the server steers by client address
+	 */
+	if (strcmp(mode, "addr"))
+		xio_set_opt(NULL, XIO_OPTLEVEL_TCP,
+			    XIO_OPTNAME_TCP_DUAL_STREAM,
+			    &dual_stream, sizeof(dual_stream));
+
+	memset(&client, 0, sizeof(client));
+	client.ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &ses_ops;
+	params.user_context	= &client;
+	params.uri		= url;
+
+	for (i = 0; i < REUSEPORT_SESSIONS_NR; i++) {
+		struct reuseport_session *s = &client.sessions[i];
+
+		s->id = i;
+		s->session = xio_session_create(&params);
+		if (s->session == NULL) {
+			fprintf(stderr, "session creation failed. %s\n",
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+		s->conn = xio_connect(s->session, client.ctx, 0, NULL,
+				      &client);
+
+		snprintf(s->hdr, REUSEPORT_HDR_LEN, "session %d", i);
+		s->req.out.header.iov_base = s->hdr;
+		s->req.out.header.iov_len  = strlen(s->hdr) + 1;
+		s->req.out.sgl_type	   = XIO_SGL_TYPE_IOV;
+		s->req.in.sgl_type	   = XIO_SGL_TYPE_IOV;
+		s->req.user_context	   = s;
+		if (xio_send_request(s->conn, &s->req) == -1) {
+			fprintf(stderr, "sending request failed. %s\n",
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+	}
+
+	xio_context_run_loop(client.ctx, XIO_INFINITE);
+
+	printf("responses %d/%d, errors %d\n", client.nrsps,
+	       REUSEPORT_SESSIONS_NR, client.nerrors);
+
+	xio_context_destroy(client.ctx);
+
+	xio_shutdown();
+
+	return (client.nrsps == REUSEPORT_SESSIONS_NR && !client.nerrors) ?
+		0 : 1;
+}
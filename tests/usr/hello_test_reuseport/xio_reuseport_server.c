@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"tcp"
+#define REUSEPORT_SHARDS_NR	2
+#define REUSEPORT_SESSIONS_NR	8
+#define REUSEPORT_HDR_LEN	32
+
+struct reuseport_shard {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	int			id;
+	int			sessions;
+	pthread_t		tid;
+	char			hdr[REUSEPORT_HDR_LEN];
+	struct xio_msg		rsps[REUSEPORT_SESSIONS_NR];
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct reuseport_shard	shards[REUSEPORT_SHARDS_NR];
+static int			served;
+static int			done;
+
+/*---------------------------------------------------------------------------*/
+/* disable_cbpf - make the kernel look like one without			     */
+/* SO_ATTACH_REUSEPORT_CBPF, the library must fall back to its hash	     */
+/*---------------------------------------------------------------------------*/
+static int disable_cbpf(void)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+			 offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_setsockopt, 0, 3),
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+			 offsetof(struct seccomp_data, args[2])),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+			 SO_ATTACH_REUSEPORT_CBPF, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K,
+			 SECCOMP_RET_ERRNO | (ENOPROTOOPT & SECCOMP_RET_DATA)),
+		BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_fprog prog = {
+		.len	= sizeof(filter) / sizeof(filter[0]),
+		.filter	= filter,
+	};
+	int fd, retval;
+
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) ||
+	    prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog)) {
+		fprintf(stderr, "installing seccomp filter failed. %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	/* make sure the library will really see the old kernel errno */
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	retval = setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+			    &prog, sizeof(prog));
+	close(fd);
+	if (retval != -1 || errno != ENOPROTOOPT) {
+		fprintf(stderr, "cbpf still attachable. %s\n",
+			strerror(errno));
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct reuseport_shard	*shard = cb_user_context;
+	int			i;
+
+	printf("shard %d session event: %s. session:%p, reason: %s\n",
+	       shard->id, xio_session_event_str(event_data->event),
+	       session, xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		if (__sync_add_and_fetch(&done, 1) < REUSEPORT_SESSIONS_NR)
+			break;
+		for (i = 0; i < REUSEPORT_SHARDS_NR; i++)
+			xio_context_stop_loop(shards[i].ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	struct reuseport_shard *shard = cb_user_context;
+
+	/* the accept and the handshake ran on this shard's thread */
+	shard->sessions++;
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_request								     */
+/*---------------------------------------------------------------------------*/
+static int on_request(struct xio_session *session,
+		      struct xio_msg *req,
+		      int more_in_batch,
+		      void *cb_user_context)
+{
+	struct reuseport_shard	*shard = cb_user_context;
+	int			nr = __sync_fetch_and_add(&served, 1);
+	struct xio_msg		*rsp = &shard->rsps[nr % REUSEPORT_SESSIONS_NR];
+
+	memset(rsp, 0, sizeof(*rsp));
+	rsp->request			= req;
+	rsp->out.header.iov_base	= shard->hdr;
+	rsp->out.header.iov_len		= strlen(shard->hdr) + 1;
+	rsp->out.sgl_type		= XIO_SGL_TYPE_IOV;
+
+	if (xio_send_response(rsp) == -1)
+		fprintf(stderr, "sending response failed. %s\n",
+			xio_strerror(xio_errno()));
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg				=  on_request,
+};
+
+/*---------------------------------------------------------------------------*/
+/* shard_thread								     */
+/*---------------------------------------------------------------------------*/
+static void *shard_thread(void *data)
+{
+	struct reuseport_shard *shard = data;
+
+	xio_context_run_loop(shard->ctx, XIO_INFINITE);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *argv0)
+{
+	printf("Usage: %s server_addr port [addr|cpu|kernel|nocbpf] " \
+	       "[transport]\n", argv0);
+	exit(1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	const char	*transport = XIO_DEF_TRANSPORT;
+	const char	*mode = "addr";
+	char		url[256];
+	int		steering = XIO_TCP_STEERING_PEER_ADDR;
+	int		nshards = REUSEPORT_SHARDS_NR;
+	int		log_level = XIO_LOG_LEVEL_WARN;
+	int		i, used = 0, total = 0;
+
+	if (argc < 3)
+		usage(argv[0]);
+	if (argc > 3)
+		mode = argv[3];
+	if (argc > 4)
+		transport = argv[4];
+
+	if (!strcmp(mode, "cpu"))
+		steering = XIO_TCP_STEERING_CPU;
+	else if (!strcmp(mode, "kernel"))
+		steering = XIO_TCP_STEERING_KERNEL;
+	else if (!strcmp(mode, "nocbpf"))
+		steering = XIO_TCP_STEERING_PEER_ADDR;
+	else if (strcmp(mode, "addr"))
+		usage(argv[0]);
+
+	if (!strcmp(mode, "nocbpf") && disable_cbpf())
+		return 1;
+
+	xio_init();
+
+	/* show the steering fallback warning */
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_LEVEL,
+		    &log_level, sizeof(log_level));
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_REUSEPORT,
+		    &nshards, sizeof(nshards));
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP,
+		    XIO_OPTNAME_TCP_REUSEPORT_STEERING,
+		    &steering, sizeof(steering));
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	/* every shard binds the same uri from its own context */
+	for (i = 0; i < REUSEPORT_SHARDS_NR; i++) {
+		struct reuseport_shard *shard = &shards[i];
+
+		shard->id = i;
+		sprintf(shard->hdr, "shard %d", i);
+		shard->ctx = xio_context_create(NULL, 0, -1);
+		shard->server = xio_bind(shard->ctx, &server_ops, url, NULL,
+					 0, shard);
+		if (shard->server == NULL) {
+			fprintf(stderr, "shard %d bind failed. %s\n", i,
+				xio_strerror(xio_errno()));
+			return 1;
+		}
+	}
+	printf("listen to %s, %d shards, %s steering\n", url,
+	       REUSEPORT_SHARDS_NR, mode);
+
+	for (i = 0; i < REUSEPORT_SHARDS_NR; i++)
+		pthread_create(&shards[i].tid, NULL, shard_thread,
+			       &shards[i]);
+	for (i = 0; i < REUSEPORT_SHARDS_NR; i++)
+		pthread_join(shards[i].tid, NULL);
+
+	for (i = 0; i < REUSEPORT_SHARDS_NR; i++) {
+		printf("shard %d accepted %d sessions\n", i,
+		       shards[i].sessions);
+		total += shards[i].sessions;
+		if (shards[i].sessions)
+			used++;
+		xio_unbind(shards[i].server);
+		xio_context_destroy(shards[i].ctx);
+	}
+
+	xio_shutdown();
+
+	if (total != REUSEPORT_SESSIONS_NR || served != REUSEPORT_SESSIONS_NR)
+		return 1;
+	/* one client address - address steering keeps it on one shard */
+	if (!strcmp(mode, "addr") && used != 1)
+		return 1;
+
+	return 0;
+}
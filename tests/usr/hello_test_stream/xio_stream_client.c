@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define STREAM_CHUNKS_NR	256
+#define STREAM_CHUNK_LEN	16384
+#define STREAM_WINDOW		8
+
+struct stream_client {
+	struct xio_context	*ctx;
+	struct xio_connection	*conn;
+	struct xio_stream	*stream;
+	struct xio_msg		*free_chunks[STREAM_WINDOW];
+	int			nfree;
+	int			nwritten;
+	int			nacked;
+	int			nerrors;
+	int			closed;
+	int			expect_reject;
+	enum xio_status		status;
+	int			pad;
+	struct xio_msg		chunks[STREAM_WINDOW];
+	char			bufs[STREAM_WINDOW][STREAM_CHUNK_LEN];
+};
+
+/*---------------------------------------------------------------------------*/
+/* fill_chunk								     */
+/*---------------------------------------------------------------------------*/
+static void fill_chunk(char *buf, int seq)
+{
+	int i;
+
+	/* the server checks the same pattern */
+	for (i = 0; i < STREAM_CHUNK_LEN; i++)
+		buf[i] = (char)(seq * 7 + i);
+}
+
+/*---------------------------------------------------------------------------*/
+/* write_chunks								     */
+/*---------------------------------------------------------------------------*/
+static void write_chunks(struct stream_client *client)
+{
+	struct xio_msg		*chunk;
+	struct xio_iovec_ex	*sglist;
+	int			last;
+
+	/* keep the window full until the last chunk is written */
+	while (client->nfree && client->nwritten < STREAM_CHUNKS_NR) {
+		chunk = client->free_chunks[client->nfree - 1];
+		sglist = vmsg_sglist(&chunk->out);
+		fill_chunk(sglist[0].iov_base, client->nwritten);
+
+		last = (client->nwritten == STREAM_CHUNKS_NR - 1);
+		if (xio_stream_write(client->stream, chunk, last) == -1) {
+			/* EAGAIN only if the window is full */
+			if (xio_errno() != EAGAIN &&
+			    !client->expect_reject) {
+				fprintf(stderr, "stream write failed. %s\n",
+					xio_strerror(xio_errno()));
+				client->nerrors++;
+			}
+			break;
+		}
+		client->nfree--;
+		client->nwritten++;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_stream_chunk_ack							     */
+/*---------------------------------------------------------------------------*/
+static int on_stream_chunk_ack(struct xio_stream *stream,
+			       struct xio_msg *chunk,
+			       void *user_context)
+{
+	struct stream_client *client = user_context;
+
+	client->nacked++;
+	client->free_chunks[client->nfree++] = chunk;
+	write_chunks(client);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_stream_close							     */
+/*---------------------------------------------------------------------------*/
+static int on_stream_close(struct xio_stream *stream,
+			   enum xio_status status,
+			   void *user_context)
+{
+	struct stream_client *client = user_context;
+
+	printf("stream closed. written %d, acknowledged %d, status: %s\n",
+	       client->nwritten, client->nacked, xio_strerror(status));
+
+	client->status = status;
+	client->closed = 1;
+	client->stream = NULL;
+	xio_disconnect(client->conn);
+
+	return 0;
+}
+
+static struct xio_stream_ops stream_ops = {
+	.on_stream_chunk_ack		=  on_stream_chunk_ack,
+	.on_stream_close		=  on_stream_close,
+};
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct stream_client *client = cb_user_context;
+
+	printf("session event: %s. reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+		client->nerrors++;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(client->ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_established						     */
+/*---------------------------------------------------------------------------*/
+static int on_session_established(struct xio_session *session,
+				  struct xio_new_session_rsp *rsp,
+				  void *cb_user_context)
+{
+	struct stream_client		*client = cb_user_context;
+	struct xio_stream_params	params;
+
+	memset(&params, 0, sizeof(params));
+	params.connection	= client->conn;
+	params.ops		= &stream_ops;
+	params.user_context	= client;
+	params.window		= STREAM_WINDOW;
+
+	client->stream = xio_stream_open(&params);
+	if (client->stream == NULL) {
+		fprintf(stderr, "stream open failed. %s\n",
+			xio_strerror(xio_errno()));
+		client->nerrors++;
+		xio_disconnect(client->conn);
+		return 0;
+	}
+	write_chunks(client);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_session_established		=  on_session_established,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct stream_client		*client;
+	struct xio_session_params	params;
+	struct xio_session		*session;
+	struct xio_iovec_ex		*sglist;
+	const char			*transport = XIO_DEF_TRANSPORT;
+	char				url[256];
+	int				i, ok;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [mode: write or reject. " \
+		       "default=write] [transport]\n", argv[0]);
+		return 1;
+	}
+
+	client = calloc(1, sizeof(*client));
+	if (client == NULL)
+		return 1;
+	if (argc > 3)
+		client->expect_reject = !strcmp(argv[3], "reject");
+	if (argc > 4)
+		transport = argv[4];
+
+	for (i = 0; i < STREAM_WINDOW; i++) {
+		struct xio_msg *chunk = &client->chunks[i];
+
+		chunk->out.sgl_type		= XIO_SGL_TYPE_IOV;
+		chunk->out.data_iov.max_nents	= XIO_IOVLEN;
+		chunk->in.sgl_type		= XIO_SGL_TYPE_IOV;
+		chunk->in.data_iov.max_nents	= XIO_IOVLEN;
+
+		sglist = vmsg_sglist(&chunk->out);
+		sglist[0].iov_base	= client->bufs[i];
+		sglist[0].iov_len	= STREAM_CHUNK_LEN;
+		vmsg_sglist_set_nents(&chunk->out, 1);
+
+		client->free_chunks[client->nfree++] = chunk;
+	}
+
+	xio_init();
+
+	client->ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &ses_ops;
+	params.user_context	= client;
+	params.uri		= url;
+
+	session = xio_session_create(&params);
+	if (session == NULL) {
+		fprintf(stderr, "session creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	client->conn = xio_connect(session, client->ctx, 0, NULL, client);
+
+	xio_context_run_loop(client->ctx, XIO_INFINITE);
+
+	/* a rejected stream fails its first chunk and takes no more */
+	if (client->expect_reject)
+		ok = client->closed && client->status != XIO_E_SUCCESS &&
+		     client->nwritten <= STREAM_WINDOW;
+	else
+		ok = client->closed && client->status == XIO_E_SUCCESS &&
+		     client->nacked == STREAM_CHUNKS_NR;
+	ok = ok && !client->nerrors && client->nfree == STREAM_WINDOW;
+
+	printf("stream %s\n", ok ? "passed" : "failed");
+
+	xio_context_destroy(client->ctx);
+
+	xio_shutdown();
+
+	free(client);
+
+	return ok ? 0 : 1;
+}
+
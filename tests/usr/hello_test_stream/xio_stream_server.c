@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define STREAM_CHUNKS_NR	256
+#define STREAM_CHUNK_LEN	16384
+
+struct stream_server {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	int			reject;
+	int			nopened;
+	int			nchunks;
+	int			nerrors;
+	int			closed;
+	enum xio_status		status;
+};
+
+/*---------------------------------------------------------------------------*/
+/* check_chunk								     */
+/*---------------------------------------------------------------------------*/
+static int check_chunk(struct xio_msg *chunk, int seq)
+{
+	struct xio_iovec_ex	*sglist = vmsg_sglist(&chunk->in);
+	int			nents = vmsg_sglist_nents(&chunk->in);
+	int			i, j, off = 0;
+	char			*buf;
+
+	/* the client writes the same pattern */
+	for (i = 0; i < nents; i++) {
+		buf = sglist[i].iov_base;
+		for (j = 0; j < (int)sglist[i].iov_len; j++, off++)
+			if (buf[j] != (char)(seq * 7 + off))
+				return -1;
+	}
+
+	return (off == STREAM_CHUNK_LEN) ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_stream_open							     */
+/*---------------------------------------------------------------------------*/
+static int on_stream_open(struct xio_stream *stream,
+			  void *user_context)
+{
+	struct stream_server *srv = user_context;
+
+	printf("stream opened. %s\n", srv->reject ? "rejecting" : "accepting");
+	srv->nopened++;
+
+	return srv->reject;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_stream_chunk							     */
+/*---------------------------------------------------------------------------*/
+static int on_stream_chunk(struct xio_stream *stream,
+			   struct xio_msg *chunk,
+			   int last,
+			   void *user_context)
+{
+	struct stream_server *srv = user_context;
+
+	if (check_chunk(chunk, srv->nchunks)) {
+		fprintf(stderr, "chunk %d corrupted\n", srv->nchunks);
+		srv->nerrors++;
+	}
+	if (last != (srv->nchunks == STREAM_CHUNKS_NR - 1)) {
+		fprintf(stderr, "chunk %d unexpected last:%d\n",
+			srv->nchunks, last);
+		srv->nerrors++;
+	}
+	srv->nchunks++;
+
+	/* advances the sender's window */
+	xio_stream_release_chunk(stream, chunk);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_stream_close							     */
+/*---------------------------------------------------------------------------*/
+static int on_stream_close(struct xio_stream *stream,
+			   enum xio_status status,
+			   void *user_context)
+{
+	struct stream_server *srv = user_context;
+
+	printf("stream closed. chunks %d, status: %s\n",
+	       srv->nchunks, xio_strerror(status));
+
+	srv->status = status;
+	srv->closed = 1;
+
+	return 0;
+}
+
+static struct xio_stream_ops stream_ops = {
+	.on_stream_open			=  on_stream_open,
+	.on_stream_chunk		=  on_stream_chunk,
+	.on_stream_close		=  on_stream_close,
+};
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct stream_server *srv = cb_user_context;
+
+	printf("session event: %s. session:%p, connection:%p, reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       session, event_data->conn,
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_NEW_CONNECTION_EVENT:
+		/* streams the client opens on this connection */
+		if (xio_stream_listen(event_data->conn, &stream_ops, srv)) {
+			fprintf(stderr, "stream listen failed. %s\n",
+				xio_strerror(xio_errno()));
+			srv->nerrors++;
+		}
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(srv->ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct stream_server	srv;
+	const char		*transport = XIO_DEF_TRANSPORT;
+	char			url[256];
+	int			ok;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [mode: accept or reject. " \
+		       "default=accept] [transport]\n", argv[0]);
+		return 1;
+	}
+
+	memset(&srv, 0, sizeof(srv));
+	if (argc > 3)
+		srv.reject = !strcmp(argv[3], "reject");
+	if (argc > 4)
+		transport = argv[4];
+
+	xio_init();
+
+	srv.ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	srv.server = xio_bind(srv.ctx, &server_ops, url, NULL, 0, &srv);
+	if (srv.server == NULL) {
+		fprintf(stderr, "bind failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	printf("listen to %s\n", url);
+
+	/* serves a single session */
+	xio_context_run_loop(srv.ctx, XIO_INFINITE);
+
+	/* a rejected stream is never delivered nor closed on this side */
+	if (srv.reject)
+		ok = srv.nopened && !srv.nchunks && !srv.closed;
+	else
+		ok = srv.closed && srv.status == XIO_E_SUCCESS &&
+		     srv.nchunks == STREAM_CHUNKS_NR;
+	ok = ok && !srv.nerrors;
+
+	printf("stream %s\n", ok ? "passed" : "failed");
+
+	xio_unbind(srv.server);
+	xio_context_destroy(srv.ctx);
+
+	xio_shutdown();
+
+	return ok ? 0 : 1;
+}
+
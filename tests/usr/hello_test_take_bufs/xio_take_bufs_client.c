@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define TAKE_REQS_NR		32
+#define TAKE_MAX_SGE		2
+#define TAKE_MAX_LEN		(128 * 1024)
+
+/* inline data, data in the transport's pool and a mix of both */
+static const size_t take_lens[][TAKE_MAX_SGE] = {
+	{ 100, 0 },
+	{ TAKE_MAX_LEN, 0 },
+	{ 100, 64 * 1024 },
+};
+
+#define TAKE_LENS_NR	(int)(sizeof(take_lens) / sizeof(take_lens[0]))
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_context	*ctx;
+static struct xio_connection	*conn;
+static struct xio_msg		req;
+static unsigned char		data[TAKE_MAX_SGE][TAKE_MAX_LEN];
+static int			nrsps;
+static int			nerrors;
+
+/*---------------------------------------------------------------------------*/
+/* send_request - fill the data with a pattern the server checks	     */
+/*---------------------------------------------------------------------------*/
+static int send_request(int seq)
+{
+	const size_t	*lens = take_lens[seq % TAKE_LENS_NR];
+	struct xio_iovec_ex *sglist;
+	size_t		off = 0, i;
+	int		j;
+
+	memset(&req, 0, sizeof(req));
+	req.out.sgl_type		= XIO_SGL_TYPE_IOV;
+	req.out.data_iov.max_nents	= XIO_IOVLEN;
+	req.in.sgl_type			= XIO_SGL_TYPE_IOV;
+	sglist = vmsg_sglist(&req.out);
+	for (j = 0; j < TAKE_MAX_SGE && lens[j]; j++) {
+		for (i = 0; i < lens[j]; i++, off++)
+			data[j][i] = (unsigned char)(seq * 13 + off);
+		sglist[j].iov_base = data[j];
+		sglist[j].iov_len  = lens[j];
+	}
+	vmsg_sglist_set_nents(&req.out, j);
+
+	if (xio_send_request(conn, &req) == -1) {
+		fprintf(stderr, "sending request failed. %s\n",
+			xio_strerror(xio_errno()));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	printf("session event: %s. reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_REJECT_EVENT:
+	case XIO_SESSION_CONNECTION_REFUSED_EVENT:
+		nerrors++;
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_response								     */
+/*---------------------------------------------------------------------------*/
+static int on_response(struct xio_session *session,
+		       struct xio_msg *rsp,
+		       int more_in_batch,
+		       void *cb_user_context)
+{
+	xio_release_response(rsp);
+
+	/* one request in flight, so that the server reuses its tasks */
+	if (++nrsps == TAKE_REQS_NR || send_request(nrsps))
+		xio_disconnect(conn);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_msg_error								     */
+/*---------------------------------------------------------------------------*/
+static int on_msg_error(struct xio_session *session,
+			enum xio_status error,
+			struct xio_msg *msg,
+			void *cb_user_context)
+{
+	fprintf(stderr, "message error: %s\n", xio_strerror(error));
+	nerrors++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops ses_ops = {
+	.on_session_event		=  on_session_event,
+	.on_msg				=  on_response,
+	.on_msg_error			=  on_msg_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_session_params	params;
+	struct xio_session		*session;
+	const char			*transport = XIO_DEF_TRANSPORT;
+	char				url[256];
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [transport]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		transport = argv[3];
+
+	xio_init();
+
+	ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= &ses_ops;
+	params.uri		= url;
+
+	session = xio_session_create(&params);
+	if (session == NULL) {
+		fprintf(stderr, "session creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	conn = xio_connect(session, ctx, 0, NULL, NULL);
+	if (send_request(0))
+		return 1;
+
+	xio_context_run_loop(ctx, XIO_INFINITE);
+
+	printf("responses %d/%d, errors %d\n", nrsps, TAKE_REQS_NR, nerrors);
+
+	xio_context_destroy(ctx);
+
+	xio_shutdown();
+
+	return (nrsps == TAKE_REQS_NR && !nerrors) ? 0 : 1;
+}
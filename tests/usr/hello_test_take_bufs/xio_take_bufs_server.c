@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libxio.h"
+
+#define XIO_DEF_TRANSPORT	"rdma"
+#define TAKE_REQS_NR		32
+#define TAKE_HELD_NR		4	/* messages kept before reading */
+#define TAKE_MAX_SGE		2
+
+struct take_held {
+	struct xio_buf		*bufs[TAKE_MAX_SGE];
+	int			nbufs;
+	int			seq;
+};
+
+/*---------------------------------------------------------------------------*/
+/* globals								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_context	*ctx;
+static struct take_held		held[TAKE_HELD_NR];
+static struct xio_msg		rsps[TAKE_REQS_NR];
+static int			nreqs;
+static int			nchecked;
+static int			nerrors;
+
+/*---------------------------------------------------------------------------*/
+/* check_held - read buffers of a message released long ago, then put them  */
+/*---------------------------------------------------------------------------*/
+static void check_held(struct take_held *h)
+{
+	unsigned char	*p;
+	size_t		off = 0, i;
+	int		j;
+
+	for (j = 0; j < h->nbufs; j++) {
+		p = h->bufs[j]->addr;
+		for (i = 0; i < h->bufs[j]->length; i++, off++) {
+			if (p[i] == (unsigned char)(h->seq * 13 + off))
+				continue;
+			fprintf(stderr, "request %d sge %d: bad data at %zd\n",
+				h->seq, j, i);
+			nerrors++;
+			break;
+		}
+		xio_buf_put(h->bufs[j]);
+	}
+	if (h->nbufs)
+		nchecked++;
+	h->nbufs = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_session_event							     */
+/*---------------------------------------------------------------------------*/
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	printf("session event: %s. session:%p, connection:%p, reason: %s\n",
+	       xio_session_event_str(event_data->event),
+	       session, event_data->conn,
+	       xio_strerror(event_data->reason));
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		xio_context_stop_loop(ctx, 0);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_request								     */
+/*---------------------------------------------------------------------------*/
+static int on_request(struct xio_session *session,
+		      struct xio_msg *req,
+		      int more_in_batch,
+		      void *cb_user_context)
+{
+	struct take_held	*h = &held[nreqs % TAKE_HELD_NR];
+	struct xio_msg		*rsp = &rsps[nreqs % TAKE_REQS_NR];
+	int			i, nbufs;
+
+	/* the slot's previous buffers outlived TAKE_HELD_NR releases */
+	check_held(h);
+
+	nbufs = xio_msg_take_bufs(req, h->bufs, TAKE_MAX_SGE);
+	if (nbufs < 0) {
+		fprintf(stderr, "taking buffers failed. %s\n",
+			xio_strerror(xio_errno()));
+		nerrors++;
+		nbufs = 0;
+	}
+	/* a second reference, dropped once the response is sent */
+	for (i = 0; i < nbufs; i++)
+		xio_buf_get(h->bufs[i]);
+	h->nbufs = nbufs;
+	h->seq	 = nreqs++;
+
+	/* releases the request, the buffers stay with the server */
+	memset(rsp, 0, sizeof(*rsp));
+	rsp->request		= req;
+	rsp->out.sgl_type	= XIO_SGL_TYPE_IOV;
+	if (xio_send_response(rsp) == -1) {
+		fprintf(stderr, "sending response failed. %s\n",
+			xio_strerror(xio_errno()));
+		nerrors++;
+	}
+	for (i = 0; i < nbufs; i++)
+		xio_buf_put(h->bufs[i]);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_new_session							     */
+/*---------------------------------------------------------------------------*/
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* callbacks								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  on_session_event,
+	.on_new_session			=  on_new_session,
+	.on_msg				=  on_request,
+};
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_server	*server;
+	const char		*transport = XIO_DEF_TRANSPORT;
+	char			url[256];
+	int			i;
+
+	if (argc < 3) {
+		printf("Usage: %s server_addr port [transport]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 3)
+		transport = argv[3];
+
+	xio_init();
+
+	ctx = xio_context_create(NULL, 0, -1);
+
+	sprintf(url, "%s://%s:%s", transport, argv[1], argv[2]);
+	server = xio_bind(ctx, &server_ops, url, NULL, 0, NULL);
+	if (server == NULL) {
+		fprintf(stderr, "bind failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	printf("listen to %s\n", url);
+
+	xio_context_run_loop(ctx, XIO_INFINITE);
+
+	xio_unbind(server);
+	xio_context_destroy(ctx);
+
+	/* the last buffers outlive their connection and context */
+	for (i = 0; i < TAKE_HELD_NR; i++)
+		check_held(&held[i]);
+
+	printf("requests %d, checked %d, errors %d\n", nreqs, nchecked,
+	       nerrors);
+
+	xio_shutdown();
+
+	return (nreqs == TAKE_REQS_NR && nchecked == TAKE_REQS_NR &&
+		!nerrors) ? 0 : 1;
+}